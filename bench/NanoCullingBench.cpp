@@ -0,0 +1,183 @@
+#include "NanoFrustumCuller.hpp"
+#include "NanoJobSystem.hpp"
+#include "NanoLogger.hpp"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Throughput of every frustum culling kernel on a random scene, single threaded and over the job system,
+// with every result checked against a straightforward double precision reference.
+// Objects that sit right on a plane are skipped by the check, float and double may disagree there
+//
+// NanoCullingBench [--objects <count>] [--repeat <count>] [--threads <count>]
+
+static constexpr uint32_t VIEW_COUNT = 8;
+static constexpr double BORDER_EPSILON = 1e-3;
+
+struct Bounds {
+    glm::vec3 min;
+    glm::vec3 max;
+    float radius;
+};
+
+// -1 outside, 1 inside, 0 too close to a plane to tell
+static int referenceVisibility(const NanoFrustum& frustum, const Bounds& bounds) {
+    double center[3], extent[3];
+    for (int i = 0; i < 3; i++) {
+        center[i] = (static_cast<double>(bounds.min[i]) + bounds.max[i]) * 0.5;
+        extent[i] = (static_cast<double>(bounds.max[i]) - bounds.min[i]) * 0.5;
+    }
+    double radius = bounds.radius < 0.0f ? std::sqrt(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]) : bounds.radius;
+
+    int result = 1;
+    for (const glm::vec4& plane : frustum.planes) {
+        double distance = plane.x * center[0] + plane.y * center[1] + plane.z * center[2] + plane.w;
+        double boxRadius = std::abs(plane.x) * extent[0] + std::abs(plane.y) * extent[1] + std::abs(plane.z) * extent[2];
+        // outside the plane when outside for the box or for the sphere
+        double margin = distance + std::min(boxRadius, radius);
+        if (margin < -BORDER_EPSILON) {
+            return -1;
+        }
+        if (margin < BORDER_EPSILON) {
+            result = 0;
+        }
+    }
+    return result;
+}
+
+static bool check(const char* name, const std::vector<int>& reference, const uint32_t* visible, uint32_t visibleCount) {
+    std::vector<uint8_t> isVisible(reference.size(), 0);
+    for (uint32_t i = 0; i < visibleCount; i++) {
+        if (i > 0 && visible[i] <= visible[i - 1]) {
+            fprintf(stderr, "%s: visible indices are not sorted\n", name);
+            return false;
+        }
+        isVisible[visible[i]] = 1;
+    }
+    for (size_t i = 0; i < reference.size(); i++) {
+        if (reference[i] != 0 && (reference[i] == 1) != (isVisible[i] != 0)) {
+            fprintf(stderr, "%s: object %lu should be %s\n", name, static_cast<unsigned long>(i), reference[i] == 1 ? "visible" : "culled");
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Logger::setSeverity(ERRLevel::WARNING);
+
+    uint32_t objectCount = 1000000;
+    uint32_t repeat = 10;
+    uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--objects") == 0 && i + 1 < argc) {
+            objectCount = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = std::max(1, atoi(argv[++i]));
+        } else {
+            fprintf(stderr, "usage: %s [--objects <count>] [--repeat <count>] [--threads <count>]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // boxes of all sizes scattered around the camera, a third with a sphere tighter than their box
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> size(0.1f, 20.0f);
+    std::vector<Bounds> bounds(objectCount);
+    NanoFrustumCuller culler{};
+    culler.Resize(objectCount);
+    for (uint32_t i = 0; i < objectCount; i++) {
+        glm::vec3 center(position(random), position(random), position(random));
+        glm::vec3 extent(size(random), size(random), size(random));
+        bounds[i] = {center - extent, center + extent, i % 3 == 0 ? glm::length(extent) * 0.7f : -1.0f};
+        culler.SetBounds(i, bounds[i].min, bounds[i].max, bounds[i].radius);
+    }
+
+    std::vector<NanoFrustum> frustums{};
+    glm::mat4 projection = glm::perspectiveRH_ZO(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 400.0f);
+    for (uint32_t view = 0; view < VIEW_COUNT; view++) {
+        float angle = glm::two_pi<float>() * view / VIEW_COUNT;
+        glm::vec3 direction(std::cos(angle), 0.3f * std::sin(angle * 2.0f), std::sin(angle));
+        frustums.push_back(NanoFrustum::FromViewProjection(projection * glm::lookAt(glm::vec3(0.0f), direction, glm::vec3(0.0f, 1.0f, 0.0f))));
+    }
+
+    std::vector<std::vector<int>> references(VIEW_COUNT, std::vector<int>(objectCount));
+    for (uint32_t view = 0; view < VIEW_COUNT; view++) {
+        for (uint32_t i = 0; i < objectCount; i++) {
+            references[view][i] = referenceVisibility(frustums[view], bounds[i]);
+        }
+    }
+
+    NanoJobSystem jobSystem{};
+    jobSystem.Init(threads - 1);
+
+    std::vector<uint32_t> visible(objectCount);
+    printf("%u objects, %u views, best of %u\n", objectCount, VIEW_COUNT, repeat);
+    printf("%-16s %8s %12s %12s %10s\n", "kernel", "threads", "ms / view", "objects/ns", "visible");
+
+    double scalarTime = 0.0;
+    NanoCullingKernel kernels[] = {NanoCullingKernel::SCALAR, NanoCullingKernel::SSE, NanoCullingKernel::AVX2};
+    for (NanoCullingKernel kernel : kernels) {
+        if (!NanoFrustumCuller::IsKernelSupported(kernel)) {
+            printf("%-16s not supported on this CPU\n", NanoFrustumCuller::GetKernelName(kernel));
+            continue;
+        }
+
+        for (uint32_t threadCount : {1u, threads}) {
+            double best = 1e30;
+            uint64_t visibleTotal = 0;
+            for (uint32_t r = 0; r < repeat; r++) {
+                visibleTotal = 0;
+                auto start = std::chrono::high_resolution_clock::now();
+                for (uint32_t view = 0; view < VIEW_COUNT; view++) {
+                    visibleTotal += threadCount == 1 ? culler.Cull(frustums[view], 0, objectCount, visible.data(), kernel)
+                                                     : culler.Cull(frustums[view], jobSystem, kernel);
+                }
+                best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+            }
+            best /= VIEW_COUNT;
+
+            // the timed runs only kept the last view, run every view again for the check
+            for (uint32_t view = 0; view < VIEW_COUNT; view++) {
+                const uint32_t* indices = visible.data();
+                uint32_t count = 0;
+                if (threadCount == 1) {
+                    count = culler.Cull(frustums[view], 0, objectCount, visible.data(), kernel);
+                } else {
+                    count = culler.Cull(frustums[view], jobSystem, kernel);
+                    indices = culler.GetVisibleIndices();
+                }
+                if (!check(NanoFrustumCuller::GetKernelName(kernel), references[view], indices, count)) {
+                    return EXIT_FAILURE;
+                }
+            }
+
+            if (kernel == NanoCullingKernel::SCALAR && threadCount == 1) {
+                scalarTime = best;
+            }
+            printf("%-16s %8u %12.3f %12.3f %10lu", NanoFrustumCuller::GetKernelName(kernel), threadCount, best, objectCount / (best * 1e6),
+                   static_cast<unsigned long>(visibleTotal / VIEW_COUNT));
+            printf("   %.2fx scalar\n", scalarTime / best);
+
+            if (threads == 1) {
+                break;
+            }
+        }
+    }
+
+    jobSystem.CleanUp();
+    return EXIT_SUCCESS;
+}
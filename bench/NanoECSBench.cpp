@@ -0,0 +1,181 @@
+#include "NanoECS.hpp"
+#include "NanoJobSystem.hpp"
+#include "NanoLogger.hpp"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// ECS query iteration against the naive alternative, one array of fat scene objects, on the same scene:
+//  every entity moves (position += velocity * dt), half of them also have health that decays.
+// The ECS side runs once through ForEach, once through raw chunk columns and once with the chunks spread over the job system
+//
+// NanoECSBench [--entities <count>] [--repeat <count>] [--threads <count>]
+
+struct Position {
+    glm::vec3 value;
+};
+struct Velocity {
+    glm::vec3 value;
+};
+struct Rotation {
+    glm::quat value;
+};
+struct Scale {
+    glm::vec3 value;
+};
+struct Health {
+    float value;
+};
+struct Renderable {
+    uint32_t mesh;
+    uint32_t material;
+};
+
+// what a scene without an ECS tends to look like: everything every object could ever need, in one struct
+struct SceneObject {
+    glm::mat4 world;
+    glm::quat rotation;
+    glm::vec3 position;
+    glm::vec3 velocity;
+    glm::vec3 scale;
+    float health;
+    uint32_t mesh;
+    uint32_t material;
+    bool hasHealth;
+    bool isRenderable;
+};
+
+static constexpr float DELTA_TIME = 1.0f / 60.0f;
+
+static glm::vec3 velocityFor(uint32_t i) {
+    return glm::vec3(static_cast<float>(i % 7) - 3.0f, static_cast<float>(i % 5) - 2.0f, static_cast<float>(i % 3) - 1.0f);
+}
+
+template <typename Function> static double timeBest(uint32_t repeat, Function&& function) {
+    double best = 1e30;
+    for (uint32_t r = 0; r < repeat; r++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        function();
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    Logger::setSeverity(ERRLevel::WARNING);
+
+    uint32_t entityCount = 1000000;
+    uint32_t repeat = 10;
+    uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--entities") == 0 && i + 1 < argc) {
+            entityCount = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = std::max(1, atoi(argv[++i]));
+        } else {
+            fprintf(stderr, "usage: %s [--entities <count>] [--repeat <count>] [--threads <count>]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    NanoJobSystem jobSystem{};
+    jobSystem.Init(threads - 1);
+
+    std::vector<SceneObject> objects(entityCount);
+    NanoWorld world{};
+    for (uint32_t i = 0; i < entityCount; i++) {
+        SceneObject& object = objects[i];
+        object.world = glm::mat4(1.0f);
+        object.rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+        object.position = glm::vec3(0.0f);
+        object.velocity = velocityFor(i);
+        object.scale = glm::vec3(1.0f);
+        object.health = 100.0f;
+        object.hasHealth = i % 2 == 0;
+        object.isRenderable = i % 4 != 3;
+
+        // same mix of component sets on the ECS side, which makes for four archetypes next to the empty one
+        NanoEntity entity = world.CreateEntity(Position{object.position}, Velocity{object.velocity}, Rotation{object.rotation}, Scale{object.scale});
+        if (object.hasHealth) {
+            world.AddComponent(entity, Health{object.health});
+        }
+        if (object.isRenderable) {
+            world.AddComponent(entity, Renderable{0, 0});
+        }
+    }
+
+    auto updateObjects = [&objects]() {
+        for (SceneObject& object : objects) {
+            object.position += object.velocity * DELTA_TIME;
+            if (object.hasHealth) {
+                object.health -= DELTA_TIME;
+            }
+        }
+    };
+    auto updateForEach = [&world]() {
+        world.ForEach<Position, const Velocity>([](Position& position, const Velocity& velocity) { position.value += velocity.value * DELTA_TIME; });
+        world.ForEach<Health>([](Health& health) { health.value -= DELTA_TIME; });
+    };
+    auto moveChunk = [](const NanoChunkView& view) {
+        Position* positions = view.Get<Position>();
+        const Velocity* velocities = view.Get<const Velocity>();
+        for (uint32_t i = 0; i < view.GetCount(); i++) {
+            positions[i].value += velocities[i].value * DELTA_TIME;
+        }
+    };
+    auto decayChunk = [](const NanoChunkView& view) {
+        Health* health = view.Get<Health>();
+        for (uint32_t i = 0; i < view.GetCount(); i++) {
+            health[i].value -= DELTA_TIME;
+        }
+    };
+    auto updateChunks = [&]() {
+        world.ForEachChunk<Position, const Velocity>(moveChunk);
+        world.ForEachChunk<Health>(decayChunk);
+    };
+    auto updateParallel = [&]() {
+        world.ParallelForEachChunk<Position, const Velocity>(jobSystem, moveChunk);
+        world.ParallelForEachChunk<Health>(jobSystem, decayChunk);
+    };
+
+    double timeObjects = timeBest(repeat, updateObjects);
+    double timeForEach = timeBest(repeat, updateForEach);
+    double timeChunks = timeBest(repeat, updateChunks);
+    double timeParallel = timeBest(repeat, updateParallel);
+
+    // the world was updated by three variants, catch the objects up so both scenes have to agree
+    for (uint32_t r = 0; r < 2 * repeat; r++) {
+        updateObjects();
+    }
+    double sumObjects = 0.0;
+    double sumWorld = 0.0;
+    for (const SceneObject& object : objects) {
+        sumObjects += object.position.x + object.position.y + object.position.z + (object.hasHealth ? object.health : 0.0f);
+    }
+    world.ForEach<const Position>([&sumWorld](const Position& position) { sumWorld += position.value.x + position.value.y + position.value.z; });
+    world.ForEach<const Health>([&sumWorld](const Health& health) { sumWorld += health.value; });
+    if (std::abs(sumObjects - sumWorld) > 1e-4 * std::abs(sumObjects) + 1.0) {
+        fprintf(stderr, "ECS and array of structs results differ: %f vs %f\n", sumObjects, sumWorld);
+        return EXIT_FAILURE;
+    }
+
+    printf("%u entities, %u archetypes, %lu bytes per scene object\n", entityCount, world.GetArchetypeCount(), sizeof(SceneObject));
+    printf("%-28s %10.3f ms\n", "array of structs", timeObjects);
+    printf("%-28s %10.3f ms %7.2fx\n", "ecs ForEach", timeForEach, timeObjects / timeForEach);
+    printf("%-28s %10.3f ms %7.2fx\n", "ecs chunk columns", timeChunks, timeObjects / timeChunks);
+    printf("%-28s %10.3f ms %7.2fx (%u threads)\n", "ecs chunk columns, parallel", timeParallel, timeObjects / timeParallel, threads);
+
+    jobSystem.CleanUp();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,476 @@
+#include "NanoConfig.hpp"
+#include "NanoEngine.hpp"
+#include "NanoLogger.hpp"
+#include "NanoMeshIO.hpp"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// The whole engine, headless, on a scripted scene: warm-up frames first, then the measured ones. Scenes are built from
+// fixed seeds and generated meshes so two runs draw exactly the same thing:
+//   triangles  one mesh of <count> triangles filling the screen
+//   instanced  <count> GPU driven instances of a cube
+//   materials  <count> static cubes over <materials> materials, merged per material and cell
+//   queued     <count> cubes and quads over <materials> materials, drawn through the render queue which batches the
+//              ones sharing a mesh and a material. The report has how many draws the queue submitted for them
+// Startup (init, scene load, time to first frame), frame time percentiles, the CPU stages of DrawFrame and the time of
+// every CPU and GPU zone per frame go to a JSON report. Every metric is a time, lower is better. Given a baseline report
+// of the same scene, metrics more than <percent> slower (and at least MIN_REGRESSION_MS) are regressions, and the exit
+// code is EXIT_REGRESSION. Run from where NanoEngine runs, for the shaders. No GPU needed, lavapipe does:
+//   VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json NanoEngineBench --scene instanced
+//
+// NanoEngineBench [--scene triangles|instanced|materials|queued] [--count <count>] [--materials <count>] [--frames <count>]
+//                 [--warmup <count>] [--width <pixels>] [--height <pixels>] [--out <file>] [--baseline <file>]
+//                 [--tolerance <percent>]
+
+static constexpr uint32_t SCENE_SEED = 5;
+static constexpr float FIELD_OF_VIEW = 60.0f;
+static constexpr float INSTANCE_SPACING = 2.0f;
+static constexpr float STATIC_SPACING = 4.0f; // 8 x 8 objects per Config::STATIC_MERGE_CELL_SIZE cell
+static constexpr double MIN_REGRESSION_MS = 0.05; // below this a difference is noise, whatever the percentage
+static constexpr int EXIT_REGRESSION = 2;
+static const char* GRID_MESH_FILE = "NanoEngineBench_grid.nmesh";
+static const char* CUBE_MESH_FILE = "NanoEngineBench_cube.nmesh";
+
+enum class Scene {
+    TRIANGLES,
+    INSTANCED,
+    MATERIALS,
+    QUEUED,
+};
+
+static const char* getSceneName(Scene scene) {
+    switch (scene) {
+    case Scene::TRIANGLES:
+        return "triangles";
+    case Scene::INSTANCED:
+        return "instanced";
+    case Scene::MATERIALS:
+        return "materials";
+    default:
+        return "queued";
+    }
+}
+
+// a square of quads in the XY plane facing +Z, cut down to exactly triangleCount triangles
+static MeshData makeGrid(uint32_t triangleCount) {
+    uint32_t side = std::max(1u, static_cast<uint32_t>(std::ceil(std::sqrt(triangleCount * 0.5))));
+    MeshData mesh{};
+    for (uint32_t y = 0; y <= side; y++) {
+        for (uint32_t x = 0; x <= side; x++) {
+            float u = static_cast<float>(x) / side, v = static_cast<float>(y) / side;
+            mesh.vertices.push_back({{u * 2.0f - 1.0f, v * 2.0f - 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {u, v}});
+        }
+    }
+    for (uint32_t y = 0; y < side; y++) {
+        for (uint32_t x = 0; x < side; x++) {
+            uint32_t corner = y * (side + 1) + x;
+            mesh.indices.insert(mesh.indices.end(), {corner, corner + 1, corner + side + 2, corner + side + 2, corner + side + 1, corner});
+        }
+    }
+    mesh.indices.resize(static_cast<size_t>(triangleCount) * 3);
+    return mesh;
+}
+
+// unit cube around the origin, counter clockwise seen from outside
+static MeshData makeCube() {
+    static const float CORNERS[8][3] = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}, {0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1}};
+    static const uint32_t INDICES[36] = {0, 3, 2, 2, 1, 0, 4, 5, 6, 6, 7, 4, 0, 4, 7, 7, 3, 0,
+                                         1, 2, 6, 6, 5, 1, 0, 1, 5, 5, 4, 0, 3, 7, 6, 6, 2, 3};
+    MeshData mesh{};
+    for (const float* corner : CORNERS) {
+        glm::vec3 position(corner[0] - 0.5f, corner[1] - 0.5f, corner[2] - 0.5f);
+        glm::vec3 normal = glm::normalize(position);
+        mesh.vertices.push_back({{position.x, position.y, position.z}, {normal.x, normal.y, normal.z}, {corner[0], corner[1]}});
+    }
+    mesh.indices.assign(INDICES, INDICES + 36);
+    return mesh;
+}
+
+static glm::mat4 randomRotation(std::mt19937& random) {
+    std::uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+    return glm::rotate(glm::mat4(1.0f), angle(random), glm::normalize(glm::vec3(0.3f, 1.0f, 0.2f)));
+}
+
+// loads the scene, and points the camera at it
+static ERR buildScene(NanoGraphics& graphics, Scene scene, uint32_t count, uint32_t materials, float aspect) {
+    ERR err = ERR::OK;
+    std::mt19937 random(SCENE_SEED);
+    glm::mat4 projection = glm::perspectiveRH_ZO(glm::radians(FIELD_OF_VIEW), aspect, 0.1f, 2000.0f);
+    glm::mat4 view(1.0f);
+    uint32_t mesh = 0, instance = 0;
+
+    if (scene == Scene::TRIANGLES) {
+        if ((err = graphics.LoadMesh(GRID_MESH_FILE, mesh)) != ERR::OK) {
+            return err;
+        }
+        err = graphics.AddInstance(mesh, glm::mat4(1.0f), instance);
+        view = glm::lookAt(glm::vec3(0.0f, 0.0f, 1.8f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    } else if (scene == Scene::INSTANCED) {
+        if ((err = graphics.LoadMesh(CUBE_MESH_FILE, mesh)) != ERR::OK) {
+            return err;
+        }
+        uint32_t side = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(count))));
+        float half = (side - 1) * INSTANCE_SPACING * 0.5f;
+        for (uint32_t i = 0; i < count && err == ERR::OK; i++) {
+            glm::vec3 position(i % side, (i / side) % side, i / (side * side));
+            glm::mat4 world = glm::translate(glm::mat4(1.0f), position * INSTANCE_SPACING - half) * randomRotation(random);
+            err = graphics.AddInstance(mesh, world, instance);
+        }
+        view = glm::lookAt(glm::vec3(half, half, half * 3.0f + 4.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    } else if (scene == Scene::QUEUED) {
+        uint32_t meshes[2] = {};
+        if ((err = graphics.LoadMesh(CUBE_MESH_FILE, meshes[0])) != ERR::OK || (err = graphics.LoadMesh(GRID_MESH_FILE, meshes[1])) != ERR::OK) {
+            return err;
+        }
+        uint32_t side = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(count))));
+        float half = (side - 1) * INSTANCE_SPACING * 0.5f;
+        std::uniform_int_distribution<uint32_t> material(0, materials - 1);
+        for (uint32_t i = 0; i < count && err == ERR::OK; i++) {
+            glm::vec3 position(i % side, (i / side) % side, i / (side * side));
+            glm::mat4 world = glm::translate(glm::mat4(1.0f), position * INSTANCE_SPACING - half) * randomRotation(random);
+            mesh = meshes[random() % 2];
+            err = graphics.AddQueuedInstance(mesh, world, material(random), instance);
+        }
+        view = glm::lookAt(glm::vec3(half, half, half * 3.0f + 4.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    } else {
+        uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+        float half = (side - 1) * STATIC_SPACING * 0.5f;
+        std::uniform_int_distribution<uint32_t> material(0, materials - 1);
+        std::vector<NanoStaticObject> objects(count);
+        for (uint32_t i = 0; i < count; i++) {
+            glm::vec3 position(i % side * STATIC_SPACING - half, 0.0f, i / side * STATIC_SPACING - half);
+            objects[i] = {CUBE_MESH_FILE, glm::translate(glm::mat4(1.0f), position) * randomRotation(random), material(random)};
+        }
+        std::vector<uint32_t> instances{};
+        err = graphics.AddStaticObjects(objects, instances);
+        view = glm::lookAt(glm::vec3(0.0f, half + 8.0f, half * 1.5f + 8.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    graphics.SetViewProjection(projection * view);
+    return err;
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string toMetricName(const std::string& name) {
+    std::string metric = name;
+    std::replace(metric.begin(), metric.end(), ' ', '_');
+    return metric;
+}
+
+// mean time per frame of every zone name over frames [first, last], nested zones count on their own. GPU zones only
+// from the frames that were read back
+static void addZoneMetrics(NanoProfiler& profiler, uint64_t first, uint64_t last, std::map<std::string, double>& metrics) {
+    std::map<std::string, double> totals{};
+    uint32_t cpuFrames = 0, gpuFrames = 0;
+    double gpuFrameTotal = 0.0;
+    for (uint64_t f = first; f <= last; f++) {
+        const NanoProfileFrame* frame = profiler.GetFrame(f);
+        if (frame == nullptr) {
+            continue;
+        }
+        cpuFrames++;
+        if (frame->gpuResolved) {
+            gpuFrames++;
+            gpuFrameTotal += frame->gpuMs;
+        }
+        for (const NanoProfileZone& zone : frame->zones) {
+            if (!zone.gpu || frame->gpuResolved) {
+                totals[(zone.gpu ? "gpu." : "cpu.") + toMetricName(zone.name)] += zone.durationMs;
+            }
+        }
+    }
+    for (const auto& total : totals) {
+        uint32_t frames = total.first.compare(0, 4, "gpu.") == 0 ? gpuFrames : cpuFrames;
+        metrics["zone." + total.first + "_ms"] = total.second / std::max(1u, frames);
+    }
+    if (gpuFrames > 0) {
+        metrics["gpu.frame_ms"] = gpuFrameTotal / gpuFrames;
+    }
+}
+
+struct Report {
+    Scene scene = Scene::INSTANCED;
+    uint32_t count = 0;
+    uint32_t materials = 0;
+    uint32_t width = 0, height = 0;
+    uint32_t warmup = 0, frames = 0;
+    uint64_t stutters = 0;
+    double fps = 0.0;
+    // the last frame's render queue: instances submitted (one per queued object, plus the fullscreen triangle) and the
+    // draw calls batching turned them into
+    uint32_t queueInstances = 0, queueDraws = 0;
+    std::map<std::string, double> metrics{};
+};
+
+static ERR writeReport(const std::string& fileName, const Report& report) {
+    std::ofstream file(fileName, std::ios::trunc);
+    if (!file.is_open()) {
+        LOG_MSG(ERRLevel::WARNING, "could not open output file: %s", fileName.c_str());
+        return ERR::NOT_FOUND;
+    }
+    file << std::fixed << std::setprecision(4);
+    file << "{\n  \"benchmark\": \"NanoEngineBench\",\n  \"scene\": \"" << getSceneName(report.scene) << "\",\n  \"count\": " << report.count
+         << ",\n  \"materials\": " << report.materials << ",\n  \"width\": " << report.width << ",\n  \"height\": " << report.height
+         << ",\n  \"warmup\": " << report.warmup << ",\n  \"frames\": " << report.frames << ",\n  \"stutters\": " << report.stutters
+         << ",\n  \"fps\": " << report.fps << ",\n  \"queue_instances\": " << report.queueInstances << ",\n  \"queue_draws\": "
+         << report.queueDraws << ",\n  \"metrics\": {";
+    const char* separator = "\n";
+    for (const auto& metric : report.metrics) {
+        file << separator << "    \"" << metric.first << "\": " << metric.second;
+        separator = ",\n";
+    }
+    file << "\n  }\n}\n";
+    return file.good() ? ERR::OK : ERR::INVALID;
+}
+
+// not a JSON parser, just enough to read back what writeReport writes
+static bool findJsonValue(const std::string& text, const std::string& key, size_t& position) {
+    position = text.find("\"" + key + "\"");
+    if (position == std::string::npos) {
+        return false;
+    }
+    position = text.find(':', position);
+    if (position == std::string::npos) {
+        return false;
+    }
+    position = text.find_first_not_of(" \t\r\n", position + 1);
+    return position != std::string::npos;
+}
+
+static ERR readBaseline(const std::string& fileName, std::string& scene, uint32_t& count, std::map<std::string, double>& metrics) {
+    std::ifstream file(fileName);
+    if (!file.is_open()) {
+        LOG_MSG(ERRLevel::WARNING, "could not open baseline: %s", fileName.c_str());
+        return ERR::NOT_FOUND;
+    }
+    std::stringstream buffer{};
+    buffer << file.rdbuf();
+    std::string text = buffer.str();
+
+    size_t position = 0;
+    if (!findJsonValue(text, "scene", position) || text[position] != '"') {
+        return ERR::INVALID;
+    }
+    scene = text.substr(position + 1, text.find('"', position + 1) - position - 1);
+    if (!findJsonValue(text, "count", position)) {
+        return ERR::INVALID;
+    }
+    count = static_cast<uint32_t>(strtoul(text.c_str() + position, nullptr, 10));
+    if (!findJsonValue(text, "metrics", position) || text[position] != '{') {
+        return ERR::INVALID;
+    }
+
+    position++;
+    while ((position = text.find_first_not_of(" \t\r\n,", position)) != std::string::npos && text[position] == '"') {
+        size_t end = text.find('"', position + 1);
+        size_t colon = text.find(':', end);
+        if (end == std::string::npos || colon == std::string::npos) {
+            return ERR::INVALID;
+        }
+        char* next = nullptr;
+        metrics[text.substr(position + 1, end - position - 1)] = strtod(text.c_str() + colon + 1, &next);
+        position = next - text.c_str();
+    }
+    return position != std::string::npos && text[position] == '}' ? ERR::OK : ERR::INVALID;
+}
+
+// prints every metric against the baseline, returns how many regressed
+static uint32_t compareToBaseline(const Report& report, const std::map<std::string, double>& baseline, double tolerance) {
+    uint32_t regressions = 0;
+    printf("\n%-40s %12s %12s %9s\n", "metric", "baseline", "current", "change");
+    for (const auto& metric : report.metrics) {
+        auto base = baseline.find(metric.first);
+        if (base == baseline.end()) {
+            printf("%-40s %12s %12.3f %9s\n", metric.first.c_str(), "-", metric.second, "new");
+            continue;
+        }
+        double change = base->second > 0.0 ? (metric.second / base->second - 1.0) * 100.0 : 0.0;
+        // the worst single frame is reported, but too noisy to gate on
+        bool gated = metric.first.find("max_ms") == std::string::npos;
+        bool regressed = gated && metric.second > base->second * (1.0 + tolerance / 100.0) && metric.second - base->second > MIN_REGRESSION_MS;
+        regressions += regressed ? 1 : 0;
+        printf("%-40s %12.3f %12.3f %8.1f%%%s\n", metric.first.c_str(), base->second, metric.second, change, regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+int main(int argc, char* argv[]) {
+    Logger::setSeverity(ERRLevel::WARNING);
+
+    Scene scene = Scene::INSTANCED;
+    int32_t count = -1;
+    uint32_t materials = 256;
+    uint32_t frames = 600, warmup = 120;
+    uint32_t width = Config::WINDOW_WIDTH, height = Config::WINDOW_HEIGHT;
+    std::string outFile = "NanoEngineBench.json";
+    std::string baselineFile{};
+    double tolerance = 10.0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc && strcmp(argv[i + 1], "triangles") == 0) {
+            scene = Scene::TRIANGLES;
+            i++;
+        } else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc && strcmp(argv[i + 1], "instanced") == 0) {
+            scene = Scene::INSTANCED;
+            i++;
+        } else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc && strcmp(argv[i + 1], "materials") == 0) {
+            scene = Scene::MATERIALS;
+            i++;
+        } else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc && strcmp(argv[i + 1], "queued") == 0) {
+            scene = Scene::QUEUED;
+            i++;
+        } else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            count = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--materials") == 0 && i + 1 < argc) {
+            materials = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            warmup = std::max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc) {
+            width = std::max(16, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--height") == 0 && i + 1 < argc) {
+            height = std::max(16, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outFile = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baselineFile = argv[++i];
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            tolerance = std::max(0.0, atof(argv[++i]));
+        } else {
+            fprintf(stderr,
+                    "usage: %s [--scene triangles|instanced|materials|queued] [--count <count>] [--materials <count>] [--frames <count>]\n"
+                    "       [--warmup <count>] [--width <pixels>] [--height <pixels>] [--out <file>] [--baseline <file>]\n"
+                    "       [--tolerance <percent>]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (count < 0) {
+        count = scene == Scene::TRIANGLES ? 500000 : (scene == Scene::MATERIALS ? 4096 : 16384);
+    }
+    if (scene == Scene::INSTANCED || scene == Scene::QUEUED) {
+        count = std::min<int32_t>(count, Config::INDIRECT_INSTANCE_CAPACITY);
+    }
+
+    // generated before Init, so writing them is not part of the startup time
+    NanoMeshWriteOptions writeOptions{};
+    if (MeshIO::WriteNanoMesh(GRID_MESH_FILE, makeGrid(scene == Scene::TRIANGLES ? count : 2), writeOptions) != ERR::OK ||
+        MeshIO::WriteNanoMesh(CUBE_MESH_FILE, makeCube(), writeOptions) != ERR::OK) {
+        fprintf(stderr, "could not write the scene's meshes\n");
+        return EXIT_FAILURE;
+    }
+
+    Report report{};
+    report.scene = scene;
+    report.count = static_cast<uint32_t>(count);
+    report.materials = scene == Scene::MATERIALS || scene == Scene::QUEUED ? materials : 0;
+    report.width = width;
+    report.height = height;
+    report.warmup = warmup;
+    report.frames = frames;
+
+    NanoEngineOptions options{};
+    options.headless.enabled = true;
+    options.headless.width = width;
+    options.headless.height = height;
+    options.profileHistoryFrames = std::max(Config::PROFILER_HISTORY_FRAMES, warmup + frames + 1);
+
+    NanoEngine engine;
+    try {
+        auto start = std::chrono::steady_clock::now();
+        engine.Init(options);
+        report.metrics["startup.init_ms"] = millisecondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        if (buildScene(engine.GetGraphics(), scene, report.count, materials, static_cast<float>(width) / height) != ERR::OK) {
+            fprintf(stderr, "could not load the %s scene\n", getSceneName(scene));
+            return EXIT_FAILURE;
+        }
+        report.metrics["startup.scene_ms"] = millisecondsSince(start);
+
+        // the first frame is part of the warm-up either way
+        engine.RunFrames(std::max(1u, warmup));
+        engine.GetGraphics().WaitForFrame(engine.GetGraphics().GetSubmittedFrameCount());
+        report.metrics["startup.first_frame_ms"] = engine.GetTimeToFirstFrame();
+        uint64_t firstFrame = std::max(1u, warmup) + 1; // the profiler numbers its frames like the loop
+
+        // percentiles over exactly the measured frames
+        engine.GetFrameStats().Init(frames);
+        start = std::chrono::steady_clock::now();
+        engine.RunFrames(frames);
+        engine.GetGraphics().WaitForFrame(engine.GetGraphics().GetSubmittedFrameCount());
+        double measuredMs = millisecondsSince(start);
+        engine.GetProfiler().ResolveGpu();
+
+        report.fps = frames * 1000.0 / std::max(measuredMs, 1e-6);
+        report.metrics["frame.mean_ms"] = measuredMs / frames;
+        const NanoFrameStats& frameStats = engine.GetFrameStats();
+        report.stutters = frameStats.GetStutterCount();
+        for (uint32_t i = 0; i < static_cast<uint32_t>(NanoFrameMetric::COUNT); i++) {
+            NanoFrameMetricSummary summary = frameStats.GetSummary(static_cast<NanoFrameMetric>(i));
+            if (summary.samples == 0) {
+                continue;
+            }
+            std::string name = toMetricName(NanoFrameStats::GetMetricName(static_cast<NanoFrameMetric>(i)));
+            report.metrics[name + ".p50_ms"] = summary.p50Ms;
+            report.metrics[name + ".p95_ms"] = summary.p95Ms;
+            report.metrics[name + ".p99_ms"] = summary.p99Ms;
+            report.metrics[name + ".max_ms"] = summary.maxMs;
+        }
+        addZoneMetrics(engine.GetProfiler(), firstFrame, firstFrame + frames - 1, report.metrics);
+        const NanoRenderQueueStats& queueStats = engine.GetGraphics().GetRenderQueueStats();
+        report.queueInstances = queueStats.instances;
+        report.queueDraws = queueStats.draws;
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    std::remove(GRID_MESH_FILE);
+    std::remove(CUBE_MESH_FILE);
+
+    printf("%s scene, %u objects, %ux%u, %u frames after %u warm-up: %.1f fps, %lu stutters\n", getSceneName(scene), report.count,
+           width, height, frames, warmup, report.fps, static_cast<unsigned long>(report.stutters));
+    printf("render queue: %u instances in %u draws\n", report.queueInstances, report.queueDraws);
+    if (writeReport(outFile, report) != ERR::OK) {
+        fprintf(stderr, "could not write %s\n", outFile.c_str());
+        return EXIT_FAILURE;
+    }
+    printf("report written to %s\n", outFile.c_str());
+
+    if (baselineFile.empty()) {
+        return EXIT_SUCCESS;
+    }
+    std::string baselineScene{};
+    uint32_t baselineCount = 0;
+    std::map<std::string, double> baseline{};
+    if (readBaseline(baselineFile, baselineScene, baselineCount, baseline) != ERR::OK) {
+        fprintf(stderr, "could not read baseline %s\n", baselineFile.c_str());
+        return EXIT_FAILURE;
+    }
+    if (baselineScene != getSceneName(scene) || baselineCount != report.count) {
+        fprintf(stderr, "baseline %s is of the %s scene with %u objects, not comparable\n", baselineFile.c_str(), baselineScene.c_str(),
+                baselineCount);
+        return EXIT_FAILURE;
+    }
+    uint32_t regressions = compareToBaseline(report, baseline, tolerance);
+    printf("%u regressions over %.1f%%\n", regressions, tolerance);
+    return regressions > 0 ? EXIT_REGRESSION : EXIT_SUCCESS;
+}
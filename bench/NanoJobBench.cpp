@@ -0,0 +1,131 @@
+#include "NanoJobSystem.hpp"
+#include "NanoLogger.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Scaling of the job system from 1 thread to every hardware thread, on three kinds of load:
+//  parallel-for: one big data parallel loop, close to what culling / transform updates look like
+//  small jobs:   lots of independent tiny jobs, measures the per job overhead
+//  fork-join:    recursive spawn and wait (wait while helping), measures stealing under nested dependencies
+//
+// NanoJobBench [--threads <max>] [--repeat <count>] [--pin]
+
+static constexpr uint32_t PARALLEL_FOR_COUNT = 1u << 22;
+static constexpr uint32_t SMALL_JOB_COUNT = 100000;
+static constexpr uint32_t FORK_JOIN_DEPTH = 16;
+
+static float work(uint32_t seed, uint32_t iterations) {
+    float value = static_cast<float>(seed & 1023) * 0.001f;
+    for (uint32_t i = 0; i < iterations; i++) {
+        value = std::sqrt(value * value + 1.0f) * 0.5f + std::sin(value) * 0.25f;
+    }
+    return value;
+}
+
+static void forkJoin(NanoJobSystem& jobSystem, uint32_t depth, std::atomic<uint64_t>& sum) {
+    if (depth == 0) {
+        sum.fetch_add(static_cast<uint64_t>(work(depth, 64) * 1000.0f), std::memory_order_relaxed);
+        return;
+    }
+    NanoJobCounter counter{};
+    jobSystem.Run([&jobSystem, depth, &sum]() { forkJoin(jobSystem, depth - 1, sum); }, &counter);
+    forkJoin(jobSystem, depth - 1, sum);
+    jobSystem.Wait(counter);
+}
+
+static double runParallelFor(NanoJobSystem& jobSystem, std::vector<float>& output) {
+    auto start = std::chrono::high_resolution_clock::now();
+    jobSystem.ParallelFor(PARALLEL_FOR_COUNT, 256, [&output](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            output[i] = work(i, 16);
+        }
+    });
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static double runSmallJobs(NanoJobSystem& jobSystem, std::vector<float>& output) {
+    auto start = std::chrono::high_resolution_clock::now();
+    NanoJobCounter counter{};
+    for (uint32_t i = 0; i < SMALL_JOB_COUNT; i++) {
+        jobSystem.Run([&output, i]() { output[i] = work(i, 32); }, &counter);
+    }
+    jobSystem.Wait(counter);
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static double runForkJoin(NanoJobSystem& jobSystem, uint64_t& result) {
+    auto start = std::chrono::high_resolution_clock::now();
+    std::atomic<uint64_t> sum{0};
+    forkJoin(jobSystem, FORK_JOIN_DEPTH, sum);
+    result = sum.load();
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+    Logger::setSeverity(ERRLevel::WARNING);
+
+    uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    uint32_t repeat = 5;
+    bool pin = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            maxThreads = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--pin") == 0) {
+            pin = true;
+        } else {
+            fprintf(stderr, "usage: %s [--threads <max>] [--repeat <count>] [--pin]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<uint32_t> threadCounts{};
+    for (uint32_t threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    std::vector<float> output(PARALLEL_FOR_COUNT);
+    double baseline[3] = {0.0, 0.0, 0.0};
+    uint64_t referenceSum = 0;
+
+    printf("%8s %14s %8s %14s %8s %14s %8s\n", "threads", "parallel-for", "speedup", "small jobs", "speedup", "fork-join", "speedup");
+    for (uint32_t threads : threadCounts) {
+        NanoJobSystem jobSystem{};
+        jobSystem.Init(threads - 1, pin);
+
+        // best of N, the first run also warms up the pools and wakes the workers
+        double best[3] = {1e30, 1e30, 1e30};
+        for (uint32_t r = 0; r < repeat; r++) {
+            uint64_t sum = 0;
+            best[0] = std::min(best[0], runParallelFor(jobSystem, output));
+            best[1] = std::min(best[1], runSmallJobs(jobSystem, output));
+            best[2] = std::min(best[2], runForkJoin(jobSystem, sum));
+
+            if (threads == 1 && r == 0) {
+                referenceSum = sum;
+            } else if (sum != referenceSum) {
+                fprintf(stderr, "fork-join result mismatch with %u threads\n", threads);
+                return EXIT_FAILURE;
+            }
+        }
+        jobSystem.CleanUp();
+
+        if (threads == 1) {
+            std::copy(best, best + 3, baseline);
+        }
+        printf("%8u %11.2f ms %7.2fx %11.2f ms %7.2fx %11.2f ms %7.2fx\n", threads, best[0], baseline[0] / best[0], best[1], baseline[1] / best[1],
+               best[2], baseline[2] / best[2]);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,244 @@
+#include "NanoFrustumCuller.hpp"
+#include "NanoJobSystem.hpp"
+#include "NanoLogger.hpp"
+#include "NanoOcclusionCuller.hpp"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Occlusion culling in a city block: a grid of buildings as occluders, lots of small objects on the streets and in the
+// back yards, the camera walking down a street. Frustum culling runs first, then the occluders are rasterized with
+// every kernel and the survivors are tested against the depth pyramid.
+// Every object that gets occluded is checked against the actual buildings: rays from the camera to points all over
+// its box have to hit a building first, or pass within a pixel and a half of one. Closer than that the depth buffer
+// can't tell, at silhouette corners a covered pixel may reach that far past the outline
+//
+// NanoOcclusionBench [--objects <count>] [--repeat <count>] [--threads <count>] [--width <pixels>] [--height <pixels>]
+
+static constexpr uint32_t VIEW_COUNT = 8;
+static constexpr int CITY_BLOCKS = 24; // per side
+static constexpr float BLOCK_SIZE = 40.0f;
+static constexpr float STREET_WIDTH = 12.0f;
+static constexpr int FACE_SAMPLES = 3; // per side of each face of an occluded box
+static constexpr float PIXEL_MARGIN = 1.5f;
+static constexpr float FIELD_OF_VIEW = 70.0f;
+
+struct Box {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// counter clockwise seen from outside, like the rest of the meshes
+static const glm::vec3 CUBE_VERTICES[8] = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}, {0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1}};
+static const uint32_t CUBE_INDICES[36] = {0, 3, 2, 2, 1, 0, 4, 5, 6, 6, 7, 4, 0, 4, 7, 7, 3, 0,
+                                          1, 2, 6, 6, 5, 1, 0, 1, 5, 5, 4, 0, 3, 7, 6, 6, 2, 3};
+
+static bool segmentHitsBox(const glm::vec3& from, const glm::vec3& to, const Box& box) {
+    glm::vec3 direction = to - from;
+    float enter = 0.0f, exit = 1.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        if (std::abs(direction[axis]) < 1e-12f) {
+            if (from[axis] < box.min[axis] || from[axis] > box.max[axis]) {
+                return false;
+            }
+            continue;
+        }
+        float t0 = (box.min[axis] - from[axis]) / direction[axis];
+        float t1 = (box.max[axis] - from[axis]) / direction[axis];
+        enter = std::max(enter, std::min(t0, t1));
+        exit = std::min(exit, std::max(t0, t1));
+    }
+    // the point itself may touch a building, only count buildings clearly in front of it
+    return enter <= exit && enter < 0.999f;
+}
+
+struct View {
+    glm::vec3 camera;
+    glm::vec3 right, up;
+    float pixelAngle; // size of a depth buffer pixel one unit away from the camera
+};
+
+static bool isBlocked(const glm::vec3& camera, const glm::vec3& point, const std::vector<Box>& buildings) {
+    for (const Box& building : buildings) {
+        if (segmentHitsBox(camera, point, building)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool isHidden(const View& view, const Box& object, const std::vector<Box>& buildings) {
+    for (int axis = 0; axis < 3; axis++) {
+        for (int side = 0; side < 2; side++) {
+            for (int i = 0; i < FACE_SAMPLES; i++) {
+                for (int j = 0; j < FACE_SAMPLES; j++) {
+                    glm::vec3 t(0.0f);
+                    t[axis] = static_cast<float>(side);
+                    t[(axis + 1) % 3] = static_cast<float>(i) / (FACE_SAMPLES - 1);
+                    t[(axis + 2) % 3] = static_cast<float>(j) / (FACE_SAMPLES - 1);
+                    glm::vec3 point = object.min + (object.max - object.min) * t;
+                    float margin = PIXEL_MARGIN * view.pixelAngle * glm::distance(view.camera, point);
+                    bool blocked = false;
+                    for (int dx = -1; dx <= 1 && !blocked; dx++) {
+                        for (int dy = -1; dy <= 1 && !blocked; dy++) {
+                            glm::vec3 offset = (view.right * static_cast<float>(dx) + view.up * static_cast<float>(dy)) * margin;
+                            blocked = isBlocked(view.camera, point + offset, buildings);
+                        }
+                    }
+                    if (!blocked) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Logger::setSeverity(ERRLevel::WARNING);
+
+    uint32_t objectCount = 200000;
+    uint32_t repeat = 10;
+    uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+    uint32_t width = 320, height = 192;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--objects") == 0 && i + 1 < argc) {
+            objectCount = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc) {
+            width = std::max(16, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--height") == 0 && i + 1 < argc) {
+            height = std::max(16, atoi(argv[++i]));
+        } else {
+            fprintf(stderr, "usage: %s [--objects <count>] [--repeat <count>] [--threads <count>] [--width <pixels>] [--height <pixels>]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // buildings of random height on every block, the streets in between stay free
+    std::mt19937 random(11);
+    std::vector<Box> buildings{};
+    std::vector<glm::mat4> buildingWorlds{};
+    float citySize = CITY_BLOCKS * BLOCK_SIZE;
+    for (int bx = 0; bx < CITY_BLOCKS; bx++) {
+        for (int bz = 0; bz < CITY_BLOCKS; bz++) {
+            glm::vec3 min(bx * BLOCK_SIZE - citySize * 0.5f + STREET_WIDTH * 0.5f, 0.0f, bz * BLOCK_SIZE - citySize * 0.5f + STREET_WIDTH * 0.5f);
+            glm::vec3 size(BLOCK_SIZE - STREET_WIDTH, std::uniform_real_distribution<float>(10.0f, 60.0f)(random), BLOCK_SIZE - STREET_WIDTH);
+            buildings.push_back({min, min + size});
+            buildingWorlds.push_back(glm::scale(glm::translate(glm::mat4(1.0f), min), size));
+        }
+    }
+
+    // small things all over the city, some end up inside buildings which is fine, they are occluded all the same
+    std::uniform_real_distribution<float> position(-citySize * 0.5f, citySize * 0.5f);
+    std::uniform_real_distribution<float> size(0.2f, 2.0f);
+    std::vector<Box> objects(objectCount);
+    NanoFrustumCuller frustumCuller{};
+    frustumCuller.Resize(objectCount);
+    for (uint32_t i = 0; i < objectCount; i++) {
+        glm::vec3 extent(size(random), size(random), size(random));
+        glm::vec3 center(position(random), extent.y, position(random));
+        objects[i] = {center - extent, center + extent};
+        frustumCuller.SetBounds(i, objects[i].min, objects[i].max);
+    }
+
+    NanoJobSystem jobSystem{};
+    jobSystem.Init(threads - 1);
+    NanoOcclusionCuller occlusionCuller{};
+    occlusionCuller.Init(width, height);
+
+    // walking down the street between the two middle rows of blocks, looking in all directions
+    std::vector<View> views{};
+    std::vector<glm::mat4> viewProjections{};
+    float aspect = static_cast<float>(width) / height;
+    float tanHalfFov = std::tan(glm::radians(FIELD_OF_VIEW) * 0.5f);
+    glm::mat4 projection = glm::perspectiveRH_ZO(glm::radians(FIELD_OF_VIEW), aspect, 0.5f, 2000.0f);
+    for (uint32_t view = 0; view < VIEW_COUNT; view++) {
+        float angle = glm::two_pi<float>() * view / VIEW_COUNT;
+        glm::vec3 camera(-citySize * 0.5f + view * citySize / VIEW_COUNT, 1.8f, 0.0f);
+        glm::vec3 direction = glm::normalize(glm::vec3(std::cos(angle), 0.05f, std::sin(angle)));
+        glm::vec3 right = glm::normalize(glm::cross(direction, glm::vec3(0.0f, 1.0f, 0.0f)));
+        float pixelAngle = std::max(2.0f * tanHalfFov / occlusionCuller.GetHeight(), 2.0f * tanHalfFov * aspect / occlusionCuller.GetWidth());
+        views.push_back({camera, right, glm::cross(right, direction), pixelAngle});
+        viewProjections.push_back(projection * glm::lookAt(camera, camera + direction, glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+
+    printf("%u objects, %lu occluder boxes, %ux%u depth, %u views, %u threads, best of %u\n", objectCount,
+           static_cast<unsigned long>(buildings.size()), occlusionCuller.GetWidth(), occlusionCuller.GetHeight(), VIEW_COUNT, threads, repeat);
+    printf("%-8s %14s %12s %14s %14s %10s\n", "kernel", "raster ms", "test ms", "frustum vis", "occlusion vis", "culled");
+
+    std::vector<std::vector<uint8_t>> checked(VIEW_COUNT, std::vector<uint8_t>(objectCount, 0));
+    for (NanoCullingKernel kernel : {NanoCullingKernel::SCALAR, NanoCullingKernel::SSE}) {
+#ifndef NANO_CULLING_X86
+        if (kernel == NanoCullingKernel::SSE) {
+            printf("%-8s not supported on this CPU\n", NanoFrustumCuller::GetKernelName(kernel));
+            continue;
+        }
+#endif
+        double rasterizeTime = 0.0, testTime = 0.0;
+        uint64_t frustumVisible = 0, occlusionVisible = 0;
+        for (uint32_t view = 0; view < VIEW_COUNT; view++) {
+            uint32_t frustumCount = frustumCuller.Cull(NanoFrustum::FromViewProjection(viewProjections[view]), jobSystem);
+
+            double bestRasterize = 1e30, bestTest = 1e30;
+            uint32_t visibleCount = 0;
+            for (uint32_t r = 0; r < repeat; r++) {
+                occlusionCuller.BeginFrame(viewProjections[view]);
+                for (const glm::mat4& world : buildingWorlds) {
+                    occlusionCuller.AddOccluder(CUBE_VERTICES, CUBE_INDICES, 36, world);
+                }
+                occlusionCuller.Rasterize(jobSystem, kernel);
+                visibleCount = occlusionCuller.Cull(frustumCuller, frustumCuller.GetVisibleIndices(), frustumCount, jobSystem);
+                bestRasterize = std::min(bestRasterize, occlusionCuller.GetStats().rasterizeMs);
+                bestTest = std::min(bestTest, occlusionCuller.GetStats().testMs);
+            }
+            rasterizeTime += bestRasterize;
+            testTime += bestTest;
+            frustumVisible += frustumCount;
+            occlusionVisible += visibleCount;
+
+            // everything frustum culling kept but occlusion culling dropped has to be behind a building
+            std::vector<uint8_t> isVisible(objectCount, 0);
+            for (uint32_t i = 0; i < visibleCount; i++) {
+                isVisible[occlusionCuller.GetVisibleIndices()[i]] = 1;
+            }
+            for (uint32_t i = 0; i < frustumCount; i++) {
+                uint32_t object = frustumCuller.GetVisibleIndices()[i];
+                if (isVisible[object] || checked[view][object]) {
+                    continue;
+                }
+                if (!isHidden(views[view], objects[object], buildings)) {
+                    fprintf(stderr, "%s: object %u is visible from view %u but was culled\n", NanoFrustumCuller::GetKernelName(kernel), object, view);
+                    return EXIT_FAILURE;
+                }
+                checked[view][object] = 1;
+            }
+        }
+
+        printf("%-8s %14.3f %12.3f %14lu %14lu %9.1f%%\n", NanoFrustumCuller::GetKernelName(kernel), rasterizeTime / VIEW_COUNT,
+               testTime / VIEW_COUNT, static_cast<unsigned long>(frustumVisible / VIEW_COUNT),
+               static_cast<unsigned long>(occlusionVisible / VIEW_COUNT),
+               100.0 * (frustumVisible - occlusionVisible) / std::max<uint64_t>(1, frustumVisible));
+    }
+
+    const NanoOcclusionStats& stats = occlusionCuller.GetStats();
+    printf("last view: %u occluder triangles, %u rasterized\n", stats.occluderTriangles, stats.rasterizedTriangles);
+
+    jobSystem.CleanUp();
+    return EXIT_SUCCESS;
+}
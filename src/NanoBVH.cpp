@@ -0,0 +1,521 @@
+#include "NanoBVH.hpp"
+
+#include <algorithm>
+#include <utility>
+
+static float surfaceArea(const glm::vec3& min, const glm::vec3& max) {
+    glm::vec3 size = glm::max(max - min, glm::vec3(0.0f));
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static glm::vec3 slotMin(const NanoBVHNode& node, uint32_t slot) {
+    return glm::vec3(node.minX[slot], node.minY[slot], node.minZ[slot]);
+}
+
+static glm::vec3 slotMax(const NanoBVHNode& node, uint32_t slot) {
+    return glm::vec3(node.maxX[slot], node.maxY[slot], node.maxZ[slot]);
+}
+
+static void setSlotBounds(NanoBVHNode& node, uint32_t slot, const glm::vec3& min, const glm::vec3& max) {
+    node.minX[slot] = min.x;
+    node.minY[slot] = min.y;
+    node.minZ[slot] = min.z;
+    node.maxX[slot] = max.x;
+    node.maxY[slot] = max.y;
+    node.maxZ[slot] = max.z;
+}
+
+void NanoBVH::Resize(uint32_t objectCount) {
+    m_mins.resize(objectCount, glm::vec3(0.0f));
+    m_maxs.resize(objectCount, glm::vec3(0.0f));
+}
+
+void NanoBVH::SetBounds(uint32_t object, const glm::vec3& min, const glm::vec3& max) {
+    m_mins[object] = min;
+    m_maxs[object] = max;
+}
+
+void NanoBVH::BuildBinary(BuildContext& context, uint32_t nodeIndex, uint32_t begin, uint32_t end) {
+    BuildNode& node = context.nodes[nodeIndex];
+    glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX), centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+    BuildPrimitive* primitives = context.primitives.data() + (begin - context.first);
+    uint32_t count = end - begin;
+    for (uint32_t i = 0; i < count; i++) {
+        boundsMin = glm::min(boundsMin, primitives[i].min);
+        boundsMax = glm::max(boundsMax, primitives[i].max);
+        centroidMin = glm::min(centroidMin, primitives[i].centroid);
+        centroidMax = glm::max(centroidMax, primitives[i].centroid);
+    }
+    node = {boundsMin, boundsMax, UINT32_MAX, UINT32_MAX, begin, count};
+    if (count <= MAX_LEAF_SIZE) {
+        return;
+    }
+
+    // binned SAH over all three axes in one pass over the objects, the split goes between two bins.
+    // An axis without centroid extent puts everything in its first bin and never finds a split
+    struct Bin {
+        glm::vec3 min{FLT_MAX}, max{-FLT_MAX};
+        uint32_t count = 0;
+    };
+    glm::vec3 centroidExtent = centroidMax - centroidMin;
+    // small nodes don't need all the bins, most of the cost there would be sweeping empty ones
+    uint32_t binCount = std::min(BIN_COUNT, count);
+    glm::vec3 scale = glm::vec3(static_cast<float>(binCount)) / glm::max(centroidExtent, glm::vec3(FLT_MIN));
+    Bin axisBins[3][BIN_COUNT];
+    for (int axis = 0; axis < 3; axis++) {
+        std::fill(axisBins[axis], axisBins[axis] + binCount, Bin{});
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        glm::vec3 binPosition = (primitives[i].centroid - centroidMin) * scale;
+        for (int axis = 0; axis < 3; axis++) {
+            Bin& bin = axisBins[axis][std::min(binCount - 1, static_cast<uint32_t>(binPosition[axis]))];
+            bin.min = glm::min(bin.min, primitives[i].min);
+            bin.max = glm::max(bin.max, primitives[i].max);
+            bin.count++;
+        }
+    }
+
+    int bestAxis = -1;
+    uint32_t bestSplit = 0; // bins [0, bestSplit] go left
+    float bestCost = FLT_MAX;
+    for (int axis = 0; axis < 3; axis++) {
+        const Bin* bins = axisBins[axis];
+        float rightCost[BIN_COUNT];
+        Bin right{};
+        for (uint32_t bin = binCount - 1; bin > 0; bin--) {
+            right.min = glm::min(right.min, bins[bin].min);
+            right.max = glm::max(right.max, bins[bin].max);
+            right.count += bins[bin].count;
+            rightCost[bin - 1] = right.count ? surfaceArea(right.min, right.max) * right.count : 0.0f;
+        }
+        Bin left{};
+        for (uint32_t split = 0; split < binCount - 1; split++) {
+            left.min = glm::min(left.min, bins[split].min);
+            left.max = glm::max(left.max, bins[split].max);
+            left.count += bins[split].count;
+            float cost = (left.count ? surfaceArea(left.min, left.max) * left.count : 0.0f) + rightCost[split];
+            if (left.count > 0 && left.count < count && cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    uint32_t middle = begin + count / 2; // every centroid in the same spot, any split is as good as another
+    if (bestAxis >= 0) {
+        auto goesLeft = [&](const BuildPrimitive& primitive) {
+            float binPosition = (primitive.centroid[bestAxis] - centroidMin[bestAxis]) * scale[bestAxis];
+            uint32_t bin = std::min(binCount - 1, static_cast<uint32_t>(binPosition));
+            return bin <= bestSplit;
+        };
+        middle = begin + static_cast<uint32_t>(std::partition(primitives, primitives + count, goesLeft) - primitives);
+    }
+
+    uint32_t left = context.nodeCount.fetch_add(2, std::memory_order_relaxed);
+    node.left = left;
+    node.right = left + 1;
+    if (count > PARALLEL_BUILD_THRESHOLD) {
+        NanoJobCounter counter{};
+        context.jobSystem->Run([this, &context, left, begin, middle]() { BuildBinary(context, left, begin, middle); }, &counter);
+        BuildBinary(context, left + 1, middle, end);
+        context.jobSystem->Wait(counter);
+    } else {
+        BuildBinary(context, left, begin, middle);
+        BuildBinary(context, left + 1, middle, end);
+    }
+}
+
+uint32_t NanoBVH::Collapse(const BuildContext& context, uint32_t binaryIndex, uint32_t depth) {
+    uint32_t nodeIndex = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.emplace_back();
+    for (uint32_t slot = 0; slot < 4; slot++) {
+        setSlotBounds(m_nodes[nodeIndex], slot, glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX));
+        m_nodes[nodeIndex].child[slot] = 0;
+        m_nodes[nodeIndex].count[slot] = NanoBVHNode::EMPTY;
+    }
+
+    // pull up grandchildren until there are four children, always opening the biggest one
+    uint32_t children[4] = {binaryIndex};
+    uint32_t childCount = 1;
+    if (context.nodes[binaryIndex].left != UINT32_MAX) {
+        children[0] = context.nodes[binaryIndex].left;
+        children[1] = context.nodes[binaryIndex].right;
+        childCount = 2;
+    }
+    while (childCount < 4) {
+        int open = -1;
+        float openArea = -1.0f;
+        for (uint32_t i = 0; i < childCount; i++) {
+            const BuildNode& child = context.nodes[children[i]];
+            float area = surfaceArea(child.min, child.max);
+            if (child.left != UINT32_MAX && area > openArea) {
+                open = static_cast<int>(i);
+                openArea = area;
+            }
+        }
+        if (open < 0) {
+            break;
+        }
+        const BuildNode& opened = context.nodes[children[open]];
+        children[open] = opened.left;
+        children[childCount++] = opened.right;
+    }
+
+    // children are written in order, so the layout ends up depth first
+    for (uint32_t slot = 0; slot < childCount; slot++) {
+        const BuildNode& child = context.nodes[children[slot]];
+        setSlotBounds(m_nodes[nodeIndex], slot, child.min, child.max);
+        if (child.left == UINT32_MAX) {
+            m_nodes[nodeIndex].child[slot] = child.begin;
+            m_nodes[nodeIndex].count[slot] = child.count;
+            continue;
+        }
+
+        uint32_t firstNode = static_cast<uint32_t>(m_nodes.size());
+        uint32_t childIndex = Collapse(context, children[slot], depth + 1);
+        m_nodes[nodeIndex].child[slot] = childIndex;
+        m_nodes[nodeIndex].count[slot] = 0;
+        if (depth + 1 == SUBTREE_DEPTH) {
+            uint32_t nodeCount = static_cast<uint32_t>(m_nodes.size()) - firstNode;
+            m_subtrees.push_back({nodeIndex, slot, child.begin, child.count, nodeCount, 0.0f});
+        }
+    }
+    return nodeIndex;
+}
+
+uint32_t NanoBVH::BuildRange(uint32_t begin, uint32_t end, uint32_t depth, NanoJobSystem& jobSystem) {
+    BuildContext context{};
+    context.jobSystem = &jobSystem;
+    context.nodes.resize(2 * static_cast<size_t>(end - begin));
+    context.nodeCount = 1;
+    context.first = begin;
+    context.primitives.resize(end - begin);
+    for (uint32_t i = begin; i < end; i++) {
+        uint32_t object = m_objects[i];
+        context.primitives[i - begin] = {m_mins[object], m_maxs[object], (m_mins[object] + m_maxs[object]) * 0.5f, object};
+    }
+
+    BuildBinary(context, 0, begin, end);
+    for (uint32_t i = begin; i < end; i++) {
+        m_objects[i] = context.primitives[i - begin].object;
+    }
+    return Collapse(context, 0, depth);
+}
+
+void NanoBVH::Build(NanoJobSystem& jobSystem) {
+    m_nodes.clear();
+    m_subtrees.clear();
+    m_garbageNodes = 0;
+    m_buildCost = 0.0f;
+
+    uint32_t objectCount = GetObjectCount();
+    m_objects.resize(objectCount);
+    for (uint32_t i = 0; i < objectCount; i++) {
+        m_objects[i] = i;
+    }
+    if (objectCount == 0) {
+        return;
+    }
+
+    BuildRange(0, objectCount, 0, jobSystem);
+    for (Subtree& subtree : m_subtrees) {
+        const NanoBVHNode& parent = m_nodes[subtree.parent];
+        uint32_t nodeCount = 0;
+        float area = std::max(surfaceArea(slotMin(parent, subtree.slot), slotMax(parent, subtree.slot)), FLT_MIN);
+        subtree.buildCost = SubtreeCost(parent.child[subtree.slot], nodeCount) / area;
+    }
+    m_buildCost = GetCost();
+}
+
+void NanoBVH::RefitNode(uint32_t nodeIndex, uint32_t depth, NanoJobSystem& jobSystem) {
+    // the first levels fan out over the job system, below that every subtree is refit by whoever picked it up
+    NanoJobCounter counter{};
+    for (uint32_t slot = 0; slot < 4; slot++) {
+        if (m_nodes[nodeIndex].count[slot] != 0) {
+            continue;
+        }
+        uint32_t child = m_nodes[nodeIndex].child[slot];
+        if (depth < SUBTREE_DEPTH) {
+            jobSystem.Run([this, child, depth, &jobSystem]() { RefitNode(child, depth + 1, jobSystem); }, &counter);
+        } else {
+            RefitNode(child, depth + 1, jobSystem);
+        }
+    }
+    jobSystem.Wait(counter);
+
+    NanoBVHNode& node = m_nodes[nodeIndex];
+    for (uint32_t slot = 0; slot < 4; slot++) {
+        if (node.count[slot] == NanoBVHNode::EMPTY) {
+            continue;
+        }
+        glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+        if (node.count[slot] > 0) {
+            for (uint32_t i = node.child[slot]; i < node.child[slot] + node.count[slot]; i++) {
+                min = glm::min(min, m_mins[m_objects[i]]);
+                max = glm::max(max, m_maxs[m_objects[i]]);
+            }
+        } else {
+            const NanoBVHNode& child = m_nodes[node.child[slot]];
+            for (uint32_t childSlot = 0; childSlot < 4; childSlot++) {
+                if (child.count[childSlot] != NanoBVHNode::EMPTY) {
+                    min = glm::min(min, slotMin(child, childSlot));
+                    max = glm::max(max, slotMax(child, childSlot));
+                }
+            }
+        }
+        setSlotBounds(node, slot, min, max);
+    }
+}
+
+void NanoBVH::Refit(NanoJobSystem& jobSystem) {
+    if (!m_nodes.empty()) {
+        RefitNode(0, 0, jobSystem);
+    }
+}
+
+float NanoBVH::SubtreeCost(uint32_t nodeIndex, uint32_t& nodeCount) const {
+    // visiting a node costs its area, testing the objects of a leaf its area times the object count
+    const NanoBVHNode& node = m_nodes[nodeIndex];
+    nodeCount++;
+    float cost = 0.0f;
+    for (uint32_t slot = 0; slot < 4; slot++) {
+        if (node.count[slot] == NanoBVHNode::EMPTY) {
+            continue;
+        }
+        float area = surfaceArea(slotMin(node, slot), slotMax(node, slot));
+        if (node.count[slot] > 0) {
+            cost += area * node.count[slot];
+        } else {
+            cost += area + SubtreeCost(node.child[slot], nodeCount);
+        }
+    }
+    return cost;
+}
+
+float NanoBVH::GetCost() const {
+    if (m_nodes.empty()) {
+        return 0.0f;
+    }
+    glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+    for (uint32_t slot = 0; slot < 4; slot++) {
+        if (m_nodes[0].count[slot] != NanoBVHNode::EMPTY) {
+            min = glm::min(min, slotMin(m_nodes[0], slot));
+            max = glm::max(max, slotMax(m_nodes[0], slot));
+        }
+    }
+    uint32_t nodeCount = 0;
+    return SubtreeCost(0, nodeCount) / std::max(surfaceArea(min, max), FLT_MIN);
+}
+
+uint32_t NanoBVH::Update(NanoJobSystem& jobSystem) {
+    if (m_nodes.empty()) {
+        return 0;
+    }
+    Refit(jobSystem);
+
+    std::vector<float> costs(m_subtrees.size());
+    jobSystem.ParallelFor(static_cast<uint32_t>(m_subtrees.size()), 1, [this, &costs](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            const NanoBVHNode& parent = m_nodes[m_subtrees[i].parent];
+            uint32_t nodeCount = 0;
+            float area = std::max(surfaceArea(slotMin(parent, m_subtrees[i].slot), slotMax(parent, m_subtrees[i].slot)), FLT_MIN);
+            costs[i] = SubtreeCost(parent.child[m_subtrees[i].slot], nodeCount) / area;
+        }
+    });
+
+    // the levels above the subtrees can't be fixed by partial rebuilds, and when most subtrees went bad a full build is cheaper anyway
+    uint32_t degradedCount = 0;
+    for (uint32_t i = 0; i < m_subtrees.size(); i++) {
+        degradedCount += costs[i] > m_subtrees[i].buildCost * REBUILD_COST_RATIO;
+    }
+    if (degradedCount * 2 > m_subtrees.size() || GetCost() > m_buildCost * REBUILD_COST_RATIO) {
+        Build(jobSystem);
+        m_fullRebuildCount++;
+        return 0;
+    }
+
+    // a rebuilt subtree covers the same objects, so its bounds and everything above it stay valid
+    uint32_t rebuiltCount = 0;
+    for (uint32_t i = 0; i < m_subtrees.size() && rebuiltCount < degradedCount; i++) {
+        Subtree& subtree = m_subtrees[i];
+        if (costs[i] <= subtree.buildCost * REBUILD_COST_RATIO) {
+            continue;
+        }
+        uint32_t firstNode = static_cast<uint32_t>(m_nodes.size());
+        uint32_t root = BuildRange(subtree.begin, subtree.begin + subtree.count, SUBTREE_DEPTH, jobSystem);
+        m_nodes[subtree.parent].child[subtree.slot] = root;
+        m_garbageNodes += subtree.nodeCount;
+        subtree.nodeCount = static_cast<uint32_t>(m_nodes.size()) - firstNode;
+
+        const NanoBVHNode& parent = m_nodes[subtree.parent];
+        uint32_t nodeCount = 0;
+        float area = std::max(surfaceArea(slotMin(parent, subtree.slot), slotMax(parent, subtree.slot)), FLT_MIN);
+        subtree.buildCost = SubtreeCost(root, nodeCount) / area;
+        rebuiltCount++;
+    }
+
+    // the nodes left behind only cost memory, until there are too many of them
+    if (m_garbageNodes > GARBAGE_RATIO * (m_nodes.size() - m_garbageNodes)) {
+        Build(jobSystem);
+        m_fullRebuildCount++;
+    }
+    return rebuiltCount;
+}
+
+// -1 outside, 0 intersecting, 1 inside
+static int classifyBox(const NanoFrustum& frustum, const glm::vec3& min, const glm::vec3& max) {
+    glm::vec3 center = (min + max) * 0.5f;
+    glm::vec3 extent = (max - min) * 0.5f;
+    int result = 1;
+    for (const glm::vec4& plane : frustum.planes) {
+        float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+        float radius = std::abs(plane.x) * extent.x + std::abs(plane.y) * extent.y + std::abs(plane.z) * extent.z;
+        if (distance < -radius) {
+            return -1;
+        }
+        if (distance < radius) {
+            result = 0;
+        }
+    }
+    return result;
+}
+
+void NanoBVH::QueryFrustum(const NanoFrustum& frustum, std::vector<uint32_t>& objects) const {
+    if (m_nodes.empty()) {
+        return;
+    }
+    // once a node is completely inside, nothing below it needs testing anymore
+    std::vector<std::pair<uint32_t, bool>> stack{{0, false}};
+    while (!stack.empty()) {
+        auto [nodeIndex, parentInside] = stack.back();
+        stack.pop_back();
+        const NanoBVHNode& node = m_nodes[nodeIndex];
+        for (uint32_t slot = 0; slot < 4; slot++) {
+            if (node.count[slot] == NanoBVHNode::EMPTY) {
+                continue;
+            }
+            bool inside = parentInside;
+            if (!inside) {
+                int result = classifyBox(frustum, slotMin(node, slot), slotMax(node, slot));
+                if (result < 0) {
+                    continue;
+                }
+                inside = result > 0;
+            }
+
+            if (node.count[slot] == 0) {
+                stack.emplace_back(node.child[slot], inside);
+                continue;
+            }
+            for (uint32_t i = node.child[slot]; i < node.child[slot] + node.count[slot]; i++) {
+                uint32_t object = m_objects[i];
+                if (inside || classifyBox(frustum, m_mins[object], m_maxs[object]) >= 0) {
+                    objects.push_back(object);
+                }
+            }
+        }
+    }
+}
+
+void NanoBVH::QueryOverlap(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& objects) const {
+    if (m_nodes.empty()) {
+        return;
+    }
+    auto overlaps = [&min, &max](const glm::vec3& otherMin, const glm::vec3& otherMax) {
+        return otherMin.x <= max.x && otherMin.y <= max.y && otherMin.z <= max.z && otherMax.x >= min.x && otherMax.y >= min.y &&
+               otherMax.z >= min.z;
+    };
+
+    std::vector<uint32_t> stack{0};
+    while (!stack.empty()) {
+        const NanoBVHNode& node = m_nodes[stack.back()];
+        stack.pop_back();
+        for (uint32_t slot = 0; slot < 4; slot++) {
+            if (node.count[slot] == NanoBVHNode::EMPTY || !overlaps(slotMin(node, slot), slotMax(node, slot))) {
+                continue;
+            }
+            if (node.count[slot] == 0) {
+                stack.push_back(node.child[slot]);
+                continue;
+            }
+            for (uint32_t i = node.child[slot]; i < node.child[slot] + node.count[slot]; i++) {
+                if (overlaps(m_mins[m_objects[i]], m_maxs[m_objects[i]])) {
+                    objects.push_back(m_objects[i]);
+                }
+            }
+        }
+    }
+}
+
+// slab test, the entry distance when hit (0 when the origin is inside), FLT_MAX otherwise
+static float intersectBox(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, const glm::vec3& min,
+                          const glm::vec3& max) {
+    glm::vec3 t0 = (min - origin) * inverseDirection;
+    glm::vec3 t1 = (max - origin) * inverseDirection;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+    float enter = std::max({tNear.x, tNear.y, tNear.z, 0.0f});
+    float exit = std::min({tFar.x, tFar.y, tFar.z, maxDistance});
+    return enter <= exit ? enter : FLT_MAX;
+}
+
+bool NanoBVH::Raycast(const NanoRay& ray, NanoRayHit& hit) const {
+    hit = {};
+    if (m_nodes.empty()) {
+        return false;
+    }
+    glm::vec3 inverseDirection = 1.0f / ray.direction;
+
+    // nearest child on top of the stack, and anything that starts behind the closest hit so far is skipped
+    std::vector<std::pair<float, uint32_t>> stack{{0.0f, 0}};
+    while (!stack.empty()) {
+        auto [enter, nodeIndex] = stack.back();
+        stack.pop_back();
+        if (enter >= hit.distance) {
+            continue;
+        }
+
+        const NanoBVHNode& node = m_nodes[nodeIndex];
+        std::pair<float, uint32_t> children[4];
+        uint32_t childCount = 0;
+        for (uint32_t slot = 0; slot < 4; slot++) {
+            if (node.count[slot] == NanoBVHNode::EMPTY) {
+                continue;
+            }
+            float maxDistance = std::min(ray.maxDistance, hit.distance);
+            float distance = intersectBox(ray.origin, inverseDirection, maxDistance, slotMin(node, slot), slotMax(node, slot));
+            if (distance == FLT_MAX) {
+                continue;
+            }
+            if (node.count[slot] == 0) {
+                children[childCount++] = {distance, node.child[slot]};
+                continue;
+            }
+            for (uint32_t i = node.child[slot]; i < node.child[slot] + node.count[slot]; i++) {
+                uint32_t object = m_objects[i];
+                float objectDistance = intersectBox(ray.origin, inverseDirection, maxDistance, m_mins[object], m_maxs[object]);
+                if (objectDistance < hit.distance) {
+                    hit = {object, objectDistance};
+                }
+            }
+        }
+        std::sort(children, children + childCount, [](const auto& a, const auto& b) { return a.first > b.first; });
+        stack.insert(stack.end(), children, children + childCount);
+    }
+    return hit.object != UINT32_MAX;
+}
+
+NanoRay NanoBVH::ScreenPointToRay(float x, float y, float width, float height, const glm::mat4& inverseViewProjection) {
+    glm::vec2 ndc(2.0f * x / width - 1.0f, 2.0f * y / height - 1.0f);
+    glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc, 0.0f, 1.0f);
+    glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+    glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+    glm::vec3 toFar = glm::vec3(farPoint) / farPoint.w - origin;
+
+    NanoRay ray{};
+    ray.origin = origin;
+    ray.maxDistance = glm::length(toFar);
+    ray.direction = toFar / ray.maxDistance;
+    return ray;
+}
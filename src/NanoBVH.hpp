@@ -0,0 +1,114 @@
+#ifndef NANOBVH_H_
+#define NANOBVH_H_
+
+#include "NanoError.hpp"
+#include "NanoFrustumCuller.hpp"
+#include "NanoJobSystem.hpp"
+
+#include "glm/glm.hpp"
+
+#include <atomic>
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+struct NanoRay {
+    glm::vec3 origin{0.0f};
+    glm::vec3 direction{0.0f, 0.0f, 1.0f}; // normalized
+    float maxDistance = FLT_MAX;
+};
+
+struct NanoRayHit {
+    uint32_t object = UINT32_MAX;
+    float distance = FLT_MAX;
+};
+
+// 4 wide node, the bounds of the four children as SoA so one node is tested in one go.
+// Two cache lines, nodes are laid out depth first so a subtree is mostly one contiguous block
+struct alignas(64) NanoBVHNode {
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+
+    float minX[4], minY[4], minZ[4];
+    float maxX[4], maxY[4], maxZ[4];
+    uint32_t child[4]; // node index, or the first entry in the object list for leaves
+    uint32_t count[4]; // objects in the leaf, 0 for inner nodes, EMPTY for unused slots
+};
+
+// Bounding volume hierarchy over the world bounds of scene objects, for culling, picking and proximity queries.
+// Built top down with binned SAH, big subtrees in parallel, then collapsed to 4 wide nodes.
+// Moving objects only need Update: bounds are refit bottom up, and the subtrees that got much worse than when they were
+// built (SAH cost) are rebuilt on their own. A full rebuild only happens when most of them or the top levels degraded,
+// or once too many nodes were left behind by partial rebuilds
+class NanoBVH {
+  public:
+    static constexpr uint32_t BIN_COUNT = 16;
+    static constexpr uint32_t MAX_LEAF_SIZE = 4;
+    static constexpr uint32_t PARALLEL_BUILD_THRESHOLD = 4096; // objects, below that a subtree is built on the current thread
+    static constexpr uint32_t SUBTREE_DEPTH = 2;               // nodes this deep are the unit of partial rebuilds (up to 16)
+    static constexpr float REBUILD_COST_RATIO = 1.5f;          // subtree SAH cost compared to right after it was built
+    static constexpr float GARBAGE_RATIO = 0.5f;               // unreachable nodes left by partial rebuilds, compared to the live ones
+
+    void Resize(uint32_t objectCount); // needs a Build afterwards
+    void SetBounds(uint32_t object, const glm::vec3& min, const glm::vec3& max);
+    uint32_t GetObjectCount() { return static_cast<uint32_t>(m_mins.size()); }
+
+    void Build(NanoJobSystem& jobSystem);
+    void Refit(NanoJobSystem& jobSystem);
+    // refit, then rebuild the subtrees that degraded too much. Returns how many subtrees were rebuilt, 0 after a full rebuild
+    uint32_t Update(NanoJobSystem& jobSystem);
+
+    // objects whose bounds touch the query, in no particular order. Results are appended
+    void QueryFrustum(const NanoFrustum& frustum, std::vector<uint32_t>& objects) const;
+    void QueryOverlap(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& objects) const;
+    // closest object whose bounds the ray hits
+    bool Raycast(const NanoRay& ray, NanoRayHit& hit) const;
+
+    // ray through a pixel, e.g. the cursor position from NanoWindow. Window coordinates start top left, like Vulkan's NDC
+    static NanoRay ScreenPointToRay(float x, float y, float width, float height, const glm::mat4& inverseViewProjection);
+
+    float GetCost() const; // SAH cost of the whole tree, relative to the root's area
+    uint32_t GetNodeCount() { return static_cast<uint32_t>(m_nodes.size()); }
+    uint32_t GetRebuildCount() { return m_fullRebuildCount; }
+
+  private:
+    struct BuildNode {
+        glm::vec3 min, max;
+        uint32_t left, right; // UINT32_MAX for leaves
+        uint32_t begin, count;
+    };
+    struct BuildPrimitive {
+        glm::vec3 min, max, centroid;
+        uint32_t object;
+    };
+    struct BuildContext {
+        std::vector<BuildNode> nodes{};
+        std::atomic<uint32_t> nodeCount{0};
+        // copy of the bounds for the range being built, partitioned in place so binning reads memory in order
+        std::vector<BuildPrimitive> primitives{};
+        uint32_t first = 0; // where the range starts in the object list
+        NanoJobSystem* jobSystem = nullptr;
+    };
+    struct Subtree {
+        uint32_t parent, slot; // where the subtree hangs
+        uint32_t begin, count; // its range in the object list
+        uint32_t nodeCount;
+        float buildCost; // relative to the subtree's own area, so a subtree that only moved or grew doesn't count as worse
+    };
+
+    void BuildBinary(BuildContext& context, uint32_t nodeIndex, uint32_t begin, uint32_t end);
+    uint32_t BuildRange(uint32_t begin, uint32_t end, uint32_t depth, NanoJobSystem& jobSystem); // returns the new 4 wide root
+    uint32_t Collapse(const BuildContext& context, uint32_t binaryIndex, uint32_t depth);
+    void RefitNode(uint32_t nodeIndex, uint32_t depth, NanoJobSystem& jobSystem);
+    float SubtreeCost(uint32_t nodeIndex, uint32_t& nodeCount) const;
+
+    std::vector<glm::vec3> m_mins{};
+    std::vector<glm::vec3> m_maxs{};
+    std::vector<uint32_t> m_objects{}; // leaves point into this
+    std::vector<NanoBVHNode> m_nodes{};
+    std::vector<Subtree> m_subtrees{};
+    uint32_t m_garbageNodes = 0;
+    uint32_t m_fullRebuildCount = 0;
+    float m_buildCost = 0.0f;
+};
+
+#endif // NANOBVH_H_
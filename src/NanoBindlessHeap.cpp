@@ -0,0 +1,370 @@
+#include "NanoBindlessHeap.hpp"
+#include "NanoLogger.hpp"
+
+#include <algorithm>
+
+static VkDescriptorType toDescriptorType(BindlessType type) {
+    switch (type) {
+    case BindlessType::SAMPLED_IMAGE:
+        return VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    case BindlessType::SAMPLER:
+        return VK_DESCRIPTOR_TYPE_SAMPLER;
+    case BindlessType::STORAGE_BUFFER:
+    default:
+        return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    }
+}
+
+VkPushConstantRange NanoBindlessHeap::GetPushConstantRange() {
+    VkPushConstantRange range{};
+    range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    range.offset = 0;
+    range.size = sizeof(NanoMaterialIndices);
+    return range;
+}
+
+ERR NanoBindlessHeap::Init(VkDevice& device, const BindlessCapabilities& capabilities) {
+    ERR err = ERR::OK;
+    _device = device;
+    m_updateAfterBind = capabilities.descriptorIndexing;
+
+    m_capacity[static_cast<uint32_t>(BindlessType::SAMPLED_IMAGE)] = capabilities.maxSampledImages;
+    m_capacity[static_cast<uint32_t>(BindlessType::SAMPLER)] = capabilities.maxSamplers;
+    m_capacity[static_cast<uint32_t>(BindlessType::STORAGE_BUFFER)] = capabilities.maxStorageBuffers;
+
+    VkDescriptorSetLayoutBinding bindings[static_cast<uint32_t>(BindlessType::COUNT)]{};
+    VkDescriptorBindingFlags bindingFlags[static_cast<uint32_t>(BindlessType::COUNT)]{};
+    VkDescriptorPoolSize poolSizes[static_cast<uint32_t>(BindlessType::COUNT)]{};
+    const uint32_t setCount = m_updateAfterBind ? 1 : Config::MAX_FRAMES_IN_FLIGHT;
+
+    for (uint32_t i = 0; i < static_cast<uint32_t>(BindlessType::COUNT); i++) {
+        if (m_capacity[i] == 0) {
+            LOG_MSG(ERRLevel::WARNING, "Bindless heap has no room for descriptor type %d", i);
+            return ERR::INVALID;
+        }
+        bindings[i].binding = i;
+        bindings[i].descriptorType = toDescriptorType(static_cast<BindlessType>(i));
+        bindings[i].descriptorCount = m_capacity[i];
+        bindings[i].stageFlags = VK_SHADER_STAGE_ALL;
+        bindings[i].pImmutableSamplers = nullptr;
+
+        bindingFlags[i] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+
+        poolSizes[i].type = bindings[i].descriptorType;
+        poolSizes[i].descriptorCount = m_capacity[i] * setCount;
+
+        m_descriptors[i].assign(m_capacity[i], Descriptor{});
+        m_freeSlots[i].clear();
+        m_allocated[i].assign(m_capacity[i], false);
+        m_nextSlot[i] = 0;
+        m_used[i] = 0;
+        m_backfill[i] = BINDLESS_INVALID_SLOT;
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = static_cast<uint32_t>(BindlessType::COUNT);
+    bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(BindlessType::COUNT);
+    layoutInfo.pBindings = bindings;
+    if (m_updateAfterBind) {
+        layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        layoutInfo.pNext = &bindingFlagsInfo;
+    }
+
+    if (vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr, &m_setLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create bindless descriptor set layout!");
+    }
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = m_updateAfterBind ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT : 0;
+    poolInfo.maxSets = setCount;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(BindlessType::COUNT);
+    poolInfo.pPoolSizes = poolSizes;
+
+    if (vkCreateDescriptorPool(_device, &poolInfo, nullptr, &m_pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create bindless descriptor pool!");
+    }
+
+    VkDescriptorSetLayout setLayouts[Config::MAX_FRAMES_IN_FLIGHT];
+    std::fill_n(setLayouts, Config::MAX_FRAMES_IN_FLIGHT, m_setLayout);
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_pool;
+    allocInfo.descriptorSetCount = setCount;
+    allocInfo.pSetLayouts = setLayouts;
+
+    if (vkAllocateDescriptorSets(_device, &allocInfo, m_sets) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate bindless descriptor set!");
+    }
+
+    LOG_MSG(ERRLevel::INFO, "Bindless heap created (%s): %d images, %d samplers, %d storage buffers",
+            m_updateAfterBind ? "update-after-bind" : "per-frame fallback", m_capacity[0], m_capacity[1], m_capacity[2]);
+
+    m_isInit = true;
+    return err;
+}
+
+void NanoBindlessHeap::CleanUp() {
+    if (!m_isInit) {
+        return;
+    }
+
+    // the device is idle at this point, every pending release can run
+    for (auto& retired : m_retired) {
+        if (retired.onRetire) {
+            retired.onRetire();
+        }
+    }
+    m_retired.clear();
+
+    vkDestroyDescriptorPool(_device, m_pool, nullptr); // frees the sets as well
+    vkDestroyDescriptorSetLayout(_device, m_setLayout, nullptr);
+    m_isInit = false;
+}
+
+uint32_t NanoBindlessHeap::allocateSlot(BindlessType type) {
+    const uint32_t typeIndex = static_cast<uint32_t>(type);
+    uint32_t slot = BINDLESS_INVALID_SLOT;
+
+    if (!m_freeSlots[typeIndex].empty()) {
+        slot = m_freeSlots[typeIndex].back();
+        m_freeSlots[typeIndex].pop_back();
+    } else if (m_nextSlot[typeIndex] < m_capacity[typeIndex]) {
+        slot = m_nextSlot[typeIndex]++;
+    } else {
+        LOG_MSG(ERRLevel::WARNING, "Bindless heap is full for descriptor type %d", typeIndex);
+        return slot;
+    }
+
+    m_allocated[typeIndex][slot] = true;
+    m_used[typeIndex]++;
+    return slot;
+}
+
+uint32_t NanoBindlessHeap::AddSampledImage(VkImageView imageView, VkImageLayout imageLayout) {
+    ASSERT(m_isInit, "Bindless heap used before Init");
+    uint32_t slot = allocateSlot(BindlessType::SAMPLED_IMAGE);
+    if (slot == BINDLESS_INVALID_SLOT) {
+        return slot;
+    }
+
+    Descriptor& descriptor = m_descriptors[static_cast<uint32_t>(BindlessType::SAMPLED_IMAGE)][slot];
+    descriptor.imageInfo.imageView = imageView;
+    descriptor.imageInfo.imageLayout = imageLayout;
+    descriptor.live = true;
+    writeSlot(BindlessType::SAMPLED_IMAGE, slot);
+    return slot;
+}
+
+uint32_t NanoBindlessHeap::AddSampler(VkSampler sampler) {
+    ASSERT(m_isInit, "Bindless heap used before Init");
+    uint32_t slot = allocateSlot(BindlessType::SAMPLER);
+    if (slot == BINDLESS_INVALID_SLOT) {
+        return slot;
+    }
+
+    Descriptor& descriptor = m_descriptors[static_cast<uint32_t>(BindlessType::SAMPLER)][slot];
+    descriptor.imageInfo.sampler = sampler;
+    descriptor.live = true;
+    writeSlot(BindlessType::SAMPLER, slot);
+    return slot;
+}
+
+uint32_t NanoBindlessHeap::AddStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    ASSERT(m_isInit, "Bindless heap used before Init");
+    uint32_t slot = allocateSlot(BindlessType::STORAGE_BUFFER);
+    if (slot == BINDLESS_INVALID_SLOT) {
+        return slot;
+    }
+
+    Descriptor& descriptor = m_descriptors[static_cast<uint32_t>(BindlessType::STORAGE_BUFFER)][slot];
+    descriptor.bufferInfo.buffer = buffer;
+    descriptor.bufferInfo.offset = offset;
+    descriptor.bufferInfo.range = range;
+    descriptor.live = true;
+    writeSlot(BindlessType::STORAGE_BUFFER, slot);
+    return slot;
+}
+
+void NanoBindlessHeap::writeSlot(BindlessType type, uint32_t slot) {
+    const uint32_t typeIndex = static_cast<uint32_t>(type);
+
+    if (m_updateAfterBind) {
+        // update-after-bind: the slot is not referenced by any pending command buffer, write it right away
+        Descriptor& descriptor = m_descriptors[typeIndex][slot];
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = m_sets[0];
+        write.dstBinding = typeIndex;
+        write.dstArrayElement = slot;
+        write.descriptorCount = 1;
+        write.descriptorType = toDescriptorType(type);
+        if (type == BindlessType::STORAGE_BUFFER) {
+            write.pBufferInfo = &descriptor.bufferInfo;
+        } else {
+            write.pImageInfo = &descriptor.imageInfo;
+        }
+        vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+        return;
+    }
+
+    if (m_backfill[typeIndex] == BINDLESS_INVALID_SLOT) {
+        // first live descriptor of this type, every unused slot can now point at something valid
+        m_backfill[typeIndex] = slot;
+        for (uint32_t i = 0; i < m_capacity[typeIndex]; i++) {
+            markDirty(type, i);
+        }
+        return;
+    }
+    markDirty(type, slot);
+}
+
+void NanoBindlessHeap::markDirty(BindlessType type, uint32_t slot) {
+    for (uint32_t frame = 0; frame < Config::MAX_FRAMES_IN_FLIGHT; frame++) {
+        m_dirty[frame].emplace_back(type, slot);
+    }
+}
+
+void NanoBindlessHeap::refreshBackfill(BindlessType type) {
+    const uint32_t typeIndex = static_cast<uint32_t>(type);
+    if (m_backfill[typeIndex] != BINDLESS_INVALID_SLOT && m_descriptors[typeIndex][m_backfill[typeIndex]].live) {
+        return;
+    }
+
+    m_backfill[typeIndex] = BINDLESS_INVALID_SLOT;
+    for (uint32_t i = 0; i < m_capacity[typeIndex]; i++) {
+        if (m_descriptors[typeIndex][i].live) {
+            m_backfill[typeIndex] = i;
+            break;
+        }
+    }
+
+    // everything that was aliasing the old backfill has to move to the new one
+    for (uint32_t i = 0; i < m_capacity[typeIndex]; i++) {
+        if (!m_descriptors[typeIndex][i].live) {
+            markDirty(type, i);
+        }
+    }
+}
+
+void NanoBindlessHeap::Release(BindlessType type, uint32_t slot, std::function<void()> onRetire) {
+    const uint32_t typeIndex = static_cast<uint32_t>(type);
+    if (slot == BINDLESS_INVALID_SLOT || slot >= m_capacity[typeIndex]) {
+        LOG_MSG(ERRLevel::WARNING, "Releasing an invalid bindless slot");
+        return;
+    }
+    if (!m_allocated[typeIndex][slot]) {
+        LOG_MSG(ERRLevel::WARNING, "Bindless slot %d of type %d released twice, or never added", slot, typeIndex);
+        return;
+    }
+    m_allocated[typeIndex][slot] = false;
+
+    RetiredSlot retired{};
+    retired.type = type;
+    retired.slot = slot;
+    retired.releaseFrame = m_frameCounter;
+    retired.onRetire = std::move(onRetire);
+    m_retired.push_back(std::move(retired));
+}
+
+void NanoBindlessHeap::BeginFrame(uint32_t frameIndex) {
+    if (!m_isInit) {
+        return;
+    }
+
+    m_currentFrame = frameIndex;
+    m_frameCounter++;
+
+    // Once MAX_FRAMES_IN_FLIGHT frames have been waited on, nothing submitted before the release can still be running.
+    // In fallback mode the slot is first re-pointed to the backfill descriptor in every copy of the set,
+    // and the resource is only handed back once all of those copies have been flushed and retired too.
+    auto it = m_retired.begin();
+    while (it != m_retired.end()) {
+        const uint32_t typeIndex = static_cast<uint32_t>(it->type);
+        const uint64_t age = m_frameCounter - it->releaseFrame;
+
+        if (!m_updateAfterBind && !it->backfilled) {
+            if (age < Config::MAX_FRAMES_IN_FLIGHT) {
+                ++it;
+                continue;
+            }
+            m_descriptors[typeIndex][it->slot].live = false;
+            refreshBackfill(it->type);
+            markDirty(it->type, it->slot);
+            it->backfilled = true;
+            it->releaseFrame = m_frameCounter;
+            ++it;
+            continue;
+        }
+
+        if (age < Config::MAX_FRAMES_IN_FLIGHT) {
+            ++it;
+            continue;
+        }
+
+        if (it->onRetire) {
+            it->onRetire();
+        }
+        m_descriptors[typeIndex][it->slot].live = false;
+        m_freeSlots[typeIndex].push_back(it->slot);
+        m_used[typeIndex]--;
+        it = m_retired.erase(it);
+    }
+
+    if (!m_updateAfterBind) {
+        flushFrame(frameIndex);
+    }
+}
+
+void NanoBindlessHeap::flushFrame(uint32_t frameIndex) {
+    std::vector<std::pair<BindlessType, uint32_t>>& dirty = m_dirty[frameIndex];
+    if (dirty.empty()) {
+        return;
+    }
+
+    std::vector<VkWriteDescriptorSet> writes{};
+    writes.reserve(dirty.size());
+
+    for (const auto& [type, slot] : dirty) {
+        const uint32_t typeIndex = static_cast<uint32_t>(type);
+        uint32_t source = m_descriptors[typeIndex][slot].live ? slot : m_backfill[typeIndex];
+        if (source == BINDLESS_INVALID_SLOT) {
+            continue; // nothing valid to point at yet, the shader must not read this type
+        }
+
+        Descriptor& descriptor = m_descriptors[typeIndex][source];
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = m_sets[frameIndex];
+        write.dstBinding = typeIndex;
+        write.dstArrayElement = slot;
+        write.descriptorCount = 1;
+        write.descriptorType = toDescriptorType(type);
+        if (type == BindlessType::STORAGE_BUFFER) {
+            write.pBufferInfo = &descriptor.bufferInfo;
+        } else {
+            write.pImageInfo = &descriptor.imageInfo;
+        }
+        writes.push_back(write);
+    }
+
+    if (!writes.empty()) {
+        vkUpdateDescriptorSets(_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+    dirty.clear();
+}
+
+void NanoBindlessHeap::Bind(VkCommandBuffer& commandBuffer, const VkPipelineLayout& pipelineLayout, VkPipelineBindPoint bindPoint) {
+    if (!m_isInit) {
+        return;
+    }
+
+    VkDescriptorSet& set = m_updateAfterBind ? m_sets[0] : m_sets[m_currentFrame];
+    vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, Config::BINDLESS_SET_INDEX, 1, &set, 0, nullptr);
+}
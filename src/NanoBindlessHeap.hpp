@@ -0,0 +1,109 @@
+#ifndef NANOBINDLESSHEAP_H_
+#define NANOBINDLESSHEAP_H_
+
+#include "NanoConfig.hpp"
+#include "NanoError.hpp"
+
+#include "vulkan/vulkan_core.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+constexpr uint32_t BINDLESS_INVALID_SLOT = UINT32_MAX;
+
+// binding index inside the global bindless set. Shaders declare the arrays with the same bindings
+enum class BindlessType : uint32_t { SAMPLED_IMAGE = 0, SAMPLER = 1, STORAGE_BUFFER = 2, COUNT = 3 };
+
+// what the selected physical device can do. Filled by NanoGraphics once the device is picked
+struct BindlessCapabilities {
+    bool descriptorIndexing = false; // true when update-after-bind + partially bound + runtime arrays are all supported
+    uint32_t maxSampledImages = 0;
+    uint32_t maxSamplers = 0;
+    uint32_t maxStorageBuffers = 0;
+};
+
+// Per draw data pushed with vkCmdPushConstants. Materials only reference resources through their slot in the global set.
+struct NanoMaterialIndices {
+    uint32_t sampledImage = BINDLESS_INVALID_SLOT;
+    uint32_t sampler = BINDLESS_INVALID_SLOT;
+    uint32_t storageBuffer = BINDLESS_INVALID_SLOT;
+    uint32_t instance = 0;
+};
+
+// One big descriptor set holding every sampled image, sampler and storage buffer the engine knows about.
+// With descriptor indexing the set is update-after-bind and bound once per command buffer.
+// Without it we fall back to one (smaller) copy of the set per frame in flight, updated when that frame is idle.
+class NanoBindlessHeap {
+  public:
+    ERR Init(VkDevice& device, const BindlessCapabilities& capabilities);
+    void CleanUp();
+
+    uint32_t AddSampledImage(VkImageView imageView, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    uint32_t AddSampler(VkSampler sampler);
+    uint32_t AddStorageBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+    // the slot is only handed out again once every frame that could still reference it has retired.
+    // onRetire is called at that point, so the underlying resource can be destroyed safely.
+    void Release(BindlessType type, uint32_t slot, std::function<void()> onRetire = nullptr);
+
+    // must be called right after the frame's inFlightFence has been waited on and before recording
+    void BeginFrame(uint32_t frameIndex);
+    void Bind(VkCommandBuffer& commandBuffer, const VkPipelineLayout& pipelineLayout,
+              VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+    bool IsInit() { return m_isInit; }
+    bool IsUpdateAfterBind() { return m_updateAfterBind; }
+    uint32_t GetCapacity(BindlessType type) { return m_capacity[static_cast<uint32_t>(type)]; }
+    uint32_t GetUsedSlots(BindlessType type) { return m_used[static_cast<uint32_t>(type)]; }
+    VkDescriptorSetLayout& GetDescriptorSetLayout() { return m_setLayout; }
+    static VkPushConstantRange GetPushConstantRange();
+
+  private:
+    struct Descriptor {
+        VkDescriptorImageInfo imageInfo{};
+        VkDescriptorBufferInfo bufferInfo{};
+        bool live = false;
+    };
+
+    struct RetiredSlot {
+        BindlessType type;
+        uint32_t slot;
+        uint64_t releaseFrame;
+        std::function<void()> onRetire;
+        bool backfilled = false; // fallback mode only
+    };
+
+    uint32_t allocateSlot(BindlessType type);
+    void writeSlot(BindlessType type, uint32_t slot);
+    void markDirty(BindlessType type, uint32_t slot);
+    void refreshBackfill(BindlessType type);
+    void flushFrame(uint32_t frameIndex);
+
+    VkDevice _device{};
+    bool m_isInit = false;
+    bool m_updateAfterBind = false;
+
+    VkDescriptorSetLayout m_setLayout{};
+    VkDescriptorPool m_pool{};
+    // only [0] is used in update-after-bind mode
+    VkDescriptorSet m_sets[Config::MAX_FRAMES_IN_FLIGHT]{};
+    uint32_t m_currentFrame = 0;
+    uint64_t m_frameCounter = 0;
+
+    uint32_t m_capacity[static_cast<uint32_t>(BindlessType::COUNT)]{};
+    uint32_t m_used[static_cast<uint32_t>(BindlessType::COUNT)]{};
+    std::vector<Descriptor> m_descriptors[static_cast<uint32_t>(BindlessType::COUNT)]{};
+    std::vector<uint32_t> m_freeSlots[static_cast<uint32_t>(BindlessType::COUNT)]{};
+    // handed out by Add* and not released yet, so a second Release of a slot can't put it on the free list twice
+    std::vector<bool> m_allocated[static_cast<uint32_t>(BindlessType::COUNT)]{};
+    uint32_t m_nextSlot[static_cast<uint32_t>(BindlessType::COUNT)]{};
+
+    // a slot released during frame N comes back once every frame that could reference it has been waited on
+    std::vector<RetiredSlot> m_retired{};
+    // fallback mode only: slots written since the frame's copy of the set was last updated
+    std::vector<std::pair<BindlessType, uint32_t>> m_dirty[Config::MAX_FRAMES_IN_FLIGHT]{};
+    // fallback mode only: live slot copied into every unused slot, since the arrays cannot be partially bound
+    uint32_t m_backfill[static_cast<uint32_t>(BindlessType::COUNT)]{BINDLESS_INVALID_SLOT, BINDLESS_INVALID_SLOT, BINDLESS_INVALID_SLOT};
+};
+
+#endif // NANOBINDLESSHEAP_H_
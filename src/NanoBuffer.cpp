@@ -0,0 +1,78 @@
+#include "NanoBuffer.hpp"
+#include "NanoLogger.hpp"
+
+#include <stdexcept>
+
+uint32_t FindMemoryType(const VkPhysicalDevice& physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("failed to find suitable memory type!");
+}
+
+ERR NanoBuffer::Init(VkDevice& device, const VkPhysicalDevice& physicalDevice, VkDeviceSize size, VkBufferUsageFlags usage,
+                     VkMemoryPropertyFlags properties) {
+    ERR err = ERR::OK;
+    _device = device;
+    m_size = size;
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(_device, &bufferInfo, nullptr, &m_buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create buffer!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(_device, m_buffer, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = FindMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
+
+    if (vkAllocateMemory(_device, &allocInfo, nullptr, &m_memory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate buffer memory!");
+    }
+
+    vkBindBufferMemory(_device, m_buffer, m_memory, 0);
+
+    if (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        vkMapMemory(_device, m_memory, 0, VK_WHOLE_SIZE, 0, &m_mappedData);
+    }
+
+    return err;
+}
+
+void NanoBuffer::Flush(VkDeviceSize offset, VkDeviceSize size) {
+    VkMappedMemoryRange range{};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = m_memory;
+    range.offset = offset;
+    range.size = size;
+    vkFlushMappedMemoryRanges(_device, 1, &range);
+}
+
+void NanoBuffer::CleanUp() {
+    if (!IsInit()) {
+        return;
+    }
+    if (m_mappedData) {
+        vkUnmapMemory(_device, m_memory);
+        m_mappedData = nullptr;
+    }
+    vkDestroyBuffer(_device, m_buffer, nullptr);
+    vkFreeMemory(_device, m_memory, nullptr);
+    m_buffer = VK_NULL_HANDLE;
+    m_memory = VK_NULL_HANDLE;
+    m_size = 0;
+}
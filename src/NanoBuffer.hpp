@@ -0,0 +1,34 @@
+#ifndef NANOBUFFER_H_
+#define NANOBUFFER_H_
+
+#include "NanoError.hpp"
+
+#include "vulkan/vulkan_core.h"
+#include <cstdint>
+
+// finds a memory type allowed by typeFilter that has at least the requested properties
+uint32_t FindMemoryType(const VkPhysicalDevice& physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
+
+// VkBuffer with its own dedicated allocation. Host visible buffers stay persistently mapped.
+class NanoBuffer {
+  public:
+    ERR Init(VkDevice& device, const VkPhysicalDevice& physicalDevice, VkDeviceSize size, VkBufferUsageFlags usage,
+             VkMemoryPropertyFlags properties);
+    void CleanUp();
+
+    bool IsInit() { return m_buffer != VK_NULL_HANDLE; }
+    VkBuffer& GetBuffer() { return m_buffer; }
+    VkDeviceSize GetSize() { return m_size; }
+    void* GetMappedData() { return m_mappedData; } // nullptr unless the memory is host visible
+    // only needed when the memory is not HOST_COHERENT
+    void Flush(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+  private:
+    VkDevice _device{};
+    VkBuffer m_buffer{};
+    VkDeviceMemory m_memory{};
+    VkDeviceSize m_size = 0;
+    void* m_mappedData = nullptr;
+};
+
+#endif // NANOBUFFER_H_
@@ -0,0 +1,93 @@
+#include "NanoComputePipeline.hpp"
+#include "NanoLogger.hpp"
+#include "vulkan/vulkan_core.h"
+
+#include <stdexcept>
+
+void NanoComputePipeline::Init(VkDevice& device){
+    _device = device;
+}
+
+void NanoComputePipeline::AddComputeShader(const std::string& compFileName){
+    m_compShader = {};
+    m_compShader.Init(_device, compFileName);
+    m_compShader.Compile();
+}
+
+void NanoComputePipeline::AddComputeShader(const NanoShader& compShader){
+    m_compShader = compShader;
+    m_compShader.CreateModule(_device);
+}
+
+void NanoComputePipeline::AddLayoutCache(NanoPipelineLayoutCache& layoutCache){
+    _layoutCache = &layoutCache;
+}
+
+void NanoComputePipeline::AddDescriptorSetLayout(uint32_t set, const VkDescriptorSetLayout& setLayout){
+    if(m_setLayouts.size() <= set){
+        m_setLayouts.resize(set + 1, VK_NULL_HANDLE);
+    }
+    m_setLayouts[set] = setLayout;
+}
+
+void NanoComputePipeline::AddSpecializationConstant(uint32_t constantID, uint32_t value){
+    VkSpecializationMapEntry entry{};
+    entry.constantID = constantID;
+    entry.offset = static_cast<uint32_t>(m_specializationData.size() * sizeof(uint32_t));
+    entry.size = sizeof(uint32_t);
+    m_specializationEntries.push_back(entry);
+    m_specializationData.push_back(value);
+}
+
+ERR NanoComputePipeline::Compile(){
+    ERR err = ERR::OK;
+
+    if(!m_compShader.IsCompiled()){
+        ASSERT(m_compShader.IsCompiled(), "compute pipeline's shader was not compiled\n");
+        return ERR::NOT_INITIALIZED;
+    }
+
+    if(!_layoutCache){
+        ASSERT(_layoutCache, "compute pipeline needs a layout cache to build its pipeline layout\n");
+        return ERR::NOT_INITIALIZED;
+    }
+
+    if(ReflectSpirv(m_compShader.GetByteCode(), m_reflection) != ERR::OK){
+        LOG_MSG(ERRLevel::WARNING, "failed to reflect the compute pipeline shader");
+        return ERR::INVALID;
+    }
+
+    VkSpecializationInfo specializationInfo = {};
+    specializationInfo.mapEntryCount = static_cast<uint32_t>(m_specializationEntries.size());
+    specializationInfo.pMapEntries = m_specializationEntries.data();
+    specializationInfo.dataSize = m_specializationData.size() * sizeof(uint32_t);
+    specializationInfo.pData = m_specializationData.data();
+
+    VkPipelineShaderStageCreateInfo computeShaderStage = {};
+    computeShaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    computeShaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    computeShaderStage.module = m_compShader.GetShaderModule();
+    computeShaderStage.pName = "main";
+    computeShaderStage.pSpecializationInfo = m_specializationEntries.empty() ? nullptr : &specializationInfo;
+
+    m_pipelineLayout = _layoutCache->GetPipelineLayout(m_reflection, m_setLayouts);
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage = computeShaderStage;
+    pipelineInfo.layout = m_pipelineLayout;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+
+    if (vkCreateComputePipelines(_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline) != VK_SUCCESS) {
+        err = ERR::INVALID;
+        throw std::runtime_error("failed to create compute pipeline!");
+    }
+
+    return err;
+}
+
+void NanoComputePipeline::CleanUp(){
+    vkDestroyPipeline(_device, m_pipeline, nullptr);
+    m_compShader.CleanUp();
+}
@@ -0,0 +1,38 @@
+#ifndef NANOCOMPUTEPIPELINE_H_
+#define NANOCOMPUTEPIPELINE_H_
+
+#include "NanoShader.hpp"
+#include "NanoShaderReflection.hpp"
+#include "NanoPipelineLayoutCache.hpp"
+#include "vulkan/vulkan_core.h"
+
+// same building blocks as NanoGraphicsPipeline: the layout is reflected from the SPIR-V and shared through the layout cache
+class NanoComputePipeline{
+    public:
+        void Init(VkDevice& device);
+        void AddComputeShader(const std::string& compShaderFile);
+        // already compiled to SPIR-V, only the module is created here
+        void AddComputeShader(const NanoShader& compShader);
+        void AddLayoutCache(NanoPipelineLayoutCache& layoutCache);
+        void AddDescriptorSetLayout(uint32_t set, const VkDescriptorSetLayout& setLayout); // replaces the reflected layout for that set
+        void AddSpecializationConstant(uint32_t constantID, uint32_t value);
+        ERR Compile();
+        void CleanUp();
+
+        VkPipeline& GetPipeline(){return m_pipeline;}
+        VkPipelineLayout& GetPipelineLayout(){return m_pipelineLayout;}
+        const ShaderReflection& GetReflection(){return m_reflection;}
+        // stages to pass to vkCmdPushConstants, 0 when the shader has no push constants
+        VkShaderStageFlags GetPushConstantStages(){return m_reflection.pushConstantRanges.empty() ? 0 : m_reflection.pushConstantRanges[0].stageFlags;}
+    private:
+        VkDevice _device = {};
+        NanoShader m_compShader = {};
+        NanoPipelineLayoutCache* _layoutCache = nullptr;
+        ShaderReflection m_reflection = {};
+        std::vector<VkDescriptorSetLayout> m_setLayouts = {};
+        std::vector<VkSpecializationMapEntry> m_specializationEntries = {};
+        std::vector<uint32_t> m_specializationData = {};
+        VkPipelineLayout m_pipelineLayout = {}; // owned by the layout cache
+        VkPipeline m_pipeline = {};
+};
+#endif // NANOCOMPUTEPIPELINE_H_
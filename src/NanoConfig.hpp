@@ -10,6 +10,56 @@ constexpr uint16_t WINDOW_HEIGHT = 600;
 constexpr const char *APP_NAME = "NanoApplication";
 constexpr const char *ENGINE_NAME = "NanoEngine";
 constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+constexpr uint32_t HEADLESS_IMAGE_COUNT = 3; // offscreen images headless frames render to in turn, >= MAX_FRAMES_IN_FLIGHT
+constexpr VkFormat HEADLESS_FORMAT = VK_FORMAT_R8G8B8A8_SRGB; // sRGB like the swapchain, so captures look the same
+constexpr uint32_t CAPTURE_SLOT_COUNT = 6; // readback buffers, MAX_FRAMES_IN_FLIGHT can wait on the GPU while the rest encode
+constexpr uint64_t STAGING_RING_SIZE = 64ull * 1024 * 1024; // every CPU -> GPU copy goes through this ring
+constexpr uint32_t VULKAN_API_VERSION = VK_API_VERSION_1_2; // descriptor indexing and vkGetPhysicalDeviceFeatures2 are core from 1.2
+constexpr uint32_t JOB_WORKER_COUNT = UINT32_MAX; // UINT32_MAX: one worker per hardware thread besides the main thread
+constexpr bool JOB_PIN_THREADS = false;            // worker i on core i, helps with benchmarks, hurts when other processes compete
+constexpr float LOD_PIXEL_ERROR_THRESHOLD = 1.0f; // coarsest mesh LOD whose projected error stays below this many pixels is drawn
+constexpr uint32_t OCCLUSION_BUFFER_WIDTH = 320;  // software occlusion depth buffer, independent of the window size
+constexpr uint32_t OCCLUSION_BUFFER_HEIGHT = 192;
+constexpr uint32_t CPU_CULLING_CHUNK = 4096;      // instances per job of NanoEngine's culling stage
+constexpr uint32_t OCCLUSION_QUERIES_PER_FRAME = 4096; // hardware queries, only big objects are worth one
+constexpr float OCCLUSION_QUERY_MIN_RADIUS = 8.0f;     // world space bounding sphere, smaller instances are never queried
+constexpr bool enableConditionalRendering = true;      // used when the device has VK_EXT_conditional_rendering
+constexpr bool enableSynchronization2 = true;          // render graph barriers through vkCmdPipelineBarrier2 when the device has it
+constexpr bool enableTimelineSemaphores = true;        // frame completion through one timeline semaphore, the fences otherwise
+constexpr bool enableIndirectRendering = true;         // GPU culled instances, needs multi draw indirect and descriptor indexing
+constexpr bool enableDepthPrepass = true;              // depth only pass of the GPU driven path first, the main pass tests EQUAL
+constexpr bool enableCpuCulling = true;                // occlusion culling of the instances on the CPU while NanoEngine has occluders
+constexpr bool enableGpuProfiler = true;               // timestamps around every render graph pass, when the engine has a profiler
+constexpr bool enablePipelineStatistics = true;        // vertex and fragment invocations per pass, when the device supports them
+constexpr uint32_t PROFILER_MAX_GPU_ZONES = 64;   // per frame
+constexpr uint32_t PROFILER_HISTORY_FRAMES = 300; // frames the profiler keeps for GetFrame and the dumps
+constexpr uint32_t FRAME_STATS_WINDOW = 1024;      // frames the rolling frame time percentiles cover
+constexpr float STUTTER_MEDIAN_MULTIPLIER = 2.0f;  // a frame this many times the median is a stutter
+constexpr uint32_t STUTTER_WARMUP_FRAMES = 60;     // frames in the window before stutters are flagged
+constexpr uint32_t STUTTER_EVENT_HISTORY = 32;     // latest stutters kept for the summary
+constexpr uint32_t INDIRECT_INSTANCE_CAPACITY = 65535;
+constexpr uint32_t SCENE_UPLOAD_MERGE_GAP = 4;  // clean instances worth re-sending to save a copy region
+constexpr uint32_t SCENE_MAX_COPY_REGIONS = 64; // per frame, the merge gap grows until the dirty runs fit
+constexpr uint32_t INSTANCE_VERTEX_BINDING = 1;  // per instance vertex inputs, fed by the render queue's instance buffer
+constexpr uint32_t RENDER_QUEUE_INSTANCE_CAPACITY = 65536; // per frame in flight, grows when a frame submits more draws
+constexpr uint32_t MESH_ARENA_VERTEX_CAPACITY = 1u << 21; // NanoVertex, 64 MiB
+constexpr uint32_t MESH_ARENA_INDEX_CAPACITY = 1u << 23;  // 32 bit, 32 MiB
+constexpr uint32_t MESH_ARENA_MESH_CAPACITY = 4096; // mesh ids are not reused, removed meshes still count
+constexpr float MESH_ARENA_COMPACT_RATIO = 0.25f;   // unloading compacts once holes are this much of the used arena
+constexpr uint32_t MESH_ARENA_MAX_LODS = 8;         // per mesh in the mesh table, coarser levels of a file are dropped
+constexpr float STATIC_MERGE_CELL_SIZE = 32.0f;     // static objects with the same material in one cell become one mesh
+constexpr uint32_t STATIC_MERGE_MAX_OBJECTS = 64;   // per merged mesh, so culling still has something to cull
+
+// Bindless resources. One global descriptor set indexed from push constants.
+// The heap is clamped to the device limits, and is much smaller when descriptor indexing is not supported
+constexpr bool enableBindless = true;
+constexpr uint32_t BINDLESS_SET_INDEX = 0;
+constexpr uint32_t BINDLESS_MAX_SAMPLED_IMAGES = 16384;
+constexpr uint32_t BINDLESS_MAX_SAMPLERS = 256;
+constexpr uint32_t BINDLESS_MAX_STORAGE_BUFFERS = 4096;
+constexpr uint32_t BINDLESS_FALLBACK_MAX_SAMPLED_IMAGES = 64;
+constexpr uint32_t BINDLESS_FALLBACK_MAX_SAMPLERS = 16;
+constexpr uint32_t BINDLESS_FALLBACK_MAX_STORAGE_BUFFERS = 16;
 
 
 #ifdef NDEBUG
@@ -31,6 +81,15 @@ constexpr const char *desiredDeviceExtensions[] = {
     NULL // to allow for while loops without crash
 };
 
+// enabled only when the device exposes them. Missing ones turn the matching feature off instead of rejecting the device
+constexpr const char *optionalDeviceExtensions[] = {
+    VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
+    VK_EXT_CONDITIONAL_RENDERING_EXTENSION_NAME,
+    VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME,
+    VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME,
+    NULL // to allow for while loops without crash
+};
+
 constexpr const char *desiredInstanceExtensions[] = {
 #ifdef __APPLE__
     VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME,
@@ -0,0 +1,341 @@
+#include "NanoECS.hpp"
+#include "NanoLogger.hpp"
+
+#include <algorithm>
+
+NanoComponentID NanoComponentRegistry::Register(uint32_t size, uint32_t alignment, const char* name) {
+    NanoComponentID id = s_count.fetch_add(1);
+    if (id >= MAX_COMPONENTS) {
+        throw std::runtime_error("too many component types, NanoComponentMask only has 64 bits!");
+    }
+    s_infos[id] = {size, alignment, name};
+    return id;
+}
+
+void* NanoChunkView::GetColumn(NanoComponentID id) const {
+    uint32_t offset = _archetype->m_columnOffsets[id];
+    return offset == NanoArchetype::NO_COLUMN ? nullptr : m_data + offset;
+}
+
+static uint32_t alignUp(uint32_t value, uint32_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+void NanoArchetype::Init(NanoComponentMask mask) {
+    m_mask = mask;
+    std::fill(std::begin(m_columnOffsets), std::end(m_columnOffsets), NO_COLUMN);
+
+    uint32_t rowSize = sizeof(NanoEntity);
+    for (NanoComponentID id = 0; id < NanoComponentRegistry::MAX_COMPONENTS; id++) {
+        if (mask & (NanoComponentMask{1} << id)) {
+            m_components.push_back(id);
+            rowSize += NanoComponentRegistry::GetInfo(id).size;
+        }
+    }
+
+    // the entity column comes first, then one column per component. Start from the unpadded estimate and shrink
+    // until the padding between the columns fits too
+    auto layoutSize = [this](uint32_t capacity) {
+        uint32_t offset = alignUp(capacity * sizeof(NanoEntity), COLUMN_ALIGNMENT);
+        for (NanoComponentID id : m_components) {
+            offset = alignUp(offset + capacity * NanoComponentRegistry::GetInfo(id).size, COLUMN_ALIGNMENT);
+        }
+        return offset;
+    };
+    m_capacity = CHUNK_SIZE / rowSize;
+    while (m_capacity > 1 && layoutSize(m_capacity) > CHUNK_SIZE) {
+        m_capacity--;
+    }
+    if (layoutSize(m_capacity) > CHUNK_SIZE) {
+        throw std::runtime_error("archetype doesn't fit a single entity in one chunk!");
+    }
+
+    uint32_t offset = alignUp(m_capacity * sizeof(NanoEntity), COLUMN_ALIGNMENT);
+    for (NanoComponentID id : m_components) {
+        m_columnOffsets[id] = offset;
+        offset = alignUp(offset + m_capacity * NanoComponentRegistry::GetInfo(id).size, COLUMN_ALIGNMENT);
+    }
+}
+
+NanoWorld::NanoWorld() {
+    GetOrCreateArchetype(0); // entities without any component
+}
+
+uint32_t NanoWorld::GetOrCreateArchetype(NanoComponentMask mask) {
+    auto it = m_archetypeLookup.find(mask);
+    if (it != m_archetypeLookup.end()) {
+        return it->second;
+    }
+    auto archetype = std::make_unique<NanoArchetype>();
+    archetype->Init(mask);
+    m_archetypes.push_back(std::move(archetype));
+
+    uint32_t index = static_cast<uint32_t>(m_archetypes.size() - 1);
+    m_archetypeLookup[mask] = index;
+    return index;
+}
+
+NanoChunkView NanoWorld::MakeView(const NanoArchetype& archetype, const NanoArchetype::Chunk& chunk) const {
+    NanoChunkView view{};
+    view._archetype = &archetype;
+    view.m_data = chunk.storage->bytes;
+    view.m_count = chunk.count;
+    return view;
+}
+
+void NanoWorld::AllocateRow(uint32_t archetypeIndex, uint32_t entityIndex) {
+    NanoArchetype& archetype = *m_archetypes[archetypeIndex];
+    if (archetype.m_chunks.empty() || archetype.m_chunks.back().count == archetype.m_capacity) {
+        NanoArchetype::Chunk chunk{};
+        chunk.storage = std::make_unique<NanoArchetype::ChunkStorage>();
+        archetype.m_chunks.push_back(std::move(chunk));
+    }
+
+    NanoArchetype::Chunk& chunk = archetype.m_chunks.back();
+    EntityRecord& record = m_entities[entityIndex];
+    record.archetype = archetypeIndex;
+    record.chunk = static_cast<uint32_t>(archetype.m_chunks.size() - 1);
+    record.row = chunk.count++;
+    archetype.GetEntity(chunk, record.row) = {entityIndex, record.generation};
+    archetype.m_entityCount++;
+}
+
+// the archetype's very last entity fills the hole, so only the last chunk is ever partially filled
+void NanoWorld::FreeRow(uint32_t archetypeIndex, uint32_t chunkIndex, uint32_t row) {
+    NanoArchetype& archetype = *m_archetypes[archetypeIndex];
+    NanoArchetype::Chunk& chunk = archetype.m_chunks[chunkIndex];
+    NanoArchetype::Chunk& lastChunk = archetype.m_chunks.back();
+    uint32_t lastRow = lastChunk.count - 1;
+
+    if (&chunk != &lastChunk || row != lastRow) {
+        NanoEntity moved = archetype.GetEntity(lastChunk, lastRow);
+        archetype.GetEntity(chunk, row) = moved;
+        for (NanoComponentID id : archetype.m_components) {
+            memcpy(archetype.GetComponent(chunk, id, row), archetype.GetComponent(lastChunk, id, lastRow), NanoComponentRegistry::GetInfo(id).size);
+        }
+        m_entities[moved.index].chunk = chunkIndex;
+        m_entities[moved.index].row = row;
+    }
+
+    archetype.m_entityCount--;
+    if (--lastChunk.count == 0) {
+        archetype.m_chunks.pop_back();
+    }
+}
+
+void NanoWorld::MoveEntity(uint32_t entityIndex, uint32_t dstArchetype) {
+    EntityRecord src = m_entities[entityIndex];
+    AllocateRow(dstArchetype, entityIndex);
+
+    NanoArchetype& from = *m_archetypes[src.archetype];
+    NanoArchetype& to = *m_archetypes[dstArchetype];
+    const EntityRecord& dst = m_entities[entityIndex];
+    for (NanoComponentID id : to.m_components) {
+        if (from.HasComponent(id)) {
+            memcpy(to.GetComponent(to.m_chunks[dst.chunk], id, dst.row), from.GetComponent(from.m_chunks[src.chunk], id, src.row),
+                   NanoComponentRegistry::GetInfo(id).size);
+        }
+    }
+    FreeRow(src.archetype, src.chunk, src.row);
+}
+
+NanoEntity NanoWorld::CreateEntityRaw(uint32_t componentCount, const NanoComponentID* ids, const void* const* data) {
+    ASSERT(!m_structureLocked, "entities can't be created while systems run, use the system's command buffer");
+
+    uint32_t index{};
+    if (!m_freeEntities.empty()) {
+        index = m_freeEntities.back();
+        m_freeEntities.pop_back();
+    } else {
+        index = static_cast<uint32_t>(m_entities.size());
+        m_entities.emplace_back();
+    }
+
+    NanoComponentMask mask = 0;
+    for (uint32_t i = 0; i < componentCount; i++) {
+        mask |= NanoComponentMask{1} << ids[i];
+    }
+    uint32_t archetypeIndex = GetOrCreateArchetype(mask);
+    AllocateRow(archetypeIndex, index);
+
+    NanoArchetype& archetype = *m_archetypes[archetypeIndex];
+    const EntityRecord& record = m_entities[index];
+    for (uint32_t i = 0; i < componentCount; i++) {
+        memcpy(archetype.GetComponent(archetype.m_chunks[record.chunk], ids[i], record.row), data[i], NanoComponentRegistry::GetInfo(ids[i]).size);
+    }
+
+    m_entityCount++;
+    return {index, record.generation};
+}
+
+bool NanoWorld::IsAlive(NanoEntity entity) const {
+    return entity.index < m_entities.size() && m_entities[entity.index].archetype != UINT32_MAX &&
+           m_entities[entity.index].generation == entity.generation;
+}
+
+void NanoWorld::DestroyEntity(NanoEntity entity) {
+    ASSERT(!m_structureLocked, "entities can't be destroyed while systems run, use the system's command buffer");
+    if (!IsAlive(entity)) {
+        return;
+    }
+
+    EntityRecord& record = m_entities[entity.index];
+    FreeRow(record.archetype, record.chunk, record.row);
+    record.archetype = UINT32_MAX;
+    record.generation++;
+    m_freeEntities.push_back(entity.index);
+    m_entityCount--;
+}
+
+void NanoWorld::AddComponentRaw(NanoEntity entity, NanoComponentID id, const void* data) {
+    ASSERT(!m_structureLocked, "components can't be added while systems run, use the system's command buffer");
+    if (!IsAlive(entity)) {
+        return;
+    }
+
+    EntityRecord& record = m_entities[entity.index];
+    NanoComponentMask mask = m_archetypes[record.archetype]->m_mask;
+    if (!(mask & (NanoComponentMask{1} << id))) {
+        MoveEntity(entity.index, GetOrCreateArchetype(mask | (NanoComponentMask{1} << id)));
+    }
+    // already there, only overwritten
+    memcpy(GetComponentRaw(entity, id), data, NanoComponentRegistry::GetInfo(id).size);
+}
+
+void NanoWorld::RemoveComponentRaw(NanoEntity entity, NanoComponentID id) {
+    ASSERT(!m_structureLocked, "components can't be removed while systems run, use the system's command buffer");
+    if (!IsAlive(entity)) {
+        return;
+    }
+
+    NanoComponentMask mask = m_archetypes[m_entities[entity.index].archetype]->m_mask;
+    if (mask & (NanoComponentMask{1} << id)) {
+        MoveEntity(entity.index, GetOrCreateArchetype(mask & ~(NanoComponentMask{1} << id)));
+    }
+}
+
+void* NanoWorld::GetComponentRaw(NanoEntity entity, NanoComponentID id) {
+    if (!IsAlive(entity)) {
+        return nullptr;
+    }
+    const EntityRecord& record = m_entities[entity.index];
+    NanoArchetype& archetype = *m_archetypes[record.archetype];
+    if (!archetype.HasComponent(id)) {
+        return nullptr;
+    }
+    return archetype.GetComponent(archetype.m_chunks[record.chunk], id, record.row);
+}
+
+void NanoEntityCommandBuffer::WriteCommand(Command command, NanoEntity entity, uint32_t value) {
+    Header header{command, entity, value};
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&header);
+    m_data.insert(m_data.end(), bytes, bytes + sizeof(Header));
+}
+
+void NanoEntityCommandBuffer::WriteComponent(NanoComponentID id, const void* data) {
+    const uint8_t* idBytes = reinterpret_cast<const uint8_t*>(&id);
+    const uint8_t* dataBytes = static_cast<const uint8_t*>(data);
+    m_data.insert(m_data.end(), idBytes, idBytes + sizeof(NanoComponentID));
+    m_data.insert(m_data.end(), dataBytes, dataBytes + NanoComponentRegistry::GetInfo(id).size);
+}
+
+void NanoEntityCommandBuffer::DestroyEntity(NanoEntity entity) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    WriteCommand(Command::DESTROY, entity, 0);
+}
+
+void NanoEntityCommandBuffer::Playback(NanoWorld& world) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // the payloads aren't aligned in the buffer, everything is copied out with memcpy
+    std::vector<NanoComponentID> ids{};
+    std::vector<const void*> data{};
+    size_t cursor = 0;
+    auto readComponents = [&](uint32_t count) {
+        ids.clear();
+        data.clear();
+        for (uint32_t i = 0; i < count; i++) {
+            NanoComponentID id{};
+            memcpy(&id, m_data.data() + cursor, sizeof(NanoComponentID));
+            cursor += sizeof(NanoComponentID);
+            ids.push_back(id);
+            data.push_back(m_data.data() + cursor);
+            cursor += NanoComponentRegistry::GetInfo(id).size;
+        }
+    };
+
+    while (cursor < m_data.size()) {
+        Header header{};
+        memcpy(&header, m_data.data() + cursor, sizeof(Header));
+        cursor += sizeof(Header);
+
+        switch (header.command) {
+        case Command::CREATE:
+            readComponents(header.value);
+            world.CreateEntityRaw(header.value, ids.data(), data.data());
+            break;
+        case Command::DESTROY:
+            world.DestroyEntity(header.entity);
+            break;
+        case Command::ADD:
+            readComponents(header.value);
+            world.AddComponentRaw(header.entity, ids[0], data[0]);
+            break;
+        case Command::REMOVE:
+            world.RemoveComponentRaw(header.entity, header.value);
+            break;
+        }
+    }
+    m_data.clear();
+}
+
+void NanoSystemScheduler::AddSystem(const std::string& name, NanoComponentMask reads, NanoComponentMask writes, NanoSystemFunction function) {
+    System system{};
+    system.name = name;
+    system.reads = reads;
+    system.writes = writes;
+    system.function = std::move(function);
+    system.commands = std::make_unique<NanoEntityCommandBuffer>();
+    m_systems.push_back(std::move(system));
+    m_graph.reset();
+}
+
+void NanoSystemScheduler::BuildGraph(NanoWorld& world) {
+    m_graph = std::make_unique<NanoTaskGraph>();
+    _graphWorld = &world;
+
+    for (uint32_t i = 0; i < m_systems.size(); i++) {
+        System* system = &m_systems[i];
+        m_graph->AddTask(system->name, [system, &world]() { system->function(world, *system->commands); });
+
+        // only the closest conflicting systems would be needed, but the graph is tiny and built once
+        for (uint32_t j = 0; j < i; j++) {
+            const System& earlier = m_systems[j];
+            bool conflict = (earlier.writes & (system->reads | system->writes)) || (system->writes & earlier.reads);
+            if (conflict) {
+                m_graph->AddDependency(i, j);
+            }
+        }
+    }
+}
+
+ERR NanoSystemScheduler::Run(NanoWorld& world, NanoJobSystem& jobSystem) {
+    if (!m_graph || _graphWorld != &world) {
+        BuildGraph(world);
+    }
+
+    world.SetStructureLocked(true);
+    ERR err = ERR::OK;
+    try {
+        err = m_graph->Run(jobSystem);
+    } catch (...) {
+        world.SetStructureLocked(false);
+        throw;
+    }
+    world.SetStructureLocked(false);
+
+    for (auto& system : m_systems) {
+        system.commands->Playback(world);
+    }
+    return err;
+}
@@ -0,0 +1,281 @@
+#ifndef NANOECS_H_
+#define NANOECS_H_
+
+#include "NanoError.hpp"
+#include "NanoJobSystem.hpp"
+#include "NanoTaskGraph.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+// Archetype ECS. Every distinct set of components is an archetype, and an archetype stores its entities in fixed size
+// chunks with one tightly packed column per component, so a query walks plain arrays chunk by chunk.
+// Components have to be trivially copyable, entities are moved between archetypes with memcpy
+
+using NanoComponentID = uint32_t;
+using NanoComponentMask = uint64_t;
+
+struct NanoEntity {
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0; // bumped every time the index is recycled, so stale handles can be told apart
+
+    bool operator==(const NanoEntity& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const NanoEntity& other) const { return !(*this == other); }
+};
+
+static constexpr NanoEntity NANO_INVALID_ENTITY{};
+
+struct NanoComponentInfo {
+    uint32_t size = 0;
+    uint32_t alignment = 0;
+    const char* name = nullptr;
+};
+
+class NanoComponentRegistry {
+  public:
+    static constexpr uint32_t MAX_COMPONENTS = 64; // one bit each in NanoComponentMask
+
+    template <typename T> static NanoComponentID GetID() {
+        static_assert(std::is_trivially_copyable_v<T>, "components are moved around with memcpy");
+        static const NanoComponentID id = Register(sizeof(T), alignof(T), typeid(T).name());
+        return id;
+    }
+    template <typename... T> static NanoComponentMask GetMask() { return (NanoComponentMask{0} | ... | (NanoComponentMask{1} << GetID<T>())); }
+    static const NanoComponentInfo& GetInfo(NanoComponentID id) { return s_infos[id]; }
+
+  private:
+    static NanoComponentID Register(uint32_t size, uint32_t alignment, const char* name);
+
+    static inline NanoComponentInfo s_infos[MAX_COMPONENTS]{};
+    static inline std::atomic<uint32_t> s_count{0};
+};
+
+class NanoArchetype;
+
+// what a query hands out: count rows, and one array per component
+class NanoChunkView {
+  public:
+    uint32_t GetCount() const { return m_count; }
+    const NanoEntity* GetEntities() const { return reinterpret_cast<const NanoEntity*>(m_data); }
+    template <typename T> T* Get() const { return static_cast<T*>(GetColumn(NanoComponentRegistry::GetID<std::remove_const_t<T>>())); }
+    template <typename T> bool Has() const;
+
+  private:
+    friend class NanoWorld;
+    void* GetColumn(NanoComponentID id) const;
+
+    const NanoArchetype* _archetype = nullptr;
+    uint8_t* m_data = nullptr;
+    uint32_t m_count = 0;
+};
+
+class NanoArchetype {
+  public:
+    static constexpr uint32_t CHUNK_SIZE = 16 * 1024;
+    static constexpr uint32_t COLUMN_ALIGNMENT = 64; // every column starts on its own cache line, fine for any SIMD width
+    static constexpr uint32_t NO_COLUMN = UINT32_MAX;
+
+    NanoComponentMask GetMask() const { return m_mask; }
+    uint32_t GetChunkCapacity() const { return m_capacity; }
+    uint32_t GetChunkCount() const { return static_cast<uint32_t>(m_chunks.size()); }
+    uint32_t GetEntityCount() const { return m_entityCount; }
+    bool HasComponent(NanoComponentID id) const { return m_columnOffsets[id] != NO_COLUMN; }
+
+  private:
+    friend class NanoWorld;
+    friend class NanoChunkView;
+
+    struct alignas(COLUMN_ALIGNMENT) ChunkStorage {
+        uint8_t bytes[CHUNK_SIZE];
+    };
+    struct Chunk {
+        std::unique_ptr<ChunkStorage> storage{};
+        uint32_t count = 0;
+    };
+
+    void Init(NanoComponentMask mask);
+    uint8_t* GetComponent(const Chunk& chunk, NanoComponentID id, uint32_t row) const {
+        return chunk.storage->bytes + m_columnOffsets[id] + row * NanoComponentRegistry::GetInfo(id).size;
+    }
+    NanoEntity& GetEntity(const Chunk& chunk, uint32_t row) const { return reinterpret_cast<NanoEntity*>(chunk.storage->bytes)[row]; }
+
+    NanoComponentMask m_mask = 0;
+    std::vector<NanoComponentID> m_components{};
+    uint32_t m_columnOffsets[NanoComponentRegistry::MAX_COMPONENTS]{}; // byte offset in the chunk, NO_COLUMN when not part of it
+    uint32_t m_capacity = 0;
+    uint32_t m_entityCount = 0;
+    std::vector<Chunk> m_chunks{}; // every chunk but the last one is full
+};
+
+template <typename T> bool NanoChunkView::Has() const { return _archetype->HasComponent(NanoComponentRegistry::GetID<std::remove_const_t<T>>()); }
+
+class NanoEntityCommandBuffer;
+
+class NanoWorld {
+  public:
+    NanoWorld();
+
+    NanoEntity CreateEntity() { return CreateEntityRaw(0, nullptr, nullptr); }
+    template <typename... T> NanoEntity CreateEntity(const T&... components) {
+        NanoComponentID ids[] = {NanoComponentRegistry::GetID<T>()...};
+        const void* data[] = {&components...};
+        return CreateEntityRaw(sizeof...(T), ids, data);
+    }
+    void DestroyEntity(NanoEntity entity);
+    bool IsAlive(NanoEntity entity) const;
+
+    template <typename T> void AddComponent(NanoEntity entity, const T& component) {
+        AddComponentRaw(entity, NanoComponentRegistry::GetID<T>(), &component);
+    }
+    template <typename T> void RemoveComponent(NanoEntity entity) { RemoveComponentRaw(entity, NanoComponentRegistry::GetID<T>()); }
+    template <typename T> T* GetComponent(NanoEntity entity) { return static_cast<T*>(GetComponentRaw(entity, NanoComponentRegistry::GetID<T>())); }
+    template <typename T> bool HasComponent(NanoEntity entity) { return GetComponent<T>(entity) != nullptr; }
+
+    // every chunk of every archetype that has all of T..., and none of the exclude mask
+    template <typename... T, typename Function> void ForEachChunk(Function&& function, NanoComponentMask exclude = 0) {
+        NanoComponentMask include = NanoComponentRegistry::GetMask<std::remove_const_t<T>...>();
+        for (auto& archetype : m_archetypes) {
+            if ((archetype->m_mask & include) != include || (archetype->m_mask & exclude)) {
+                continue;
+            }
+            for (auto& chunk : archetype->m_chunks) {
+                function(MakeView(*archetype, chunk));
+            }
+        }
+    }
+    // same, with the chunks spread over the job system. Returns once every chunk was processed
+    template <typename... T, typename Function>
+    void ParallelForEachChunk(NanoJobSystem& jobSystem, Function&& function, NanoComponentMask exclude = 0) {
+        std::vector<NanoChunkView> views{};
+        ForEachChunk<T...>([&views](const NanoChunkView& view) { views.push_back(view); }, exclude);
+        jobSystem.ParallelFor(static_cast<uint32_t>(views.size()), 1, [&views, &function](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                function(views[i]);
+            }
+        });
+    }
+    // per entity convenience on top of ForEachChunk, function(T&...)
+    template <typename... T, typename Function> void ForEach(Function&& function, NanoComponentMask exclude = 0) {
+        ForEachChunk<T...>(
+            [&function](const NanoChunkView& view) {
+                auto columns = std::make_tuple(view.Get<T>()...);
+                for (uint32_t i = 0; i < view.GetCount(); i++) {
+                    function(std::get<T*>(columns)[i]...);
+                }
+            },
+            exclude);
+    }
+
+    uint32_t GetEntityCount() const { return m_entityCount; }
+    uint32_t GetArchetypeCount() const { return static_cast<uint32_t>(m_archetypes.size()); }
+
+    // set by the scheduler while systems run, any structural change then has to go through a command buffer
+    void SetStructureLocked(bool locked) { m_structureLocked = locked; }
+
+  private:
+    friend class NanoEntityCommandBuffer;
+
+    struct EntityRecord {
+        uint32_t archetype = UINT32_MAX; // UINT32_MAX while the index is free
+        uint32_t chunk = 0;
+        uint32_t row = 0;
+        uint32_t generation = 0;
+    };
+
+    NanoEntity CreateEntityRaw(uint32_t componentCount, const NanoComponentID* ids, const void* const* data);
+    void AddComponentRaw(NanoEntity entity, NanoComponentID id, const void* data);
+    void RemoveComponentRaw(NanoEntity entity, NanoComponentID id);
+    void* GetComponentRaw(NanoEntity entity, NanoComponentID id);
+
+    uint32_t GetOrCreateArchetype(NanoComponentMask mask);
+    void AllocateRow(uint32_t archetypeIndex, uint32_t entityIndex);
+    void MoveEntity(uint32_t entityIndex, uint32_t dstArchetype); // keeps every component both archetypes share
+    void FreeRow(uint32_t archetypeIndex, uint32_t chunk, uint32_t row);
+    NanoChunkView MakeView(const NanoArchetype& archetype, const NanoArchetype::Chunk& chunk) const;
+
+    std::vector<std::unique_ptr<NanoArchetype>> m_archetypes{};
+    std::unordered_map<NanoComponentMask, uint32_t> m_archetypeLookup{};
+    std::vector<EntityRecord> m_entities{};
+    std::vector<uint32_t> m_freeEntities{};
+    uint32_t m_entityCount = 0;
+    bool m_structureLocked = false;
+};
+
+// Structural changes recorded from anywhere (systems, jobs inside systems) and applied later on one thread with Playback,
+// in the order they were recorded
+class NanoEntityCommandBuffer {
+  public:
+    template <typename... T> void CreateEntity(const T&... components) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        WriteCommand(Command::CREATE, NANO_INVALID_ENTITY, sizeof...(T));
+        (WriteComponent(NanoComponentRegistry::GetID<T>(), &components), ...);
+    }
+    void DestroyEntity(NanoEntity entity);
+    template <typename T> void AddComponent(NanoEntity entity, const T& component) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        WriteCommand(Command::ADD, entity, 1);
+        WriteComponent(NanoComponentRegistry::GetID<T>(), &component);
+    }
+    template <typename T> void RemoveComponent(NanoEntity entity) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        WriteCommand(Command::REMOVE, entity, NanoComponentRegistry::GetID<T>());
+    }
+
+    void Playback(NanoWorld& world); // also clears the buffer
+    bool IsEmpty() { return m_data.empty(); }
+
+  private:
+    enum class Command : uint32_t { CREATE, DESTROY, ADD, REMOVE };
+    struct Header {
+        Command command;
+        NanoEntity entity;
+        uint32_t value; // component count for CREATE and ADD, the component for REMOVE
+    };
+
+    void WriteCommand(Command command, NanoEntity entity, uint32_t value);
+    void WriteComponent(NanoComponentID id, const void* data);
+
+    std::mutex m_mutex{};
+    std::vector<uint8_t> m_data{};
+};
+
+using NanoSystemFunction = std::function<void(NanoWorld& world, NanoEntityCommandBuffer& commands)>;
+
+// Systems declare which components they read and write. Two systems run at the same time unless one of them writes something
+// the other one touches, otherwise they keep the order they were added in. Every system records its structural changes
+// into its own command buffer, and they are all played back in system order once every system is done
+class NanoSystemScheduler {
+  public:
+    void AddSystem(const std::string& name, NanoComponentMask reads, NanoComponentMask writes, NanoSystemFunction function);
+    // called on the thread that owns the job system
+    ERR Run(NanoWorld& world, NanoJobSystem& jobSystem);
+    NanoTaskGraph* GetLastGraph() { return m_graph.get(); } // for the timings of the last Run
+
+  private:
+    struct System {
+        std::string name{};
+        NanoComponentMask reads = 0;
+        NanoComponentMask writes = 0;
+        NanoSystemFunction function{};
+        std::unique_ptr<NanoEntityCommandBuffer> commands{};
+    };
+
+    void BuildGraph(NanoWorld& world);
+
+    std::vector<System> m_systems{};
+    std::unique_ptr<NanoTaskGraph> m_graph{};
+    NanoWorld* _graphWorld = nullptr; // the world the graph's tasks were built for
+};
+
+#endif // NANOECS_H_
@@ -1,4 +1,7 @@
 #include "NanoEngine.hpp"
+#include "NanoConfig.hpp"
+
+#include <algorithm>
 
 NanoEngine::~NanoEngine(){
     CleanUp();
@@ -8,24 +11,80 @@ ERR NanoEngine::CleanUp(){
     ERR err = ERR::OK;
     m_NanoWindow.CleanUp();
     m_NanoGraphics.CleanUp();
+    m_NanoProfiler.CleanUp();
+    m_NanoJobSystem.CleanUp();
     return err;
 }
 
-ERR NanoEngine::Init(){
+ERR NanoEngine::Init(const NanoEngineOptions& options){
     ERR err = ERR::OK;
-    err = m_NanoWindow.Init();
-    err = m_NanoGraphics.Init(m_NanoWindow);
+    m_options = options;
+    m_initStart = std::chrono::steady_clock::now();
+    m_timeToFirstFrameMs = 0.0;
+    err = m_NanoJobSystem.Init(Config::JOB_WORKER_COUNT, Config::JOB_PIN_THREADS);
+    m_NanoProfiler.Init(m_options.profileHistoryFrames);
+    m_NanoFrameStats.Init();
+    m_NanoOcclusion.Init(Config::OCCLUSION_BUFFER_WIDTH, Config::OCCLUSION_BUFFER_HEIGHT);
+
+    // GLFW wants the window on the main thread, the rest of the stages go wherever there is a free worker. No window
+    // at all headless
+    NanoTaskGraph initGraph{};
+    NanoTaskGraph::TaskID windowTask = UINT32_MAX;
+    if (!m_options.headless.enabled) {
+        windowTask = initGraph.AddTask("window", [this]() { m_NanoWindow.Init(); }, NanoTaskAffinity::MAIN_THREAD);
+    }
+    err = m_NanoGraphics.Init(m_NanoWindow, initGraph, windowTask, m_options.headless, &m_NanoProfiler);
+    err = initGraph.Run(m_NanoJobSystem);
+    initGraph.LogReport("engine init");
+
+    if (m_options.capture) {
+        m_NanoGraphics.StartCapture(m_NanoJobSystem, m_options.captureOptions);
+    }
     return err;
 }
 
 ERR NanoEngine::Run(){
+    ERR err = RunFrames(m_options.frameCount);
+    // nothing presents headless runs, their frames only count once the GPU is done with them
+    if(m_options.headless.enabled){
+        m_NanoGraphics.WaitForFrame(m_NanoGraphics.GetSubmittedFrameCount());
+        LOG_MSG(ERRLevel::INFO, "headless run done: %d frames", static_cast<int>(m_NanoGraphics.GetCompletedFrameCount()));
+    }
+    m_NanoGraphics.StopCapture();
+    m_NanoFrameStats.LogSummary();
+
+    if (!m_options.profilePath.empty()) {
+        // the frames still in flight have their GPU zones read back too
+        m_NanoGraphics.WaitForFrame(m_NanoGraphics.GetSubmittedFrameCount());
+        m_NanoProfiler.ResolveGpu();
+        m_NanoProfiler.WriteCSV(m_options.profilePath + ".csv");
+        m_NanoProfiler.WriteTrace(m_options.profilePath + ".json");
+        LOG_MSG(ERRLevel::INFO, "profile written to %s.csv and %s.json", m_options.profilePath.c_str(), m_options.profilePath.c_str());
+    }
+    return err;
+}
+
+ERR NanoEngine::RunFrames(uint64_t frameCount){
     ERR err = ERR::OK;
-    while(!m_NanoWindow.ShouldWindowClose()){
+    uint64_t frames = 0;
+    while(m_options.headless.enabled || !m_NanoWindow.ShouldWindowClose()){
+        if(frameCount > 0 && frames == frameCount){
+            break;
+        }
 
-        m_NanoWindow.PollEvents();
+        auto frameStart = std::chrono::steady_clock::now();
+        if(!m_options.headless.enabled){
+            m_NanoWindow.PollEvents();
+        }
 
         MainLoop();
+        frames++;
+        recordFrameStats(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
 
+        if (m_timeToFirstFrameMs == 0.0) {
+            m_timeToFirstFrameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_initStart).count();
+            LOG_MSG(ERRLevel::INFO, "time to first frame: %f ms", m_timeToFirstFrameMs);
+        }
     }
     return err;
 }
@@ -33,7 +92,145 @@ ERR NanoEngine::Run(){
 ERR NanoEngine::MainLoop(){
     ERR err = ERR::OK;
 
-    m_NanoGraphics.DrawFrame();
+    m_NanoProfiler.BeginFrame();
+    {
+        NanoProfileScope zone(&m_NanoProfiler, "systems");
+        m_NanoSystems.Run(m_NanoWorld, m_NanoJobSystem);
+    }
+    {
+        NanoProfileScope zone(&m_NanoProfiler, "transforms");
+        m_NanoTransforms.Update(m_NanoJobSystem);
+    }
+    {
+        NanoProfileScope zone(&m_NanoProfiler, "bvh");
+        m_NanoBVH.Update(m_NanoJobSystem);
+    }
+    if (Config::enableCpuCulling) {
+        NanoProfileScope zone(&m_NanoProfiler, "culling");
+        cullInstances();
+    }
+    {
+        NanoProfileScope zone(&m_NanoProfiler, "draw");
+        m_NanoGraphics.DrawFrame(m_NanoJobSystem);
+    }
 
     return err;
 }
+
+void NanoEngine::cullInstances(){
+    // the GPU frustum culls every instance on its own, the CPU only has something to add when there are occluders
+    if (m_occluders.empty()) {
+        if (m_instancesCulled) {
+            m_instanceVisible.assign(m_NanoGraphics.GetInstanceCount(), 1);
+            applyInstanceVisibility();
+            m_instancesCulled = false;
+        }
+        return;
+    }
+    uint32_t count = m_NanoGraphics.GetInstanceCount();
+    if (count == 0) {
+        return;
+    }
+
+    // the bounds are kept from frame to frame, only the instances that moved (or were added) since the last run are updated
+    if (m_NanoFrustum.GetCount() != count) {
+        m_NanoFrustum.Resize(count);
+    }
+    m_NanoGraphics.TakeMovedInstances(m_movedInstances);
+    m_NanoJobSystem.ParallelFor(static_cast<uint32_t>(m_movedInstances.size()), Config::CPU_CULLING_CHUNK, [this](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            glm::vec3 center(0.0f);
+            float radius = 0.0f;
+            // removed, or the mesh is gone: the GPU skips the instance anyway
+            m_NanoGraphics.GetInstanceSphere(m_movedInstances[i], center, radius);
+            m_NanoFrustum.SetBounds(m_movedInstances[i], center - glm::vec3(radius), center + glm::vec3(radius), radius);
+        }
+    });
+
+    const glm::mat4& viewProjection = m_NanoGraphics.GetViewProjection();
+    uint32_t visibleCount = m_NanoFrustum.Cull(NanoFrustum::FromViewProjection(viewProjection), m_NanoJobSystem);
+    const uint32_t* visible = m_NanoFrustum.GetVisibleIndices();
+    if (visibleCount > 0) {
+        m_NanoOcclusion.BeginFrame(viewProjection);
+        for (const Occluder& occluder : m_occluders) {
+            m_NanoOcclusion.AddOccluder(occluder.vertices.data(), occluder.indices.data(), static_cast<uint32_t>(occluder.indices.size()),
+                                        occluder.world, occluder.twoSided);
+        }
+        m_NanoOcclusion.Rasterize(m_NanoJobSystem);
+        visibleCount = m_NanoOcclusion.Cull(m_NanoFrustum, visible, visibleCount, m_NanoJobSystem);
+        visible = m_NanoOcclusion.GetVisibleIndices();
+    }
+
+    m_instanceVisible.assign(count, 0);
+    m_NanoJobSystem.ParallelFor(visibleCount, Config::CPU_CULLING_CHUNK, [this, visible](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            m_instanceVisible[visible[i]] = 1;
+        }
+    });
+    applyInstanceVisibility();
+    m_instancesCulled = true;
+}
+
+void NanoEngine::applyInstanceVisibility(){
+    // the jobs only collect the instances whose visibility changed, the scene buffer is written from here
+    uint32_t count = static_cast<uint32_t>(m_instanceVisible.size());
+    uint32_t chunkCount = (count + Config::CPU_CULLING_CHUNK - 1) / Config::CPU_CULLING_CHUNK;
+    m_visibilityChanges.resize(chunkCount);
+    m_NanoJobSystem.ParallelFor(chunkCount, 1, [this, count](uint32_t chunkBegin, uint32_t chunkEnd) {
+        for (uint32_t chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+            std::vector<uint32_t>& changes = m_visibilityChanges[chunk];
+            changes.clear();
+            uint32_t end = std::min(count, (chunk + 1) * Config::CPU_CULLING_CHUNK);
+            for (uint32_t i = chunk * Config::CPU_CULLING_CHUNK; i < end; i++) {
+                if (m_NanoGraphics.IsInstanceVisible(i) != (m_instanceVisible[i] != 0)) {
+                    changes.push_back(i);
+                }
+            }
+        }
+    });
+    for (const std::vector<uint32_t>& changes : m_visibilityChanges) {
+        for (uint32_t instance : changes) {
+            m_NanoGraphics.SetInstanceVisible(instance, m_instanceVisible[instance] != 0);
+        }
+    }
+}
+
+uint32_t NanoEngine::AddOccluder(const glm::vec3* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+                                 const glm::mat4& world, bool twoSided){
+    m_occluders.push_back({std::vector<glm::vec3>(vertices, vertices + vertexCount),
+                           std::vector<uint32_t>(indices, indices + indexCount), world, twoSided});
+    return static_cast<uint32_t>(m_occluders.size() - 1);
+}
+
+void NanoEngine::SetOccluderWorld(uint32_t occluder, const glm::mat4& world){
+    if (occluder < m_occluders.size()) {
+        m_occluders[occluder].world = world;
+    }
+}
+
+void NanoEngine::recordFrameStats(double frameMs){
+    const NanoFrameTimings& timings = m_NanoGraphics.GetFrameTimings();
+    m_NanoFrameStats.Record(NanoFrameMetric::FENCE_WAIT, timings.fenceWaitMs);
+    m_NanoFrameStats.Record(NanoFrameMetric::RECORD, timings.recordMs);
+    m_NanoFrameStats.Record(NanoFrameMetric::SUBMIT, timings.submitMs);
+    if(!m_options.headless.enabled){
+        m_NanoFrameStats.Record(NanoFrameMetric::ACQUIRE, timings.acquireMs);
+        m_NanoFrameStats.Record(NanoFrameMetric::PRESENT, timings.presentMs);
+    }
+    m_NanoFrameStats.EndFrame(frameMs);
+}
+
+bool NanoEngine::PickObject(const glm::mat4& viewProjection, NanoRayHit& hit){
+    double x = 0.0, y = 0.0;
+    int32_t width = 0, height = 0;
+    m_NanoWindow.GetCursorPosition(x, y);
+    m_NanoWindow.GetWindowSize(width, height);
+    if(width == 0 || height == 0){
+        hit = {};
+        return false;
+    }
+
+    NanoRay ray = NanoBVH::ScreenPointToRay(static_cast<float>(x), static_cast<float>(y), static_cast<float>(width),
+                                            static_cast<float>(height), glm::inverse(viewProjection));
+    return m_NanoBVH.Raycast(ray, hit);
+}
@@ -1,9 +1,28 @@
 #ifndef NANOENGINE_H_
 #define NANOENGINE_H_
 
+#include "NanoBVH.hpp"
+#include "NanoECS.hpp"
+#include "NanoFrameStats.hpp"
+#include "NanoFrustumCuller.hpp"
 #include "NanoGraphics.hpp"
+#include "NanoJobSystem.hpp"
+#include "NanoOcclusionCuller.hpp"
+#include "NanoProfiler.hpp"
+#include "NanoTransformHierarchy.hpp"
 #include "NanoWindow.hpp"
+#include <chrono>
 #include <cstdint>
+#include <vector>
+
+struct NanoEngineOptions {
+    NanoHeadlessOptions headless{};
+    uint64_t frameCount = 0; // Run returns after this many frames, 0 runs until the window is closed (forever headless)
+    bool capture = false;    // from the first frame, all of them are written by the time Run returns
+    NanoCaptureOptions captureOptions{};
+    std::string profilePath{}; // Run writes <profilePath>.csv and <profilePath>.json of the profiler's history when it returns
+    uint32_t profileHistoryFrames = Config::PROFILER_HISTORY_FRAMES; // frames the profiler keeps
+};
 
 class NanoEngine {
   public:
@@ -12,14 +31,74 @@ class NanoEngine {
     NanoEngine(const NanoEngine &other) = default;
     NanoEngine(NanoEngine &&other) = default;
     NanoEngine &operator=(const NanoEngine &other) = default;
-    ERR Init();
+    ERR Init(const NanoEngineOptions& options = {});
     ERR Run();
+    // frameCount frames (0 like Run) of the loop Run goes through, without what Run does once it's done: nothing is
+    // waited on, stopped or written. For callers timing parts of a run themselves (NanoEngineBench)
+    ERR RunFrames(uint64_t frameCount);
     ERR CleanUp();
+    // every parallel subsystem runs its work here instead of spawning its own threads
+    NanoJobSystem& GetJobSystem() { return m_NanoJobSystem; }
+    // world matrices are brought up to date once per frame, before anything is drawn
+    NanoTransformHierarchy& GetTransforms() { return m_NanoTransforms; }
+    NanoWorld& GetWorld() { return m_NanoWorld; }
+    // systems added here run every frame, before the transforms are updated
+    NanoSystemScheduler& GetSystems() { return m_NanoSystems; }
+    // world bounds of the scene objects, kept up to date with Update once per frame after the transforms
+    NanoBVH& GetBVH() { return m_NanoBVH; }
+    // closest object in the BVH under the cursor
+    bool PickObject(const glm::mat4& viewProjection, NanoRayHit& hit);
+    // occluders stay until ClearOccluders, they're rasterized every frame the instances are culled against them.
+    // The mesh is copied, the index returned is the one SetOccluderWorld takes
+    uint32_t AddOccluder(const glm::vec3* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+                         const glm::mat4& world, bool twoSided = false);
+    void SetOccluderWorld(uint32_t occluder, const glm::mat4& world);
+    void ClearOccluders() { m_occluders.clear(); }
+    // while there are occluders, the culling stage runs both every frame between the BVH update and DrawFrame and the
+    // instances neither keeps are hidden from the GPU pass. Their results (visible indices, stats) are the ones of the
+    // last frame it ran. The bounds are only updated for the instances that moved
+    NanoFrustumCuller& GetFrustumCuller() { return m_NanoFrustum; }
+    NanoOcclusionCuller& GetOcclusionCuller() { return m_NanoOcclusion; }
+    // from the start of Init to the end of the first frame, 0 until that frame was drawn
+    double GetTimeToFirstFrame() { return m_timeToFirstFrameMs; }
+    NanoGraphics& GetGraphics() { return m_NanoGraphics; }
+    // CPU zones of the frame's stages (add your own with NanoProfileScope) and GPU time per render graph pass
+    NanoProfiler& GetProfiler() { return m_NanoProfiler; }
+    // rolling frame time percentiles and stutters, always on. A summary is logged when Run returns
+    NanoFrameStats& GetFrameStats() { return m_NanoFrameStats; }
 
   private:
+    struct Occluder {
+        std::vector<glm::vec3> vertices;
+        std::vector<uint32_t> indices;
+        glm::mat4 world;
+        bool twoSided;
+    };
+
     ERR MainLoop();
+    void cullInstances();
+    void applyInstanceVisibility();
+    void recordFrameStats(double frameMs);
     NanoGraphics m_NanoGraphics;
     NanoWindow m_NanoWindow;
+    NanoJobSystem m_NanoJobSystem;
+    NanoTransformHierarchy m_NanoTransforms;
+    NanoWorld m_NanoWorld;
+    NanoSystemScheduler m_NanoSystems;
+    NanoBVH m_NanoBVH;
+    NanoFrustumCuller m_NanoFrustum;
+    NanoOcclusionCuller m_NanoOcclusion;
+    NanoProfiler m_NanoProfiler;
+    NanoFrameStats m_NanoFrameStats;
+
+    NanoEngineOptions m_options{};
+    std::chrono::steady_clock::time_point m_initStart{};
+    double m_timeToFirstFrameMs = 0.0;
+    std::vector<Occluder> m_occluders{};
+    std::vector<uint8_t> m_instanceVisible{};
+    std::vector<uint32_t> m_movedInstances{};
+    std::vector<std::vector<uint32_t>> m_visibilityChanges{}; // per chunk of instances
+    bool m_instancesCulled = false;                           // some instances may still be hidden
 };
 
 #endif // NANOENGINE_H_
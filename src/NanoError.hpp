@@ -28,6 +28,6 @@ enum class ERRLevel {
     DEBUG,
 };
 
-enum class ERR { OK, NOT_INITIALIZED, NOT_FOUND, WRONG_ARGUMENT, UNDEFINED, INVALID };
+enum class ERR { OK, NOT_INITIALIZED, NOT_FOUND, WRONG_ARGUMENT, UNDEFINED, INVALID, OUT_OF_SPACE };
 
 #endif // NANOERROR_H_
@@ -0,0 +1,279 @@
+#include "NanoFrameCapture.hpp"
+#include "NanoConfig.hpp"
+#include "NanoLogger.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+static_assert(Config::CAPTURE_SLOT_COUNT > Config::MAX_FRAMES_IN_FLIGHT, "capture slots must outnumber the frames in flight");
+
+bool NanoFrameCapture::IsFormatSupported(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// cached memory makes the encoders' reads much faster, it's not there on every device
+static VkMemoryPropertyFlags getReadbackMemoryProperties(const VkPhysicalDevice& physicalDevice) {
+    VkMemoryPropertyFlags cached = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        if ((memoryProperties.memoryTypes[i].propertyFlags & cached) == cached) {
+            return cached;
+        }
+    }
+    return VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+ERR NanoFrameCapture::Init(VkDevice& device, const VkPhysicalDevice& physicalDevice, NanoJobSystem& jobSystem, const VkExtent2D& extent,
+                           VkFormat format, const NanoCaptureOptions& options) {
+    ERR err = ERR::OK;
+    if (!IsFormatSupported(format)) {
+        LOG_MSG(ERRLevel::WARNING, "frame capture: format %d is not 8 bit RGBA or BGRA", static_cast<int>(format));
+        return ERR::INVALID;
+    }
+
+    _device = device;
+    _jobSystem = &jobSystem;
+    m_options = options;
+    m_extent = extent;
+    m_pixelOrder = format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB ? ImageWriter::PixelOrder::BGRA
+                                                                                            : ImageWriter::PixelOrder::RGBA;
+
+    if (m_options.format == NanoCaptureFormat::RAW_VIDEO) {
+        std::string fileName = m_options.path + ".rgba";
+        m_stream.open(fileName, std::ios::binary | std::ios::trunc);
+        if (!m_stream.is_open()) {
+            LOG_MSG(ERRLevel::WARNING, "could not open output file: %s", fileName.c_str());
+            return ERR::NOT_FOUND;
+        }
+    }
+
+    VkMemoryPropertyFlags properties = getReadbackMemoryProperties(physicalDevice);
+    VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+    m_slotCount = Config::CAPTURE_SLOT_COUNT;
+    m_slots = std::make_unique<Slot[]>(m_slotCount);
+    for (uint32_t i = 0; i < m_slotCount; i++) {
+        m_slots[i].buffer.Init(device, physicalDevice, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties);
+    }
+
+    m_current = UINT32_MAX;
+    m_nextSequence = 0;
+    m_nextWrite = 0;
+    m_captured = 0;
+    m_failed = 0;
+    m_encodeUs = 0;
+    m_dropped = 0;
+    LOG_MSG(ERRLevel::INFO, "frame capture: %dx%d to %s, %d slots%s", extent.width, extent.height, m_options.path.c_str(), m_slotCount,
+            properties & VK_MEMORY_PROPERTY_HOST_CACHED_BIT ? ", cached" : "");
+
+    m_isInit = true;
+    return err;
+}
+
+void NanoFrameCapture::CleanUp() {
+    if (!m_isInit) {
+        return;
+    }
+
+    _jobSystem->Wait(m_encodes);
+    for (uint32_t i = 0; i < m_slotCount; i++) {
+        if (m_slots[i].state.load(std::memory_order_acquire) == RECORDED) {
+            m_dropped++; // never collected
+        }
+        m_slots[i].buffer.CleanUp();
+    }
+    m_slots.reset();
+    m_slotCount = 0;
+    if (m_stream.is_open()) {
+        m_stream.close();
+    }
+
+    NanoCaptureStats stats = GetStats();
+    LOG_MSG(ERRLevel::INFO, "frame capture: %d captured, %d dropped, %d failed, %f ms encoding", static_cast<int>(stats.captured),
+            static_cast<int>(stats.dropped), static_cast<int>(stats.failed), stats.encodeMs);
+    m_isInit = false;
+}
+
+void NanoFrameCapture::Collect(uint64_t completedFrame) {
+    if (!m_isInit) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < m_slotCount; i++) {
+        Slot& slot = m_slots[i];
+        if (slot.state.load(std::memory_order_acquire) == RECORDED && slot.frame <= completedFrame) {
+            slot.state.store(ENCODING, std::memory_order_relaxed);
+            _jobSystem->Run([this, i]() { encode(i); }, &m_encodes);
+        }
+    }
+}
+
+bool NanoFrameCapture::BeginFrame(uint64_t frame) {
+    m_current = UINT32_MAX;
+    if (!m_isInit || IsDone()) {
+        return false;
+    }
+
+    while (true) {
+        bool encoding = false;
+        for (uint32_t i = 0; i < m_slotCount; i++) {
+            uint32_t state = m_slots[i].state.load(std::memory_order_acquire);
+            if (state == FREE) {
+                m_current = i;
+                m_slots[i].frame = frame;
+                return true;
+            }
+            encoding |= state != RECORDED;
+        }
+
+        // slots waiting on the GPU only free up through Collect, waiting here would never end
+        if (m_options.dropWhenBusy || !encoding) {
+            m_dropped++;
+            return false;
+        }
+        if (!_jobSystem->RunPendingJob()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void NanoFrameCapture::RecordCopy(VkCommandBuffer& commandBuffer, VkImage image, VkImageLayout layout, const VkExtent2D& extent) {
+    if (m_current == UINT32_MAX) {
+        return;
+    }
+    Slot& slot = m_slots[m_current];
+    m_current = UINT32_MAX;
+    if (extent.width != m_extent.width || extent.height != m_extent.height) {
+        m_dropped++; // the slots are sized for the extent capture started with
+        return;
+    }
+
+    // whatever the frame's passes did to the image, then into a layout the copy can read
+    VkImageMemoryBarrier imageBarrier{};
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    imageBarrier.oldLayout = layout;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = image;
+    imageBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+                         &imageBarrier);
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0; // tightly packed
+    region.bufferImageHeight = 0;
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {m_extent.width, m_extent.height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer.GetBuffer(), 1, &region);
+
+    // the host reads the buffer once the frame's fence or timeline value says so, and the image goes back to where the
+    // graph left it (the present waits on the frame's semaphore)
+    VkBufferMemoryBarrier bufferBarrier{};
+    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.buffer = slot.buffer.GetBuffer();
+    bufferBarrier.offset = 0;
+    bufferBarrier.size = VK_WHOLE_SIZE;
+    imageBarrier.srcAccessMask = 0;
+    imageBarrier.dstAccessMask = 0;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageBarrier.newLayout = layout;
+    uint32_t imageBarrierCount = layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL ? 1 : 0;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         0, nullptr, 1, &bufferBarrier, imageBarrierCount, &imageBarrier);
+
+    slot.sequence = m_nextSequence++;
+    slot.state.store(RECORDED, std::memory_order_release);
+}
+
+bool NanoFrameCapture::IsDone() {
+    return m_options.frameCount > 0 && m_nextSequence >= m_options.frameCount;
+}
+
+NanoCaptureStats NanoFrameCapture::GetStats() {
+    NanoCaptureStats stats{};
+    stats.captured = m_captured.load(std::memory_order_relaxed);
+    stats.dropped = m_dropped;
+    stats.failed = m_failed.load(std::memory_order_relaxed);
+    stats.encodeMs = m_encodeUs.load(std::memory_order_relaxed) / 1000.0;
+    return stats;
+}
+
+void NanoFrameCapture::encode(uint32_t slotIndex) {
+    Slot& slot = m_slots[slotIndex];
+    auto start = std::chrono::steady_clock::now();
+    const uint8_t* pixels = static_cast<const uint8_t*>(slot.buffer.GetMappedData());
+
+    if (m_options.format == NanoCaptureFormat::RAW_VIDEO) {
+        // RGBA targets are written straight from the mapped buffer
+        if (m_pixelOrder != ImageWriter::PixelOrder::RGBA) {
+            ImageWriter::ConvertToRGBA(pixels, m_extent.width, m_extent.height, m_pixelOrder, slot.encoded);
+        }
+        slot.state.store(READY, std::memory_order_release);
+        writeReadyFrames();
+    } else {
+        bool png = m_options.format == NanoCaptureFormat::PNG;
+        if (png) {
+            ImageWriter::EncodePNG(pixels, m_extent.width, m_extent.height, m_pixelOrder, slot.encoded);
+        } else {
+            ImageWriter::EncodePPM(pixels, m_extent.width, m_extent.height, m_pixelOrder, slot.encoded);
+        }
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), "_%06llu.%s", static_cast<unsigned long long>(slot.frame), png ? "png" : "ppm");
+        if (ImageWriter::WriteFile(m_options.path + suffix, slot.encoded.data(), slot.encoded.size()) == ERR::OK) {
+            m_captured.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            m_failed.fetch_add(1, std::memory_order_relaxed);
+        }
+        slot.state.store(FREE, std::memory_order_release);
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    m_encodeUs.fetch_add(static_cast<uint64_t>(elapsed.count()), std::memory_order_relaxed);
+}
+
+// Whichever encode finishes writes every frame that is next in line, a frame that finished early waits in its slot
+void NanoFrameCapture::writeReadyFrames() {
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    bool wrote = true;
+    while (wrote) {
+        wrote = false;
+        for (uint32_t i = 0; i < m_slotCount; i++) {
+            Slot& slot = m_slots[i];
+            if (slot.state.load(std::memory_order_acquire) != READY || slot.sequence != m_nextWrite) {
+                continue;
+            }
+
+            size_t size = static_cast<size_t>(m_extent.width) * m_extent.height * 4;
+            const uint8_t* data = m_pixelOrder == ImageWriter::PixelOrder::RGBA ? static_cast<const uint8_t*>(slot.buffer.GetMappedData())
+                                                                                : slot.encoded.data();
+            m_stream.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+            if (m_stream.good()) {
+                m_captured.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                m_failed.fetch_add(1, std::memory_order_relaxed);
+                m_stream.clear();
+            }
+            m_nextWrite++;
+            slot.state.store(FREE, std::memory_order_release);
+            wrote = true;
+        }
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef NANOFRAMECAPTURE_H_
+#define NANOFRAMECAPTURE_H_
+
+#include "NanoBuffer.hpp"
+#include "NanoError.hpp"
+#include "NanoImageWriter.hpp"
+#include "NanoJobSystem.hpp"
+
+#include "vulkan/vulkan_core.h"
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class NanoCaptureFormat {
+    PNG,       // <path>_<frame>.png
+    PPM,       // <path>_<frame>.ppm
+    RAW_VIDEO, // one <path>.rgba stream, frames back to back in capture order
+};
+
+struct NanoCaptureOptions {
+    NanoCaptureFormat format = NanoCaptureFormat::PNG;
+    std::string path = "capture";
+    uint32_t frameCount = 0;   // stops capturing after this many frames, 0 until StopCapture
+    bool dropWhenBusy = false; // skip frames while every slot is taken instead of waiting for an encode to finish
+};
+
+struct NanoCaptureStats {
+    uint64_t captured = 0; // encoded and written
+    uint64_t dropped = 0;  // skipped, every slot was busy (dropWhenBusy) or the extent changed
+    uint64_t failed = 0;   // could not be written
+    double encodeMs = 0.0; // summed over all encodes, across threads
+};
+
+// Frame readback. Each captured frame copies the target image into one of a ring of host visible buffers, in the frame's
+// own command buffer. Slots are only looked at once the frame is known to be complete (Collect), and then handed to a job
+// that encodes and writes them, so the render loop never waits on the GPU for a capture. What it does wait on is encoding:
+// when every slot is taken, BeginFrame helps with the encodes until one is free (or drops the frame), so the capture rate
+// settles at what the encoders sustain.
+// Only 8 bit RGBA and BGRA targets can be captured
+class NanoFrameCapture {
+  public:
+    ERR Init(VkDevice& device, const VkPhysicalDevice& physicalDevice, NanoJobSystem& jobSystem, const VkExtent2D& extent,
+             VkFormat format, const NanoCaptureOptions& options);
+    // waits for the encodes in flight. Frames still on the GPU are lost, Collect them first
+    void CleanUp();
+
+    // hands the slots of frames up to completedFrame to the encoders
+    void Collect(uint64_t completedFrame);
+    // picks the slot the frame is copied to, false when it isn't captured
+    bool BeginFrame(uint64_t frame);
+    // after the frame's last pass. The image is in layout and stays in it
+    void RecordCopy(VkCommandBuffer& commandBuffer, VkImage image, VkImageLayout layout, const VkExtent2D& extent);
+
+    bool IsInit() { return m_isInit; }
+    bool IsDone(); // frameCount reached
+    NanoCaptureStats GetStats();
+
+    static bool IsFormatSupported(VkFormat format);
+
+  private:
+    enum SlotState : uint32_t {
+        FREE,
+        RECORDED, // copy recorded, the frame may still be on the GPU
+        ENCODING,
+        READY, // raw video: converted, waiting for the frames before it to be written
+    };
+    struct Slot {
+        NanoBuffer buffer{};
+        uint64_t frame = 0;
+        uint64_t sequence = 0; // capture order
+        std::atomic<uint32_t> state{FREE};
+        std::vector<uint8_t> encoded{};
+    };
+
+    void encode(uint32_t slotIndex);
+    void writeReadyFrames(); // raw video, in sequence order
+
+    VkDevice _device{};
+    NanoJobSystem* _jobSystem = nullptr;
+    bool m_isInit = false;
+    NanoCaptureOptions m_options{};
+    VkExtent2D m_extent{};
+    ImageWriter::PixelOrder m_pixelOrder = ImageWriter::PixelOrder::RGBA;
+
+    std::unique_ptr<Slot[]> m_slots{};
+    uint32_t m_slotCount = 0;
+    uint32_t m_current = UINT32_MAX; // slot picked by BeginFrame
+    uint64_t m_nextSequence = 0;
+    NanoJobCounter m_encodes{};
+
+    std::mutex m_streamMutex{};
+    std::ofstream m_stream{};
+    uint64_t m_nextWrite = 0; // sequence the stream expects next
+
+    std::atomic<uint64_t> m_captured{0};
+    std::atomic<uint64_t> m_failed{0};
+    std::atomic<uint64_t> m_encodeUs{0};
+    uint64_t m_dropped = 0;
+};
+
+#endif // NANOFRAMECAPTURE_H_
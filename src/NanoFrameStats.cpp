@@ -0,0 +1,203 @@
+#include "NanoFrameStats.hpp"
+#include "NanoLogger.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void NanoFrameHistogram::Init(uint32_t windowSize) {
+    m_windowSize = std::max(windowSize, 1u);
+    m_window = std::make_unique<std::atomic<uint32_t>[]>(m_windowSize);
+    Reset();
+}
+
+void NanoFrameHistogram::Reset() {
+    for (auto& bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    for (uint32_t i = 0; i < m_windowSize; i++) {
+        m_window[i].store(0, std::memory_order_relaxed);
+    }
+    m_added.store(0, std::memory_order_release);
+}
+
+uint32_t NanoFrameHistogram::GetBucket(uint32_t us) {
+    if (us < LINEAR_LIMIT) {
+        return us;
+    }
+    uint32_t exponent = 31;
+    while (!(us >> exponent)) {
+        exponent--;
+    }
+    uint32_t subBucket = (us >> (exponent - SUB_BUCKET_BITS)) & ((1u << SUB_BUCKET_BITS) - 1);
+    return LINEAR_LIMIT + (exponent - SUB_BUCKET_BITS - 1) * (1u << SUB_BUCKET_BITS) + subBucket;
+}
+
+uint64_t NanoFrameHistogram::GetBucketLowerBound(uint32_t bucket) {
+    if (bucket < LINEAR_LIMIT) {
+        return bucket;
+    }
+    uint32_t index = bucket - LINEAR_LIMIT;
+    uint32_t exponent = index / (1u << SUB_BUCKET_BITS) + SUB_BUCKET_BITS + 1;
+    uint64_t subBucket = index % (1u << SUB_BUCKET_BITS);
+    return ((1ull << SUB_BUCKET_BITS) + subBucket) << (exponent - SUB_BUCKET_BITS);
+}
+
+uint64_t NanoFrameHistogram::GetBucketUpperBound(uint32_t bucket) {
+    if (bucket < LINEAR_LIMIT) {
+        return bucket + 1;
+    }
+    uint32_t exponent = (bucket - LINEAR_LIMIT) / (1u << SUB_BUCKET_BITS) + SUB_BUCKET_BITS + 1;
+    return GetBucketLowerBound(bucket) + (1ull << (exponent - SUB_BUCKET_BITS));
+}
+
+void NanoFrameHistogram::Add(double ms) {
+    double us = std::round(ms * 1000.0);
+    uint32_t sample = us <= 0.0 ? 0 : us >= 4294967295.0 ? UINT32_MAX : static_cast<uint32_t>(us);
+
+    uint64_t added = m_added.load(std::memory_order_relaxed);
+    std::atomic<uint32_t>& slot = m_window[added % m_windowSize];
+    if (added >= m_windowSize) {
+        m_buckets[GetBucket(slot.load(std::memory_order_relaxed))].fetch_sub(1, std::memory_order_relaxed);
+    }
+    slot.store(sample, std::memory_order_relaxed);
+    m_buckets[GetBucket(sample)].fetch_add(1, std::memory_order_relaxed);
+    m_added.store(added + 1, std::memory_order_release);
+}
+
+uint32_t NanoFrameHistogram::GetCount() const {
+    return static_cast<uint32_t>(std::min<uint64_t>(m_added.load(std::memory_order_acquire), m_windowSize));
+}
+
+double NanoFrameHistogram::GetPercentile(double p) const {
+    uint32_t count = GetCount();
+    if (count == 0) {
+        return 0.0;
+    }
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::min(std::max(p, 0.0), 1.0) * count)));
+    uint64_t seen = 0;
+    for (uint32_t bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+        seen += m_buckets[bucket].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            // the middle of the bucket, exact below LINEAR_LIMIT
+            uint64_t lower = GetBucketLowerBound(bucket);
+            uint64_t upper = GetBucketUpperBound(bucket);
+            return (lower + (upper - lower - 1) / 2.0) / 1000.0;
+        }
+    }
+    return GetMax(); // samples moved while we walked
+}
+
+double NanoFrameHistogram::GetMax() const {
+    uint32_t count = GetCount();
+    uint32_t maxSample = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        maxSample = std::max(maxSample, m_window[i].load(std::memory_order_relaxed));
+    }
+    return maxSample / 1000.0;
+}
+
+ERR NanoFrameStats::Init(uint32_t windowSize) {
+    ERR err = ERR::OK;
+    for (uint32_t i = 0; i < METRIC_COUNT; i++) {
+        m_histograms[i].Init(windowSize);
+        m_stageMs[i] = -1.0;
+    }
+    m_frames.store(0, std::memory_order_relaxed);
+    m_stutters.store(0, std::memory_order_relaxed);
+    return err;
+}
+
+void NanoFrameStats::Record(NanoFrameMetric metric, double ms) {
+    uint32_t index = static_cast<uint32_t>(metric);
+    m_histograms[index].Add(ms);
+    m_stageMs[index] = ms;
+}
+
+void NanoFrameStats::EndFrame(double frameMs) {
+    NanoFrameHistogram& frames = m_histograms[static_cast<uint32_t>(NanoFrameMetric::FRAME)];
+    uint64_t frame = m_frames.load(std::memory_order_relaxed) + 1;
+
+    if (frames.GetCount() >= Config::STUTTER_WARMUP_FRAMES) {
+        double medianMs = frames.GetPercentile(0.5);
+        if (frameMs > medianMs * Config::STUTTER_MEDIAN_MULTIPLIER) {
+            NanoStutterEvent event{};
+            event.frame = frame;
+            event.frameMs = frameMs;
+            event.medianMs = medianMs;
+            for (uint32_t i = 1; i < METRIC_COUNT; i++) {
+                if (m_stageMs[i] > event.worstStageMs) {
+                    event.worstStage = static_cast<NanoFrameMetric>(i);
+                    event.worstStageMs = m_stageMs[i];
+                }
+            }
+            uint64_t stutters = m_stutters.load(std::memory_order_relaxed);
+            m_stutterEvents[stutters % Config::STUTTER_EVENT_HISTORY] = event;
+            m_stutters.store(stutters + 1, std::memory_order_relaxed);
+        }
+    }
+
+    frames.Add(frameMs);
+    for (double& stageMs : m_stageMs) {
+        stageMs = -1.0;
+    }
+    m_frames.store(frame, std::memory_order_relaxed);
+}
+
+NanoFrameMetricSummary NanoFrameStats::GetSummary(NanoFrameMetric metric) const {
+    const NanoFrameHistogram& histogram = GetHistogram(metric);
+    NanoFrameMetricSummary summary{};
+    summary.samples = histogram.GetCount();
+    summary.p50Ms = histogram.GetPercentile(0.50);
+    summary.p95Ms = histogram.GetPercentile(0.95);
+    summary.p99Ms = histogram.GetPercentile(0.99);
+    summary.maxMs = histogram.GetMax();
+    return summary;
+}
+
+uint32_t NanoFrameStats::GetStutterEvents(NanoStutterEvent* events, uint32_t maxEvents) const {
+    uint64_t stutters = m_stutters.load(std::memory_order_relaxed);
+    uint32_t count = static_cast<uint32_t>(std::min<uint64_t>({stutters, Config::STUTTER_EVENT_HISTORY, maxEvents}));
+    for (uint32_t i = 0; i < count; i++) {
+        events[i] = m_stutterEvents[(stutters - count + i) % Config::STUTTER_EVENT_HISTORY];
+    }
+    return count;
+}
+
+void NanoFrameStats::LogSummary() const {
+    LOG_MSG(ERRLevel::INFO, "frame stats: %d frames, %d stutters (over %f x the median)", static_cast<int>(GetFrameCount()),
+            static_cast<int>(GetStutterCount()), static_cast<double>(Config::STUTTER_MEDIAN_MULTIPLIER));
+    for (uint32_t i = 0; i < METRIC_COUNT; i++) {
+        NanoFrameMetricSummary summary = GetSummary(static_cast<NanoFrameMetric>(i));
+        if (summary.samples == 0) {
+            continue;
+        }
+        LOG_MSG(ERRLevel::INFO, "  %s: p50 %f ms, p95 %f ms, p99 %f ms, max %f ms (last %d)", GetMetricName(static_cast<NanoFrameMetric>(i)),
+                summary.p50Ms, summary.p95Ms, summary.p99Ms, summary.maxMs, static_cast<int>(summary.samples));
+    }
+
+    NanoStutterEvent events[Config::STUTTER_EVENT_HISTORY];
+    uint32_t count = GetStutterEvents(events, Config::STUTTER_EVENT_HISTORY);
+    for (uint32_t i = 0; i < count; i++) {
+        LOG_MSG(ERRLevel::INFO, "  stutter at frame %d: %f ms against a median of %f ms, %s took %f ms", static_cast<int>(events[i].frame),
+                events[i].frameMs, events[i].medianMs, GetMetricName(events[i].worstStage), events[i].worstStageMs);
+    }
+}
+
+const char* NanoFrameStats::GetMetricName(NanoFrameMetric metric) {
+    switch (metric) {
+    case NanoFrameMetric::FRAME:
+        return "frame";
+    case NanoFrameMetric::FENCE_WAIT:
+        return "fence wait";
+    case NanoFrameMetric::ACQUIRE:
+        return "acquire";
+    case NanoFrameMetric::RECORD:
+        return "record";
+    case NanoFrameMetric::SUBMIT:
+        return "submit";
+    case NanoFrameMetric::PRESENT:
+        return "present";
+    default:
+        return "unknown";
+    }
+}
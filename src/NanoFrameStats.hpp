@@ -0,0 +1,100 @@
+#ifndef NANOFRAMESTATS_H_
+#define NANOFRAMESTATS_H_
+
+#include "NanoConfig.hpp"
+#include "NanoError.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+enum class NanoFrameMetric {
+    FRAME,      // CPU time of a whole main loop iteration
+    FENCE_WAIT, // blocked in vkWaitForFences
+    ACQUIRE,    // blocked in vkAcquireNextImageKHR
+    RECORD,
+    SUBMIT,
+    PRESENT,
+    COUNT,
+};
+
+struct NanoFrameMetricSummary {
+    uint32_t samples = 0; // in the window
+    double p50Ms = 0.0;
+    double p95Ms = 0.0;
+    double p99Ms = 0.0;
+    double maxMs = 0.0; // in the window
+};
+
+struct NanoStutterEvent {
+    uint64_t frame = 0;
+    double frameMs = 0.0;
+    double medianMs = 0.0; // what the frame was compared against
+    NanoFrameMetric worstStage = NanoFrameMetric::FRAME; // the stage that took longest, FRAME when none was measured
+    double worstStageMs = 0.0;
+};
+
+// Rolling histogram over the last windowSize samples, in microseconds. Buckets are log linear: exact below 32us, then 16
+// per power of two, so a percentile is off by at most ~3%. A sample leaving the window is taken out of its bucket again.
+// One thread adds, any thread can read: counters are relaxed atomics, a read racing an Add can be off by that sample
+class NanoFrameHistogram {
+  public:
+    static constexpr uint32_t SUB_BUCKET_BITS = 4;
+    static constexpr uint32_t LINEAR_LIMIT = 2u << SUB_BUCKET_BITS; // 32us, values below get a bucket each
+    static constexpr uint32_t BUCKET_COUNT = LINEAR_LIMIT + (32 - SUB_BUCKET_BITS - 1) * (1u << SUB_BUCKET_BITS);
+
+    void Init(uint32_t windowSize);
+    void Add(double ms);
+    void Reset();
+
+    // p in [0, 1], 0 when there are no samples
+    double GetPercentile(double p) const;
+    double GetMax() const; // exact, scans the window
+    uint32_t GetCount() const;
+
+    static uint32_t GetBucket(uint32_t us);
+    static uint64_t GetBucketLowerBound(uint32_t bucket); // in us
+    static uint64_t GetBucketUpperBound(uint32_t bucket); // in us, exclusive
+
+  private:
+    std::atomic<uint32_t> m_buckets[BUCKET_COUNT]{};
+    std::unique_ptr<std::atomic<uint32_t>[]> m_window{}; // samples in us, ring
+    uint32_t m_windowSize = 0;
+    std::atomic<uint64_t> m_added{0};
+};
+
+// Frame time instrumentation cheap enough to always stay on: a handful of atomic adds per frame. Every metric gets a
+// rolling histogram over the last Config::FRAME_STATS_WINDOW frames. A frame longer than Config::STUTTER_MEDIAN_MULTIPLIER
+// times the window's median (once the window has Config::STUTTER_WARMUP_FRAMES) is kept as a stutter event, along with the
+// stage that took longest
+class NanoFrameStats {
+  public:
+    ERR Init(uint32_t windowSize = Config::FRAME_STATS_WINDOW);
+
+    // stages of the current frame, any order, at most once each
+    void Record(NanoFrameMetric metric, double ms);
+    // adds the frame time, and checks it against the median of the frames before
+    void EndFrame(double frameMs);
+
+    NanoFrameMetricSummary GetSummary(NanoFrameMetric metric) const;
+    const NanoFrameHistogram& GetHistogram(NanoFrameMetric metric) const { return m_histograms[static_cast<uint32_t>(metric)]; }
+    uint64_t GetFrameCount() const { return m_frames.load(std::memory_order_relaxed); }
+    uint64_t GetStutterCount() const { return m_stutters.load(std::memory_order_relaxed); }
+    // the last Config::STUTTER_EVENT_HISTORY events, oldest first. Only from the thread calling EndFrame
+    uint32_t GetStutterEvents(NanoStutterEvent* events, uint32_t maxEvents) const;
+    // p50 / p95 / p99 / max of every metric, and the latest stutters
+    void LogSummary() const;
+
+    static const char* GetMetricName(NanoFrameMetric metric);
+
+  private:
+    static constexpr uint32_t METRIC_COUNT = static_cast<uint32_t>(NanoFrameMetric::COUNT);
+
+    NanoFrameHistogram m_histograms[METRIC_COUNT]{};
+    double m_stageMs[METRIC_COUNT]{}; // current frame, -1 when not recorded
+    std::atomic<uint64_t> m_frames{0};
+    std::atomic<uint64_t> m_stutters{0};
+    NanoStutterEvent m_stutterEvents[Config::STUTTER_EVENT_HISTORY]{};
+};
+
+#endif // NANOFRAMESTATS_H_
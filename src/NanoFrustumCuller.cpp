@@ -0,0 +1,325 @@
+#include "NanoFrustumCuller.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef NANO_CULLING_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define NANO_TARGET_AVX2
+#else
+#define NANO_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+NanoFrustum NanoFrustum::FromViewProjection(const glm::mat4& viewProjection) {
+    // Gribb / Hartmann, glm is column major so the rows are gathered by hand
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    }
+
+    NanoFrustum frustum{};
+    frustum.planes[0] = rows[3] + rows[0];
+    frustum.planes[1] = rows[3] - rows[0];
+    frustum.planes[2] = rows[3] + rows[1];
+    frustum.planes[3] = rows[3] - rows[1];
+    frustum.planes[4] = rows[2]; // 0 <= z, not -w <= z like in OpenGL
+    frustum.planes[5] = rows[3] - rows[2];
+    for (auto& plane : frustum.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+void NanoFrustumCuller::Resize(uint32_t count) {
+    m_centerX.resize(count);
+    m_centerY.resize(count);
+    m_centerZ.resize(count);
+    m_extentX.resize(count);
+    m_extentY.resize(count);
+    m_extentZ.resize(count);
+    m_radius.resize(count);
+}
+
+void NanoFrustumCuller::SetBounds(uint32_t index, const glm::vec3& min, const glm::vec3& max, float sphereRadius) {
+    glm::vec3 center = (min + max) * 0.5f;
+    glm::vec3 extent = (max - min) * 0.5f;
+    m_centerX[index] = center.x;
+    m_centerY[index] = center.y;
+    m_centerZ[index] = center.z;
+    m_extentX[index] = extent.x;
+    m_extentY[index] = extent.y;
+    m_extentZ[index] = extent.z;
+    m_radius[index] = sphereRadius < 0.0f ? glm::length(extent) : sphereRadius;
+}
+
+void NanoFrustumCuller::GetBounds(uint32_t index, glm::vec3& min, glm::vec3& max) const {
+    glm::vec3 center(m_centerX[index], m_centerY[index], m_centerZ[index]);
+    glm::vec3 extent(m_extentX[index], m_extentY[index], m_extentZ[index]);
+    min = center - extent;
+    max = center + extent;
+}
+
+void NanoFrustumCuller::SetBounds(uint32_t index, const glm::mat4& world, const glm::vec3& localMin, const glm::vec3& localMax,
+                                  float localSphereRadius) {
+    glm::vec3 localCenter = (localMin + localMax) * 0.5f;
+    glm::vec3 localExtent = (localMax - localMin) * 0.5f;
+
+    glm::vec3 center = glm::vec3(world * glm::vec4(localCenter, 1.0f));
+    glm::vec3 extent = glm::abs(glm::vec3(world[0])) * localExtent.x + glm::abs(glm::vec3(world[1])) * localExtent.y +
+                       glm::abs(glm::vec3(world[2])) * localExtent.z;
+
+    float radius = -1.0f;
+    if (localSphereRadius >= 0.0f) {
+        float scale = std::max({glm::length(glm::vec3(world[0])), glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))});
+        radius = localSphereRadius * scale;
+    }
+    SetBounds(index, center - extent, center + extent, radius);
+}
+
+namespace {
+struct CullingInput {
+    const float* centerX;
+    const float* centerY;
+    const float* centerZ;
+    const float* extentX;
+    const float* extentY;
+    const float* extentZ;
+    const float* radius;
+};
+
+// planes split into components, plus the absolute normal for the box radius
+struct CullingPlanes {
+    float nx[6], ny[6], nz[6], w[6];
+    float ax[6], ay[6], az[6];
+};
+} // namespace
+
+// Every kernel does the exact same operations in the same order: per plane, d = n.c + w, the box projects to
+// |n|.e, and the object is out when d < -min(box, sphere) for any plane.
+// Indices are written unconditionally and the cursor only moves for visible objects, no branch per object
+static uint32_t cullScalar(const CullingInput& input, const CullingPlanes& planes, uint32_t begin, uint32_t end, uint32_t* visible) {
+    uint32_t count = 0;
+    for (uint32_t i = begin; i < end; i++) {
+        bool outside = false;
+        for (int p = 0; p < 6; p++) {
+            float d = planes.nx[p] * input.centerX[i] + planes.ny[p] * input.centerY[i] + planes.nz[p] * input.centerZ[i] + planes.w[p];
+            float box = planes.ax[p] * input.extentX[i] + planes.ay[p] * input.extentY[i] + planes.az[p] * input.extentZ[i];
+            float r = std::min(box, input.radius[i]);
+            outside |= d < -r;
+        }
+        visible[count] = i;
+        count += !outside;
+    }
+    return count;
+}
+
+#ifdef NANO_CULLING_X86
+// only whole groups, the rest goes through the scalar kernel. That also keeps the unconditional writes inside [0, end - begin)
+static uint32_t cullSSE(const CullingInput& input, const CullingPlanes& planes, uint32_t begin, uint32_t end, uint32_t* visible) {
+    __m128 nx[6], ny[6], nz[6], w[6], ax[6], ay[6], az[6];
+    for (int p = 0; p < 6; p++) {
+        nx[p] = _mm_set1_ps(planes.nx[p]);
+        ny[p] = _mm_set1_ps(planes.ny[p]);
+        nz[p] = _mm_set1_ps(planes.nz[p]);
+        w[p] = _mm_set1_ps(planes.w[p]);
+        ax[p] = _mm_set1_ps(planes.ax[p]);
+        ay[p] = _mm_set1_ps(planes.ay[p]);
+        az[p] = _mm_set1_ps(planes.az[p]);
+    }
+    const __m128 zero = _mm_setzero_ps();
+
+    uint32_t count = 0;
+    uint32_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128 cx = _mm_loadu_ps(input.centerX + i);
+        __m128 cy = _mm_loadu_ps(input.centerY + i);
+        __m128 cz = _mm_loadu_ps(input.centerZ + i);
+        __m128 ex = _mm_loadu_ps(input.extentX + i);
+        __m128 ey = _mm_loadu_ps(input.extentY + i);
+        __m128 ez = _mm_loadu_ps(input.extentZ + i);
+        __m128 radius = _mm_loadu_ps(input.radius + i);
+
+        __m128 outside = zero;
+        for (int p = 0; p < 6; p++) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)), _mm_mul_ps(nz[p], cz)), w[p]);
+            __m128 box = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)), _mm_mul_ps(az[p], ez));
+            __m128 r = _mm_min_ps(box, radius);
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(d, _mm_sub_ps(zero, r)));
+        }
+
+        uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_ps(outside));
+        for (uint32_t k = 0; k < 4; k++) {
+            visible[count] = i + k;
+            count += (mask >> k) & 1;
+        }
+    }
+    return count + cullScalar(input, planes, i, end, visible + count);
+}
+
+NANO_TARGET_AVX2
+static uint32_t cullAVX2(const CullingInput& input, const CullingPlanes& planes, uint32_t begin, uint32_t end, uint32_t* visible) {
+    __m256 nx[6], ny[6], nz[6], w[6], ax[6], ay[6], az[6];
+    for (int p = 0; p < 6; p++) {
+        nx[p] = _mm256_set1_ps(planes.nx[p]);
+        ny[p] = _mm256_set1_ps(planes.ny[p]);
+        nz[p] = _mm256_set1_ps(planes.nz[p]);
+        w[p] = _mm256_set1_ps(planes.w[p]);
+        ax[p] = _mm256_set1_ps(planes.ax[p]);
+        ay[p] = _mm256_set1_ps(planes.ay[p]);
+        az[p] = _mm256_set1_ps(planes.az[p]);
+    }
+    const __m256 zero = _mm256_setzero_ps();
+
+    uint32_t count = 0;
+    uint32_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 cx = _mm256_loadu_ps(input.centerX + i);
+        __m256 cy = _mm256_loadu_ps(input.centerY + i);
+        __m256 cz = _mm256_loadu_ps(input.centerZ + i);
+        __m256 ex = _mm256_loadu_ps(input.extentX + i);
+        __m256 ey = _mm256_loadu_ps(input.extentY + i);
+        __m256 ez = _mm256_loadu_ps(input.extentZ + i);
+        __m256 radius = _mm256_loadu_ps(input.radius + i);
+
+        __m256 outside = zero;
+        for (int p = 0; p < 6; p++) {
+            // no FMA on purpose, the results have to match the other kernels bit for bit
+            __m256 d = _mm256_add_ps(_mm256_mul_ps(nx[p], cx), _mm256_mul_ps(ny[p], cy));
+            d = _mm256_add_ps(_mm256_add_ps(d, _mm256_mul_ps(nz[p], cz)), w[p]);
+            __m256 box = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax[p], ex), _mm256_mul_ps(ay[p], ey)), _mm256_mul_ps(az[p], ez));
+            __m256 r = _mm256_min_ps(box, radius);
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, _mm256_sub_ps(zero, r), _CMP_LT_OQ));
+        }
+
+        uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_ps(outside));
+        for (uint32_t k = 0; k < 8; k++) {
+            visible[count] = i + k;
+            count += (mask >> k) & 1;
+        }
+    }
+    return count + cullScalar(input, planes, i, end, visible + count);
+}
+
+static bool cpuSupportsAVX2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    bool osSavesAVX = (info[2] & (1 << 27)) && (info[2] & (1 << 28));
+    if (!osSavesAVX || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+bool NanoFrustumCuller::IsKernelSupported(NanoCullingKernel kernel) {
+    switch (kernel) {
+    case NanoCullingKernel::AUTO:
+    case NanoCullingKernel::SCALAR:
+        return true;
+#ifdef NANO_CULLING_X86
+    case NanoCullingKernel::SSE:
+        return true; // part of x86-64
+    case NanoCullingKernel::AVX2: {
+        static const bool supported = cpuSupportsAVX2();
+        return supported;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+NanoCullingKernel NanoFrustumCuller::GetBestKernel() {
+    if (IsKernelSupported(NanoCullingKernel::AVX2)) {
+        return NanoCullingKernel::AVX2;
+    }
+    if (IsKernelSupported(NanoCullingKernel::SSE)) {
+        return NanoCullingKernel::SSE;
+    }
+    return NanoCullingKernel::SCALAR;
+}
+
+const char* NanoFrustumCuller::GetKernelName(NanoCullingKernel kernel) {
+    switch (kernel) {
+    case NanoCullingKernel::AUTO:
+        return "auto";
+    case NanoCullingKernel::SCALAR:
+        return "scalar";
+    case NanoCullingKernel::SSE:
+        return "sse";
+    case NanoCullingKernel::AVX2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+uint32_t NanoFrustumCuller::Cull(const NanoFrustum& frustum, uint32_t begin, uint32_t end, uint32_t* visibleIndices,
+                                 NanoCullingKernel kernel) const {
+    if (kernel == NanoCullingKernel::AUTO || !IsKernelSupported(kernel)) {
+        kernel = GetBestKernel();
+    }
+
+    CullingInput input{m_centerX.data(), m_centerY.data(), m_centerZ.data(), m_extentX.data(), m_extentY.data(), m_extentZ.data(), m_radius.data()};
+    CullingPlanes planes{};
+    for (int p = 0; p < 6; p++) {
+        planes.nx[p] = frustum.planes[p].x;
+        planes.ny[p] = frustum.planes[p].y;
+        planes.nz[p] = frustum.planes[p].z;
+        planes.w[p] = frustum.planes[p].w;
+        planes.ax[p] = std::abs(frustum.planes[p].x);
+        planes.ay[p] = std::abs(frustum.planes[p].y);
+        planes.az[p] = std::abs(frustum.planes[p].z);
+    }
+
+    switch (kernel) {
+#ifdef NANO_CULLING_X86
+    case NanoCullingKernel::AVX2:
+        return cullAVX2(input, planes, begin, end, visibleIndices);
+    case NanoCullingKernel::SSE:
+        return cullSSE(input, planes, begin, end, visibleIndices);
+#endif
+    default:
+        return cullScalar(input, planes, begin, end, visibleIndices);
+    }
+}
+
+uint32_t NanoFrustumCuller::Cull(const NanoFrustum& frustum, NanoJobSystem& jobSystem, NanoCullingKernel kernel) {
+    uint32_t count = GetCount();
+    uint32_t chunkCount = (count + PARALLEL_CHUNK - 1) / PARALLEL_CHUNK;
+    m_visible.resize(count);
+    m_chunkCounts.resize(chunkCount);
+
+    // every chunk writes to its own slice of the output first
+    jobSystem.ParallelFor(chunkCount, 1, [&](uint32_t chunkBegin, uint32_t chunkEnd) {
+        for (uint32_t chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+            uint32_t begin = chunk * PARALLEL_CHUNK;
+            uint32_t end = std::min(count, begin + PARALLEL_CHUNK);
+            m_chunkCounts[chunk] = Cull(frustum, begin, end, m_visible.data() + begin, kernel);
+        }
+    });
+
+    // then the slices are packed, moving at most the visible indices
+    uint32_t visibleCount = 0;
+    for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+        uint32_t begin = chunk * PARALLEL_CHUNK;
+        if (visibleCount != begin) {
+            memmove(m_visible.data() + visibleCount, m_visible.data() + begin, m_chunkCounts[chunk] * sizeof(uint32_t));
+        }
+        visibleCount += m_chunkCounts[chunk];
+    }
+    m_visibleCount = visibleCount;
+    return visibleCount;
+}
@@ -0,0 +1,72 @@
+#ifndef NANOFRUSTUMCULLER_H_
+#define NANOFRUSTUMCULLER_H_
+
+#include "NanoError.hpp"
+#include "NanoJobSystem.hpp"
+
+#include "glm/glm.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define NANO_CULLING_X86 1
+#endif
+
+struct NanoFrustum {
+    glm::vec4 planes[6]{}; // left, right, bottom, top, near, far. Normals point inside and are normalized
+
+    // Vulkan clip space, depth in [0, 1]
+    static NanoFrustum FromViewProjection(const glm::mat4& viewProjection);
+};
+
+enum class NanoCullingKernel {
+    AUTO, // widest kernel the CPU supports
+    SCALAR,
+    SSE,  // 4 objects per iteration
+    AVX2, // 8 objects per iteration
+};
+
+// World space bounds of every object as structure of arrays: box center, box half extents, and the radius of a bounding
+// sphere around the same center. For round objects the sphere is tighter than the box corners, for long thin ones the box
+// is, and each plane test simply uses whichever of the two is smaller. Culling writes the indices of the objects that
+// survived, in ascending order, so the list can go straight to command recording
+class NanoFrustumCuller {
+  public:
+    static constexpr uint32_t PARALLEL_CHUNK = 4096; // objects per job
+
+    void Resize(uint32_t count);
+    uint32_t GetCount() { return static_cast<uint32_t>(m_centerX.size()); }
+    // sphereRadius < 0 uses the sphere through the box corners, i.e. only the box matters
+    void SetBounds(uint32_t index, const glm::vec3& min, const glm::vec3& max, float sphereRadius = -1.0f);
+    // world space box of a transformed local box (Arvo), the sphere radius scales with the largest axis
+    void SetBounds(uint32_t index, const glm::mat4& world, const glm::vec3& localMin, const glm::vec3& localMax, float localSphereRadius = -1.0f);
+    void GetBounds(uint32_t index, glm::vec3& min, glm::vec3& max) const;
+
+    // [begin, end) on the calling thread. visibleIndices needs room for end - begin entries, returns how many were written
+    uint32_t Cull(const NanoFrustum& frustum, uint32_t begin, uint32_t end, uint32_t* visibleIndices,
+                  NanoCullingKernel kernel = NanoCullingKernel::AUTO) const;
+    // every object, in chunks over the job system. The result stays valid until the next call
+    uint32_t Cull(const NanoFrustum& frustum, NanoJobSystem& jobSystem, NanoCullingKernel kernel = NanoCullingKernel::AUTO);
+    const uint32_t* GetVisibleIndices() { return m_visible.data(); }
+    uint32_t GetVisibleCount() { return m_visibleCount; }
+
+    static bool IsKernelSupported(NanoCullingKernel kernel);
+    static NanoCullingKernel GetBestKernel();
+    static const char* GetKernelName(NanoCullingKernel kernel);
+
+  private:
+    std::vector<float> m_centerX{};
+    std::vector<float> m_centerY{};
+    std::vector<float> m_centerZ{};
+    std::vector<float> m_extentX{};
+    std::vector<float> m_extentY{};
+    std::vector<float> m_extentZ{};
+    std::vector<float> m_radius{};
+
+    std::vector<uint32_t> m_visible{};
+    std::vector<uint32_t> m_chunkCounts{};
+    uint32_t m_visibleCount = 0;
+};
+
+#endif // NANOFRUSTUMCULLER_H_
@@ -6,6 +6,18 @@
 #include "NanoWindow.hpp"
 #include "NanoShader.hpp"
 #include "NanoGraphicsPipeline.hpp"
+#include "NanoBindlessHeap.hpp"
+#include "NanoPipelineLayoutCache.hpp"
+#include "NanoStagingRing.hpp"
+#include "NanoOcclusionQueries.hpp"
+#include "NanoMeshArena.hpp"
+#include "NanoIndirectRenderer.hpp"
+#include "NanoSceneBuffer.hpp"
+#include "NanoRenderQueue.hpp"
+#include "NanoRenderGraph.hpp"
+#include "NanoBuffer.hpp"
+#include "NanoFrameCapture.hpp"
+#include "NanoProfiler.hpp"
 
 #include "vulkan/vulkan_core.h"
 #include <cstdint>
@@ -15,9 +27,11 @@
 #include <GLFW/glfw3.h>
 
 #include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <map>
 #include <set>
+#include <tuple>
 #include <vector>
 
 #define _CRT_SECURE_NO_WARNINGS
@@ -43,6 +57,21 @@ struct SwapchainDetails {
     VkExtent2D currentExtent;
 
     uint32_t imageCount;
+    VkImageUsageFlags imageUsage = 0; // transfer source when the surface allows it, frames can only be captured then
+};
+
+// what the GPU driven path needs from the device
+struct IndirectCapabilities {
+    bool supported = false;         // multi draw indirect and non zero firstInstance in indirect draws
+    bool drawIndirectCount = false; // VK_KHR_draw_indirect_count
+    uint32_t maxDrawIndirectCount = 0;
+};
+
+// what the GPU profiler can measure on the graphics queue
+struct ProfilerCapabilities {
+    uint32_t timestampValidBits = 0; // 0 when the queue has no timestamps
+    float timestampPeriod = 0.0f;    // ns per tick
+    bool pipelineStatistics = false;
 };
 
 struct SwapchainSyncObjects {
@@ -57,7 +86,6 @@ struct SwapchainContext{
     struct SwapchainDetails info {};
     std::vector<VkImage> images{};
     std::vector<VkImageView> imageViews{};
-    std::vector<VkFramebuffer> framebuffers;
 
     uint32_t currentFrame = 0;
     VkCommandBuffer commandBuffer[Config::MAX_FRAMES_IN_FLIGHT]{};
@@ -75,15 +103,90 @@ struct NanoVKContext {
 
     VkSurfaceKHR surface{};
 
+    // the frame's passes, barriers and framebuffers. renderpass is compatible with its main pass, pipelines are built against it
+    NanoRenderGraph renderGraph{};
+    NanoRGResource backbuffer = 0;
     VkRenderPass renderpass{};
+    // the depth attachment is a transient of the graph, recreated at the new extent along with the swapchain. UNDEFINED
+    // when the device supports none of the candidates, the main pass then has no depth
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+    NanoRGResource depth = 0;
+    VkRenderPass depthRenderpass{}; // depth only, for the pre-pass. VK_NULL_HANDLE when it's off
+
+    BindlessCapabilities bindlessCapabilities{};
+    bool conditionalRendering = false;
+    bool synchronization2 = false;
+    bool timelineSemaphores = false;
+    IndirectCapabilities indirectCapabilities{};
+    ProfilerCapabilities profilerCapabilities{};
+    NanoBindlessHeap bindlessHeap{};
+    NanoPipelineLayoutCache layoutCache{};
 
     std::vector<NanoGraphicsPipeline> graphicsPipelines{};
     NanoGraphicsPipeline* currentGraphicsPipeline{};
 
     VkCommandPool commandPool{};
 
+    NanoStagingRing stagingRing{};
+    NanoOcclusionQueries occlusionQueries{}; // one pool per frame in flight, next to the swapchain sync objects
+
+    // GPU driven path: every mesh is packed in the arena, arenaMeshes maps a mesh index to its arena mesh
+    NanoMeshArena meshArena{};
+    std::vector<uint32_t> arenaMeshes{};
+    std::vector<uint32_t> staticMeshes{};    // arena meshes AddStaticObjects merged
+    std::vector<uint32_t> staticInstances{}; // and the scene instances drawing them
+    NanoSceneBuffer sceneBuffer{}; // instances, only the ones that changed are uploaded each frame
+    NanoIndirectRenderer indirectRenderer{};
+    NanoShader cullShader{};
+    NanoShader indirectVertShader{};
+    NanoShader indirectFragShader{};
+    NanoShader depthVertShader{};
+    glm::mat4 viewProjection{1.0f};
+
+    // scene instances drawn through the render queue instead (AddQueuedInstance), with queued.vert. UINT32_MAX pipeline
+    // without the GPU driven path, the queued instances live in its scene buffer and mesh arena
+    NanoShader queuedVertShader{};
+    NanoGraphicsPipeline queuedPipeline{};
+    uint32_t queuedPipelineId = UINT32_MAX;
+    std::vector<uint32_t> queuedInstances{};
+    std::vector<uint32_t> queueMeshes{};             // render queue mesh per arena mesh, UINT32_MAX until one is queued
+    std::map<uint32_t, uint32_t> queueMaterials{};   // instance material -> render queue material
+
+    // scene instances big enough for a hardware occlusion query (OCCLUSION_QUERY_MIN_RADIUS). Their bounding boxes are
+    // queried after the depth pre-pass, with occlusion.vert, and the results come back as NANO_INSTANCE_OCCLUDED
+    NanoShader occlusionVertShader{};
+    NanoGraphicsPipeline occlusionPipeline{};
+    bool hasOcclusionPipeline = false;
+    std::vector<uint32_t> queryInstances{};  // query object -> instance
+    std::vector<uint32_t> instanceQueries{}; // instance -> query object, UINT32_MAX when it has none
+
+    // direct draws, sorted by state and batched into instanced draws every frame. The fullscreen triangle is one of them
+    NanoRenderQueue renderQueue{};
+    uint32_t trianglePipeline = UINT32_MAX;
+    uint32_t triangleMaterial = UINT32_MAX;
+    uint32_t triangleMesh = UINT32_MAX;
+
+    NanoShader vertShader{};
+    NanoShader fragShader{};
+
     SwapchainContext swapchainContext{};
 
+    // headless: no surface or swapchain, swapchainContext.images are engine owned and left in TRANSFER_SRC_OPTIMAL
+    bool headless = false;
+    std::vector<VkDeviceMemory> offscreenMemory{};
+    uint32_t offscreenImage = 0; // the next one to render to
+
+    // frame completion, see NanoGraphics::GetCompletedFrameCount
+    VkSemaphore frameTimeline{};
+    uint64_t submittedFrames = 0;
+    uint64_t completedFrames = 0; // highest frame seen done, fence fallback
+    uint64_t slotFrames[Config::MAX_FRAMES_IN_FLIGHT]{}; // frame last submitted with each in flight fence
+
+    NanoFrameCapture frameCapture{}; // between StartCapture and StopCapture
+    // engine owned, nullptr without one. CPU zones around the frame's stages, a GPU zone per render graph pass
+    NanoProfiler* profiler = nullptr;
+    NanoFrameTimings frameTimings{}; // last DrawFrame
+
     void AddGraphicsPipeline(const NanoGraphicsPipeline& graphicsPipeline){
         graphicsPipelines.push_back(std::move(graphicsPipeline));
         //for now use the last graphics pipeline we added as the current pipeline
@@ -161,10 +264,6 @@ static void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT
 }
 
 void cleanupSwapChainContext(const VkDevice& device, SwapchainContext& swapchainContext) {
-    for (auto framebuffer : swapchainContext.framebuffers) {
-        vkDestroyFramebuffer(device, framebuffer, nullptr);
-    }
-
     for (auto imageView : swapchainContext.imageViews) {
         vkDestroyImageView(device, imageView, nullptr);
     }
@@ -175,32 +274,58 @@ void cleanupSwapChainContext(const VkDevice& device, SwapchainContext& swapchain
 ERR NanoGraphics::CleanUp() {
     ERR err = ERR::OK;
 
+    StopCapture();
     vkDeviceWaitIdle(_NanoContext.device);
+    if (_NanoContext.profiler) {
+        _NanoContext.profiler->CleanUpGpu();
+    }
     for(int i = 0; i < Config::MAX_FRAMES_IN_FLIGHT; i++){
         vkDestroySemaphore(_NanoContext.device, _NanoContext.swapchainContext.syncObjects[i].imageAvailableSemaphore, nullptr);
         vkDestroySemaphore(_NanoContext.device, _NanoContext.swapchainContext.syncObjects[i].renderFinishedSemaphore, nullptr);
         vkDestroyFence(_NanoContext.device, _NanoContext.swapchainContext.syncObjects[i].inFlightFence, nullptr);
     }
+    vkDestroySemaphore(_NanoContext.device, _NanoContext.frameTimeline, nullptr);
 
     vkDestroyCommandPool(_NanoContext.device, _NanoContext.commandPool, nullptr);
 
-    for (auto framebuffer : _NanoContext.swapchainContext.framebuffers) {
-        vkDestroyFramebuffer(_NanoContext.device, framebuffer, nullptr);
-    }
+    _NanoContext.stagingRing.CleanUp();
+
+    _NanoContext.bindlessHeap.CleanUp();
+    _NanoContext.occlusionQueries.CleanUp();
+    _NanoContext.indirectRenderer.CleanUp();
+    _NanoContext.sceneBuffer.CleanUp();
+    _NanoContext.meshArena.CleanUp();
+
+    // framebuffers, transient images and the cached render passes (renderpass is one of them)
+    _NanoContext.renderGraph.CleanUp();
 
+    _NanoContext.renderQueue.CleanUp();
     for (auto& graphicsPipeline : _NanoContext.graphicsPipelines){
         graphicsPipeline.CleanUp();
     }
+    if (_NanoContext.hasOcclusionPipeline) {
+        _NanoContext.occlusionPipeline.CleanUp();
+    }
+    if (_NanoContext.queuedPipelineId != UINT32_MAX) {
+        _NanoContext.queuedPipeline.CleanUp();
+    }
 
-    vkDestroyRenderPass(_NanoContext.device, _NanoContext.renderpass, nullptr);
+    _NanoContext.layoutCache.CleanUp();
 
     for (auto& imageView : _NanoContext.swapchainContext.imageViews) {
         vkDestroyImageView(_NanoContext.device, imageView, nullptr);
     }
 
-    vkDestroySwapchainKHR(_NanoContext.device, _NanoContext.swapchainContext.swapchain, nullptr);
+    if (_NanoContext.headless) {
+        for (size_t i = 0; i < _NanoContext.offscreenMemory.size(); i++) {
+            vkDestroyImage(_NanoContext.device, _NanoContext.swapchainContext.images[i], nullptr);
+            vkFreeMemory(_NanoContext.device, _NanoContext.offscreenMemory[i], nullptr);
+        }
+    } else {
+        vkDestroySwapchainKHR(_NanoContext.device, _NanoContext.swapchainContext.swapchain, nullptr);
 
-    vkDestroySurfaceKHR(_NanoContext.instance, _NanoContext.surface, nullptr);
+        vkDestroySurfaceKHR(_NanoContext.instance, _NanoContext.surface, nullptr);
+    }
 
     vkDestroyDevice(_NanoContext.device, nullptr);
 
@@ -264,9 +389,12 @@ SwapchainDetails querySwapChainSupport(const VkPhysicalDevice device, const VkSu
 
 static std::vector<const char *> getRequiredInstanceExtensions() {
     uint32_t glfwExtensionCount = 0;
-    const char **glfwExtensions;
+    const char **glfwExtensions = nullptr;
 
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    // headless runs never initialize GLFW, there is no surface to create
+    if (!_NanoContext.headless) {
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    }
 
     // additional instance extension we may want to add
     std::vector<const char *> instanceExtensions;
@@ -320,7 +448,7 @@ static ERR createInstance(const char *applicationName, const char *engineName, V
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = engineName;
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = Config::VULKAN_API_VERSION;
 
     VkInstanceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -381,8 +509,11 @@ ERR findQueueFamilies(VkPhysicalDevice device, QueueFamilyIndices &indices) {
     for (int i = 0; i < queueFamilies.size(); i++) {
         if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
             indices.graphicsFamily = i;
-            VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, _NanoContext.surface, &presentSupport);
+            // nothing is presented headless, the graphics queue stands in for the present queue
+            VkBool32 presentSupport = _NanoContext.headless;
+            if (!_NanoContext.headless) {
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, _NanoContext.surface, &presentSupport);
+            }
             if (presentSupport)
                 indices.presentFamily = i;
         }
@@ -396,6 +527,11 @@ ERR findQueueFamilies(VkPhysicalDevice device, QueueFamilyIndices &indices) {
     return err;
 }
 
+// the swapchain extension is only required with a window
+static bool isRequiredDeviceExtension(const char *extensionName) {
+    return !_NanoContext.headless || strcmp(extensionName, VK_KHR_SWAPCHAIN_EXTENSION_NAME) != 0;
+}
+
 ERR checkDeviceExtensionSupport(VkPhysicalDevice device) {
     ERR err = ERR::OK;
     uint32_t extensionCount;
@@ -407,7 +543,9 @@ ERR checkDeviceExtensionSupport(VkPhysicalDevice device) {
     std::set<std::string> requiredExtensions{};
     int extIdx = 0;
     while (Config::desiredDeviceExtensions[extIdx]) {
-        requiredExtensions.emplace(std::string(Config::desiredDeviceExtensions[extIdx]));
+        if (isRequiredDeviceExtension(Config::desiredDeviceExtensions[extIdx])) {
+            requiredExtensions.emplace(std::string(Config::desiredDeviceExtensions[extIdx]));
+        }
         extIdx++;
     }
 
@@ -420,6 +558,176 @@ ERR checkDeviceExtensionSupport(VkPhysicalDevice device) {
     return err;
 }
 
+static bool isDeviceExtensionSupported(const VkPhysicalDevice &device, const char *extensionName) {
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+    for (const auto &extension : availableExtensions) {
+        if (strcmp(extension.extensionName, extensionName) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// descriptor indexing is core in 1.2, otherwise it needs VK_EXT_descriptor_indexing.
+// Fills the heap sizes for the bindless mode, clamped to what the device can bind in a single set.
+static BindlessCapabilities queryBindlessCapabilities(const VkPhysicalDevice &device) {
+    BindlessCapabilities capabilities{};
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+    const VkPhysicalDeviceLimits &limits = deviceProperties.limits;
+    capabilities.maxSampledImages = std::min({Config::BINDLESS_FALLBACK_MAX_SAMPLED_IMAGES, limits.maxPerStageDescriptorSampledImages,
+                                              limits.maxDescriptorSetSampledImages});
+    capabilities.maxSamplers = std::min({Config::BINDLESS_FALLBACK_MAX_SAMPLERS, limits.maxPerStageDescriptorSamplers, limits.maxDescriptorSetSamplers});
+    capabilities.maxStorageBuffers = std::min({Config::BINDLESS_FALLBACK_MAX_STORAGE_BUFFERS, limits.maxPerStageDescriptorStorageBuffers,
+                                               limits.maxDescriptorSetStorageBuffers});
+
+    bool apiSupportsFeatures2 = deviceProperties.apiVersion >= VK_API_VERSION_1_1;
+    bool descriptorIndexingAvailable =
+        deviceProperties.apiVersion >= VK_API_VERSION_1_2 || isDeviceExtensionSupported(device, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    if (!apiSupportsFeatures2 || !descriptorIndexingAvailable) {
+        return capabilities;
+    }
+
+    VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+    VkPhysicalDeviceFeatures2 deviceFeatures2{};
+    deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    deviceFeatures2.pNext = &indexingFeatures;
+    vkGetPhysicalDeviceFeatures2(device, &deviceFeatures2);
+
+    capabilities.descriptorIndexing = indexingFeatures.runtimeDescriptorArray && indexingFeatures.descriptorBindingPartiallyBound &&
+                                      indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+                                      indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind &&
+                                      indexingFeatures.shaderSampledImageArrayNonUniformIndexing;
+    if (!capabilities.descriptorIndexing) {
+        return capabilities;
+    }
+
+    VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+    indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 deviceProperties2{};
+    deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    deviceProperties2.pNext = &indexingProperties;
+    vkGetPhysicalDeviceProperties2(device, &deviceProperties2);
+
+    capabilities.maxSampledImages = std::min({Config::BINDLESS_MAX_SAMPLED_IMAGES, indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                                              indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages});
+    capabilities.maxSamplers = std::min({Config::BINDLESS_MAX_SAMPLERS, indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+                                         indexingProperties.maxDescriptorSetUpdateAfterBindSamplers});
+    capabilities.maxStorageBuffers = std::min({Config::BINDLESS_MAX_STORAGE_BUFFERS, indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+                                               indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers});
+
+    return capabilities;
+}
+
+static bool queryConditionalRendering(const VkPhysicalDevice &device) {
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    if (deviceProperties.apiVersion < VK_API_VERSION_1_1 || !isDeviceExtensionSupported(device, VK_EXT_CONDITIONAL_RENDERING_EXTENSION_NAME)) {
+        return false;
+    }
+
+    VkPhysicalDeviceConditionalRenderingFeaturesEXT conditionalRenderingFeatures{};
+    conditionalRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_CONDITIONAL_RENDERING_FEATURES_EXT;
+
+    VkPhysicalDeviceFeatures2 deviceFeatures2{};
+    deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    deviceFeatures2.pNext = &conditionalRenderingFeatures;
+    vkGetPhysicalDeviceFeatures2(device, &deviceFeatures2);
+    return conditionalRenderingFeatures.conditionalRendering;
+}
+
+static bool querySynchronization2(const VkPhysicalDevice &device) {
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    if (deviceProperties.apiVersion < VK_API_VERSION_1_1 || !isDeviceExtensionSupported(device, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME)) {
+        return false;
+    }
+
+    VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features{};
+    synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+
+    VkPhysicalDeviceFeatures2 deviceFeatures2{};
+    deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    deviceFeatures2.pNext = &synchronization2Features;
+    vkGetPhysicalDeviceFeatures2(device, &deviceFeatures2);
+    return synchronization2Features.synchronization2;
+}
+
+static bool queryTimelineSemaphores(const VkPhysicalDevice &device) {
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    if (deviceProperties.apiVersion < VK_API_VERSION_1_2) {
+        return false;
+    }
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+
+    VkPhysicalDeviceFeatures2 deviceFeatures2{};
+    deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    deviceFeatures2.pNext = &timelineFeatures;
+    vkGetPhysicalDeviceFeatures2(device, &deviceFeatures2);
+    return timelineFeatures.timelineSemaphore;
+}
+
+static IndirectCapabilities queryIndirectCapabilities(const VkPhysicalDevice &device) {
+    IndirectCapabilities capabilities{};
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    VkPhysicalDeviceFeatures deviceFeatures;
+    vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+
+    capabilities.supported = deviceFeatures.multiDrawIndirect && deviceFeatures.drawIndirectFirstInstance;
+    capabilities.drawIndirectCount = isDeviceExtensionSupported(device, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    capabilities.maxDrawIndirectCount = deviceProperties.limits.maxDrawIndirectCount;
+    return capabilities;
+}
+
+static ProfilerCapabilities queryProfilerCapabilities(const VkPhysicalDevice &device, int32_t graphicsFamily) {
+    ProfilerCapabilities capabilities{};
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    VkPhysicalDeviceFeatures deviceFeatures;
+    vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+
+    if (graphicsFamily >= 0 && static_cast<uint32_t>(graphicsFamily) < queueFamilyCount) {
+        capabilities.timestampValidBits = queueFamilies[graphicsFamily].timestampValidBits;
+    }
+    capabilities.timestampPeriod = deviceProperties.limits.timestampPeriod;
+    capabilities.pipelineStatistics = deviceFeatures.pipelineStatisticsQuery;
+    return capabilities;
+}
+
+// first one usable as an optimal tiling depth attachment, no stencil needed so the plain 32 bit float comes first
+static VkFormat findDepthFormat(const VkPhysicalDevice &device) {
+    const VkFormat candidates[] = {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT};
+    for (VkFormat format : candidates) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(device, format, &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+            return format;
+        }
+    }
+    LOG_MSG(ERRLevel::WARNING, "no supported depth format, rendering without a depth buffer");
+    return VK_FORMAT_UNDEFINED;
+}
+
 int rateDeviceSuitability(const VkPhysicalDevice &device, const VkSurfaceKHR &surface, QueueFamilyIndices &queueIndices) {
     VkPhysicalDeviceProperties deviceProperties;
     vkGetPhysicalDeviceProperties(device, &deviceProperties);
@@ -446,6 +754,15 @@ int rateDeviceSuitability(const VkPhysicalDevice &device, const VkSurfaceKHR &su
         fprintf(stderr, "No Tesselation shader support found\n");
     }
 
+    // Bindless rendering works without it (per frame fallback), but update-after-bind saves a lot of descriptor work
+    if (Config::enableBindless) {
+        if (queryBindlessCapabilities(device).descriptorIndexing) {
+            score += 500;
+        } else {
+            fprintf(stderr, "No descriptor indexing support found. bindless heap will use the fallback path\n");
+        }
+    }
+
     // Application can't function without the required device extensions
     bool extensionsSupported = ERR::OK == checkDeviceExtensionSupport(device);
     if (!extensionsSupported) {
@@ -454,7 +771,7 @@ int rateDeviceSuitability(const VkPhysicalDevice &device, const VkSurfaceKHR &su
     }
 
     bool swapchainAdequate = false;
-    if (extensionsSupported) {
+    if (extensionsSupported && !_NanoContext.headless) {
         SwapchainDetails swapchainSupport = querySwapChainSupport(device, surface);
         swapchainAdequate = !swapchainSupport.formats.empty() && !swapchainSupport.presentModes.empty();
         if (!swapchainAdequate) {
@@ -565,11 +882,67 @@ ERR createLogicalDevice(VkPhysicalDevice &physicalDevice, QueueFamilyIndices &in
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 
-    VkPhysicalDeviceFeatures deviceFeatures{}; // defaults all the features to false for now
+    VkPhysicalDeviceFeatures deviceFeatures{}; // everything off but what the optional paths need
+    if (Config::enableIndirectRendering && _NanoContext.indirectCapabilities.supported) {
+        deviceFeatures.multiDrawIndirect = VK_TRUE;
+        deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+    }
+    if (_NanoContext.profiler && Config::enableGpuProfiler && Config::enablePipelineStatistics &&
+        _NanoContext.profilerCapabilities.pipelineStatistics) {
+        deviceFeatures.pipelineStatisticsQuery = VK_TRUE;
+    }
     createInfo.pEnabledFeatures = &deviceFeatures;
 
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(Utility::SizeOf(Config::desiredDeviceExtensions));
-    createInfo.ppEnabledExtensionNames = Config::desiredDeviceExtensions;
+    // required extensions first, then the optional ones the device actually exposes
+    std::vector<const char *> deviceExtensions{};
+    int extIdx = 0;
+    while (Config::desiredDeviceExtensions[extIdx]) {
+        if (isRequiredDeviceExtension(Config::desiredDeviceExtensions[extIdx])) {
+            deviceExtensions.push_back(Config::desiredDeviceExtensions[extIdx]);
+        }
+        extIdx++;
+    }
+    extIdx = 0;
+    while (Config::optionalDeviceExtensions[extIdx]) {
+        if (isDeviceExtensionSupported(physicalDevice, Config::optionalDeviceExtensions[extIdx])) {
+            deviceExtensions.push_back(Config::optionalDeviceExtensions[extIdx]);
+        }
+        extIdx++;
+    }
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+
+    VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    if (Config::enableBindless && _NanoContext.bindlessCapabilities.descriptorIndexing) {
+        indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+        indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+        indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        createInfo.pNext = &indexingFeatures;
+    }
+    VkPhysicalDeviceConditionalRenderingFeaturesEXT conditionalRenderingFeatures{};
+    conditionalRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_CONDITIONAL_RENDERING_FEATURES_EXT;
+    if (Config::enableConditionalRendering && _NanoContext.conditionalRendering) {
+        conditionalRenderingFeatures.conditionalRendering = VK_TRUE;
+        conditionalRenderingFeatures.pNext = const_cast<void *>(createInfo.pNext);
+        createInfo.pNext = &conditionalRenderingFeatures;
+    }
+    VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features{};
+    synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+    if (Config::enableSynchronization2 && _NanoContext.synchronization2) {
+        synchronization2Features.synchronization2 = VK_TRUE;
+        synchronization2Features.pNext = const_cast<void *>(createInfo.pNext);
+        createInfo.pNext = &synchronization2Features;
+    }
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    if (Config::enableTimelineSemaphores && _NanoContext.timelineSemaphores) {
+        timelineFeatures.timelineSemaphore = VK_TRUE;
+        timelineFeatures.pNext = const_cast<void *>(createInfo.pNext);
+        createInfo.pNext = &timelineFeatures;
+    }
     if (Config::enableValidationLayers) {
         createInfo.enabledLayerCount = static_cast<uint32_t>(Utility::SizeOf(Config::desiredValidationLayers));
         createInfo.ppEnabledLayerNames = Config::desiredValidationLayers;
@@ -665,29 +1038,6 @@ ERR createSCImageViews(const VkDevice &device, SwapchainContext& swapchainContex
     return err;
 }
 
-ERR createFramebuffer(const VkDevice& device, const VkRenderPass& renderpass, SwapchainContext& swapchainContext){
-    ERR err = ERR::OK;
-    swapchainContext.framebuffers.resize(swapchainContext.info.imageCount);
-
-    for (size_t i = 0; i < swapchainContext.imageViews.size(); i++) {
-        VkImageView attachments[] = {swapchainContext.imageViews[i]};
-
-        VkFramebufferCreateInfo framebufferInfo{};
-        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferInfo.renderPass = renderpass;
-        framebufferInfo.attachmentCount = 1;
-        framebufferInfo.pAttachments = attachments;
-        framebufferInfo.width = swapchainContext.info.currentExtent.width;
-        framebufferInfo.height = swapchainContext.info.currentExtent.height;
-        framebufferInfo.layers = 1;
-
-        if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapchainContext.framebuffers[i]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create framebuffer!");
-        }
-    }
-    return err;
-}
-
 ERR createSwapchain(const VkPhysicalDevice &physicalDevice, const VkDevice &device, GLFWwindow *window, const VkSurfaceKHR &surface, SwapchainContext& swapchainContext) {
     ERR err = ERR::OK;
     swapchainContext.info = querySwapChainSupport(physicalDevice, surface);
@@ -711,7 +1061,10 @@ ERR createSwapchain(const VkPhysicalDevice &physicalDevice, const VkDevice &devi
     createInfo.imageColorSpace = swapchainContext.info.selectedFormat.colorSpace;
     createInfo.imageExtent = swapchainContext.info.currentExtent;
     createInfo.imageArrayLayers = 1;
-    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    // frame capture copies out of the swapchain images
+    swapchainContext.info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                       (swapchainContext.info.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    createInfo.imageUsage = swapchainContext.info.imageUsage;
 
     QueueFamilyIndices indices = {};
     err = findQueueFamilies(physicalDevice, indices);
@@ -753,8 +1106,52 @@ ERR createSwapchain(const VkPhysicalDevice &physicalDevice, const VkDevice &devi
     return err;
 }
 
+// headless stand in for the swapchain. The same fields are filled, the pipelines and the render graph can't tell the difference
+ERR createOffscreenImages(const VkPhysicalDevice &physicalDevice, const VkDevice &device, const VkExtent2D &extent, SwapchainContext& swapchainContext,
+                          std::vector<VkDeviceMemory>& memory) {
+    ERR err = ERR::OK;
+    swapchainContext.info.selectedFormat = {Config::HEADLESS_FORMAT, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+    swapchainContext.info.currentExtent = extent;
+    swapchainContext.info.imageCount = Config::HEADLESS_IMAGE_COUNT;
+    swapchainContext.info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT; // copied out to read the frame back
+    swapchainContext.images.resize(Config::HEADLESS_IMAGE_COUNT);
+    memory.resize(Config::HEADLESS_IMAGE_COUNT);
+
+    for (uint32_t i = 0; i < Config::HEADLESS_IMAGE_COUNT; i++) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = Config::HEADLESS_FORMAT;
+        imageInfo.extent = {extent.width, extent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = swapchainContext.info.imageUsage;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        if (vkCreateImage(device, &imageInfo, nullptr, &swapchainContext.images[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create offscreen image!");
+        }
+
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(device, swapchainContext.images[i], &requirements);
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = requirements.size;
+        allocInfo.memoryTypeIndex = FindMemoryType(physicalDevice, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if (vkAllocateMemory(device, &allocInfo, nullptr, &memory[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate offscreen image memory!");
+        }
+        vkBindImageMemory(device, swapchainContext.images[i], memory[i], 0);
+    }
+
+    LOG_MSG(ERRLevel::INFO, "headless: %d offscreen images of %dx%d", Config::HEADLESS_IMAGE_COUNT, extent.width, extent.height);
+    return err;
+}
 
-ERR recreateSwapchain(const VkPhysicalDevice &physicalDevice, const VkDevice &device, GLFWwindow *window, const VkSurfaceKHR &surface, SwapchainContext& swapChainContext, const VkRenderPass& renderpass){
+ERR recreateSwapchain(const VkPhysicalDevice &physicalDevice, const VkDevice &device, GLFWwindow *window, const VkSurfaceKHR &surface, SwapchainContext& swapChainContext,
+                       NanoRenderGraph& renderGraph, NanoRGResource backbuffer){
     ERR err = ERR::OK;
     vkDeviceWaitIdle(device);
 
@@ -767,9 +1164,9 @@ ERR recreateSwapchain(const VkPhysicalDevice &physicalDevice, const VkDevice &de
     err = createSCImageViews(device,
                              swapChainContext);
 
-    err = createFramebuffer(device,
-                            renderpass,
-                            swapChainContext);
+    // the graph rebuilds its framebuffers and transient images on the next Execute
+    renderGraph.SetImportedImages(backbuffer, swapChainContext.images, swapChainContext.imageViews);
+    renderGraph.SetExtent(swapChainContext.info.currentExtent);
 
     return err;
 }
@@ -779,66 +1176,212 @@ ERR createGraphicsPipeline(VkDevice& device,const SwapchainDetails& swapchainDet
     ERR err = ERR::OK;
 
     graphicsPipeline.Init(device, swapchainDetails.currentExtent);
-    graphicsPipeline.AddVertShader("./src/shader/shader.vert");
-    graphicsPipeline.AddFragShader("./src/shader/shader.frag");
+    // compiled to SPIR-V by their own init tasks, only the modules are left to create
+    graphicsPipeline.AddVertShader(_NanoContext.vertShader);
+    graphicsPipeline.AddFragShader(_NanoContext.fragShader);
+    // the triangle is an overlay, no depth state: drawn over whatever the main pass has
     graphicsPipeline.AddRenderPass(renderpass);
+    graphicsPipeline.AddLayoutCache(_NanoContext.layoutCache);
+    if (_NanoContext.bindlessHeap.IsInit()) {
+        graphicsPipeline.AddDescriptorSetLayout(Config::BINDLESS_SET_INDEX, _NanoContext.bindlessHeap.GetDescriptorSetLayout());
+        graphicsPipeline.AddPushConstantRange(NanoBindlessHeap::GetPushConstantRange());
+    }
     graphicsPipeline.Compile();
 
     return err;
 }
 
-// renderpass with at least one color attachment
-ERR createRenderPass(VkDevice& device, const SwapchainDetails& swapchainDetails, VkRenderPass& renderpass){
-    ERR err = ERR::OK;
+// passes of the render queue, recorded in this order in the main pass
+static constexpr uint32_t QUEUE_PASS_OVERLAY = 0; // before the GPU driven draws, the fullscreen triangle
+static constexpr uint32_t QUEUE_PASS_SCENE = 1;   // after them, the queued instances are depth tested against what they left
+
+// arena meshes drawn through the render queue, shaded like the GPU driven path. The render queue's per instance input
+// is the scene buffer entry each draw reads
+static ERR createQueuedPipeline(){
+    NanoGraphicsPipeline& pipeline = _NanoContext.queuedPipeline;
+    pipeline.Init(_NanoContext.device, _NanoContext.swapchainContext.info.currentExtent);
+    pipeline.AddVertShader(_NanoContext.queuedVertShader);
+    pipeline.AddFragShader(_NanoContext.indirectFragShader);
+    pipeline.AddRenderPass(_NanoContext.renderpass);
+    pipeline.AddLayoutCache(_NanoContext.layoutCache);
+    pipeline.AddDescriptorSetLayout(Config::BINDLESS_SET_INDEX, _NanoContext.bindlessHeap.GetDescriptorSetLayout());
+    pipeline.AddPushConstantRange(NanoBindlessHeap::GetPushConstantRange());
+    pipeline.AddInstanceInputs(3);
+    pipeline.AddDepthState(VK_COMPARE_OP_LESS, true);
+    ERR err = pipeline.Compile();
+    if (err != ERR::OK) {
+        pipeline.CleanUp();
+        return err;
+    }
+    _NanoContext.queuedPipelineId = _NanoContext.renderQueue.AddPipeline(pipeline.GetPipeline(), pipeline.GetPipelineLayout());
+    return ERR::OK;
+}
+
+// LOD 0, the render queue draws are not LOD selected
+static NanoQueueMesh makeQueueMesh(uint32_t arenaMesh){
+    const NanoGPUMesh& mesh = _NanoContext.meshArena.GetMesh(arenaMesh);
+    NanoQueueMesh queueMesh{};
+    queueMesh.vertexBuffer = _NanoContext.meshArena.GetVertexBuffer().GetBuffer();
+    queueMesh.indexBuffer = _NanoContext.meshArena.GetIndexBuffer().GetBuffer();
+    queueMesh.count = mesh.lods[0].indexCount;
+    queueMesh.firstIndex = mesh.lods[0].indexOffset;
+    queueMesh.vertexOffset = mesh.vertexOffset;
+    return queueMesh;
+}
 
-    VkAttachmentDescription colorAttachment{};
-    colorAttachment.format = swapchainDetails.selectedFormat.format;
-    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-    VkAttachmentReference colorAttachmentRef{};
-    colorAttachmentRef.attachment = 0;
-    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    // The following other types of attachments can be referenced by a subpass:
-    // pInputAttachments: Attachments that are read from a shader
-    // pResolveAttachments: Attachments used for multisampling color attachments
-    // pDepthStencilAttachment: Attachment for depth and stencil data
-    // pPreserveAttachments: Attachments that are not used by this subpass, but for which the data must be preserved
-    VkSubpassDescription subpass{};
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &colorAttachmentRef; // always add the reference to the attachment and never the attachment itself
-    // The index of the attachment in this array is directly referenced from the fragment shader with the layout(location = 0) out vec4 outColor directive!
-
-    // subpass synchronization with swapchain images state
-    VkSubpassDependency dependency{};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0; //The dstSubpass is our one and only subpass (for now). it must always be higher than srcSubpass to prevent cycles in the dependency graph (unless one of the subpasses is VK_SUBPASS_EXTERNAL)
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-    VkRenderPassCreateInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = 1;
-    renderPassInfo.pAttachments = &colorAttachment;
-    renderPassInfo.subpassCount = 1;
-    renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
-
-    if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderpass) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create render pass!");
+// one render queue material per instance material, so batching merges exactly the draws sharing both
+static uint32_t getQueueMaterial(uint32_t material){
+    auto queueMaterial = _NanoContext.queueMaterials.find(material);
+    if (queueMaterial != _NanoContext.queueMaterials.end()) {
+        return queueMaterial->second;
     }
+    NanoMaterialIndices indices{};
+    indices.storageBuffer = _NanoContext.indirectRenderer.GetInstanceSlot();
+    uint32_t id = _NanoContext.renderQueue.AddMaterial(indices);
+    if (id != UINT32_MAX) {
+        _NanoContext.queueMaterials[material] = id;
+    }
+    return id;
+}
 
-    return err;
+// every queued instance the CPU culling stage kept. The render queue sorts them front to back and merges the ones
+// sharing a mesh and a material into instanced draws
+static void submitQueuedInstances(){
+    const glm::mat4& viewProjection = _NanoContext.viewProjection;
+    glm::vec4 rowW(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+    for (uint32_t instance : _NanoContext.queuedInstances) {
+        const NanoGPUInstance& data = _NanoContext.sceneBuffer.Get(instance);
+        // a removed slot may have been handed out again, to an instance of the GPU driven path
+        if ((data.flags & (NANO_INSTANCE_HIDDEN | NANO_INSTANCE_REMOVED | NANO_INSTANCE_OCCLUDED)) || !(data.flags & NANO_INSTANCE_QUEUED) ||
+            _NanoContext.meshArena.GetMesh(data.mesh).lodCount == 0) {
+            continue;
+        }
+        uint32_t material = getQueueMaterial(data.material);
+        if (material == UINT32_MAX) {
+            continue;
+        }
+        // clip space w is the distance along the view direction
+        float viewDepth = glm::dot(rowW, data.world[3]);
+        _NanoContext.renderQueue.Submit(QUEUE_PASS_SCENE, _NanoContext.queuedPipelineId, material, _NanoContext.queueMeshes[data.mesh],
+                                        std::max(viewDepth, 0.0f), false, instance);
+    }
+}
+
+// same as cull.comp: the sphere scales with the largest axis
+static bool getInstanceSphere(uint32_t instance, glm::vec3& center, float& radius){
+    NanoSceneBuffer& sceneBuffer = _NanoContext.sceneBuffer;
+    if (!sceneBuffer.IsInit() || instance >= sceneBuffer.GetCount() || sceneBuffer.IsRemoved(instance)) {
+        return false;
+    }
+    const NanoGPUInstance& data = sceneBuffer.Get(instance);
+    const NanoGPUMesh& mesh = _NanoContext.meshArena.GetMesh(data.mesh);
+    if (mesh.lodCount == 0) {
+        return false;
+    }
+    center = glm::vec3(data.world * glm::vec4(mesh.boundsCenter[0], mesh.boundsCenter[1], mesh.boundsCenter[2], 1.0f));
+    float scale = glm::max(glm::max(glm::length(glm::vec3(data.world[0])), glm::length(glm::vec3(data.world[1]))),
+                           glm::length(glm::vec3(data.world[2])));
+    radius = mesh.boundsRadius * scale;
+    return true;
+}
+
+// bounding boxes of the occlusion queries, tested against the pre-pass's depth without writing it. LESS_OR_EQUAL: a
+// visible instance's box is never behind what its own front faces left
+static ERR createOcclusionPipeline(){
+    NanoGraphicsPipeline& pipeline = _NanoContext.occlusionPipeline;
+    pipeline.Init(_NanoContext.device, _NanoContext.swapchainContext.info.currentExtent);
+    pipeline.AddVertShader(_NanoContext.occlusionVertShader);
+    pipeline.AddRenderPass(_NanoContext.depthRenderpass);
+    pipeline.AddLayoutCache(_NanoContext.layoutCache);
+    pipeline.AddDepthState(VK_COMPARE_OP_LESS_OR_EQUAL, false);
+    pipeline.AddCullMode(VK_CULL_MODE_NONE);
+    ERR err = pipeline.Compile();
+    if (err != ERR::OK) {
+        pipeline.CleanUp();
+        return err;
+    }
+    _NanoContext.hasOcclusionPipeline = true;
+    return ERR::OK;
+}
+
+// instances whose bounding sphere is big enough get a query object, once. Objects are never unregistered, the ones
+// that shrank or whose slot was removed are simply not queried
+static void registerQueryInstance(uint32_t instance){
+    glm::vec3 center{};
+    float radius = 0.0f;
+    if (!_NanoContext.hasOcclusionPipeline || !getInstanceSphere(instance, center, radius) || radius < Config::OCCLUSION_QUERY_MIN_RADIUS) {
+        return;
+    }
+    if (instance >= _NanoContext.instanceQueries.size()) {
+        _NanoContext.instanceQueries.resize(instance + 1, UINT32_MAX);
+    }
+    if (_NanoContext.instanceQueries[instance] != UINT32_MAX) {
+        return;
+    }
+    _NanoContext.instanceQueries[instance] = static_cast<uint32_t>(_NanoContext.queryInstances.size());
+    _NanoContext.queryInstances.push_back(instance);
+    _NanoContext.occlusionQueries.Resize(static_cast<uint32_t>(_NanoContext.queryInstances.size()));
+}
+
+// a box partly in front of the near plane is clipped, it could come back with no samples while the camera is inside it
+static bool crossesNearPlane(const glm::mat4& boxToClip){
+    for (uint32_t corner = 0; corner < 8; corner++) {
+        glm::vec4 position((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f, 1.0f);
+        glm::vec4 clip = boxToClip * position;
+        if (clip.w <= 0.0f || clip.z < 0.0f) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// the "occlusion queries" pass, after the depth pre-pass: the box of every registered instance NeedsQuery picks, each
+// in its own query. Instances the CPU culled aren't queried, they show up right away once it lets them through
+static void recordOcclusionQueries(VkCommandBuffer& commandBuffer){
+    if (_NanoContext.queryInstances.empty()) {
+        return;
+    }
+    NanoOcclusionQueries& queries = _NanoContext.occlusionQueries;
+    NanoGraphicsPipeline& pipeline = _NanoContext.occlusionPipeline;
+    VkShaderStageFlags stages = pipeline.GetReflection().pushConstantRanges[0].stageFlags;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.GetPipeline());
+    for (uint32_t object = 0; object < _NanoContext.queryInstances.size(); object++) {
+        uint32_t instance = _NanoContext.queryInstances[object];
+        glm::vec3 center{};
+        float radius = 0.0f;
+        if (!getInstanceSphere(instance, center, radius) || radius < Config::OCCLUSION_QUERY_MIN_RADIUS ||
+            (_NanoContext.sceneBuffer.Get(instance).flags & NANO_INSTANCE_HIDDEN)) {
+            queries.MarkVisible(object);
+            continue;
+        }
+        glm::mat4 box(radius);
+        box[3] = glm::vec4(center, 1.0f);
+        glm::mat4 boxToClip = _NanoContext.viewProjection * box;
+        if (crossesNearPlane(boxToClip)) {
+            queries.MarkVisible(object);
+            continue;
+        }
+        if (!queries.NeedsQuery(object) || !queries.BeginQuery(commandBuffer, object)) {
+            continue;
+        }
+        vkCmdPushConstants(commandBuffer, pipeline.GetPipelineLayout(), stages, 0, sizeof(glm::mat4), &boxToClip);
+        vkCmdDraw(commandBuffer, 36, 1, 0, 0);
+        queries.EndQuery(commandBuffer);
+    }
+}
+
+// the results BeginFrame just read are MAX_FRAMES_IN_FLIGHT frames old. The GPU culling skips the occluded instances,
+// their boxes keep being queried every frame until one comes back with samples
+static void applyOcclusionResults(){
+    for (uint32_t object = 0; object < _NanoContext.queryInstances.size(); object++) {
+        uint32_t instance = _NanoContext.queryInstances[object];
+        uint32_t flags = _NanoContext.sceneBuffer.Get(instance).flags;
+        if (flags & NANO_INSTANCE_REMOVED) {
+            continue;
+        }
+        bool occluded = !_NanoContext.occlusionQueries.IsVisible(object);
+        _NanoContext.sceneBuffer.SetFlags(instance, occluded ? flags | NANO_INSTANCE_OCCLUDED : flags & ~NANO_INSTANCE_OCCLUDED);
+    }
 }
 
 ERR createCommandPool(VkDevice& device, const QueueFamilyIndices& queueFamilyIndices, VkCommandPool& commandPool){
@@ -875,7 +1418,7 @@ ERR createCommandBuffer(VkDevice& device, const VkCommandPool& commandPool, VkCo
     return err;
 }
 
-ERR recordCommandBuffer(NanoGraphicsPipeline& graphicsPipeline, VkFramebuffer& swapchainFrameBufferToWriteTo, VkCommandBuffer& commandBuffer) {
+ERR recordCommandBuffer(VkCommandBuffer& commandBuffer, uint32_t imageIndex) {
     ERR err = ERR::OK;
 
     VkCommandBufferBeginInfo beginInfo{};
@@ -887,40 +1430,18 @@ ERR recordCommandBuffer(NanoGraphicsPipeline& graphicsPipeline, VkFramebuffer& s
         throw std::runtime_error("failed to begin recording command buffer!");
     }
 
-    VkRenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = graphicsPipeline.GetRenderPass();
-    renderPassInfo.framebuffer = swapchainFrameBufferToWriteTo;
-
-    renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = graphicsPipeline.GetExtent();
-
-    VkClearValue clearColor = {{{0.02f, 0.02f, 0.02f, 1.0f}}};
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
-
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline.GetPipeline());
-
-        // need to manually set the viewport and scissor here because we defined them as dynamic.
-        VkViewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = static_cast<float>(graphicsPipeline.GetExtent().width);
-        viewport.height = static_cast<float>(graphicsPipeline.GetExtent().height);
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-
-        VkRect2D scissor{};
-        scissor.offset = {0, 0};
-        scissor.extent = graphicsPipeline.GetExtent();
-        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-        vkCmdDraw(commandBuffer, 3, 1, 0, 0);
-
-        vkCmdEndRenderPass(commandBuffer);
+    // query pools can only be reset outside of a render pass
+    _NanoContext.occlusionQueries.RecordFrameStart(commandBuffer);
+    if (_NanoContext.profiler) {
+        _NanoContext.profiler->RecordGpuFrameStart(commandBuffer);
+    }
+    // scene upload, culling and the main pass, with the barriers between them
+    _NanoContext.renderGraph.Execute(commandBuffer, imageIndex);
+    // the graph left the image in its final layout, the copy puts it back there
+    _NanoContext.frameCapture.RecordCopy(commandBuffer,
+                                         _NanoContext.swapchainContext.images[imageIndex],
+                                         _NanoContext.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                         _NanoContext.swapchainContext.info.currentExtent);
 
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
         throw std::runtime_error("failed to record command buffer!");
@@ -953,118 +1474,807 @@ ERR createSwapchainSyncObjects(VkDevice& device ,SwapchainSyncObjects* syncObjec
     return err;
 }
 
-ERR NanoGraphics::Init(NanoWindow &window) {
+// counts finished frames, every submit signals it with its frame number
+ERR createFrameTimeline(VkDevice& device, VkSemaphore& timeline){
     ERR err = ERR::OK;
-    // Here the err validation is not that useful
-    // a iferr_return can be added at the end of each statement to check it's state and exit (or at least warn) if an error did occur
-    err = createInstance(Config::APP_NAME,
-                         Config::ENGINE_NAME,
-                         _NanoContext.instance); // APP_NAME and ENGINE_NAME is defined in NanoConfig
-
-    err = setupDebugMessenger(_NanoContext.instance,
-                              debugMessenger); // this depends on whether we are running in debug or not
-
-    err = createSurface(_NanoContext.instance,
-                        window.getGLFWwindow(),
-                        _NanoContext.surface);
-
-    err = pickPhysicalDevice(_NanoContext.instance,
-                             _NanoContext.surface,
-                             _NanoContext.queueIndices,
-                             _NanoContext.physicalDevice); // physical device is not created but picked based on scores dictated by the number of supported features
-
-    err = createLogicalDevice(_NanoContext.physicalDevice,
-                              _NanoContext.queueIndices,
-                              _NanoContext.presentQueue,
-                              _NanoContext.graphicsQueue,
-                              _NanoContext.device); // Logical device *is* created and therefore has to be destroyed
-
-    err = createSwapchain(_NanoContext.physicalDevice,
-                          _NanoContext.device,
-                          window.getGLFWwindow(),
-                          _NanoContext.surface,
-                          _NanoContext.swapchainContext);
 
-    err = createSCImageViews(_NanoContext.device,
-                             _NanoContext.swapchainContext);
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
 
-    err = createRenderPass(_NanoContext.device,
-                           _NanoContext.swapchainContext.info,
-                           _NanoContext.renderpass);
+    if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create the frame timeline semaphore!");
+    }
 
-    NanoGraphicsPipeline graphicsPipeline{};
-    err = createGraphicsPipeline(_NanoContext.device,
-                                 _NanoContext.swapchainContext.info,
-                                 _NanoContext.renderpass,
-                                 graphicsPipeline);
+    return err;
+}
 
-    _NanoContext.AddGraphicsPipeline(graphicsPipeline);
+ERR NanoGraphics::Init(NanoWindow &window, NanoTaskGraph& initGraph, NanoTaskGraph::TaskID windowTask, const NanoHeadlessOptions& headless,
+                       NanoProfiler* profiler) {
+    ERR err = ERR::OK;
+    // Init only records the stages and what each one needs, the engine runs the graph. Shader compilation has no Vulkan
+    // dependency at all so it overlaps with instance and device creation, and the independent device level objects
+    // (caches, swapchain, command pool, staging ring, sync objects) are created side by side once the device exists.
+    // Every stage throws on failure, the task graph rethrows the first error once it stopped
+    using Affinity = NanoTaskAffinity;
+    _NanoContext.headless = headless.enabled;
+    _NanoContext.profiler = profiler;
+
+    auto instance = initGraph.AddTask("instance", []() {
+        createInstance(Config::APP_NAME,
+                       Config::ENGINE_NAME,
+                       _NanoContext.instance); // APP_NAME and ENGINE_NAME is defined in NanoConfig
+    });
+    if (!headless.enabled) {
+        initGraph.AddDependency(instance, windowTask); // glfwGetRequiredInstanceExtensions needs glfwInit
+    }
 
-    err = createFramebuffer(_NanoContext.device,
-                            _NanoContext.renderpass,
-                            _NanoContext.swapchainContext);
+    auto messenger = initGraph.AddTask("debug messenger", []() {
+        setupDebugMessenger(_NanoContext.instance,
+                            debugMessenger); // this depends on whether we are running in debug or not
+    });
+    initGraph.AddDependency(messenger, instance);
+
+    NanoTaskGraph::TaskID surface = instance; // headless, picking the device only needs the instance
+    if (!headless.enabled) {
+        surface = initGraph.AddTask("surface", [&window]() {
+            createSurface(_NanoContext.instance,
+                          window.getGLFWwindow(),
+                          _NanoContext.surface);
+        });
+        initGraph.AddDependency(surface, instance);
+        initGraph.AddDependency(surface, windowTask);
+    }
 
-    err = createCommandPool(_NanoContext.device,
+    auto physicalDevice = initGraph.AddTask("physical device", []() {
+        pickPhysicalDevice(_NanoContext.instance,
+                           _NanoContext.surface,
+                           _NanoContext.queueIndices,
+                           _NanoContext.physicalDevice); // physical device is not created but picked based on scores dictated by the number of supported features
+        _NanoContext.bindlessCapabilities = queryBindlessCapabilities(_NanoContext.physicalDevice);
+        _NanoContext.conditionalRendering = queryConditionalRendering(_NanoContext.physicalDevice);
+        _NanoContext.synchronization2 = querySynchronization2(_NanoContext.physicalDevice);
+        _NanoContext.timelineSemaphores = queryTimelineSemaphores(_NanoContext.physicalDevice);
+        _NanoContext.indirectCapabilities = queryIndirectCapabilities(_NanoContext.physicalDevice);
+        _NanoContext.profilerCapabilities = queryProfilerCapabilities(_NanoContext.physicalDevice, _NanoContext.queueIndices.graphicsFamily);
+        _NanoContext.depthFormat = findDepthFormat(_NanoContext.physicalDevice);
+    });
+    initGraph.AddDependency(physicalDevice, surface);
+
+    auto device = initGraph.AddTask("logical device", []() {
+        createLogicalDevice(_NanoContext.physicalDevice,
                             _NanoContext.queueIndices,
-                            _NanoContext.commandPool);
+                            _NanoContext.presentQueue,
+                            _NanoContext.graphicsQueue,
+                            _NanoContext.device); // Logical device *is* created and therefore has to be destroyed
+    });
+    initGraph.AddDependency(device, physicalDevice);
+
+    auto vertShader = initGraph.AddTask("vertex shader", []() {
+        _NanoContext.vertShader.Init("./src/shader/shader.vert");
+        _NanoContext.vertShader.CompileSpirv();
+    });
+    auto fragShader = initGraph.AddTask("fragment shader", []() {
+        _NanoContext.fragShader.Init("./src/shader/shader.frag");
+        _NanoContext.fragShader.CompileSpirv();
+    });
+
+    auto indirectShaders = initGraph.AddTask("indirect shaders", []() {
+        _NanoContext.cullShader.Init("./src/shader/cull.comp");
+        _NanoContext.cullShader.CompileSpirv();
+        _NanoContext.indirectVertShader.Init("./src/shader/indirect.vert");
+        _NanoContext.indirectVertShader.CompileSpirv();
+        _NanoContext.indirectFragShader.Init("./src/shader/indirect.frag");
+        _NanoContext.indirectFragShader.CompileSpirv();
+        _NanoContext.depthVertShader.Init("./src/shader/depth.vert");
+        _NanoContext.depthVertShader.CompileSpirv();
+        _NanoContext.queuedVertShader.Init("./src/shader/queued.vert");
+        _NanoContext.queuedVertShader.CompileSpirv();
+        _NanoContext.occlusionVertShader.Init("./src/shader/occlusion.vert");
+        _NanoContext.occlusionVertShader.CompileSpirv();
+    });
+
+    auto descriptors = initGraph.AddTask("layout cache and bindless heap", []() {
+        _NanoContext.layoutCache.Init(_NanoContext.device);
+        if (Config::enableBindless) {
+            _NanoContext.bindlessHeap.Init(_NanoContext.device,
+                                           _NanoContext.bindlessCapabilities);
+        }
+    });
+    initGraph.AddDependency(descriptors, device);
+
+    // glfwGetFramebufferSize may only be called from the main thread
+    VkExtent2D headlessExtent = {headless.width, headless.height};
+    auto swapchain = initGraph.AddTask("swapchain", [&window, headlessExtent]() {
+        if (_NanoContext.headless) {
+            createOffscreenImages(_NanoContext.physicalDevice,
+                                  _NanoContext.device,
+                                  headlessExtent,
+                                  _NanoContext.swapchainContext,
+                                  _NanoContext.offscreenMemory);
+        } else {
+            createSwapchain(_NanoContext.physicalDevice,
+                            _NanoContext.device,
+                            window.getGLFWwindow(),
+                            _NanoContext.surface,
+                            _NanoContext.swapchainContext);
+        }
+        createSCImageViews(_NanoContext.device,
+                           _NanoContext.swapchainContext);
+    }, Affinity::MAIN_THREAD);
+    initGraph.AddDependency(swapchain, device);
+
+    // the pipelines only need a compatible render pass, the graph's passes are declared once everything else exists
+    auto renderpass = initGraph.AddTask("render pass", []() {
+        _NanoContext.renderGraph.Init(_NanoContext.device,
+                                      _NanoContext.physicalDevice,
+                                      Config::enableSynchronization2 && _NanoContext.synchronization2);
+        if (Config::enableGpuProfiler) {
+            _NanoContext.renderGraph.SetProfiler(_NanoContext.profiler);
+        }
+        _NanoContext.renderpass = _NanoContext.renderGraph.GetCompatibleRenderPass({_NanoContext.swapchainContext.info.selectedFormat.format},
+                                                                                    _NanoContext.depthFormat);
+        if (Config::enableDepthPrepass && _NanoContext.depthFormat != VK_FORMAT_UNDEFINED) {
+            _NanoContext.depthRenderpass = _NanoContext.renderGraph.GetCompatibleRenderPass({}, _NanoContext.depthFormat);
+        }
+    });
+    initGraph.AddDependency(renderpass, swapchain);
+
+    auto pipeline = initGraph.AddTask("graphics pipeline", []() {
+        NanoGraphicsPipeline graphicsPipeline{};
+        createGraphicsPipeline(_NanoContext.device,
+                               _NanoContext.swapchainContext.info,
+                               _NanoContext.renderpass,
+                               graphicsPipeline);
+        _NanoContext.AddGraphicsPipeline(graphicsPipeline);
+
+        _NanoContext.renderQueue.Init(_NanoContext.device, _NanoContext.physicalDevice, Config::RENDER_QUEUE_INSTANCE_CAPACITY);
+        NanoQueueMesh triangle{};
+        triangle.count = 3;
+        _NanoContext.trianglePipeline = _NanoContext.renderQueue.AddPipeline(_NanoContext.currentGraphicsPipeline->GetPipeline(),
+                                                                             _NanoContext.currentGraphicsPipeline->GetPipelineLayout());
+        _NanoContext.triangleMaterial = _NanoContext.renderQueue.AddMaterial(NanoMaterialIndices{});
+        _NanoContext.triangleMesh = _NanoContext.renderQueue.AddMesh(triangle);
+    });
+    initGraph.AddDependency(pipeline, renderpass);
+    initGraph.AddDependency(pipeline, descriptors);
+    initGraph.AddDependency(pipeline, vertShader);
+    initGraph.AddDependency(pipeline, fragShader);
+
+    // the shaders index the storage buffers of the bindless set with runtime arrays
+    auto indirectRenderer = initGraph.AddTask("indirect renderer", []() {
+        if (!Config::enableIndirectRendering || !_NanoContext.indirectCapabilities.supported || !_NanoContext.bindlessHeap.IsInit() ||
+            !_NanoContext.bindlessHeap.IsUpdateAfterBind()) {
+            LOG_MSG(ERRLevel::INFO, "GPU driven rendering is not available on this device");
+            return;
+        }
+        _NanoContext.meshArena.Init(_NanoContext.device,
+                                    _NanoContext.physicalDevice,
+                                    Config::MESH_ARENA_VERTEX_CAPACITY,
+                                    Config::MESH_ARENA_INDEX_CAPACITY,
+                                    Config::MESH_ARENA_MESH_CAPACITY);
+        uint32_t instanceCapacity = std::min(Config::INDIRECT_INSTANCE_CAPACITY, _NanoContext.indirectCapabilities.maxDrawIndirectCount);
+        _NanoContext.sceneBuffer.Init(_NanoContext.device, _NanoContext.physicalDevice, instanceCapacity);
+        ERR err = _NanoContext.indirectRenderer.Init(_NanoContext.device,
+                                                     _NanoContext.physicalDevice,
+                                                     _NanoContext.bindlessHeap,
+                                                     _NanoContext.meshArena,
+                                                     _NanoContext.sceneBuffer,
+                                                     _NanoContext.indirectCapabilities.drawIndirectCount);
+        if (err == ERR::OK) {
+            err = _NanoContext.indirectRenderer.CreatePipelines(_NanoContext.layoutCache,
+                                                                _NanoContext.renderpass,
+                                                                _NanoContext.depthRenderpass,
+                                                                _NanoContext.swapchainContext.info.currentExtent,
+                                                                _NanoContext.cullShader,
+                                                                _NanoContext.indirectVertShader,
+                                                                _NanoContext.indirectFragShader,
+                                                                _NanoContext.depthVertShader);
+        }
+        if (err != ERR::OK) {
+            _NanoContext.indirectRenderer.CleanUp();
+            _NanoContext.sceneBuffer.CleanUp();
+            _NanoContext.meshArena.CleanUp();
+            return;
+        }
+        if (createQueuedPipeline() != ERR::OK) {
+            LOG_MSG(ERRLevel::WARNING, "failed to create the queued instance pipeline, AddQueuedInstance is not available");
+        }
+        // the boxes are tested against the pre-pass's depth, there is nothing to test against without it
+        if (_NanoContext.indirectRenderer.HasDepthPrepass() && createOcclusionPipeline() != ERR::OK) {
+            LOG_MSG(ERRLevel::WARNING, "failed to create the occlusion query pipeline, instances won't be occlusion queried");
+        }
+    });
+    initGraph.AddDependency(indirectRenderer, renderpass);
+    initGraph.AddDependency(indirectRenderer, descriptors);
+    initGraph.AddDependency(indirectRenderer, indirectShaders);
+    // both get or create layouts in the layout cache, which isn't thread safe
+    initGraph.AddDependency(indirectRenderer, pipeline);
+
+    // declared in execution order, Compile runs on the first Execute
+    auto renderGraph = initGraph.AddTask("render graph", []() {
+        NanoRenderGraph& graph = _NanoContext.renderGraph;
+        _NanoContext.backbuffer = graph.ImportImage("backbuffer",
+                                                    _NanoContext.swapchainContext.info.selectedFormat.format,
+                                                    _NanoContext.swapchainContext.images,
+                                                    _NanoContext.swapchainContext.imageViews,
+                                                    _NanoContext.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+        bool indirect = _NanoContext.indirectRenderer.IsInit();
+        NanoRGResource scene = graph.ImportBuffer("scene");
+        NanoRGResource draws = graph.ImportBuffer("draws");
+        if (indirect) {
+            NanoRGPass upload = graph.AddPass("scene upload", NanoRGPassType::TRANSFER, [](VkCommandBuffer& commandBuffer) {
+                _NanoContext.sceneBuffer.RecordUpload(commandBuffer, _NanoContext.stagingRing);
+            });
+            graph.Use(upload, scene, NanoRGAccess::TRANSFER_WRITE);
+
+            NanoRGPass cull = graph.AddPass("cull", NanoRGPassType::COMPUTE, [](VkCommandBuffer& commandBuffer) {
+                _NanoContext.indirectRenderer.RecordCull(commandBuffer, _NanoContext.swapchainContext.currentFrame, _NanoContext.viewProjection,
+                                                         static_cast<float>(_NanoContext.renderGraph.GetExtent().height));
+            });
+            graph.Use(cull, scene, NanoRGAccess::SHADER_READ);
+            graph.Use(cull, draws, NanoRGAccess::TRANSFER_WRITE); // cleared first
+            graph.Use(cull, draws, NanoRGAccess::SHADER_WRITE);
+        }
 
-    err = createCommandBuffer(_NanoContext.device,
-                              _NanoContext.commandPool,
-                              _NanoContext.swapchainContext.commandBuffer,
-                              Config::MAX_FRAMES_IN_FLIGHT);
+        // the depth image starts cleared in whichever pass writes it first
+        bool hasDepth = _NanoContext.depthFormat != VK_FORMAT_UNDEFINED;
+        bool depthPrepass = hasDepth && indirect && _NanoContext.indirectRenderer.HasDepthPrepass();
+        VkClearValue clearDepth{};
+        clearDepth.depthStencil = {1.0f, 0};
+        if (hasDepth) {
+            _NanoContext.depth = graph.CreateImage("depth", _NanoContext.depthFormat);
+        }
+        if (depthPrepass) {
+            NanoRGPass prepass = graph.AddPass("depth prepass", NanoRGPassType::GRAPHICS, [](VkCommandBuffer& commandBuffer) {
+                _NanoContext.indirectRenderer.RecordDepth(commandBuffer, _NanoContext.swapchainContext.currentFrame);
+            });
+            graph.Use(prepass, _NanoContext.depth, NanoRGAccess::DEPTH_WRITE, &clearDepth);
+            graph.Use(prepass, draws, NanoRGAccess::INDIRECT_READ);
+            graph.Use(prepass, scene, NanoRGAccess::SHADER_READ);
+        }
+        if (depthPrepass && _NanoContext.hasOcclusionPipeline) {
+            NanoRGPass queries = graph.AddPass("occlusion queries", NanoRGPassType::GRAPHICS, [](VkCommandBuffer& commandBuffer) {
+                recordOcclusionQueries(commandBuffer);
+            });
+            // only tested, but declared as a write so the graph keeps the pass: the queries are its output, not an attachment
+            graph.Use(queries, _NanoContext.depth, NanoRGAccess::DEPTH_WRITE);
+        }
 
-    err = createSwapchainSyncObjects(_NanoContext.device,
-                                     _NanoContext.swapchainContext.syncObjects,
-                                     Config::MAX_FRAMES_IN_FLIGHT);
+        NanoRGPass mainPass = graph.AddPass("main", NanoRGPassType::GRAPHICS, [](VkCommandBuffer& commandBuffer) {
+            // bindless: the global set is bound once per pipeline layout, each draw only pushes the indices of the resources it uses
+            _NanoContext.renderQueue.Record(commandBuffer, QUEUE_PASS_OVERLAY, &_NanoContext.bindlessHeap);
+            if (_NanoContext.indirectRenderer.IsInit()) {
+                _NanoContext.indirectRenderer.RecordDraw(commandBuffer, _NanoContext.swapchainContext.currentFrame);
+            }
+            if (_NanoContext.queuedPipelineId != UINT32_MAX) {
+                // the render queue only pushes the material indices, the view projection after them is set once here
+                NanoGraphicsPipeline& pipeline = _NanoContext.queuedPipeline;
+                vkCmdPushConstants(commandBuffer, pipeline.GetPipelineLayout(), pipeline.GetReflection().pushConstantRanges[0].stageFlags,
+                                   sizeof(NanoMaterialIndices), sizeof(glm::mat4), &_NanoContext.viewProjection);
+                _NanoContext.renderQueue.Record(commandBuffer, QUEUE_PASS_SCENE, &_NanoContext.bindlessHeap);
+            }
+        });
+        VkClearValue clearColor = {{{0.02f, 0.02f, 0.02f, 1.0f}}};
+        graph.Use(mainPass, _NanoContext.backbuffer, NanoRGAccess::COLOR_WRITE, &clearColor);
+        if (hasDepth) {
+            // still a depth write after the pre-pass, the pipelines of direct draws may write it (not a read only layout)
+            graph.Use(mainPass, _NanoContext.depth, NanoRGAccess::DEPTH_WRITE, depthPrepass ? nullptr : &clearDepth);
+        }
+        if (indirect) {
+            graph.Use(mainPass, draws, NanoRGAccess::INDIRECT_READ);
+            graph.Use(mainPass, scene, NanoRGAccess::SHADER_READ);
+        }
+        graph.SetExtent(_NanoContext.swapchainContext.info.currentExtent);
+    });
+    initGraph.AddDependency(renderGraph, pipeline);
+    initGraph.AddDependency(renderGraph, indirectRenderer);
+
+    auto commandPool = initGraph.AddTask("command pool and buffers", []() {
+        createCommandPool(_NanoContext.device,
+                          _NanoContext.queueIndices,
+                          _NanoContext.commandPool);
+        createCommandBuffer(_NanoContext.device,
+                            _NanoContext.commandPool,
+                            _NanoContext.swapchainContext.commandBuffer,
+                            Config::MAX_FRAMES_IN_FLIGHT);
+    });
+    initGraph.AddDependency(commandPool, device);
+
+    // has its own command pool, only shares the queue with the frame
+    auto stagingRing = initGraph.AddTask("staging ring", []() {
+        _NanoContext.stagingRing.Init(_NanoContext.device,
+                                      _NanoContext.physicalDevice,
+                                      _NanoContext.graphicsQueue,
+                                      _NanoContext.queueIndices.graphicsFamily,
+                                      Config::STAGING_RING_SIZE);
+    });
+    initGraph.AddDependency(stagingRing, device);
+
+    auto syncObjects = initGraph.AddTask("sync objects", []() {
+        createSwapchainSyncObjects(_NanoContext.device,
+                                   _NanoContext.swapchainContext.syncObjects,
+                                   Config::MAX_FRAMES_IN_FLIGHT);
+        if (Config::enableTimelineSemaphores && _NanoContext.timelineSemaphores) {
+            createFrameTimeline(_NanoContext.device, _NanoContext.frameTimeline);
+        }
+        _NanoContext.occlusionQueries.Init(_NanoContext.device,
+                                           _NanoContext.physicalDevice,
+                                           Config::OCCLUSION_QUERIES_PER_FRAME,
+                                           Config::enableConditionalRendering && _NanoContext.conditionalRendering);
+        if (_NanoContext.profiler && Config::enableGpuProfiler) {
+            _NanoContext.profiler->InitGpu(_NanoContext.device,
+                                           _NanoContext.profilerCapabilities.timestampPeriod,
+                                           _NanoContext.profilerCapabilities.timestampValidBits,
+                                           Config::enablePipelineStatistics && _NanoContext.profilerCapabilities.pipelineStatistics);
+        }
+    });
+    initGraph.AddDependency(syncObjects, device);
 
     return err;
 }
 
-ERR NanoGraphics::DrawFrame(){
-    ERR err = ERR::OK;
+static double millisecondsSince(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
 
-    vkWaitForFences(_NanoContext.device, 1, &_NanoContext.swapchainContext.syncObjects[_NanoContext.swapchainContext.currentFrame].inFlightFence, VK_TRUE, UINT64_MAX);
+ERR NanoGraphics::DrawFrame(NanoJobSystem& jobSystem){
+    ERR err = ERR::OK;
+    NanoProfiler* profiler = _NanoContext.profiler;
+    NanoFrameTimings& timings = _NanoContext.frameTimings;
+    timings = {};
+
+    {
+        NanoProfileScope zone(profiler, "wait for frame");
+        auto start = std::chrono::steady_clock::now();
+        vkWaitForFences(_NanoContext.device, 1, &_NanoContext.swapchainContext.syncObjects[_NanoContext.swapchainContext.currentFrame].inFlightFence, VK_TRUE, UINT64_MAX);
+        timings.fenceWaitMs = millisecondsSince(start);
+    }
     vkResetFences(_NanoContext.device, 1, &_NanoContext.swapchainContext.syncObjects[_NanoContext.swapchainContext.currentFrame].inFlightFence);
+    _NanoContext.completedFrames = std::max(_NanoContext.completedFrames, _NanoContext.slotFrames[_NanoContext.swapchainContext.currentFrame]);
+    // the slot's previous frame is done, its timestamps are read without waiting
+    if (profiler) {
+        profiler->BeginGpuFrame(_NanoContext.swapchainContext.currentFrame);
+    }
+
+    // captured frames the GPU is done with go to the encoders, then this one gets a readback slot (see NanoFrameCapture)
+    if (_NanoContext.frameCapture.IsInit()) {
+        _NanoContext.frameCapture.Collect(GetCompletedFrameCount());
+        _NanoContext.frameCapture.BeginFrame(_NanoContext.submittedFrames + 1);
+    }
+
+    // the frame's previous submission is done, retired bindless slots can be recycled
+    _NanoContext.bindlessHeap.BeginFrame(_NanoContext.swapchainContext.currentFrame);
+    // frame uploads (scene buffer deltas) are recorded into this frame's command buffer from the reclaimed ring space
+    _NanoContext.stagingRing.BeginFrame();
+    _NanoContext.occlusionQueries.BeginFrame(_NanoContext.swapchainContext.currentFrame);
+    applyOcclusionResults();
+
+    _NanoContext.renderQueue.BeginFrame(_NanoContext.swapchainContext.currentFrame);
+    _NanoContext.renderQueue.Submit(QUEUE_PASS_OVERLAY, _NanoContext.trianglePipeline, _NanoContext.triangleMaterial, _NanoContext.triangleMesh,
+                                    0.0f);
+    if (_NanoContext.queuedPipelineId != UINT32_MAX) {
+        submitQueuedInstances();
+    }
+    _NanoContext.renderQueue.Sort(&jobSystem);
 
     uint32_t imageIndex;
-    vkAcquireNextImageKHR(_NanoContext.device, _NanoContext.swapchainContext.swapchain, UINT64_MAX, _NanoContext.swapchainContext.syncObjects[_NanoContext.swapchainContext.currentFrame].imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+    if (_NanoContext.headless) {
+        // the image's previous frame was submitted HEADLESS_IMAGE_COUNT frames ago, at least as long as the fence we waited on
+        imageIndex = _NanoContext.offscreenImage;
+        _NanoContext.offscreenImage = (_NanoContext.offscreenImage + 1) % Config::HEADLESS_IMAGE_COUNT;
+    } else {
+        auto start = std::chrono::steady_clock::now();
+        vkAcquireNextImageKHR(_NanoContext.device, _NanoContext.swapchainContext.swapchain, UINT64_MAX, _NanoContext.swapchainContext.syncObjects[_NanoContext.swapchainContext.currentFrame].imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+        timings.acquireMs = millisecondsSince(start);
+    }
 
     vkResetCommandBuffer(_NanoContext.swapchainContext.commandBuffer[_NanoContext.swapchainContext.currentFrame], 0);
 
-    recordCommandBuffer(*_NanoContext.currentGraphicsPipeline,
-                        _NanoContext.swapchainContext.framebuffers[imageIndex], //swapchain framebuffer for the command buffer to operate on
-                        _NanoContext.swapchainContext.commandBuffer[_NanoContext.swapchainContext.currentFrame]); //command buffer to write to.
+    {
+        NanoProfileScope zone(profiler, "record");
+        auto start = std::chrono::steady_clock::now();
+        recordCommandBuffer(_NanoContext.swapchainContext.commandBuffer[_NanoContext.swapchainContext.currentFrame], //command buffer to write to.
+                            imageIndex); //swapchain image the graph renders to
+        timings.recordMs = millisecondsSince(start);
+    }
+
+    NanoProfileScope submitZone(profiler, "submit");
 
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     VkSemaphore waitSemaphores[] = {_NanoContext.swapchainContext.syncObjects[_NanoContext.swapchainContext.currentFrame].imageAvailableSemaphore};
-    VkSemaphore signalSemaphores[] = {_NanoContext.swapchainContext.syncObjects[_NanoContext.swapchainContext.currentFrame].renderFinishedSemaphore};
     VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &_NanoContext.swapchainContext.commandBuffer[_NanoContext.swapchainContext.currentFrame];
-    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.waitSemaphoreCount = _NanoContext.headless ? 0 : 1; // no image to acquire
     submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
 
+    // the present waits on the first one, the frame timeline (when there is one) comes last
+    uint64_t frame = ++_NanoContext.submittedFrames;
+    VkSemaphore signalSemaphores[2] = {};
+    uint64_t signalValues[2] = {}; // ignored for the binary semaphore
+    uint32_t signalCount = 0;
+    if (!_NanoContext.headless) {
+        SwapchainSyncObjects& syncObjects = _NanoContext.swapchainContext.syncObjects[_NanoContext.swapchainContext.currentFrame];
+        signalSemaphores[signalCount++] = syncObjects.renderFinishedSemaphore;
+    }
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    if (_NanoContext.frameTimeline != VK_NULL_HANDLE) {
+        signalValues[signalCount] = frame;
+        signalSemaphores[signalCount++] = _NanoContext.frameTimeline;
+        timelineInfo.signalSemaphoreValueCount = signalCount;
+        timelineInfo.pSignalSemaphoreValues = signalValues;
+        submitInfo.pNext = &timelineInfo;
+    }
+    submitInfo.signalSemaphoreCount = signalCount;
+    submitInfo.pSignalSemaphores = signalSemaphores;
+
+    if (profiler) {
+        profiler->MarkSubmit();
+    }
+    auto submitStart = std::chrono::steady_clock::now();
     if (vkQueueSubmit(_NanoContext.graphicsQueue, 1, &submitInfo, _NanoContext.swapchainContext.syncObjects[_NanoContext.swapchainContext.currentFrame].inFlightFence) != VK_SUCCESS) {
         throw std::runtime_error("failed to submit draw command buffer!");
     }
+    timings.submitMs = millisecondsSince(submitStart);
+    _NanoContext.slotFrames[_NanoContext.swapchainContext.currentFrame] = frame;
+
+    if (!_NanoContext.headless) {
+        VkPresentInfoKHR presentInfo{};
+        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        presentInfo.waitSemaphoreCount = 1;
+        presentInfo.pWaitSemaphores = signalSemaphores;
+        VkSwapchainKHR swapchains[] = {_NanoContext.swapchainContext.swapchain};
+        presentInfo.swapchainCount = 1;
+        presentInfo.pSwapchains = swapchains;
+        presentInfo.pImageIndices = &imageIndex;
+        presentInfo.pResults = nullptr; // Optional
+
+        auto presentStart = std::chrono::steady_clock::now();
+        vkQueuePresentKHR(_NanoContext.presentQueue, &presentInfo);
+        timings.presentMs = millisecondsSince(presentStart);
+    }
 
-    VkPresentInfoKHR presentInfo{};
-    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
-    VkSwapchainKHR swapchains[] = {_NanoContext.swapchainContext.swapchain};
-    presentInfo.swapchainCount = 1;
-    presentInfo.pSwapchains = swapchains;
-    presentInfo.pImageIndices = &imageIndex;
-    presentInfo.pResults = nullptr; // Optional
+    _NanoContext.swapchainContext.currentFrame = (_NanoContext.swapchainContext.currentFrame + 1) % Config::MAX_FRAMES_IN_FLIGHT;
 
-    vkQueuePresentKHR(_NanoContext.presentQueue, &presentInfo);
+    return err;
+}
 
-    _NanoContext.swapchainContext.currentFrame = (_NanoContext.swapchainContext.currentFrame + 1) % Config::MAX_FRAMES_IN_FLIGHT;
+// compacts the mesh arena once its holes are more than ratio of what it uses, returns whether it did. Waits for the GPU
+static bool compactMeshArena(float ratio){
+    NanoMeshArena& arena = _NanoContext.meshArena;
+    uint32_t freeVertices = arena.GetFreeVertexCount();
+    uint32_t freeIndices = arena.GetFreeIndexCount();
+    if (!arena.IsInit() || (freeVertices == 0 && freeIndices == 0) ||
+        (freeVertices < ratio * arena.GetVertexCount() && freeIndices < ratio * arena.GetIndexCount())) {
+        return false;
+    }
+    vkDeviceWaitIdle(_NanoContext.device);
+    if (arena.Compact(_NanoContext.stagingRing) != ERR::OK) {
+        return false;
+    }
+    // the render queue still has the offsets from before
+    for (uint32_t arenaMesh = 0; arenaMesh < _NanoContext.queueMeshes.size(); arenaMesh++) {
+        if (_NanoContext.queueMeshes[arenaMesh] != UINT32_MAX) {
+            _NanoContext.renderQueue.SetMesh(_NanoContext.queueMeshes[arenaMesh], makeQueueMesh(arenaMesh));
+        }
+    }
+    return true;
+}
+
+ERR NanoGraphics::LoadMesh(const std::string& meshFile, uint32_t& meshIndex){
+    meshIndex = UINT32_MAX;
+    if (!_NanoContext.indirectRenderer.IsInit()) {
+        return ERR::NOT_INITIALIZED;
+    }
+
+    // the arena is the only copy, meshes are only ever drawn by the GPU driven path. When it is out of space and there
+    // are holes, the arena is compacted and the mesh gets a second chance
+    uint32_t arenaMesh = UINT32_MAX;
+    ERR err = _NanoContext.meshArena.AddMesh(_NanoContext.stagingRing, meshFile, arenaMesh);
+    if (err == ERR::OUT_OF_SPACE && compactMeshArena(0.0f)) {
+        err = _NanoContext.meshArena.AddMesh(_NanoContext.stagingRing, meshFile, arenaMesh);
+    }
+    if (err != ERR::OK) {
+        return err;
+    }
+
+    meshIndex = static_cast<uint32_t>(_NanoContext.arenaMeshes.size());
+    _NanoContext.arenaMeshes.push_back(arenaMesh);
+    return err;
+}
+
+ERR NanoGraphics::UnloadMesh(uint32_t meshIndex){
+    if (meshIndex >= _NanoContext.arenaMeshes.size()) {
+        return ERR::INVALID;
+    }
+    // the arena may still be read by the frames in flight
+    vkDeviceWaitIdle(_NanoContext.device);
+    if (_NanoContext.arenaMeshes[meshIndex] != UINT32_MAX) {
+        // the instances of the mesh lose their bounds
+        for (uint32_t instance = 0; instance < _NanoContext.sceneBuffer.GetCount(); instance++) {
+            if (_NanoContext.sceneBuffer.Get(instance).mesh == _NanoContext.arenaMeshes[meshIndex]) {
+                _NanoContext.sceneBuffer.MarkMoved(instance);
+            }
+        }
+        _NanoContext.meshArena.RemoveMesh(_NanoContext.stagingRing, _NanoContext.arenaMeshes[meshIndex]);
+        _NanoContext.arenaMeshes[meshIndex] = UINT32_MAX;
+        compactMeshArena(Config::MESH_ARENA_COMPACT_RATIO);
+    }
+    return ERR::OK;
+}
+
+ERR NanoGraphics::AddStaticObjects(const std::vector<NanoStaticObject>& objects, std::vector<uint32_t>& instances){
+    instances.assign(objects.size(), UINT32_MAX);
+    if (!_NanoContext.indirectRenderer.IsInit()) {
+        return ERR::NOT_INITIALIZED;
+    }
+
+    // objects are grouped by material, then by the cell their origin falls in, so a merged mesh stays small enough to be culled
+    struct GroupKey {
+        uint32_t material;
+        glm::ivec3 cell;
+        uint32_t object;
+    };
+    std::vector<GroupKey> keys{};
+    keys.reserve(objects.size());
+    for (uint32_t i = 0; i < objects.size(); i++) {
+        glm::ivec3 cell = glm::ivec3(glm::floor(glm::vec3(objects[i].world[3]) / Config::STATIC_MERGE_CELL_SIZE));
+        keys.push_back({objects[i].material, cell, i});
+    }
+    auto sameGroup = [](const GroupKey& a, const GroupKey& b) { return a.material == b.material && a.cell == b.cell; };
+    std::sort(keys.begin(), keys.end(), [](const GroupKey& a, const GroupKey& b) {
+        return std::tie(a.material, a.cell.x, a.cell.y, a.cell.z, a.object) < std::tie(b.material, b.cell.x, b.cell.y, b.cell.z, b.object);
+    });
 
+    ERR err = ERR::OK;
+    std::vector<NanoMergePart> parts{};
+    for (size_t begin = 0; begin < keys.size();) {
+        size_t end = begin + 1;
+        while (end < keys.size() && end - begin < Config::STATIC_MERGE_MAX_OBJECTS && sameGroup(keys[begin], keys[end])) {
+            end++;
+        }
+        parts.clear();
+        for (size_t i = begin; i < end; i++) {
+            parts.push_back({objects[keys[i].object].meshFile, objects[keys[i].object].world});
+        }
+
+        uint32_t arenaMesh = UINT32_MAX;
+        ERR groupErr = _NanoContext.meshArena.AddMergedMesh(_NanoContext.stagingRing, parts, arenaMesh);
+        if (groupErr == ERR::OUT_OF_SPACE && compactMeshArena(0.0f)) {
+            groupErr = _NanoContext.meshArena.AddMergedMesh(_NanoContext.stagingRing, parts, arenaMesh);
+        }
+        if (groupErr == ERR::OK) {
+            _NanoContext.staticMeshes.push_back(arenaMesh);
+            // the vertices are already in world space
+            NanoGPUInstance data{};
+            data.mesh = arenaMesh;
+            data.material = keys[begin].material;
+            uint32_t instance = _NanoContext.sceneBuffer.Add(data);
+            groupErr = instance == UINT32_MAX ? ERR::INVALID : ERR::OK;
+            if (instance != UINT32_MAX) {
+                _NanoContext.staticInstances.push_back(instance);
+                registerQueryInstance(instance);
+            }
+            for (size_t i = begin; i < end; i++) {
+                instances[keys[i].object] = instance;
+            }
+        }
+        err = groupErr != ERR::OK ? groupErr : err;
+        begin = end;
+    }
+    LOG_MSG(ERRLevel::INFO, "%d static objects merged into %d meshes", static_cast<int>(objects.size()),
+            static_cast<int>(_NanoContext.staticMeshes.size()));
     return err;
 }
+
+ERR NanoGraphics::UnloadStaticObjects(){
+    if (_NanoContext.staticMeshes.empty()) {
+        return ERR::OK;
+    }
+    vkDeviceWaitIdle(_NanoContext.device);
+    for (uint32_t arenaMesh : _NanoContext.staticMeshes) {
+        _NanoContext.meshArena.RemoveMesh(_NanoContext.stagingRing, arenaMesh);
+    }
+    // the slots go back to the scene buffer, the next AddStaticObjects (or AddInstance) reuses them
+    for (uint32_t instance : _NanoContext.staticInstances) {
+        _NanoContext.sceneBuffer.Remove(instance);
+    }
+    _NanoContext.staticMeshes.clear();
+    _NanoContext.staticInstances.clear();
+    compactMeshArena(Config::MESH_ARENA_COMPACT_RATIO);
+    return ERR::OK;
+}
+
+ERR NanoGraphics::AddInstance(uint32_t meshIndex, const glm::mat4& world, uint32_t& instance){
+    instance = UINT32_MAX;
+    if (!_NanoContext.indirectRenderer.IsInit() || meshIndex >= _NanoContext.arenaMeshes.size() ||
+        _NanoContext.arenaMeshes[meshIndex] == UINT32_MAX) {
+        return ERR::NOT_INITIALIZED;
+    }
+    NanoGPUInstance data{};
+    data.world = world;
+    data.mesh = _NanoContext.arenaMeshes[meshIndex];
+    instance = _NanoContext.sceneBuffer.Add(data);
+    if (instance == UINT32_MAX) {
+        return ERR::INVALID;
+    }
+    registerQueryInstance(instance);
+    return ERR::OK;
+}
+
+ERR NanoGraphics::AddQueuedInstance(uint32_t meshIndex, const glm::mat4& world, uint32_t material, uint32_t& instance){
+    instance = UINT32_MAX;
+    if (_NanoContext.queuedPipelineId == UINT32_MAX || meshIndex >= _NanoContext.arenaMeshes.size() ||
+        _NanoContext.arenaMeshes[meshIndex] == UINT32_MAX) {
+        return ERR::NOT_INITIALIZED;
+    }
+    uint32_t arenaMesh = _NanoContext.arenaMeshes[meshIndex];
+    if (arenaMesh >= _NanoContext.queueMeshes.size()) {
+        _NanoContext.queueMeshes.resize(arenaMesh + 1, UINT32_MAX);
+    }
+    if (_NanoContext.queueMeshes[arenaMesh] == UINT32_MAX) {
+        _NanoContext.queueMeshes[arenaMesh] = _NanoContext.renderQueue.AddMesh(makeQueueMesh(arenaMesh));
+    }
+    if (getQueueMaterial(material) == UINT32_MAX) {
+        return ERR::INVALID;
+    }
+
+    NanoGPUInstance data{};
+    data.world = world;
+    data.mesh = arenaMesh;
+    data.material = material;
+    data.flags = NANO_INSTANCE_QUEUED;
+    instance = _NanoContext.sceneBuffer.Add(data);
+    if (instance == UINT32_MAX) {
+        return ERR::INVALID;
+    }
+    _NanoContext.queuedInstances.push_back(instance);
+    registerQueryInstance(instance);
+    return ERR::OK;
+}
+
+void NanoGraphics::SetInstanceTransform(uint32_t instance, const glm::mat4& world){
+    _NanoContext.sceneBuffer.SetTransform(instance, world);
+    // may have grown past OCCLUSION_QUERY_MIN_RADIUS
+    registerQueryInstance(instance);
+}
+
+void NanoGraphics::SetInstanceMaterial(uint32_t instance, uint32_t material){
+    _NanoContext.sceneBuffer.SetMaterial(instance, material);
+}
+
+void NanoGraphics::SetInstanceVisible(uint32_t instance, bool visible){
+    if (instance >= _NanoContext.sceneBuffer.GetCount()) {
+        return;
+    }
+    uint32_t flags = _NanoContext.sceneBuffer.Get(instance).flags;
+    _NanoContext.sceneBuffer.SetFlags(instance, visible ? flags & ~NANO_INSTANCE_HIDDEN : flags | NANO_INSTANCE_HIDDEN);
+}
+
+bool NanoGraphics::IsInstanceVisible(uint32_t instance){
+    return instance < GetInstanceCount() && !(_NanoContext.sceneBuffer.Get(instance).flags & NANO_INSTANCE_HIDDEN);
+}
+
+void NanoGraphics::TakeMovedInstances(std::vector<uint32_t>& instances){
+    if (!_NanoContext.sceneBuffer.IsInit()) {
+        instances.clear();
+        return;
+    }
+    _NanoContext.sceneBuffer.TakeMoved(instances);
+}
+
+uint32_t NanoGraphics::GetInstanceCount(){
+    return _NanoContext.sceneBuffer.IsInit() ? _NanoContext.sceneBuffer.GetCount() : 0;
+}
+
+bool NanoGraphics::GetInstanceSphere(uint32_t instance, glm::vec3& center, float& radius){
+    return getInstanceSphere(instance, center, radius);
+}
+
+void NanoGraphics::SetViewProjection(const glm::mat4& viewProjection){
+    _NanoContext.viewProjection = viewProjection;
+}
+
+const glm::mat4& NanoGraphics::GetViewProjection(){
+    return _NanoContext.viewProjection;
+}
+
+const NanoRenderQueueStats& NanoGraphics::GetRenderQueueStats(){
+    return _NanoContext.renderQueue.GetStats();
+}
+
+const NanoRenderGraphStats& NanoGraphics::GetRenderGraphStats(){
+    return _NanoContext.renderGraph.GetStats();
+}
+
+const NanoFrameTimings& NanoGraphics::GetFrameTimings(){
+    return _NanoContext.frameTimings;
+}
+
+bool NanoGraphics::IsHeadless(){
+    return _NanoContext.headless;
+}
+
+uint64_t NanoGraphics::GetSubmittedFrameCount(){
+    return _NanoContext.submittedFrames;
+}
+
+uint64_t NanoGraphics::GetCompletedFrameCount(){
+    if (_NanoContext.frameTimeline != VK_NULL_HANDLE) {
+        uint64_t value = 0;
+        vkGetSemaphoreCounterValue(_NanoContext.device, _NanoContext.frameTimeline, &value);
+        return value;
+    }
+    for (uint32_t i = 0; i < Config::MAX_FRAMES_IN_FLIGHT; i++) {
+        if (_NanoContext.slotFrames[i] > _NanoContext.completedFrames &&
+            vkGetFenceStatus(_NanoContext.device, _NanoContext.swapchainContext.syncObjects[i].inFlightFence) == VK_SUCCESS) {
+            _NanoContext.completedFrames = _NanoContext.slotFrames[i];
+        }
+    }
+    return _NanoContext.completedFrames;
+}
+
+bool NanoGraphics::WaitForFrame(uint64_t frame, uint64_t timeoutNs){
+    if (frame > _NanoContext.submittedFrames) {
+        return false; // would never signal
+    }
+    if (frame == 0 || frame <= _NanoContext.completedFrames) {
+        return true;
+    }
+    if (_NanoContext.frameTimeline != VK_NULL_HANDLE) {
+        VkSemaphoreWaitInfo waitInfo{};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &_NanoContext.frameTimeline;
+        waitInfo.pValues = &frame;
+        return vkWaitSemaphores(_NanoContext.device, &waitInfo, timeoutNs) == VK_SUCCESS;
+    }
+    // one submit per frame, so frames go round the in flight slots in order. A slot that was reused since was waited on
+    uint32_t slot = static_cast<uint32_t>((frame - 1) % Config::MAX_FRAMES_IN_FLIGHT);
+    if (_NanoContext.slotFrames[slot] == frame &&
+        vkWaitForFences(_NanoContext.device, 1, &_NanoContext.swapchainContext.syncObjects[slot].inFlightFence, VK_TRUE, timeoutNs) != VK_SUCCESS) {
+        return false;
+    }
+    _NanoContext.completedFrames = std::max(_NanoContext.completedFrames, frame);
+    return true;
+}
+
+ERR NanoGraphics::StartCapture(NanoJobSystem& jobSystem, const NanoCaptureOptions& options){
+    StopCapture();
+    if (!(_NanoContext.swapchainContext.info.imageUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+        LOG_MSG(ERRLevel::WARNING, "frame capture: the surface doesn't allow copies out of the swapchain images");
+        return ERR::INVALID;
+    }
+    return _NanoContext.frameCapture.Init(_NanoContext.device,
+                                          _NanoContext.physicalDevice,
+                                          jobSystem,
+                                          _NanoContext.swapchainContext.info.currentExtent,
+                                          _NanoContext.swapchainContext.info.selectedFormat.format,
+                                          options);
+}
+
+void NanoGraphics::StopCapture(){
+    if (!_NanoContext.frameCapture.IsInit()) {
+        return;
+    }
+    WaitForFrame(_NanoContext.submittedFrames);
+    _NanoContext.frameCapture.Collect(_NanoContext.submittedFrames);
+    _NanoContext.frameCapture.CleanUp();
+}
+
+bool NanoGraphics::IsCapturing(){
+    return _NanoContext.frameCapture.IsInit() && !_NanoContext.frameCapture.IsDone();
+}
+
+NanoCaptureStats NanoGraphics::GetCaptureStats(){
+    return _NanoContext.frameCapture.GetStats();
+}
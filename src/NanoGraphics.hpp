@@ -1,14 +1,104 @@
 #ifndef NANOGRAPHICS_H_
 #define NANOGRAPHICS_H_
 
+#include "NanoConfig.hpp"
+#include "NanoFrameCapture.hpp"
 #include "NanoLogger.hpp"
+#include "NanoProfiler.hpp"
+#include "NanoRenderGraph.hpp"
+#include "NanoRenderQueue.hpp"
+#include "NanoTaskGraph.hpp"
 #include "NanoWindow.hpp"
 
+#include "glm/glm.hpp"
+#include <string>
+#include <vector>
+
+// geometry that never moves once loaded
+struct NanoStaticObject {
+    std::string meshFile;
+    glm::mat4 world{1.0f};
+    uint32_t material = 0;
+};
+
+// no window, surface or swapchain (render servers, automated perf runs, software ICDs like lavapipe). Frames render to
+// Config::HEADLESS_IMAGE_COUNT engine owned images in turn and nothing is presented
+struct NanoHeadlessOptions {
+    bool enabled = false;
+    uint32_t width = Config::WINDOW_WIDTH;
+    uint32_t height = Config::WINDOW_HEIGHT;
+};
+
+// CPU time the last DrawFrame spent in each stage, the blocking calls are what the GPU or the presentation engine made
+// the frame wait for. Headless frames neither acquire nor present
+struct NanoFrameTimings {
+    double fenceWaitMs = 0.0; // vkWaitForFences
+    double acquireMs = 0.0;   // vkAcquireNextImageKHR
+    double recordMs = 0.0;
+    double submitMs = 0.0;
+    double presentMs = 0.0;
+};
+
 class NanoGraphics{
     public:
-        ERR Init(NanoWindow& window);
-        ERR DrawFrame();
+        // records the init stages into initGraph instead of running them, windowTask is the stage that creates the window.
+        // Headless, neither window nor windowTask are used. profiler, when there is one, gets the frame's CPU stages and a
+        // GPU zone per render graph pass, and has to outlive CleanUp
+        ERR Init(NanoWindow& window, NanoTaskGraph& initGraph, NanoTaskGraph::TaskID windowTask, const NanoHeadlessOptions& headless = {},
+                 NanoProfiler* profiler = nullptr);
+        // the frame's draw list is sorted over the job system
+        ERR DrawFrame(NanoJobSystem& jobSystem);
         ERR CleanUp();
+        // loads an engine native .nmesh file (see NanoMeshConverter) into the mesh arena, drawn through AddInstance.
+        // Nothing is kept when it doesn't fit, even once the arena was compacted
+        ERR LoadMesh(const std::string& meshFile, uint32_t& meshIndex);
+        // waits for the GPU, the mesh index stays taken. Its instances are skipped from then on
+        ERR UnloadMesh(uint32_t meshIndex);
+        // Objects sharing a material and a Config::STATIC_MERGE_CELL_SIZE cell are baked into one arena mesh, drawn as a
+        // single GPU driven instance. instances[i] is the instance object i ended up in, UINT32_MAX if it was left out
+        ERR AddStaticObjects(const std::vector<NanoStaticObject>& objects, std::vector<uint32_t>& instances);
+        // every merged static mesh and its instance, e.g. on a level change. Waits for the GPU, the instance ids handed
+        // out by AddStaticObjects are reused by the next instances added
+        ERR UnloadStaticObjects();
+        // GPU driven instances (see NanoIndirectRenderer), culled and drawn on the GPU every frame from then on. Ones with a
+        // sphere of at least Config::OCCLUSION_QUERY_MIN_RADIUS also get a hardware occlusion query (NanoOcclusionQueries)
+        ERR AddInstance(uint32_t meshIndex, const glm::mat4& world, uint32_t& instance);
+        // drawn through the render queue instead, one draw per instance before batching: the instances sharing a mesh
+        // and a material become one instanced draw. LOD 0 and no GPU culling, the CPU culling stage still applies. The
+        // instance is a scene instance like AddInstance's, the same setters work on it
+        ERR AddQueuedInstance(uint32_t meshIndex, const glm::mat4& world, uint32_t material, uint32_t& instance);
+        void SetInstanceTransform(uint32_t instance, const glm::mat4& world);
+        void SetInstanceMaterial(uint32_t instance, uint32_t material);
+        // hidden instances are skipped by the GPU culling pass, for culling done on the CPU
+        void SetInstanceVisible(uint32_t instance, bool visible);
+        bool IsInstanceVisible(uint32_t instance);
+        uint32_t GetInstanceCount();
+        // world space bounding sphere, the one the GPU culls with. false once the instance or its mesh was unloaded.
+        // Safe to call from several jobs at once, as long as nothing changes the instances meanwhile
+        bool GetInstanceSphere(uint32_t instance, glm::vec3& center, float& radius);
+        // the instances whose sphere changed since the last call
+        void TakeMovedInstances(std::vector<uint32_t>& instances);
+        void SetViewProjection(const glm::mat4& viewProjection);
+        const glm::mat4& GetViewProjection();
+        // state changes and sort time of the last frame's render queue
+        const NanoRenderQueueStats& GetRenderQueueStats();
+        // passes, barriers and transient memory of the compiled render graph
+        const NanoRenderGraphStats& GetRenderGraphStats();
+        const NanoFrameTimings& GetFrameTimings();
+        bool IsHeadless();
+        // Frames are numbered from 1 in submission order. Completion comes from a timeline semaphore every submit signals
+        // with its frame number, or from the frames' fences when the device has no timeline semaphores
+        uint64_t GetSubmittedFrameCount();
+        uint64_t GetCompletedFrameCount();
+        // false on timeout
+        bool WaitForFrame(uint64_t frame, uint64_t timeoutNs = UINT64_MAX);
+        // every frame drawn from now on is read back and encoded over the job system (see NanoFrameCapture), until
+        // options.frameCount frames were or StopCapture. Needs 8 bit RGBA or BGRA images the surface lets us copy from
+        ERR StartCapture(NanoJobSystem& jobSystem, const NanoCaptureOptions& options);
+        // waits for the captured frames still on the GPU and for their encodes. CleanUp stops it too
+        void StopCapture();
+        bool IsCapturing(); // false once frameCount frames were captured
+        NanoCaptureStats GetCaptureStats();
     private:
 };
 
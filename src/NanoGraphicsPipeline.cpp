@@ -1,4 +1,6 @@
 #include "NanoGraphicsPipeline.hpp"
+#include "NanoConfig.hpp"
+#include "NanoLogger.hpp"
 #include "vulkan/vulkan_core.h"
 
 //TODO ; Match the init design of the NanoGraphics class
@@ -15,14 +17,78 @@ void NanoGraphicsPipeline::AddVertShader(const std::string& vertFileName){
 
 void NanoGraphicsPipeline::AddFragShader(const std::string& fragFileName){
     m_fragShader = {};
+    m_hasFragShader = true;
     m_fragShader.Init(_device, fragFileName);
     m_fragShader.Compile();
 }
 
+void NanoGraphicsPipeline::AddVertShader(const NanoShader& vertShader){
+    m_vertShader = vertShader;
+    m_vertShader.CreateModule(_device);
+}
+
+void NanoGraphicsPipeline::AddFragShader(const NanoShader& fragShader){
+    m_fragShader = fragShader;
+    m_hasFragShader = true;
+    m_fragShader.CreateModule(_device);
+}
+
 void NanoGraphicsPipeline::AddRenderPass(const VkRenderPass& renderpass){
     _renderpass = renderpass;
 }
 
+void NanoGraphicsPipeline::AddLayoutCache(NanoPipelineLayoutCache& layoutCache){
+    _layoutCache = &layoutCache;
+}
+
+void NanoGraphicsPipeline::AddDescriptorSetLayout(uint32_t set, const VkDescriptorSetLayout& setLayout){
+    if(m_setLayouts.size() <= set){
+        m_setLayouts.resize(set + 1, VK_NULL_HANDLE);
+    }
+    m_setLayouts[set] = setLayout;
+}
+
+void NanoGraphicsPipeline::AddPushConstantRange(const VkPushConstantRange& pushConstantRange){
+    m_pushConstantRanges.push_back(pushConstantRange);
+}
+
+void NanoGraphicsPipeline::AddInstanceInputs(uint32_t firstLocation){
+    m_firstInstanceLocation = firstLocation;
+}
+
+void NanoGraphicsPipeline::AddDepthState(VkCompareOp compareOp, bool depthWrite){
+    m_depthTest = true;
+    m_depthCompareOp = compareOp;
+    m_depthWrite = depthWrite;
+}
+
+void NanoGraphicsPipeline::AddCullMode(VkCullModeFlags cullMode){
+    m_cullMode = cullMode;
+}
+
+void NanoGraphicsPipeline::AddSpecializationConstant(uint32_t constantID, uint32_t value){
+    VkSpecializationMapEntry entry{};
+    entry.constantID = constantID;
+    entry.offset = static_cast<uint32_t>(m_specializationData.size() * sizeof(uint32_t));
+    entry.size = sizeof(uint32_t);
+    m_specializationEntries.push_back(entry);
+    m_specializationData.push_back(value);
+}
+
+// only keep the constants the stage actually declares, the rest would be ignored by the driver anyway
+static std::vector<VkSpecializationMapEntry> filterSpecializationEntries(const std::vector<VkSpecializationMapEntry>& entries, const ShaderReflection& reflection){
+    std::vector<VkSpecializationMapEntry> stageEntries{};
+    for(const auto& entry : entries){
+        for(const auto& constant : reflection.specializationConstants){
+            if(constant.constantID == entry.constantID){
+                stageEntries.push_back(entry);
+                break;
+            }
+        }
+    }
+    return stageEntries;
+}
+
 void NanoGraphicsPipeline::ConfigureViewport(const VkExtent2D& extent){
     m_extent = extent;
 }
@@ -35,11 +101,38 @@ ERR NanoGraphicsPipeline::Compile(bool forceReCompile){
         return ERR::NOT_INITIALIZED;
     }
 
-    if(!m_fragShader.IsCompiled()){
+    // no fragment shader is a depth only pipeline (pre-pass, shadows), for render passes without color attachments
+    bool depthOnly = !m_hasFragShader;
+    if(!depthOnly && !m_fragShader.IsCompiled()){
         ASSERT(m_fragShader.IsCompiled(), "graphics pipeline's fragment shader was not compiled\n");
         return ERR::NOT_INITIALIZED;
     }
 
+    if(!_layoutCache){
+        ASSERT(_layoutCache, "graphics pipeline needs a layout cache to build its pipeline layout\n");
+        return ERR::NOT_INITIALIZED;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    // Reflection ////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // the pipeline interface is read from the SPIR-V, so the layout can never drift from the shaders
+    m_fragReflection = {};
+    if(ReflectSpirv(m_vertShader.GetByteCode(), m_vertReflection) != ERR::OK ||
+       (!depthOnly && ReflectSpirv(m_fragShader.GetByteCode(), m_fragReflection) != ERR::OK)){
+        LOG_MSG(ERRLevel::WARNING, "failed to reflect the graphics pipeline shaders");
+        return ERR::INVALID;
+    }
+    m_reflection = m_vertReflection;
+    m_reflection.Merge(m_fragReflection);
+
+    for(const auto& pushConstantRange : m_pushConstantRanges){
+        ShaderReflection extraRange{};
+        extraRange.pushConstantRanges.push_back(pushConstantRange);
+        m_reflection.Merge(extraRange);
+    }
+
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     // Shaders ///////////////////////////////////////////////////////////////////////////////////////////////////////////
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -49,25 +142,59 @@ ERR NanoGraphicsPipeline::Compile(bool forceReCompile){
     vertexShaderStage.stage = VK_SHADER_STAGE_VERTEX_BIT;
     vertexShaderStage.module = m_vertShader.GetShaderModule();
     vertexShaderStage.pName = "main";
-    // VkSpecializationInfo specializationInfo = {};
-    vertexShaderStage.pSpecializationInfo = nullptr; //Can specify different values for constant used in this shader. allows better optimization at shader creation stage
+    std::vector<VkSpecializationMapEntry> vertSpecializationEntries = filterSpecializationEntries(m_specializationEntries, m_vertReflection);
+    VkSpecializationInfo vertSpecializationInfo = {};
+    vertSpecializationInfo.mapEntryCount = static_cast<uint32_t>(vertSpecializationEntries.size());
+    vertSpecializationInfo.pMapEntries = vertSpecializationEntries.data();
+    vertSpecializationInfo.dataSize = m_specializationData.size() * sizeof(uint32_t);
+    vertSpecializationInfo.pData = m_specializationData.data();
+    vertexShaderStage.pSpecializationInfo = vertSpecializationEntries.empty() ? nullptr : &vertSpecializationInfo; //Can specify different values for constant used in this shader. allows better optimization at shader creation stage
 
     VkPipelineShaderStageCreateInfo fragmentShaderStage = {};
     fragmentShaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     fragmentShaderStage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
     fragmentShaderStage.module = m_fragShader.GetShaderModule();
     fragmentShaderStage.pName = "main";
-    // VkSpecializationInfo specializationInfo = {};
-    fragmentShaderStage.pSpecializationInfo = nullptr; //Can specify different values for constant used in this shader. allows better optimization at shader creation stage
+    std::vector<VkSpecializationMapEntry> fragSpecializationEntries = filterSpecializationEntries(m_specializationEntries, m_fragReflection);
+    VkSpecializationInfo fragSpecializationInfo = {};
+    fragSpecializationInfo.mapEntryCount = static_cast<uint32_t>(fragSpecializationEntries.size());
+    fragSpecializationInfo.pMapEntries = fragSpecializationEntries.data();
+    fragSpecializationInfo.dataSize = m_specializationData.size() * sizeof(uint32_t);
+    fragSpecializationInfo.pData = m_specializationData.data();
+    fragmentShaderStage.pSpecializationInfo = fragSpecializationEntries.empty() ? nullptr : &fragSpecializationInfo; //Can specify different values for constant used in this shader. allows better optimization at shader creation stage
 
     VkPipelineShaderStageCreateInfo shaderStages[] = {vertexShaderStage, fragmentShaderStage};
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 0;
-    vertexInputInfo.pVertexBindingDescriptions = nullptr;
-    vertexInputInfo.vertexAttributeDescriptionCount = 0;
-    vertexInputInfo.pVertexAttributeDescriptions = nullptr;
+    // reflected vertex inputs are packed, in location order, in a single interleaved binding. The per instance ones
+    // (AddInstanceInputs) get a second interleaved binding that advances once per instance
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+    VkVertexInputBindingDescription perBindingDescriptions[2]{};
+    perBindingDescriptions[0].binding = 0;
+    perBindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    perBindingDescriptions[1].binding = Config::INSTANCE_VERTEX_BINDING;
+    perBindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    for(const auto& input : m_reflection.vertexInputs){
+        VkVertexInputBindingDescription& binding = perBindingDescriptions[input.location >= m_firstInstanceLocation ? 1 : 0];
+        VkVertexInputAttributeDescription attribute{};
+        attribute.location = input.location;
+        attribute.binding = binding.binding;
+        attribute.format = input.format;
+        attribute.offset = binding.stride;
+        binding.stride += input.size;
+        attributeDescriptions.push_back(attribute);
+    }
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions{};
+    for(const auto& binding : perBindingDescriptions){
+        if(binding.stride > 0){
+            bindingDescriptions.push_back(binding);
+        }
+    }
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     // Input assembly ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -120,7 +247,7 @@ ERR NanoGraphicsPipeline::Compile(bool forceReCompile){
     // If rasterizerDiscardEnable is set to VK_TRUE, then geometry never passes through the rasterizer stage. This basically disables any output to the framebuffer.
     rasterizer.rasterizerDiscardEnable = VK_FALSE;
     rasterizer.polygonMode = VK_POLYGON_MODE_FILL; // using anything other than fill requires enabling a gpu feature (this can allow us to set line width and point size)
-    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizer.cullMode = m_cullMode;
     rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
     rasterizer.depthBiasEnable = VK_FALSE; // sometimes used for shadow mapping
     rasterizer.depthBiasConstantFactor = 0.0f; // Optional
@@ -143,7 +270,20 @@ ERR NanoGraphicsPipeline::Compile(bool forceReCompile){
     multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
     multisampling.alphaToOneEnable = VK_FALSE; // Optional
 
-    VkPipelineDepthStencilStateCreateInfo depthStencil{}; // optional.
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    // Depth & Stencil ///////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // always given, render passes with a depth attachment need it even with the test off
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = m_depthTest ? VK_TRUE : VK_FALSE;
+    depthStencil.depthWriteEnable = m_depthTest && m_depthWrite ? VK_TRUE : VK_FALSE;
+    depthStencil.depthCompareOp = m_depthCompareOp;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = VK_FALSE;
+    depthStencil.minDepthBounds = 0.0f;
+    depthStencil.maxDepthBounds = 1.0f;
 
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     // Color blending ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -163,7 +303,7 @@ ERR NanoGraphicsPipeline::Compile(bool forceReCompile){
     colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     colorBlending.logicOpEnable = VK_FALSE;
     colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
-    colorBlending.attachmentCount = 1;
+    colorBlending.attachmentCount = depthOnly ? 0 : 1;
     colorBlending.pAttachments = &colorBlendAttachment;
     colorBlending.blendConstants[0] = 0.0f; // Optional
     colorBlending.blendConstants[1] = 0.0f; // Optional
@@ -174,27 +314,19 @@ ERR NanoGraphicsPipeline::Compile(bool forceReCompile){
     // Pipeline Layout ///////////////////////////////////////////////////////////////////////////////////////////////////
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 0; // Optional
-    pipelineLayoutInfo.pSetLayouts = nullptr; // Optional
-    pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-    pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
-
-    if (vkCreatePipelineLayout(_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create pipeline layout!");
-    }
+    // shared between every pipeline with a compatible interface. Added set layouts (bindless set) take precedence over the reflected ones
+    m_pipelineLayout = _layoutCache->GetPipelineLayout(m_reflection, m_setLayouts);
 
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2;
+    pipelineInfo.stageCount = depthOnly ? 1 : 2;
     pipelineInfo.pStages = shaderStages;
     pipelineInfo.pVertexInputState = &vertexInputInfo;
     pipelineInfo.pInputAssemblyState = &inputAssembly;
     pipelineInfo.pViewportState = &viewportState;
     pipelineInfo.pRasterizationState = &rasterizer;
     pipelineInfo.pMultisampleState = &multisampling;
-    pipelineInfo.pDepthStencilState = nullptr; // Optional
+    pipelineInfo.pDepthStencilState = &depthStencil;
     pipelineInfo.pColorBlendState = &colorBlending;
     pipelineInfo.pDynamicState = &dynamicState;
     pipelineInfo.layout = m_pipelineLayout;
@@ -213,7 +345,6 @@ ERR NanoGraphicsPipeline::Compile(bool forceReCompile){
 
 void NanoGraphicsPipeline::CleanUp(){
     vkDestroyPipeline(_device, m_pipeline, nullptr);
-    vkDestroyPipelineLayout(_device, m_pipelineLayout, nullptr);
     m_fragShader.CleanUp();
     m_vertShader.CleanUp();
 }
@@ -2,6 +2,8 @@
 #define NANOGRAPHICSPIPELINE_H_
 
 #include "NanoShader.hpp"
+#include "NanoShaderReflection.hpp"
+#include "NanoPipelineLayoutCache.hpp"
 #include "vulkan/vulkan_core.h"
 
 class NanoGraphicsPipeline{
@@ -9,12 +11,27 @@ class NanoGraphicsPipeline{
         void Init(VkDevice& device, const VkExtent2D& extent);
         void AddVertShader(const std::string& vertShaderFile);
         void AddFragShader(const std::string& fragShaderFile);
+        // shaders that were already compiled to SPIR-V (e.g. by an init job before the device existed), only the module is created here
+        void AddVertShader(const NanoShader& vertShader);
+        void AddFragShader(const NanoShader& fragShader);
         void AddRenderPass(const VkRenderPass& renderpass);
+        void AddLayoutCache(NanoPipelineLayoutCache& layoutCache);
+        void AddDescriptorSetLayout(uint32_t set, const VkDescriptorSetLayout& setLayout); // replaces the reflected layout for that set
+        void AddPushConstantRange(const VkPushConstantRange& pushConstantRange); // merged with the reflected push constant range
+        void AddSpecializationConstant(uint32_t constantID, uint32_t value);
+        // reflected vertex inputs from firstLocation on are read per instance, from Config::INSTANCE_VERTEX_BINDING
+        void AddInstanceInputs(uint32_t firstLocation);
+        // depth test (and write) against the render pass's depth attachment, off by default
+        void AddDepthState(VkCompareOp compareOp, bool depthWrite);
+        // back faces by default, VK_CULL_MODE_NONE e.g. for proxy geometry whose winding doesn't matter
+        void AddCullMode(VkCullModeFlags cullMode);
         void ConfigureViewport(const VkExtent2D& extent);
         ERR Compile(bool forceReCompile = false);
         void CleanUp();
 
         VkPipeline& GetPipeline(){return m_pipeline;}
+        VkPipelineLayout& GetPipelineLayout(){return m_pipelineLayout;}
+        const ShaderReflection& GetReflection(){return m_reflection;}
         VkRenderPass& GetRenderPass(){return _renderpass;}
         VkExtent2D& GetExtent(){return m_extent;}
     private:
@@ -23,7 +40,21 @@ class NanoGraphicsPipeline{
         VkExtent2D m_extent = {};
         NanoShader m_vertShader = {};
         NanoShader m_fragShader = {};
-        VkPipelineLayout m_pipelineLayout = {};
+        NanoPipelineLayoutCache* _layoutCache = nullptr;
+        ShaderReflection m_vertReflection = {};
+        ShaderReflection m_fragReflection = {};
+        ShaderReflection m_reflection = {}; // merged interface of every stage
+        std::vector<VkDescriptorSetLayout> m_setLayouts = {};
+        std::vector<VkPushConstantRange> m_pushConstantRanges = {};
+        std::vector<VkSpecializationMapEntry> m_specializationEntries = {};
+        std::vector<uint32_t> m_specializationData = {};
+        uint32_t m_firstInstanceLocation = UINT32_MAX;
+        bool m_hasFragShader = false; // none is a depth only pipeline
+        bool m_depthTest = false;
+        bool m_depthWrite = false;
+        VkCompareOp m_depthCompareOp = VK_COMPARE_OP_LESS;
+        VkCullModeFlags m_cullMode = VK_CULL_MODE_BACK_BIT;
+        VkPipelineLayout m_pipelineLayout = {}; // owned by the layout cache
         VkPipeline m_pipeline = {};
 };
 #endif // NANOGRAPHICSPIPELINE_H_
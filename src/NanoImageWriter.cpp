@@ -0,0 +1,184 @@
+#include "NanoImageWriter.hpp"
+#include "NanoLogger.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace ImageWriter {
+
+static constexpr uint32_t STORED_BLOCK_SIZE = 65535; // the most a stored deflate block can hold
+
+static void writeRGBRow(const uint8_t* pixels, uint32_t width, PixelOrder order, uint8_t* out) {
+    uint32_t red = order == PixelOrder::RGBA ? 0 : 2;
+    uint32_t blue = 2 - red;
+    for (uint32_t x = 0; x < width; x++) {
+        out[0] = pixels[red];
+        out[1] = pixels[1];
+        out[2] = pixels[blue];
+        pixels += 4;
+        out += 3;
+    }
+}
+
+static void appendBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// length, type, data, crc of type and data
+static void appendChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, uint32_t size) {
+    appendBigEndian(out, size);
+    size_t typeOffset = out.size();
+    out.insert(out.end(), type, type + 4);
+    if (size > 0) {
+        out.insert(out.end(), data, data + size);
+    }
+    appendBigEndian(out, Crc32(out.data() + typeOffset, size + 4));
+}
+
+void EncodePPM(const uint8_t* pixels, uint32_t width, uint32_t height, PixelOrder order, std::vector<uint8_t>& out) {
+    char header[32];
+    int headerSize = snprintf(header, sizeof(header), "P6\n%u %u\n255\n", width, height);
+    size_t rowSize = static_cast<size_t>(width) * 3;
+
+    out.resize(headerSize + rowSize * height);
+    memcpy(out.data(), header, headerSize);
+    for (uint32_t y = 0; y < height; y++) {
+        writeRGBRow(pixels + static_cast<size_t>(y) * width * 4, width, order, out.data() + headerSize + y * rowSize);
+    }
+}
+
+void EncodePNG(const uint8_t* pixels, uint32_t width, uint32_t height, PixelOrder order, std::vector<uint8_t>& out) {
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    size_t rowSize = static_cast<size_t>(width) * 3 + 1; // filter byte first
+    size_t rawSize = rowSize * height;
+    size_t blockCount = (rawSize + STORED_BLOCK_SIZE - 1) / STORED_BLOCK_SIZE;
+    size_t zlibSize = 2 + blockCount * 5 + rawSize + 4; // header, block headers, data, adler32
+
+    out.clear();
+    out.reserve(sizeof(signature) + 25 + 12 + zlibSize + 12);
+    out.insert(out.end(), signature, signature + sizeof(signature));
+
+    uint8_t ihdr[13] = {};
+    for (int i = 0; i < 4; i++) {
+        ihdr[i] = static_cast<uint8_t>(width >> (24 - i * 8));
+        ihdr[4 + i] = static_cast<uint8_t>(height >> (24 - i * 8));
+    }
+    ihdr[8] = 8; // bits per channel
+    ihdr[9] = 2; // truecolor, no alpha
+    appendChunk(out, "IHDR", ihdr, sizeof(ihdr));
+
+    // the IDAT is written in place: filtered rows are produced straight into the stored blocks
+    appendBigEndian(out, static_cast<uint32_t>(zlibSize));
+    size_t typeOffset = out.size();
+    out.insert(out.end(), {'I', 'D', 'A', 'T', 0x78, 0x01});
+    size_t dataOffset = out.size();
+    out.resize(dataOffset + zlibSize - 2);
+
+    std::vector<uint8_t> row(rowSize);
+    size_t blockLeft = 0;
+    uint8_t* cursor = out.data() + dataOffset;
+    uint32_t adler = 1;
+    size_t written = 0;
+    for (uint32_t y = 0; y < height; y++) {
+        row[0] = 0;
+        writeRGBRow(pixels + static_cast<size_t>(y) * width * 4, width, order, row.data() + 1);
+        adler = Adler32(row.data(), rowSize, adler);
+
+        size_t rowOffset = 0;
+        while (rowOffset < rowSize) {
+            if (blockLeft == 0) {
+                blockLeft = std::min<size_t>(STORED_BLOCK_SIZE, rawSize - written);
+                uint16_t length = static_cast<uint16_t>(blockLeft);
+                uint16_t inverse = static_cast<uint16_t>(~length);
+                cursor[0] = written + blockLeft == rawSize ? 1 : 0; // BFINAL, BTYPE 00
+                cursor[1] = static_cast<uint8_t>(length);
+                cursor[2] = static_cast<uint8_t>(length >> 8);
+                cursor[3] = static_cast<uint8_t>(inverse);
+                cursor[4] = static_cast<uint8_t>(inverse >> 8);
+                cursor += 5;
+            }
+            size_t count = std::min(blockLeft, rowSize - rowOffset);
+            memcpy(cursor, row.data() + rowOffset, count);
+            cursor += count;
+            rowOffset += count;
+            blockLeft -= count;
+            written += count;
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        cursor[i] = static_cast<uint8_t>(adler >> (24 - i * 8));
+    }
+    appendBigEndian(out, Crc32(out.data() + typeOffset, zlibSize + 4));
+
+    appendChunk(out, "IEND", nullptr, 0);
+}
+
+void ConvertToRGBA(const uint8_t* pixels, uint32_t width, uint32_t height, PixelOrder order, std::vector<uint8_t>& out) {
+    size_t size = static_cast<size_t>(width) * height * 4;
+    out.resize(size);
+    if (order == PixelOrder::RGBA) {
+        memcpy(out.data(), pixels, size);
+        return;
+    }
+    for (size_t i = 0; i < size; i += 4) {
+        out[i] = pixels[i + 2];
+        out[i + 1] = pixels[i + 1];
+        out[i + 2] = pixels[i];
+        out[i + 3] = pixels[i + 3];
+    }
+}
+
+ERR WriteFile(const std::string& fileName, const uint8_t* data, size_t size) {
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        LOG_MSG(ERRLevel::WARNING, "could not open output file: %s", fileName.c_str());
+        return ERR::NOT_FOUND;
+    }
+    file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+    return file.good() ? ERR::OK : ERR::INVALID;
+}
+
+uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc) {
+    static const auto table = []() {
+        std::vector<uint32_t> entries(256);
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; bit++) {
+                value = value & 1 ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+            }
+            entries[i] = value;
+        }
+        return entries;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+uint32_t Adler32(const uint8_t* data, size_t size, uint32_t adler) {
+    constexpr uint32_t MOD = 65521;
+    constexpr size_t RUN = 5552; // longest run before the sums can overflow 32 bits
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    while (size > 0) {
+        size_t count = std::min(size, RUN);
+        size -= count;
+        for (size_t i = 0; i < count; i++) {
+            a += *data++;
+            b += a;
+        }
+        a %= MOD;
+        b %= MOD;
+    }
+    return (b << 16) | a;
+}
+
+} // namespace ImageWriter
@@ -0,0 +1,34 @@
+#ifndef NANOIMAGEWRITER_H_
+#define NANOIMAGEWRITER_H_
+
+#include "NanoError.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 8 bit images to memory and disk, no dependencies. Input is tightly packed 4 channel rows (RGBA, or BGRA as most
+// swapchains are), alpha is dropped. PNG is written with stored (uncompressed) deflate blocks: the files are as big as
+// PPM, but encoding is a copy and two checksums, so a capture isn't limited by a compressor
+namespace ImageWriter {
+
+enum class PixelOrder {
+    RGBA,
+    BGRA,
+};
+
+// binary P6
+void EncodePPM(const uint8_t* pixels, uint32_t width, uint32_t height, PixelOrder order, std::vector<uint8_t>& out);
+// 8 bit RGB, filter type none on every row
+void EncodePNG(const uint8_t* pixels, uint32_t width, uint32_t height, PixelOrder order, std::vector<uint8_t>& out);
+// RGBA, as a raw video stream wants it (e.g. ffmpeg -f rawvideo -pixel_format rgba)
+void ConvertToRGBA(const uint8_t* pixels, uint32_t width, uint32_t height, PixelOrder order, std::vector<uint8_t>& out);
+
+ERR WriteFile(const std::string& fileName, const uint8_t* data, size_t size);
+
+uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+uint32_t Adler32(const uint8_t* data, size_t size, uint32_t adler = 1);
+
+} // namespace ImageWriter
+
+#endif // NANOIMAGEWRITER_H_
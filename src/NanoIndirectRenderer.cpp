@@ -0,0 +1,198 @@
+#include "NanoIndirectRenderer.hpp"
+#include "NanoFrustumCuller.hpp"
+#include "NanoLogger.hpp"
+
+#include <algorithm>
+#include <cfloat>
+
+ERR NanoIndirectRenderer::Init(VkDevice& device, const VkPhysicalDevice& physicalDevice, NanoBindlessHeap& bindlessHeap, NanoMeshArena& meshArena,
+                               NanoSceneBuffer& sceneBuffer, bool drawIndirectCount) {
+    ERR err = ERR::OK;
+    _device = device;
+    _bindlessHeap = &bindlessHeap;
+    _meshArena = &meshArena;
+    _sceneBuffer = &sceneBuffer;
+
+    m_instanceSlot = bindlessHeap.AddStorageBuffer(sceneBuffer.GetBuffer().GetBuffer());
+    m_meshSlot = bindlessHeap.AddStorageBuffer(meshArena.GetMeshBuffer().GetBuffer());
+
+    VkDeviceSize drawBufferSize = DRAW_COMMAND_OFFSET + static_cast<VkDeviceSize>(sceneBuffer.GetCapacity()) * sizeof(VkDrawIndexedIndirectCommand);
+    for (uint32_t i = 0; i < Config::MAX_FRAMES_IN_FLIGHT; i++) {
+        m_drawBuffers[i].Init(device, physicalDevice, drawBufferSize,
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        m_drawSlots[i] = bindlessHeap.AddStorageBuffer(m_drawBuffers[i].GetBuffer());
+        m_drawCapacity[i] = 0;
+    }
+
+    if (m_instanceSlot == BINDLESS_INVALID_SLOT || m_meshSlot == BINDLESS_INVALID_SLOT ||
+        std::find(m_drawSlots, m_drawSlots + Config::MAX_FRAMES_IN_FLIGHT, BINDLESS_INVALID_SLOT) != m_drawSlots + Config::MAX_FRAMES_IN_FLIGHT) {
+        LOG_MSG(ERRLevel::WARNING, "no bindless storage buffer slot left for the indirect renderer");
+        return ERR::INVALID;
+    }
+
+    m_cmdDrawIndexedIndirectCount = nullptr;
+    if (drawIndirectCount) {
+        m_cmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(_device, "vkCmdDrawIndexedIndirectCountKHR");
+    }
+    LOG_MSG(ERRLevel::INFO, "Indirect renderer: %d instances, %s", sceneBuffer.GetCapacity(),
+            m_cmdDrawIndexedIndirectCount ? "draw indirect count" : "max count indirect draws");
+
+    m_stats = {};
+    m_isInit = true;
+    return err;
+}
+
+ERR NanoIndirectRenderer::CreatePipelines(NanoPipelineLayoutCache& layoutCache, const VkRenderPass& renderpass, const VkRenderPass& depthRenderpass,
+                                          const VkExtent2D& extent, const NanoShader& cullShader, const NanoShader& vertShader,
+                                          const NanoShader& fragShader, const NanoShader& depthShader) {
+    ERR err = ERR::OK;
+
+    m_cullPipeline.Init(_device);
+    m_cullPipeline.AddComputeShader(cullShader);
+    m_cullPipeline.AddLayoutCache(layoutCache);
+    m_cullPipeline.AddDescriptorSetLayout(Config::BINDLESS_SET_INDEX, _bindlessHeap->GetDescriptorSetLayout());
+    err = m_cullPipeline.Compile();
+    if (err != ERR::OK) {
+        return err;
+    }
+
+    // vertex inputs are reflected from indirect.vert and match NanoVertex, the layout of the arena
+    m_drawPipeline.Init(_device, extent);
+    m_drawPipeline.AddVertShader(vertShader);
+    m_drawPipeline.AddFragShader(fragShader);
+    m_drawPipeline.AddRenderPass(renderpass);
+    m_drawPipeline.AddLayoutCache(layoutCache);
+    m_drawPipeline.AddDescriptorSetLayout(Config::BINDLESS_SET_INDEX, _bindlessHeap->GetDescriptorSetLayout());
+    m_drawPipeline.AddPushConstantRange(NanoBindlessHeap::GetPushConstantRange());
+    m_hasDepthPrepass = depthRenderpass != VK_NULL_HANDLE;
+    // after the pre-pass the depth is final, only the visible fragment of each pixel passes
+    m_drawPipeline.AddDepthState(m_hasDepthPrepass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS, !m_hasDepthPrepass);
+    err = m_drawPipeline.Compile();
+    if (err != ERR::OK) {
+        return err;
+    }
+
+    if (m_hasDepthPrepass) {
+        // vertex only, the single position input matches the arena's position stream
+        m_depthPipeline.Init(_device, extent);
+        m_depthPipeline.AddVertShader(depthShader);
+        m_depthPipeline.AddRenderPass(depthRenderpass);
+        m_depthPipeline.AddLayoutCache(layoutCache);
+        m_depthPipeline.AddDescriptorSetLayout(Config::BINDLESS_SET_INDEX, _bindlessHeap->GetDescriptorSetLayout());
+        m_depthPipeline.AddPushConstantRange(NanoBindlessHeap::GetPushConstantRange());
+        m_depthPipeline.AddDepthState(VK_COMPARE_OP_LESS, true);
+        err = m_depthPipeline.Compile();
+        if (err != ERR::OK) {
+            m_drawPipeline.CleanUp();
+            return err;
+        }
+    }
+
+    m_hasPipelines = true;
+    return err;
+}
+
+void NanoIndirectRenderer::CleanUp() {
+    if (!m_isInit) {
+        return;
+    }
+    if (m_hasPipelines) {
+        m_cullPipeline.CleanUp();
+        m_drawPipeline.CleanUp();
+        if (m_hasDepthPrepass) {
+            m_depthPipeline.CleanUp();
+        }
+        m_hasPipelines = false;
+    }
+    // the heap goes away with the device, the slots don't need to be released one by one
+    for (uint32_t i = 0; i < Config::MAX_FRAMES_IN_FLIGHT; i++) {
+        m_drawBuffers[i].CleanUp();
+    }
+    m_isInit = false;
+}
+
+void NanoIndirectRenderer::RecordCull(VkCommandBuffer& commandBuffer, uint32_t frameIndex, const glm::mat4& viewProjection, float viewportHeight) {
+    ASSERT(m_hasPipelines, "indirect renderer used before CreatePipelines");
+    m_stats = {};
+    m_stats.instanceCount = GetInstanceCount();
+    m_viewProjection = viewProjection;
+    NanoBuffer& drawBuffer = m_drawBuffers[frameIndex];
+    m_drawCapacity[frameIndex] = GetInstanceCount();
+
+    // the draw buffer is the frame's own, its last reader is done since the fence was waited on. The count alone is
+    // enough when the draw reads it, otherwise stale commands past the survivors have to go too
+    VkDeviceSize clearSize = m_cmdDrawIndexedIndirectCount
+                                 ? sizeof(uint32_t)
+                                 : DRAW_COMMAND_OFFSET + static_cast<VkDeviceSize>(GetInstanceCount()) * sizeof(VkDrawIndexedIndirectCommand);
+    vkCmdFillBuffer(commandBuffer, drawBuffer.GetBuffer(), 0, clearSize, 0);
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    if (GetInstanceCount() > 0) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipeline.GetPipeline());
+        _bindlessHeap->Bind(commandBuffer, m_cullPipeline.GetPipelineLayout(), VK_PIPELINE_BIND_POINT_COMPUTE);
+
+        CullConstants constants{};
+        NanoFrustum frustum = NanoFrustum::FromViewProjection(viewProjection);
+        std::copy(frustum.planes, frustum.planes + 6, constants.planes);
+        constants.instanceCount = GetInstanceCount();
+        constants.instanceBuffer = m_instanceSlot;
+        constants.meshBuffer = m_meshSlot;
+        constants.drawBuffer = m_drawSlots[frameIndex];
+        // the y and w rows of a perspective projection give the pixels per unit at distance 1. Orthographic views have no
+        // w row, they keep LOD 0
+        glm::vec3 rowY(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1]);
+        glm::vec3 rowW(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3]);
+        float projectionScale = glm::length(rowW) > 0.0f ? 0.5f * viewportHeight * glm::length(rowY) / glm::length(rowW) : FLT_MAX;
+        constants.lodScale = projectionScale / Config::LOD_PIXEL_ERROR_THRESHOLD;
+        vkCmdPushConstants(commandBuffer, m_cullPipeline.GetPipelineLayout(), m_cullPipeline.GetPushConstantStages(), 0, sizeof(CullConstants),
+                           &constants);
+
+        m_stats.dispatchedGroups = (GetInstanceCount() + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE;
+        vkCmdDispatch(commandBuffer, m_stats.dispatchedGroups, 1, 1);
+    }
+}
+
+void NanoIndirectRenderer::RecordDraw(VkCommandBuffer& commandBuffer, uint32_t frameIndex) {
+    recordIndirect(commandBuffer, frameIndex, m_drawPipeline, _meshArena->GetVertexBuffer());
+}
+
+void NanoIndirectRenderer::RecordDepth(VkCommandBuffer& commandBuffer, uint32_t frameIndex) {
+    ASSERT(m_hasDepthPrepass, "indirect renderer has no depth pre-pass pipeline");
+    recordIndirect(commandBuffer, frameIndex, m_depthPipeline, _meshArena->GetPositionBuffer());
+}
+
+// the same draw buffer either way, the pre-pass and the main pass rasterize exactly the same triangles
+void NanoIndirectRenderer::recordIndirect(VkCommandBuffer& commandBuffer, uint32_t frameIndex, NanoGraphicsPipeline& pipeline,
+                                          NanoBuffer& vertexBuffer) {
+    uint32_t maxDrawCount = m_drawCapacity[frameIndex];
+    if (maxDrawCount == 0) {
+        return;
+    }
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.GetPipeline());
+    _bindlessHeap->Bind(commandBuffer, pipeline.GetPipelineLayout());
+
+    DrawConstants constants{};
+    constants.material.storageBuffer = m_instanceSlot;
+    constants.viewProjection = m_viewProjection;
+    vkCmdPushConstants(commandBuffer, pipeline.GetPipelineLayout(), pipeline.GetReflection().pushConstantRanges[0].stageFlags, 0,
+                       sizeof(DrawConstants), &constants);
+
+    VkDeviceSize vertexOffset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.GetBuffer(), &vertexOffset);
+    vkCmdBindIndexBuffer(commandBuffer, _meshArena->GetIndexBuffer().GetBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+    VkBuffer& drawBuffer = m_drawBuffers[frameIndex].GetBuffer();
+    if (m_cmdDrawIndexedIndirectCount) {
+        m_cmdDrawIndexedIndirectCount(commandBuffer, drawBuffer, DRAW_COMMAND_OFFSET, drawBuffer, 0, maxDrawCount,
+                                      sizeof(VkDrawIndexedIndirectCommand));
+    } else {
+        vkCmdDrawIndexedIndirect(commandBuffer, drawBuffer, DRAW_COMMAND_OFFSET, maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef NANOINDIRECTRENDERER_H_
+#define NANOINDIRECTRENDERER_H_
+
+#include "NanoBindlessHeap.hpp"
+#include "NanoBuffer.hpp"
+#include "NanoComputePipeline.hpp"
+#include "NanoConfig.hpp"
+#include "NanoError.hpp"
+#include "NanoGraphicsPipeline.hpp"
+#include "NanoMeshArena.hpp"
+#include "NanoSceneBuffer.hpp"
+
+#include "glm/glm.hpp"
+#include "vulkan/vulkan_core.h"
+#include <cstdint>
+
+struct NanoIndirectStats {
+    uint32_t instanceCount = 0;
+    uint32_t dispatchedGroups = 0;
+};
+
+// GPU driven rendering. Instances are read from the scene buffer, a compute pass tests each one against the frustum and
+// appends an indexed indirect command for the survivors, and the whole scene goes out in one indirect draw over the
+// shared mesh arena. The CPU records the same handful of commands every frame whatever the instance count.
+// With VK_KHR_draw_indirect_count the draw reads the survivor count from the GPU. Without it the command list is cleared
+// every frame and drawn with the max count, culled slots are then zero instance draws.
+// Per frame: RecordCull outside of the render pass after the scene buffer upload, RecordDraw inside. Only the barrier
+// between the clear and the dispatch is recorded here, the ones around the pass come from the render graph.
+// Depth pre-pass: with a depth only render pass, RecordDepth draws the same commands from the arena's position stream
+// first, and the main draw tests EQUAL without writing, so fragments are only shaded once per pixel. Without it the main
+// draw tests LESS and writes
+class NanoIndirectRenderer {
+  public:
+    static constexpr uint32_t CULL_GROUP_SIZE = 64; // local_size_x of cull.comp
+    static constexpr VkDeviceSize DRAW_COMMAND_OFFSET = 16; // the draw count comes first in the draw buffer
+
+    ERR Init(VkDevice& device, const VkPhysicalDevice& physicalDevice, NanoBindlessHeap& bindlessHeap, NanoMeshArena& meshArena,
+             NanoSceneBuffer& sceneBuffer, bool drawIndirectCount);
+    // shaders already compiled to SPIR-V, the pipelines use the bindless set. depthRenderpass is VK_NULL_HANDLE without
+    // a depth pre-pass, depthShader is then unused
+    ERR CreatePipelines(NanoPipelineLayoutCache& layoutCache, const VkRenderPass& renderpass, const VkRenderPass& depthRenderpass,
+                        const VkExtent2D& extent, const NanoShader& cullShader, const NanoShader& vertShader, const NanoShader& fragShader,
+                        const NanoShader& depthShader);
+    void CleanUp();
+
+    uint32_t GetInstanceCount() { return _sceneBuffer->GetCount(); }
+    uint32_t GetInstanceSlot() { return m_instanceSlot; } // the scene buffer's bindless storage buffer slot
+
+    // outside of a render pass, after the frame's fence was waited on. The draw buffer needs a compute write to indirect
+    // read barrier before RecordDraw. viewportHeight is what the LOD error is measured against
+    void RecordCull(VkCommandBuffer& commandBuffer, uint32_t frameIndex, const glm::mat4& viewProjection, float viewportHeight);
+    void RecordDraw(VkCommandBuffer& commandBuffer, uint32_t frameIndex);
+    // inside the depth only render pass, after the same compute write to indirect read barrier
+    void RecordDepth(VkCommandBuffer& commandBuffer, uint32_t frameIndex);
+
+    bool IsInit() { return m_isInit; }
+    bool HasDrawIndirectCount() { return m_cmdDrawIndexedIndirectCount != nullptr; }
+    bool HasDepthPrepass() { return m_hasDepthPrepass; }
+    const NanoIndirectStats& GetStats() { return m_stats; }
+
+  private:
+    // matches the push constant blocks of cull.comp and indirect.vert / depth.vert
+    struct CullConstants {
+        glm::vec4 planes[6];
+        uint32_t instanceCount;
+        uint32_t instanceBuffer; // bindless storage buffer slots
+        uint32_t meshBuffer;
+        uint32_t drawBuffer;
+        float lodScale;
+    };
+    struct DrawConstants {
+        NanoMaterialIndices material; // storageBuffer is the instance buffer
+        glm::mat4 viewProjection;
+    };
+
+    void recordIndirect(VkCommandBuffer& commandBuffer, uint32_t frameIndex, NanoGraphicsPipeline& pipeline, NanoBuffer& vertexBuffer);
+
+    VkDevice _device{};
+    NanoBindlessHeap* _bindlessHeap = nullptr;
+    NanoMeshArena* _meshArena = nullptr;
+    NanoSceneBuffer* _sceneBuffer = nullptr;
+    bool m_isInit = false;
+
+    uint32_t m_instanceSlot = BINDLESS_INVALID_SLOT;
+    uint32_t m_meshSlot = BINDLESS_INVALID_SLOT;
+    // one per frame in flight, so culling never waits on the previous frame's draw
+    NanoBuffer m_drawBuffers[Config::MAX_FRAMES_IN_FLIGHT]{};
+    uint32_t m_drawSlots[Config::MAX_FRAMES_IN_FLIGHT]{};
+    uint32_t m_drawCapacity[Config::MAX_FRAMES_IN_FLIGHT]{}; // commands the frame's cull pass may have written
+    PFN_vkCmdDrawIndexedIndirectCountKHR m_cmdDrawIndexedIndirectCount = nullptr;
+
+    NanoComputePipeline m_cullPipeline{};
+    NanoGraphicsPipeline m_drawPipeline{};
+    NanoGraphicsPipeline m_depthPipeline{};
+    bool m_hasPipelines = false;
+    bool m_hasDepthPrepass = false;
+    glm::mat4 m_viewProjection{1.0f};
+    NanoIndirectStats m_stats{};
+};
+
+#endif // NANOINDIRECTRENDERER_H_
@@ -0,0 +1,411 @@
+#include "NanoJobSystem.hpp"
+#include "NanoLogger.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+static thread_local uint32_t s_threadIndex = std::numeric_limits<uint32_t>::max();
+
+// NanoJobDeque
+////////////////////////////////////////////////////////////////////////////////
+
+void NanoJobDeque::Init(uint32_t capacity) {
+    ASSERT((capacity & (capacity - 1)) == 0, "job deque capacity must be a power of two");
+    m_jobs = std::make_unique<std::atomic<NanoJob*>[]>(capacity);
+    m_mask = static_cast<int64_t>(capacity) - 1;
+    m_top.store(0, std::memory_order_relaxed);
+    m_bottom.store(0, std::memory_order_relaxed);
+}
+
+bool NanoJobDeque::Push(NanoJob* job) {
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    int64_t top = m_top.load(std::memory_order_acquire);
+    if (bottom - top > m_mask) {
+        return false;
+    }
+
+    m_jobs[bottom & m_mask].store(job, std::memory_order_relaxed);
+    m_bottom.store(bottom + 1, std::memory_order_release); // publishes the job to the thieves
+    return true;
+}
+
+NanoJob* NanoJobDeque::Pop() {
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = m_top.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+        // was empty
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    NanoJob* job = m_jobs[bottom & m_mask].load(std::memory_order_relaxed);
+    if (top == bottom) {
+        // last one, race the thieves for it
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            job = nullptr;
+        }
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+NanoJob* NanoJobDeque::Steal() {
+    int64_t top = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = m_bottom.load(std::memory_order_acquire);
+    if (top >= bottom) {
+        return nullptr;
+    }
+
+    NanoJob* job = m_jobs[top & m_mask].load(std::memory_order_relaxed);
+    if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr; // lost to the owner or another thief
+    }
+    return job;
+}
+
+bool NanoJobDeque::IsEmpty() const {
+    return m_top.load(std::memory_order_relaxed) >= m_bottom.load(std::memory_order_relaxed);
+}
+
+// NanoJobSystem
+////////////////////////////////////////////////////////////////////////////////
+
+static void pinCurrentThread(uint32_t core) {
+#ifdef _WIN32
+    SetThreadAffinityMask(GetCurrentThread(), 1ull << (core % 64));
+#elif defined(__linux__)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(core % CPU_SETSIZE, &cpuSet);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet);
+#else
+    (void)core; // macOS has no hard affinity, the scheduler only takes hints
+#endif
+}
+
+ERR NanoJobSystem::Init(uint32_t workerCount, bool pinThreads) {
+    if (m_isInit) {
+        return ERR::OK;
+    }
+
+    if (workerCount == AUTO_WORKER_COUNT) {
+        uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+        workerCount = hardwareThreads - 1;
+    }
+
+    m_stop.store(false);
+    m_queuedJobs.store(0);
+    m_sleepingWorkers.store(0);
+    m_blockedWaiters.store(0);
+
+    m_threads.resize(workerCount + 1);
+    for (uint32_t i = 0; i < m_threads.size(); i++) {
+        m_threads[i] = std::make_unique<ThreadData>();
+        m_threads[i]->deque.Init(DEQUE_CAPACITY);
+        m_threads[i]->jobPool = std::make_unique<NanoJob[]>(JOB_POOL_SIZE);
+        m_threads[i]->randomState = 0x9E3779B9u * (i + 1);
+    }
+
+    s_threadIndex = 0;
+    if (pinThreads) {
+        pinCurrentThread(0);
+    }
+
+    m_workers.reserve(workerCount);
+    for (uint32_t i = 1; i <= workerCount; i++) {
+        m_workers.emplace_back([this, i, pinThreads]() {
+            if (pinThreads) {
+                pinCurrentThread(i);
+            }
+            WorkerLoop(i);
+        });
+    }
+
+    m_isInit = true;
+    LOG_MSG(ERRLevel::INFO, "Job system: %d worker threads%s", static_cast<int>(workerCount), pinThreads ? " (pinned)" : "");
+    return ERR::OK;
+}
+
+void NanoJobSystem::CleanUp() {
+    if (!m_isInit) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_stop.store(true);
+    }
+    m_wakeCondition.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+    m_workers.clear();
+
+    // whatever is still queued never ran, the owners of the counters are expected to have waited on them
+    for (NanoJob* job : m_sharedJobs) {
+        delete job;
+    }
+    m_sharedJobs.clear();
+    m_threads.clear();
+
+    s_threadIndex = std::numeric_limits<uint32_t>::max();
+    m_isInit = false;
+}
+
+uint32_t NanoJobSystem::GetThreadIndex() {
+    return s_threadIndex;
+}
+
+NanoJob* NanoJobSystem::AllocateJob(std::function<void()>&& function, NanoJobCounter* counter) {
+    NanoJob* job = nullptr;
+
+    if (s_threadIndex < m_threads.size()) {
+        // jobs are freed by whichever thread ran them, only the owner hands them out.
+        // The ring hands out the oldest slot next, if a few in a row are still busy the pool is saturated
+        ThreadData& thread = *m_threads[s_threadIndex];
+        for (uint32_t i = 0; i < JOB_POOL_PROBES && !job; i++) {
+            NanoJob* candidate = &thread.jobPool[thread.poolCursor];
+            thread.poolCursor = (thread.poolCursor + 1) & (JOB_POOL_SIZE - 1);
+            if (!candidate->inUse.load(std::memory_order_acquire)) {
+                job = candidate;
+                job->pooled = true;
+            }
+        }
+    }
+    if (!job) {
+        job = new NanoJob();
+        job->pooled = false;
+    }
+
+    job->inUse.store(true, std::memory_order_relaxed);
+    job->function = std::move(function);
+    job->counter = counter;
+    if (counter) {
+        counter->m_value.fetch_add(1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+void NanoJobSystem::Submit(NanoJob* job) {
+    bool queued = false;
+    if (s_threadIndex < m_threads.size()) {
+        queued = m_threads[s_threadIndex]->deque.Push(job);
+        if (!queued) {
+            // deque is full, there is plenty of work around already
+            Execute(job);
+            return;
+        }
+    } else {
+        std::lock_guard<std::mutex> lock(m_sharedMutex);
+        m_sharedJobs.push_back(job);
+        queued = true;
+    }
+
+    m_queuedJobs.fetch_add(1, std::memory_order_seq_cst);
+    if (m_sleepingWorkers.load(std::memory_order_seq_cst) > 0) {
+        // taking the lock orders this against a worker that checked the queue but isn't waiting yet
+        { std::lock_guard<std::mutex> lock(m_wakeMutex); }
+        m_wakeCondition.notify_one();
+    }
+}
+
+void NanoJobSystem::Run(std::function<void()> function, NanoJobCounter* counter) {
+    if (!m_isInit) {
+        function(); // keeps callers working before Init / after CleanUp
+        return;
+    }
+    Submit(AllocateJob(std::move(function), counter));
+}
+
+void NanoJobSystem::RunAfter(NanoJobCounter& dependency, std::function<void()> function, NanoJobCounter* counter) {
+    if (!m_isInit) {
+        function();
+        return;
+    }
+
+    NanoJob* job = AllocateJob(std::move(function), counter);
+    {
+        std::lock_guard<std::mutex> lock(dependency.m_mutex);
+        if (dependency.GetValue() != 0) {
+            dependency.m_continuations.push_back(job);
+            return;
+        }
+    }
+    Submit(job);
+}
+
+NanoJob* NanoJobSystem::FindJob(uint32_t threadIndex) {
+    NanoJob* job = nullptr;
+
+    if (threadIndex < m_threads.size()) {
+        job = m_threads[threadIndex]->deque.Pop();
+    }
+
+    if (!job && m_queuedJobs.load(std::memory_order_relaxed) > 0) {
+        // random victim, so thieves don't all pile onto the same deque
+        uint32_t threadCount = static_cast<uint32_t>(m_threads.size());
+        uint32_t start = 0;
+        if (threadIndex < threadCount) {
+            uint32_t& state = m_threads[threadIndex]->randomState;
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            start = state % threadCount;
+        }
+        for (uint32_t i = 0; i < threadCount && !job; i++) {
+            uint32_t victim = (start + i) % threadCount;
+            if (victim != threadIndex) {
+                job = m_threads[victim]->deque.Steal();
+            }
+        }
+    }
+
+    if (!job) {
+        std::lock_guard<std::mutex> lock(m_sharedMutex);
+        if (!m_sharedJobs.empty()) {
+            job = m_sharedJobs.back();
+            m_sharedJobs.pop_back();
+        }
+    }
+
+    if (job) {
+        m_queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+void NanoJobSystem::Execute(NanoJob* job) {
+    job->function();
+    job->function = nullptr; // drops the captures now rather than when the slot gets reused
+
+    NanoJobCounter* counter = job->counter;
+    if (job->pooled) {
+        job->inUse.store(false, std::memory_order_release);
+    } else {
+        delete job;
+    }
+
+    if (counter) {
+        Decrement(*counter);
+    }
+}
+
+void NanoJobSystem::Decrement(NanoJobCounter& counter) {
+    counter.m_finishing.fetch_add(1, std::memory_order_seq_cst);
+    if (counter.m_value.fetch_sub(1, std::memory_order_seq_cst) == 1) {
+        std::vector<NanoJob*> continuations{};
+        {
+            std::lock_guard<std::mutex> lock(counter.m_mutex);
+            continuations.swap(counter.m_continuations);
+        }
+        for (NanoJob* job : continuations) {
+            Submit(job);
+        }
+    }
+    // last access, the counter may be gone after this
+    counter.m_finishing.fetch_sub(1, std::memory_order_seq_cst);
+
+    if (m_blockedWaiters.load(std::memory_order_seq_cst) > 0) {
+        { std::lock_guard<std::mutex> lock(m_counterMutex); }
+        m_counterCondition.notify_all();
+    }
+}
+
+void NanoJobSystem::Wait(NanoJobCounter& counter, NanoJobWait mode) {
+    if (!m_isInit) {
+        return;
+    }
+
+    if (mode == NanoJobWait::BLOCK) {
+        m_blockedWaiters.fetch_add(1, std::memory_order_seq_cst);
+        {
+            std::unique_lock<std::mutex> lock(m_counterMutex);
+            m_counterCondition.wait(lock, [&counter]() { return counter.IsDone(); });
+        }
+        m_blockedWaiters.fetch_sub(1, std::memory_order_seq_cst);
+    } else {
+        while (!counter.IsDone()) {
+            NanoJob* job = FindJob(s_threadIndex);
+            if (job) {
+                Execute(job);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+}
+
+bool NanoJobSystem::RunPendingJob() {
+    if (!m_isInit) {
+        return false;
+    }
+    NanoJob* job = FindJob(s_threadIndex);
+    if (job) {
+        Execute(job);
+    }
+    return job != nullptr;
+}
+
+void NanoJobSystem::WorkerLoop(uint32_t threadIndex) {
+    s_threadIndex = threadIndex;
+
+    uint32_t idleSpins = 0;
+    while (!m_stop.load(std::memory_order_relaxed)) {
+        NanoJob* job = FindJob(threadIndex);
+        if (job) {
+            Execute(job);
+            idleSpins = 0;
+            continue;
+        }
+
+        if (++idleSpins < IDLE_SPIN_COUNT) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+        m_wakeCondition.wait(lock, [this]() { return m_queuedJobs.load(std::memory_order_seq_cst) > 0 || m_stop.load(); });
+        m_sleepingWorkers.fetch_sub(1, std::memory_order_seq_cst);
+        idleSpins = 0;
+    }
+}
+
+void NanoJobSystem::ParallelForRange(uint32_t begin, uint32_t end, uint32_t grain, const std::function<void(uint32_t, uint32_t)>* function,
+                                     NanoJobCounter* counter) {
+    // keep the lower half, offer the upper half to thieves, until the range is small enough to just run
+    while (end - begin > grain) {
+        uint32_t middle = begin + (end - begin) / 2;
+        Run([this, middle, end, grain, function, counter]() { ParallelForRange(middle, end, grain, function, counter); }, counter);
+        end = middle;
+    }
+    (*function)(begin, end);
+}
+
+void NanoJobSystem::ParallelFor(uint32_t count, uint32_t minChunk, const std::function<void(uint32_t begin, uint32_t end)>& function) {
+    if (count == 0) {
+        return;
+    }
+
+    uint32_t threadCount = m_isInit ? GetThreadCount() : 1;
+    uint32_t grain = std::max({1u, minChunk, count / (threadCount * PARALLEL_FOR_CHUNKS_PER_THREAD)});
+    if (threadCount == 1 || count <= grain) {
+        function(0, count);
+        return;
+    }
+
+    NanoJobCounter counter{};
+    ParallelForRange(0, count, grain, &function, &counter);
+    Wait(counter);
+}
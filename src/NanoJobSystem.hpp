@@ -0,0 +1,128 @@
+#ifndef NANOJOBSYSTEM_H_
+#define NANOJOBSYSTEM_H_
+
+#include "NanoError.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class NanoJobCounter;
+
+struct NanoJob {
+    std::function<void()> function{};
+    NanoJobCounter* counter = nullptr; // decremented once the function returned
+    bool pooled = false;               // false when allocated from a thread that isn't part of the job system
+    std::atomic<bool> inUse{false};
+};
+
+// Jobs that are started with a counter increment it, and decrement it when they are done.
+// Other jobs can be chained behind a counter (NanoJobSystem::RunAfter), they are queued as soon as it reaches zero
+class NanoJobCounter {
+  public:
+    uint32_t GetValue() const { return m_value.load(std::memory_order_acquire); }
+    // also waits for the thread that brought the value to zero to be done with the counter, so the owner can destroy it right after
+    bool IsDone() const { return GetValue() == 0 && m_finishing.load(std::memory_order_acquire) == 0; }
+
+  private:
+    friend class NanoJobSystem;
+    std::atomic<uint32_t> m_value{0};
+    std::atomic<uint32_t> m_finishing{0}; // decrements in flight
+    std::mutex m_mutex{};
+    std::vector<NanoJob*> m_continuations{};
+};
+
+// Chase-Lev work stealing deque (Le et al. "Correct and Efficient Work-Stealing for Weak Memory Models").
+// The owner pushes and pops at the bottom, LIFO, other threads steal from the top, FIFO. Fixed capacity, Push fails when full
+class NanoJobDeque {
+  public:
+    void Init(uint32_t capacity); // power of two
+    bool Push(NanoJob* job);      // owner only
+    NanoJob* Pop();               // owner only
+    NanoJob* Steal();             // any thread
+    bool IsEmpty() const;
+
+  private:
+    alignas(64) std::atomic<int64_t> m_top{0};
+    alignas(64) std::atomic<int64_t> m_bottom{0};
+    std::unique_ptr<std::atomic<NanoJob*>[]> m_jobs{};
+    int64_t m_mask = 0;
+};
+
+enum class NanoJobWait {
+    HELP,  // run other jobs until the counter is done, the default
+    BLOCK, // sleep, for threads that must not pick up unrelated work (e.g. while holding a lock a job may want)
+};
+
+// Fixed pool of worker threads, each with its own deque. The thread calling Init becomes thread 0 and takes part in the work
+// whenever it waits. Idle workers steal from a random victim, and go to sleep after a short spin when there is nothing to steal
+class NanoJobSystem {
+  public:
+    static constexpr uint32_t DEQUE_CAPACITY = 4096;          // per thread
+    static constexpr uint32_t JOB_POOL_SIZE = 4096;           // per thread, power of two
+    static constexpr uint32_t JOB_POOL_PROBES = 16;           // slots tried before a job falls back to the heap
+    static constexpr uint32_t IDLE_SPIN_COUNT = 64;           // steal attempts before a worker goes to sleep
+    static constexpr uint32_t PARALLEL_FOR_CHUNKS_PER_THREAD = 8;
+
+    static constexpr uint32_t AUTO_WORKER_COUNT = UINT32_MAX; // one worker per hardware thread, minus the calling thread
+
+    ERR Init(uint32_t workerCount = AUTO_WORKER_COUNT, bool pinThreads = false);
+    void CleanUp();
+
+    void Run(std::function<void()> function, NanoJobCounter* counter = nullptr);
+    // queued once dependency reaches zero. counter is incremented right away, so waiting on it also covers the wait for dependency
+    void RunAfter(NanoJobCounter& dependency, std::function<void()> function, NanoJobCounter* counter = nullptr);
+    void Wait(NanoJobCounter& counter, NanoJobWait mode = NanoJobWait::HELP);
+    // runs one queued job on the calling thread, false when there was nothing to run. For loops that wait on something else than a counter
+    bool RunPendingJob();
+
+    // function(begin, end) over [0, count). The range is split in halves lazily, thieves take the biggest remaining half first.
+    // Chunks never get smaller than minChunk, and the caller works on the range too. Returns once everything is done
+    void ParallelFor(uint32_t count, uint32_t minChunk, const std::function<void(uint32_t begin, uint32_t end)>& function);
+
+    bool IsInit() { return m_isInit; }
+    uint32_t GetThreadCount() { return static_cast<uint32_t>(m_threads.size()); } // workers + the thread that called Init
+    static uint32_t GetThreadIndex();                                              // UINT32_MAX outside of the job system
+
+  private:
+    struct ThreadData {
+        NanoJobDeque deque{};
+        std::unique_ptr<NanoJob[]> jobPool{};
+        uint32_t poolCursor = 0;
+        uint32_t randomState = 0;
+    };
+
+    void WorkerLoop(uint32_t threadIndex);
+    NanoJob* AllocateJob(std::function<void()>&& function, NanoJobCounter* counter);
+    void Submit(NanoJob* job);
+    NanoJob* FindJob(uint32_t threadIndex);
+    void Execute(NanoJob* job);
+    void Decrement(NanoJobCounter& counter);
+    void ParallelForRange(uint32_t begin, uint32_t end, uint32_t grain, const std::function<void(uint32_t, uint32_t)>* function,
+                          NanoJobCounter* counter);
+
+    bool m_isInit = false;
+    std::vector<std::unique_ptr<ThreadData>> m_threads{};
+    std::vector<std::thread> m_workers{};
+    std::atomic<bool> m_stop{false};
+
+    // jobs from threads that have no deque of their own
+    std::mutex m_sharedMutex{};
+    std::vector<NanoJob*> m_sharedJobs{};
+
+    std::atomic<int32_t> m_queuedJobs{0}; // pushed but not yet picked up, what sleeping workers wake up for
+    std::atomic<int32_t> m_sleepingWorkers{0};
+    std::mutex m_wakeMutex{};
+    std::condition_variable m_wakeCondition{};
+
+    std::atomic<int32_t> m_blockedWaiters{0};
+    std::mutex m_counterMutex{};
+    std::condition_variable m_counterCondition{};
+};
+
+#endif // NANOJOBSYSTEM_H_
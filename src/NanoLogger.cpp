@@ -6,6 +6,7 @@ Logger *Logger::oneAndOnlyInstance = nullptr;
 int Logger::uniqueID = 0;
 ERRLevel Logger::severity = ERRLevel::INFO;
 std::vector<std::string> Logger::logMessages{};
+std::mutex Logger::logMutex{};
 int ScopeTracker::indentTracker = 1;
 
 static std::string severityEnumToString(ERRLevel severityLevel) {
@@ -88,6 +89,7 @@ void Logger::Log(ERRLevel messageSeverity, const char *fmt, ...) {
 
     va_end(args);
 
+    std::lock_guard<std::mutex> lock(logMutex);
     logMessages.push_back(message.str());
 
     if (messageSeverity <= severity) {
@@ -153,6 +155,7 @@ void Logger::LogVerbose(ERRLevel messageSeverity, const char* fileName, const in
 
     va_end(args);
 
+    std::lock_guard<std::mutex> lock(logMutex);
     logMessages.push_back(message.str());
 
     if (messageSeverity <= severity) {
@@ -210,6 +213,7 @@ void Logger::LogVar(ERRLevel messageSeverity, const char *fmt, ...) {
 
     va_end(args);
 
+    std::lock_guard<std::mutex> lock(logMutex);
     logMessages.push_back(message.str());
 
     if (messageSeverity <= severity) {
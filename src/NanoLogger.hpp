@@ -7,6 +7,7 @@
 
 #include <cstdarg>
 #include <iostream>
+#include <mutex>
 #include <sstream>
 #include <vector>
 
@@ -42,6 +43,7 @@ class Logger { // singleton
     static int uniqueID;
     static ERRLevel severity;
     static std::vector<std::string> logMessages;
+    static std::mutex logMutex; // init tasks log from the job system's workers
 
   public:
     static Logger *get_instance(const int num = 0) {
@@ -0,0 +1,103 @@
+#include "NanoMappedFile.hpp"
+#include "NanoLogger.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+NanoMappedFile::~NanoMappedFile() {
+    Close();
+}
+
+#ifdef _WIN32
+ERR NanoMappedFile::Open(const std::string &fileName) {
+    Close();
+
+    HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        LOG_MSG(ERRLevel::WARNING, "could not open file: %s", fileName.c_str());
+        return ERR::NOT_FOUND;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return ERR::INVALID;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) {
+        CloseHandle(file);
+        return ERR::INVALID;
+    }
+
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return ERR::INVALID;
+    }
+
+    m_fileHandle = file;
+    m_mappingHandle = mapping;
+    m_data = static_cast<const uint8_t *>(data);
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+    return ERR::OK;
+}
+
+void NanoMappedFile::Close() {
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_mappingHandle);
+        CloseHandle(m_fileHandle);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_fileHandle = nullptr;
+    m_mappingHandle = nullptr;
+}
+#else
+ERR NanoMappedFile::Open(const std::string &fileName) {
+    Close();
+
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG_MSG(ERRLevel::WARNING, "could not open file: %s", fileName.c_str());
+        return ERR::NOT_FOUND;
+    }
+
+    struct stat fileStat {};
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+        close(fd);
+        return ERR::INVALID;
+    }
+
+    void *data = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps its own reference to the file
+    if (data == MAP_FAILED) {
+        LOG_MSG(ERRLevel::WARNING, "could not map file: %s", fileName.c_str());
+        return ERR::INVALID;
+    }
+
+    // the whole file is going to be streamed into the staging buffer front to back
+    madvise(data, static_cast<size_t>(fileStat.st_size), MADV_SEQUENTIAL);
+    madvise(data, static_cast<size_t>(fileStat.st_size), MADV_WILLNEED);
+
+    m_data = static_cast<const uint8_t *>(data);
+    m_size = static_cast<size_t>(fileStat.st_size);
+    return ERR::OK;
+}
+
+void NanoMappedFile::Close() {
+    if (m_data) {
+        munmap(const_cast<uint8_t *>(m_data), m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+}
+#endif
@@ -0,0 +1,35 @@
+#ifndef NANOMAPPEDFILE_H_
+#define NANOMAPPEDFILE_H_
+
+#include "NanoError.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file. Pages are only brought in when they are touched,
+// so copying a stream out of it does not go through an intermediate buffer.
+class NanoMappedFile {
+  public:
+    NanoMappedFile() = default;
+    ~NanoMappedFile();
+    NanoMappedFile(const NanoMappedFile &other) = delete;
+    NanoMappedFile &operator=(const NanoMappedFile &other) = delete;
+
+    ERR Open(const std::string &fileName);
+    void Close();
+
+    bool IsOpen() { return m_data != nullptr; }
+    const uint8_t *GetData() { return m_data; }
+    size_t GetSize() { return m_size; }
+
+  private:
+    const uint8_t *m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void *m_fileHandle = nullptr;
+    void *m_mappingHandle = nullptr;
+#endif
+};
+
+#endif // NANOMAPPEDFILE_H_
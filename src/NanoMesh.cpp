@@ -0,0 +1,131 @@
+#include "NanoMesh.hpp"
+#include "NanoLogger.hpp"
+#include "NanoMappedFile.hpp"
+
+#include <cstddef>
+#include <cstring>
+
+static ERR uploadStream(VkDevice& device, const VkPhysicalDevice& physicalDevice, NanoStagingRing& stagingRing, const NanoMeshView& view,
+                        const NanoMeshStream& stream, VkBufferUsageFlags usage, NanoBuffer& buffer) {
+    if (stream.compression != NanoMeshCompression::NONE) {
+        LOG_MSG(ERRLevel::WARNING, "mesh stream uses an unsupported compression: %d", static_cast<int>(stream.compression));
+        return ERR::INVALID;
+    }
+
+    buffer.Init(device, physicalDevice, stream.uncompressedSize, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    // straight from the mapped pages into the staging ring, no parsing in between
+    return stagingRing.UploadBuffer(buffer.GetBuffer(), 0, view.GetStreamData(stream), stream.size);
+}
+
+ERR NanoMesh::Load(VkDevice& device, const VkPhysicalDevice& physicalDevice, NanoStagingRing& stagingRing, const std::string& meshFile) {
+    ERR err = ERR::OK;
+
+    NanoMappedFile file{};
+    err = file.Open(meshFile);
+    if (err != ERR::OK) {
+        return err;
+    }
+
+    NanoMeshView view{};
+    if (view.Open(file.GetData(), file.GetSize()) != ERR::OK) {
+        LOG_MSG(ERRLevel::WARNING, "not a valid nmesh file (or wrong version): %s", meshFile.c_str());
+        return ERR::INVALID;
+    }
+    m_header = *view.header;
+
+    const NanoMeshStream* vertexStream = view.FindStream(NanoMeshStreamType::VERTEX);
+    const NanoMeshStream* indexStream = view.FindStream(NanoMeshStreamType::INDEX);
+    if (!vertexStream || !indexStream) {
+        LOG_MSG(ERRLevel::WARNING, "nmesh file is missing its vertex or index stream: %s", meshFile.c_str());
+        return ERR::INVALID;
+    }
+
+    err = uploadStream(device, physicalDevice, stagingRing, view, *vertexStream, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, m_vertexBuffer);
+    if (err != ERR::OK) {
+        return err;
+    }
+    err = uploadStream(device, physicalDevice, stagingRing, view, *indexStream, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, m_indexBuffer);
+    if (err != ERR::OK) {
+        return err;
+    }
+
+    m_lods.clear();
+    const NanoMeshStream* lodStream = view.FindStream(NanoMeshStreamType::LODS);
+    if (lodStream && lodStream->compression == NanoMeshCompression::NONE && lodStream->size >= sizeof(NanoMeshLod)) {
+        m_lods.resize(lodStream->size / sizeof(NanoMeshLod));
+        memcpy(m_lods.data(), view.GetStreamData(*lodStream), m_lods.size() * sizeof(NanoMeshLod));
+    } else {
+        m_lods.push_back({0, m_header.indexCount, 0.0f, 0});
+    }
+
+    // optional, older files and files that skipped the optimizer just don't have them
+    const NanoMeshStream* meshletStream = view.FindStream(NanoMeshStreamType::MESHLETS);
+    const NanoMeshStream* meshletVertexStream = view.FindStream(NanoMeshStreamType::MESHLET_VERTICES);
+    const NanoMeshStream* meshletTriangleStream = view.FindStream(NanoMeshStreamType::MESHLET_TRIANGLES);
+    if (meshletStream && meshletVertexStream && meshletTriangleStream && meshletStream->uncompressedSize > 0) {
+        err = uploadStream(device, physicalDevice, stagingRing, view, *meshletStream, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_meshletBuffer);
+        if (err != ERR::OK) {
+            return err;
+        }
+        err = uploadStream(device, physicalDevice, stagingRing, view, *meshletVertexStream, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                           m_meshletVertexBuffer);
+        if (err != ERR::OK) {
+            return err;
+        }
+        err = uploadStream(device, physicalDevice, stagingRing, view, *meshletTriangleStream, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                           m_meshletTriangleBuffer);
+        if (err != ERR::OK) {
+            return err;
+        }
+        m_meshletCount = static_cast<uint32_t>(meshletStream->uncompressedSize / sizeof(NanoMeshlet));
+    }
+
+    // the mapping is released when we return, the copies have to be done reading from it
+    err = stagingRing.Flush();
+
+    LOG_MSG(ERRLevel::INFO, "loaded mesh %s: %d vertices, %d indices, %d LODs, %d meshlets%s", meshFile.c_str(), m_header.vertexCount,
+            m_lods[0].indexCount, static_cast<int>(m_lods.size()), m_meshletCount, IsQuantized() ? " (quantized)" : "");
+    return err;
+}
+
+void NanoMesh::CleanUp() {
+    m_vertexBuffer.CleanUp();
+    m_indexBuffer.CleanUp();
+    m_meshletBuffer.CleanUp();
+    m_meshletVertexBuffer.CleanUp();
+    m_meshletTriangleBuffer.CleanUp();
+    m_meshletCount = 0;
+    m_lods.clear();
+}
+
+void NanoMesh::GetVertexInputDescription(bool quantized, VkVertexInputBindingDescription& bindingDescription,
+                                         std::vector<VkVertexInputAttributeDescription>& attributeDescriptions) {
+    bindingDescription = {};
+    bindingDescription.binding = 0;
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    attributeDescriptions.resize(3);
+
+    for (uint32_t i = 0; i < 3; i++) {
+        attributeDescriptions[i].location = i;
+        attributeDescriptions[i].binding = 0;
+    }
+
+    if (quantized) {
+        bindingDescription.stride = sizeof(NanoQuantizedVertex);
+        attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM; // rescaled with the mesh quantization in the shader
+        attributeDescriptions[0].offset = offsetof(NanoQuantizedVertex, position);
+        attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM; // octahedral
+        attributeDescriptions[1].offset = offsetof(NanoQuantizedVertex, normal);
+        attributeDescriptions[2].format = VK_FORMAT_R16G16_SFLOAT;
+        attributeDescriptions[2].offset = offsetof(NanoQuantizedVertex, uv);
+    } else {
+        bindingDescription.stride = sizeof(NanoVertex);
+        attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+        attributeDescriptions[0].offset = offsetof(NanoVertex, position);
+        attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+        attributeDescriptions[1].offset = offsetof(NanoVertex, normal);
+        attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+        attributeDescriptions[2].offset = offsetof(NanoVertex, uv);
+    }
+}
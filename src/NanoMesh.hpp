@@ -0,0 +1,51 @@
+#ifndef NANOMESH_H_
+#define NANOMESH_H_
+
+#include "NanoBuffer.hpp"
+#include "NanoConfig.hpp"
+#include "NanoError.hpp"
+#include "NanoMeshFormat.hpp"
+#include "NanoStagingRing.hpp"
+
+#include "vulkan/vulkan_core.h"
+#include <string>
+#include <vector>
+
+// GPU side of a .nmesh file: one device local vertex buffer and one index buffer,
+// plus the meshlet streams as storage buffers when the file went through NanoMeshOptimizer
+class NanoMesh {
+  public:
+    ERR Load(VkDevice& device, const VkPhysicalDevice& physicalDevice, NanoStagingRing& stagingRing, const std::string& meshFile);
+    void CleanUp();
+
+    NanoBuffer& GetVertexBuffer() { return m_vertexBuffer; }
+    NanoBuffer& GetIndexBuffer() { return m_indexBuffer; }
+    const NanoMeshHeader& GetHeader() { return m_header; }
+    uint32_t GetIndexCount() { return m_lods.empty() ? 0 : m_lods[0].indexCount; } // LOD 0
+    uint32_t GetLodCount() { return static_cast<uint32_t>(m_lods.size()); }
+    const NanoMeshLod& GetLod(uint32_t lod) { return m_lods[lod]; }
+    VkIndexType GetIndexType() { return (m_header.flags & NANOMESH_FLAG_INDEX_32) ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16; }
+    bool IsQuantized() { return m_header.flags & NANOMESH_FLAG_QUANTIZED; }
+
+    bool HasMeshlets() { return m_meshletCount > 0; }
+    uint32_t GetMeshletCount() { return m_meshletCount; }
+    NanoBuffer& GetMeshletBuffer() { return m_meshletBuffer; }
+    NanoBuffer& GetMeshletVertexBuffer() { return m_meshletVertexBuffer; }
+    NanoBuffer& GetMeshletTriangleBuffer() { return m_meshletTriangleBuffer; }
+
+    // vertex input state matching either NanoVertex or NanoQuantizedVertex, bound at binding 0
+    static void GetVertexInputDescription(bool quantized, VkVertexInputBindingDescription& bindingDescription,
+                                          std::vector<VkVertexInputAttributeDescription>& attributeDescriptions);
+
+  private:
+    NanoMeshHeader m_header{};
+    std::vector<NanoMeshLod> m_lods{};
+    NanoBuffer m_vertexBuffer{};
+    NanoBuffer m_indexBuffer{};
+    uint32_t m_meshletCount = 0;
+    NanoBuffer m_meshletBuffer{};
+    NanoBuffer m_meshletVertexBuffer{};
+    NanoBuffer m_meshletTriangleBuffer{};
+};
+
+#endif // NANOMESH_H_
@@ -0,0 +1,370 @@
+#include "NanoMeshArena.hpp"
+#include "NanoLogger.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+ERR NanoMeshArena::Init(VkDevice& device, const VkPhysicalDevice& physicalDevice, uint32_t vertexCapacity, uint32_t indexCapacity,
+                        uint32_t meshCapacity) {
+    ERR err = ERR::OK;
+    _device = device;
+    _physicalDevice = physicalDevice;
+    m_vertexCapacity = vertexCapacity;
+    m_indexCapacity = indexCapacity;
+    m_meshCapacity = meshCapacity;
+    m_vertexCount = 0;
+    m_indexCount = 0;
+    m_freeVertexCount = 0;
+    m_freeIndexCount = 0;
+    m_meshes.clear();
+    m_allocations.clear();
+
+    // transfer source as well, Compact copies the live meshes out and back
+    m_vertexBuffer.Init(device, physicalDevice, static_cast<VkDeviceSize>(vertexCapacity) * sizeof(NanoVertex),
+                        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_positionBuffer.Init(device, physicalDevice, static_cast<VkDeviceSize>(vertexCapacity) * sizeof(NanoPosition),
+                          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_indexBuffer.Init(device, physicalDevice, static_cast<VkDeviceSize>(indexCapacity) * sizeof(uint32_t),
+                       VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_meshBuffer.Init(device, physicalDevice, static_cast<VkDeviceSize>(meshCapacity) * sizeof(NanoGPUMesh),
+                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    m_isInit = true;
+    return err;
+}
+
+void NanoMeshArena::CleanUp() {
+    if (!m_isInit) {
+        return;
+    }
+    m_vertexBuffer.CleanUp();
+    m_positionBuffer.CleanUp();
+    m_indexBuffer.CleanUp();
+    m_meshBuffer.CleanUp();
+    m_meshes.clear();
+    m_allocations.clear();
+    m_isInit = false;
+}
+
+ERR NanoMeshArena::openMesh(const std::string& meshFile, NanoMappedFile& file, MeshSource& source) {
+    ERR err = file.Open(meshFile);
+    if (err != ERR::OK) {
+        return err;
+    }
+
+    NanoMeshView view{};
+    if (view.Open(file.GetData(), file.GetSize()) != ERR::OK) {
+        LOG_MSG(ERRLevel::WARNING, "not a valid nmesh file (or wrong version): %s", meshFile.c_str());
+        return ERR::INVALID;
+    }
+    const NanoMeshHeader& header = *view.header;
+    const NanoMeshStream* vertexStream = view.FindStream(NanoMeshStreamType::VERTEX);
+    const NanoMeshStream* indexStream = view.FindStream(NanoMeshStreamType::INDEX);
+    if (!vertexStream || !indexStream || vertexStream->compression != NanoMeshCompression::NONE ||
+        indexStream->compression != NanoMeshCompression::NONE) {
+        LOG_MSG(ERRLevel::WARNING, "nmesh file has no readable vertex or index stream: %s", meshFile.c_str());
+        return ERR::INVALID;
+    }
+
+    bool quantized = header.flags & NANOMESH_FLAG_QUANTIZED;
+    bool index32 = header.flags & NANOMESH_FLAG_INDEX_32;
+    uint64_t vertexSize = static_cast<uint64_t>(header.vertexCount) * (quantized ? sizeof(NanoQuantizedVertex) : sizeof(NanoVertex));
+    uint64_t indexSize = static_cast<uint64_t>(header.indexCount) * (index32 ? sizeof(uint32_t) : sizeof(uint16_t));
+    if (vertexStream->size < vertexSize || indexStream->size < indexSize) {
+        LOG_MSG(ERRLevel::WARNING, "nmesh streams are shorter than the header says: %s", meshFile.c_str());
+        return ERR::INVALID;
+    }
+
+    source.header = view.header;
+    source.vertices = view.GetStreamData(*vertexStream);
+    source.indices = view.GetStreamData(*indexStream);
+    source.lodCount = 1;
+    source.lods[0] = {0, header.indexCount, 0.0f, 0};
+    const NanoMeshStream* lodStream = view.FindStream(NanoMeshStreamType::LODS);
+    if (lodStream && lodStream->compression == NanoMeshCompression::NONE && lodStream->size >= sizeof(NanoMeshLod)) {
+        source.lodCount = static_cast<uint32_t>(std::min<uint64_t>(lodStream->size / sizeof(NanoMeshLod), Config::MESH_ARENA_MAX_LODS));
+        memcpy(source.lods, view.GetStreamData(*lodStream), source.lodCount * sizeof(NanoMeshLod));
+    }
+    for (uint32_t lod = 0; lod < source.lodCount; lod++) {
+        if (static_cast<uint64_t>(source.lods[lod].indexOffset) + source.lods[lod].indexCount > header.indexCount) {
+            LOG_MSG(ERRLevel::WARNING, "nmesh LOD %d is out of the index stream: %s", lod, meshFile.c_str());
+            return ERR::INVALID;
+        }
+    }
+    return ERR::OK;
+}
+
+ERR NanoMeshArena::uploadMesh(NanoStagingRing& stagingRing, const void* vertices, uint32_t vertexCount, const void* indices,
+                              uint32_t indexCount, NanoGPUMesh gpuMesh, uint32_t& mesh) {
+    ERR err = ERR::OK;
+    err = stagingRing.UploadBuffer(m_vertexBuffer.GetBuffer(), static_cast<VkDeviceSize>(m_vertexCount) * sizeof(NanoVertex), vertices,
+                                   static_cast<VkDeviceSize>(vertexCount) * sizeof(NanoVertex));
+    if (err != ERR::OK) {
+        return err;
+    }
+    m_positionScratch.resize(vertexCount);
+    const NanoVertex* fullVertices = reinterpret_cast<const NanoVertex*>(vertices);
+    for (uint32_t i = 0; i < vertexCount; i++) {
+        memcpy(m_positionScratch[i].position, fullVertices[i].position, sizeof(NanoPosition));
+    }
+    err = stagingRing.UploadBuffer(m_positionBuffer.GetBuffer(), static_cast<VkDeviceSize>(m_vertexCount) * sizeof(NanoPosition),
+                                   m_positionScratch.data(), static_cast<VkDeviceSize>(vertexCount) * sizeof(NanoPosition));
+    if (err != ERR::OK) {
+        return err;
+    }
+    err = stagingRing.UploadBuffer(m_indexBuffer.GetBuffer(), static_cast<VkDeviceSize>(m_indexCount) * sizeof(uint32_t), indices,
+                                   static_cast<VkDeviceSize>(indexCount) * sizeof(uint32_t));
+    if (err != ERR::OK) {
+        return err;
+    }
+
+    // gpuMesh comes in relative to the mesh's own streams
+    for (uint32_t lod = 0; lod < gpuMesh.lodCount; lod++) {
+        gpuMesh.lods[lod].indexOffset += m_indexCount;
+    }
+    gpuMesh.vertexOffset = static_cast<int32_t>(m_vertexCount);
+    mesh = static_cast<uint32_t>(m_meshes.size());
+    err = stagingRing.UploadBuffer(m_meshBuffer.GetBuffer(), static_cast<VkDeviceSize>(mesh) * sizeof(NanoGPUMesh), &gpuMesh, sizeof(NanoGPUMesh));
+    if (err != ERR::OK) {
+        return err;
+    }
+    // the sources may be a mapping that is released when the caller returns, the copies have to be done reading from it
+    err = stagingRing.Flush();
+
+    m_meshes.push_back(gpuMesh);
+    m_allocations.push_back({m_vertexCount, vertexCount, m_indexCount, indexCount});
+    m_vertexCount += vertexCount;
+    m_indexCount += indexCount;
+    return err;
+}
+
+ERR NanoMeshArena::AddMesh(NanoStagingRing& stagingRing, const std::string& meshFile, uint32_t& mesh) {
+    ERR err = ERR::OK;
+
+    NanoMappedFile file{};
+    MeshSource source{};
+    err = openMesh(meshFile, file, source);
+    if (err != ERR::OK) {
+        return err;
+    }
+    const NanoMeshHeader& header = *source.header;
+    if (m_meshes.size() >= m_meshCapacity) {
+        LOG_MSG(ERRLevel::WARNING, "mesh arena has no mesh slot left, %s is left out", meshFile.c_str());
+        return ERR::INVALID;
+    }
+    if (m_vertexCount + static_cast<uint64_t>(header.vertexCount) > m_vertexCapacity ||
+        m_indexCount + static_cast<uint64_t>(header.indexCount) > m_indexCapacity) {
+        LOG_MSG(ERRLevel::WARNING, "mesh arena is full, %s is left out", meshFile.c_str());
+        return ERR::OUT_OF_SPACE;
+    }
+
+    // the common case goes straight from the mapped file to the staging ring, the rest is converted first
+    const void* vertices = source.vertices;
+    if (header.flags & NANOMESH_FLAG_QUANTIZED) {
+        m_vertexScratch.resize(header.vertexCount);
+        const NanoQuantizedVertex* quantizedVertices = reinterpret_cast<const NanoQuantizedVertex*>(vertices);
+        for (uint32_t i = 0; i < header.vertexCount; i++) {
+            m_vertexScratch[i] = MeshQuantization::DequantizeVertex(quantizedVertices[i], header);
+        }
+        vertices = m_vertexScratch.data();
+    }
+    const void* indices = source.indices;
+    if (!(header.flags & NANOMESH_FLAG_INDEX_32)) {
+        m_indexScratch.assign(reinterpret_cast<const uint16_t*>(indices), reinterpret_cast<const uint16_t*>(indices) + header.indexCount);
+        indices = m_indexScratch.data();
+    }
+
+    NanoGPUMesh gpuMesh{};
+    gpuMesh.lodCount = source.lodCount;
+    std::copy(source.lods, source.lods + source.lodCount, gpuMesh.lods);
+    float squaredRadius = 0.0f;
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        gpuMesh.boundsCenter[axis] = 0.5f * (header.aabbMin[axis] + header.aabbMax[axis]);
+        float halfExtent = 0.5f * (header.aabbMax[axis] - header.aabbMin[axis]);
+        squaredRadius += halfExtent * halfExtent;
+    }
+    gpuMesh.boundsRadius = std::sqrt(squaredRadius);
+
+    return uploadMesh(stagingRing, vertices, header.vertexCount, indices, header.indexCount, gpuMesh, mesh);
+}
+
+ERR NanoMeshArena::AddMergedMesh(NanoStagingRing& stagingRing, const std::vector<NanoMergePart>& parts, uint32_t& mesh) {
+    ERR err = ERR::OK;
+    m_vertexScratch.clear();
+    m_indexScratch.clear();
+    glm::vec3 boundsMin(INFINITY);
+    glm::vec3 boundsMax(-INFINITY);
+
+    for (const NanoMergePart& part : parts) {
+        NanoMappedFile file{};
+        MeshSource source{};
+        err = openMesh(part.meshFile, file, source);
+        if (err != ERR::OK) {
+            return err;
+        }
+        const NanoMeshHeader& header = *source.header;
+
+        // normals go through the inverse transpose so non uniform scales keep them perpendicular
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(part.world)));
+        uint32_t baseVertex = static_cast<uint32_t>(m_vertexScratch.size());
+        bool quantized = header.flags & NANOMESH_FLAG_QUANTIZED;
+        for (uint32_t i = 0; i < header.vertexCount; i++) {
+            NanoVertex vertex = quantized
+                                    ? MeshQuantization::DequantizeVertex(reinterpret_cast<const NanoQuantizedVertex*>(source.vertices)[i], header)
+                                    : reinterpret_cast<const NanoVertex*>(source.vertices)[i];
+            glm::vec3 position = glm::vec3(part.world * glm::vec4(vertex.position[0], vertex.position[1], vertex.position[2], 1.0f));
+            glm::vec3 normal = normalMatrix * glm::vec3(vertex.normal[0], vertex.normal[1], vertex.normal[2]);
+            float length = glm::length(normal);
+            normal = length > 0.0f ? normal / length : normal;
+            for (uint32_t axis = 0; axis < 3; axis++) {
+                vertex.position[axis] = position[axis];
+                vertex.normal[axis] = normal[axis];
+            }
+            boundsMin = glm::min(boundsMin, position);
+            boundsMax = glm::max(boundsMax, position);
+            m_vertexScratch.push_back(vertex);
+        }
+
+        bool index32 = header.flags & NANOMESH_FLAG_INDEX_32;
+        const NanoMeshLod& lod0 = source.lods[0];
+        for (uint32_t i = lod0.indexOffset; i < lod0.indexOffset + lod0.indexCount; i++) {
+            uint32_t index = index32 ? reinterpret_cast<const uint32_t*>(source.indices)[i] : reinterpret_cast<const uint16_t*>(source.indices)[i];
+            m_indexScratch.push_back(baseVertex + index);
+        }
+    }
+
+    uint32_t vertexCount = static_cast<uint32_t>(m_vertexScratch.size());
+    uint32_t indexCount = static_cast<uint32_t>(m_indexScratch.size());
+    if (vertexCount == 0 || indexCount == 0) {
+        return ERR::INVALID;
+    }
+    if (m_meshes.size() >= m_meshCapacity) {
+        LOG_MSG(ERRLevel::WARNING, "mesh arena has no mesh slot left, a merged mesh of %d parts is left out", static_cast<int>(parts.size()));
+        return ERR::INVALID;
+    }
+    if (m_vertexCount + static_cast<uint64_t>(vertexCount) > m_vertexCapacity || m_indexCount + static_cast<uint64_t>(indexCount) > m_indexCapacity) {
+        LOG_MSG(ERRLevel::WARNING, "mesh arena is full, a merged mesh of %d parts is left out", static_cast<int>(parts.size()));
+        return ERR::OUT_OF_SPACE;
+    }
+
+    NanoGPUMesh gpuMesh{};
+    gpuMesh.lodCount = 1;
+    gpuMesh.lods[0] = {0, indexCount, 0.0f, 0};
+    glm::vec3 center = 0.5f * (boundsMin + boundsMax);
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        gpuMesh.boundsCenter[axis] = center[axis];
+    }
+    gpuMesh.boundsRadius = glm::length(boundsMax - center);
+
+    return uploadMesh(stagingRing, m_vertexScratch.data(), vertexCount, m_indexScratch.data(), indexCount, gpuMesh, mesh);
+}
+
+ERR NanoMeshArena::RemoveMesh(NanoStagingRing& stagingRing, uint32_t mesh) {
+    if (mesh >= m_meshes.size() || m_allocations[mesh].vertexCount == 0) {
+        return ERR::INVALID;
+    }
+    Allocation& allocation = m_allocations[mesh];
+    m_freeVertexCount += allocation.vertexCount;
+    m_freeIndexCount += allocation.indexCount;
+    allocation.vertexCount = 0;
+    allocation.indexCount = 0;
+
+    // no LOD left to draw, culling skips it
+    m_meshes[mesh].lodCount = 0;
+    ERR err = stagingRing.UploadBuffer(m_meshBuffer.GetBuffer(), static_cast<VkDeviceSize>(mesh) * sizeof(NanoGPUMesh), &m_meshes[mesh],
+                                       sizeof(NanoGPUMesh));
+    if (err != ERR::OK) {
+        return err;
+    }
+    return stagingRing.Flush();
+}
+
+ERR NanoMeshArena::Compact(NanoStagingRing& stagingRing) {
+    ERR err = ERR::OK;
+    if (m_freeVertexCount == 0 && m_freeIndexCount == 0) {
+        return err;
+    }
+    uint32_t liveVertexCount = m_vertexCount - m_freeVertexCount;
+    uint32_t liveIndexCount = m_indexCount - m_freeIndexCount;
+    VkDeviceSize vertexBytes = static_cast<VkDeviceSize>(liveVertexCount) * sizeof(NanoVertex);
+    VkDeviceSize positionBytes = static_cast<VkDeviceSize>(liveVertexCount) * sizeof(NanoPosition);
+    VkDeviceSize indexBytes = static_cast<VkDeviceSize>(liveIndexCount) * sizeof(uint32_t);
+
+    // copies within a buffer can't overlap, so the live meshes go out packed to a scratch buffer (vertices, positions then
+    // indices) and come back in one copy per buffer
+    std::vector<VkBufferCopy> vertexRegions{};
+    std::vector<VkBufferCopy> positionRegions{};
+    std::vector<VkBufferCopy> indexRegions{};
+    auto addRegion = [](std::vector<VkBufferCopy>& regions, VkDeviceSize srcOffset, VkDeviceSize dstOffset, VkDeviceSize size) {
+        if (size == 0) {
+            return;
+        }
+        if (!regions.empty() && regions.back().srcOffset + regions.back().size == srcOffset &&
+            regions.back().dstOffset + regions.back().size == dstOffset) {
+            regions.back().size += size;
+            return;
+        }
+        regions.push_back({srcOffset, dstOffset, size});
+    };
+
+    // meshes are appended and compacting keeps their order, so mesh order is also the order in the buffers
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    for (uint32_t mesh = 0; mesh < m_meshes.size(); mesh++) {
+        Allocation& allocation = m_allocations[mesh];
+        if (allocation.vertexCount == 0) {
+            continue;
+        }
+        addRegion(vertexRegions, static_cast<VkDeviceSize>(allocation.firstVertex) * sizeof(NanoVertex),
+                  static_cast<VkDeviceSize>(vertexCount) * sizeof(NanoVertex),
+                  static_cast<VkDeviceSize>(allocation.vertexCount) * sizeof(NanoVertex));
+        addRegion(positionRegions, static_cast<VkDeviceSize>(allocation.firstVertex) * sizeof(NanoPosition),
+                  vertexBytes + static_cast<VkDeviceSize>(vertexCount) * sizeof(NanoPosition),
+                  static_cast<VkDeviceSize>(allocation.vertexCount) * sizeof(NanoPosition));
+        addRegion(indexRegions, static_cast<VkDeviceSize>(allocation.firstIndex) * sizeof(uint32_t),
+                  vertexBytes + positionBytes + static_cast<VkDeviceSize>(indexCount) * sizeof(uint32_t),
+                  static_cast<VkDeviceSize>(allocation.indexCount) * sizeof(uint32_t));
+
+        // indices are relative to vertexOffset, only the offsets move
+        for (uint32_t lod = 0; lod < m_meshes[mesh].lodCount; lod++) {
+            m_meshes[mesh].lods[lod].indexOffset = m_meshes[mesh].lods[lod].indexOffset - allocation.firstIndex + indexCount;
+        }
+        m_meshes[mesh].vertexOffset = static_cast<int32_t>(vertexCount);
+        allocation.firstVertex = vertexCount;
+        allocation.firstIndex = indexCount;
+        vertexCount += allocation.vertexCount;
+        indexCount += allocation.indexCount;
+    }
+
+    NanoBuffer scratch{};
+    if (vertexBytes + indexBytes > 0) {
+        scratch.Init(_device, _physicalDevice, vertexBytes + positionBytes + indexBytes,
+                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        stagingRing.CopyBuffer(m_vertexBuffer.GetBuffer(), scratch.GetBuffer(), static_cast<uint32_t>(vertexRegions.size()), vertexRegions.data());
+        stagingRing.CopyBuffer(m_positionBuffer.GetBuffer(), scratch.GetBuffer(), static_cast<uint32_t>(positionRegions.size()),
+                               positionRegions.data());
+        stagingRing.CopyBuffer(m_indexBuffer.GetBuffer(), scratch.GetBuffer(), static_cast<uint32_t>(indexRegions.size()), indexRegions.data());
+        VkBufferCopy vertexBack{0, 0, vertexBytes};
+        VkBufferCopy positionBack{vertexBytes, 0, positionBytes};
+        VkBufferCopy indexBack{vertexBytes + positionBytes, 0, indexBytes};
+        stagingRing.CopyBuffer(scratch.GetBuffer(), m_vertexBuffer.GetBuffer(), vertexBytes > 0 ? 1 : 0, &vertexBack);
+        stagingRing.CopyBuffer(scratch.GetBuffer(), m_positionBuffer.GetBuffer(), positionBytes > 0 ? 1 : 0, &positionBack);
+        stagingRing.CopyBuffer(scratch.GetBuffer(), m_indexBuffer.GetBuffer(), indexBytes > 0 ? 1 : 0, &indexBack);
+    }
+    err = stagingRing.UploadBuffer(m_meshBuffer.GetBuffer(), 0, m_meshes.data(), static_cast<VkDeviceSize>(m_meshes.size()) * sizeof(NanoGPUMesh));
+    // the copies read the scratch buffer, they have to be done before it goes
+    ERR flushErr = stagingRing.Flush();
+    err = err == ERR::OK ? flushErr : err;
+    scratch.CleanUp();
+
+    LOG_MSG(ERRLevel::INFO, "Mesh arena compacted: %d vertices and %d indices reclaimed", m_freeVertexCount, m_freeIndexCount);
+    m_vertexCount = vertexCount;
+    m_indexCount = indexCount;
+    m_freeVertexCount = 0;
+    m_freeIndexCount = 0;
+    return err;
+}
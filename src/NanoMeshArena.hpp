@@ -0,0 +1,117 @@
+#ifndef NANOMESHARENA_H_
+#define NANOMESHARENA_H_
+
+#include "NanoBuffer.hpp"
+#include "NanoConfig.hpp"
+#include "NanoError.hpp"
+#include "NanoMappedFile.hpp"
+#include "NanoMeshFormat.hpp"
+#include "NanoStagingRing.hpp"
+
+#include "glm/glm.hpp"
+#include "vulkan/vulkan_core.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Where a mesh lives in the arena, also the layout of the mesh table the culling shader reads. Every LOD of the file
+// is in there, the culling shader picks one per instance from its projected error (see cull.comp). 160 bytes
+struct NanoGPUMesh {
+    uint32_t lodCount; // 0 once removed
+    int32_t vertexOffset;
+    uint32_t reserved[2];
+    float boundsCenter[3]; // object space bounding sphere
+    float boundsRadius;
+    NanoMeshLod lods[Config::MESH_ARENA_MAX_LODS]; // finest first, indexOffset is into the arena's index buffer
+};
+
+static_assert(sizeof(NanoGPUMesh) == 32 + 16 * Config::MESH_ARENA_MAX_LODS, "NanoGPUMesh is read as a std430 struct");
+
+// the position only vertex stream, R32G32B32_SFLOAT
+struct NanoPosition {
+    float position[3];
+};
+
+// one static object of a merged mesh, its vertices are baked in world space
+struct NanoMergePart {
+    std::string meshFile;
+    glm::mat4 world{1.0f};
+};
+
+// Every mesh's vertices and indices in one shared vertex buffer and one shared index buffer, so a single bind covers the
+// whole scene and indirect draws only differ by their offsets. Vertices are stored as NanoVertex (quantized files are
+// expanded while loading) and indices as 32 bit. Positions are also kept on their own, tightly packed, for passes that
+// only need them (the depth pre-pass): a third of the vertex fetch.
+// Meshes are appended and their offsets only change in Compact, which slides the live ones down over the holes removed
+// meshes left, in one device side copy through a scratch buffer. Mesh ids are never reused: instances of a removed mesh
+// keep pointing at an empty entry of the mesh table, which the culling shader skips
+class NanoMeshArena {
+  public:
+    ERR Init(VkDevice& device, const VkPhysicalDevice& physicalDevice, uint32_t vertexCapacity, uint32_t indexCapacity, uint32_t meshCapacity);
+    void CleanUp();
+
+    // both return OUT_OF_SPACE when the vertices or indices don't fit, the only failure Compact may help with
+    ERR AddMesh(NanoStagingRing& stagingRing, const std::string& meshFile, uint32_t& mesh);
+    // static objects drawn with the same material, baked into one mesh (LOD 0 only) so they cost a single draw. Best for
+    // objects close to each other, the merged bounds are what gets culled
+    ERR AddMergedMesh(NanoStagingRing& stagingRing, const std::vector<NanoMergePart>& parts, uint32_t& mesh);
+    // these two rewrite what the GPU may be reading, the frames in flight have to be done with the arena
+    ERR RemoveMesh(NanoStagingRing& stagingRing, uint32_t mesh);
+    ERR Compact(NanoStagingRing& stagingRing);
+
+    bool IsInit() { return m_isInit; }
+    NanoBuffer& GetVertexBuffer() { return m_vertexBuffer; }
+    NanoBuffer& GetPositionBuffer() { return m_positionBuffer; } // vec3 per vertex, same vertex offsets
+    NanoBuffer& GetIndexBuffer() { return m_indexBuffer; }
+    NanoBuffer& GetMeshBuffer() { return m_meshBuffer; } // NanoGPUMesh[], storage buffer
+    uint32_t GetMeshCount() { return static_cast<uint32_t>(m_meshes.size()); }
+    const NanoGPUMesh& GetMesh(uint32_t mesh) { return m_meshes[mesh]; }
+    uint32_t GetVertexCount() { return m_vertexCount; }
+    uint32_t GetIndexCount() { return m_indexCount; }
+    // left in holes by removed meshes, until the next Compact
+    uint32_t GetFreeVertexCount() { return m_freeVertexCount; }
+    uint32_t GetFreeIndexCount() { return m_freeIndexCount; }
+
+  private:
+    struct Allocation {
+        uint32_t firstVertex;
+        uint32_t vertexCount; // 0 once removed
+        uint32_t firstIndex;
+        uint32_t indexCount;
+    };
+    // a validated file, its streams still in the mapping
+    struct MeshSource {
+        const NanoMeshHeader* header;
+        const void* vertices;
+        const void* indices;
+        uint32_t lodCount;
+        NanoMeshLod lods[Config::MESH_ARENA_MAX_LODS]; // relative to the file's index stream
+    };
+
+    ERR openMesh(const std::string& meshFile, NanoMappedFile& file, MeshSource& source);
+    ERR uploadMesh(NanoStagingRing& stagingRing, const void* vertices, uint32_t vertexCount, const void* indices, uint32_t indexCount,
+                   NanoGPUMesh gpuMesh, uint32_t& mesh);
+
+    VkDevice _device{};
+    VkPhysicalDevice _physicalDevice{};
+    bool m_isInit = false;
+    NanoBuffer m_vertexBuffer{};
+    NanoBuffer m_positionBuffer{};
+    NanoBuffer m_indexBuffer{};
+    NanoBuffer m_meshBuffer{};
+    uint32_t m_vertexCapacity = 0;
+    uint32_t m_indexCapacity = 0;
+    uint32_t m_meshCapacity = 0;
+    uint32_t m_vertexCount = 0;
+    uint32_t m_indexCount = 0;
+    uint32_t m_freeVertexCount = 0;
+    uint32_t m_freeIndexCount = 0;
+    std::vector<NanoGPUMesh> m_meshes{};
+    std::vector<Allocation> m_allocations{};
+    // converted streams, when they can't be copied as they are
+    std::vector<NanoVertex> m_vertexScratch{};
+    std::vector<uint32_t> m_indexScratch{};
+    std::vector<NanoPosition> m_positionScratch{};
+};
+
+#endif // NANOMESHARENA_H_
@@ -0,0 +1,298 @@
+#ifndef NANOMESHFORMAT_H_
+#define NANOMESHFORMAT_H_
+
+// Engine native binary mesh container (.nmesh). Shared by the engine loader and the offline tools, so no Vulkan here.
+//
+// [NanoMeshHeader][NanoMeshStream * streamCount][padding][stream 0][padding][stream 1]...
+//
+// Every stream starts on a NANOMESH_STREAM_ALIGNMENT boundary and is stored exactly as the GPU consumes it,
+// so the loader can memcpy straight from the mapped file into the staging buffer.
+
+#include "NanoError.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+constexpr uint32_t NANOMESH_MAGIC = 0x48534D4E; // "NMSH"
+constexpr uint16_t NANOMESH_VERSION_MAJOR = 1;  // bumped when old files can't be read anymore
+constexpr uint16_t NANOMESH_VERSION_MINOR = 1;  // bumped when something is added that old loaders can skip
+constexpr uint32_t NANOMESH_STREAM_ALIGNMENT = 256; // covers optimalBufferCopyOffsetAlignment and nonCoherentAtomSize on every device we know of
+
+enum NanoMeshFlags : uint32_t {
+    NANOMESH_FLAG_NONE = 0,
+    NANOMESH_FLAG_QUANTIZED = 1 << 0, // vertices use NanoQuantizedVertex, positions have to be rescaled with the header's quantization
+    NANOMESH_FLAG_INDEX_32 = 1 << 1,  // 32 bit indices, 16 bit otherwise
+};
+
+enum class NanoMeshStreamType : uint32_t {
+    VERTEX = 0,
+    INDEX = 1,
+    // 1.1: cluster data written by NanoMeshOptimizer
+    MESHLETS = 2,          // NanoMeshlet[]
+    MESHLET_VERTICES = 3,  // uint32_t[], index into the vertex stream
+    MESHLET_TRIANGLES = 4, // uint8_t[3 * triangles], index into the meshlet's vertices, padded to 4 bytes per meshlet
+    LODS = 5,              // NanoMeshLod[], finest first. The levels share the vertex stream and are back to back in the index stream
+};
+
+// Only NONE is produced for now. The field is there so compressed streams can be added without a major version bump;
+// the loader refuses streams it can't decode instead of uploading garbage.
+enum class NanoMeshCompression : uint32_t {
+    NONE = 0,
+};
+
+struct NanoMeshHeader {
+    uint32_t magic = NANOMESH_MAGIC;
+    uint16_t versionMajor = NANOMESH_VERSION_MAJOR;
+    uint16_t versionMinor = NANOMESH_VERSION_MINOR;
+    uint32_t flags = NANOMESH_FLAG_NONE;
+    uint32_t vertexStride = 0;
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    uint32_t streamCount = 0;
+    uint32_t headerSize = sizeof(NanoMeshHeader); // lets a newer minor version grow the header
+    float aabbMin[3] = {0.0f, 0.0f, 0.0f};
+    float aabbMax[3] = {0.0f, 0.0f, 0.0f};
+    // quantized position = round((position - quantizationOffset) / quantizationScale * 65535)
+    float quantizationOffset[3] = {0.0f, 0.0f, 0.0f};
+    float quantizationScale[3] = {1.0f, 1.0f, 1.0f};
+    uint32_t reserved[4] = {};
+};
+
+struct NanoMeshStream {
+    NanoMeshStreamType type = NanoMeshStreamType::VERTEX;
+    NanoMeshCompression compression = NanoMeshCompression::NONE;
+    uint64_t offset = 0;           // from the start of the file, multiple of NANOMESH_STREAM_ALIGNMENT
+    uint64_t size = 0;             // bytes stored in the file
+    uint64_t uncompressedSize = 0; // bytes once uploaded
+};
+
+static_assert(sizeof(NanoMeshHeader) == 96, "NanoMeshHeader layout changed, bump NANOMESH_VERSION_MAJOR");
+static_assert(sizeof(NanoMeshStream) == 32, "NanoMeshStream layout changed, bump NANOMESH_VERSION_MAJOR");
+
+// 32 bytes. R32G32B32_SFLOAT, R32G32B32_SFLOAT, R32G32_SFLOAT
+struct NanoVertex {
+    float position[3];
+    float normal[3];
+    float uv[2];
+};
+
+// 16 bytes. R16G16B16A16_UNORM, R16G16_SNORM (octahedral), R16G16_SFLOAT
+struct NanoQuantizedVertex {
+    uint16_t position[4]; // w is padding
+    int16_t normal[2];
+    uint16_t uv[2];
+};
+
+// 48 bytes. Cone culling: the whole meshlet is back facing when
+// dot(center - cameraPosition, coneAxis) >= coneCutoff * length(center - cameraPosition) + radius
+struct NanoMeshlet {
+    uint32_t vertexOffset;   // into MESHLET_VERTICES
+    uint32_t triangleOffset; // into MESHLET_TRIANGLES, in bytes
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+    float center[3];
+    float radius;
+    float coneAxis[3];
+    float coneCutoff; // sin of the cone half angle, 1 when the cone is degenerate (never culled)
+};
+
+// without a LODS stream the whole index stream is LOD 0
+struct NanoMeshLod {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    float error; // object space, how far this level may deviate from LOD 0
+    uint32_t reserved;
+};
+
+static_assert(sizeof(NanoMeshLod) == 16, "NanoMeshLod must stay tightly packed");
+static_assert(sizeof(NanoMeshlet) == 48, "NanoMeshlet must stay tightly packed");
+static_assert(sizeof(NanoVertex) == 32, "NanoVertex must stay tightly packed");
+static_assert(sizeof(NanoQuantizedVertex) == 16, "NanoQuantizedVertex must stay tightly packed");
+
+namespace MeshQuantization {
+
+inline uint64_t AlignUp(uint64_t value, uint64_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+// IEEE 754 binary16, round to nearest even. Denormals are kept, NaN stays NaN
+inline uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (((bits >> 23) & 0xFF) == 0xFF) { // inf / nan
+        return static_cast<uint16_t>(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    }
+    if (exponent >= 0x1F) { // overflow
+        return static_cast<uint16_t>(sign | 0x7C00);
+    }
+    if (exponent <= 0) { // denormal or zero
+        if (exponent < -10) {
+            return static_cast<uint16_t>(sign);
+        }
+        mantissa |= 0x800000;
+        uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        uint32_t halfMantissa = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (halfMantissa & 1))) {
+            halfMantissa++;
+        }
+        return static_cast<uint16_t>(sign | halfMantissa);
+    }
+
+    uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1FFF;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        half++; // may carry into the exponent, which is the correct rounding
+    }
+    return static_cast<uint16_t>(half);
+}
+
+inline float HalfToFloat(uint16_t half) {
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1F;
+    uint32_t mantissa = half & 0x3FF;
+    uint32_t bits;
+
+    if (exponent == 0) {
+        if (mantissa == 0) {
+            bits = sign;
+        } else { // normalize the denormal
+            exponent = 127 - 15 + 1;
+            while (!(mantissa & 0x400)) {
+                mantissa <<= 1;
+                exponent--;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+        }
+    } else if (exponent == 0x1F) {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline int16_t FloatToSnorm16(float value) {
+    value = std::clamp(value, -1.0f, 1.0f);
+    return static_cast<int16_t>(std::lround(value * 32767.0f));
+}
+
+inline float Snorm16ToFloat(int16_t value) { return std::max(static_cast<float>(value) / 32767.0f, -1.0f); }
+
+inline uint16_t FloatToUnorm16(float value) {
+    value = std::clamp(value, 0.0f, 1.0f);
+    return static_cast<uint16_t>(std::lround(value * 65535.0f));
+}
+
+// Octahedral normal encoding (Cigolle et al. 2014). The unit sphere is projected on an octahedron and unfolded on a square
+inline void OctahedralEncode(const float normal[3], int16_t encoded[2]) {
+    float invL1 = 1.0f / (std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]) + 1e-20f);
+    float x = normal[0] * invL1;
+    float y = normal[1] * invL1;
+    if (normal[2] < 0.0f) {
+        float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    encoded[0] = FloatToSnorm16(x);
+    encoded[1] = FloatToSnorm16(y);
+}
+
+inline void OctahedralDecode(const int16_t encoded[2], float normal[3]) {
+    float x = Snorm16ToFloat(encoded[0]);
+    float y = Snorm16ToFloat(encoded[1]);
+    float z = 1.0f - std::fabs(x) - std::fabs(y);
+    float t = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+    float length = std::sqrt(x * x + y * y + z * z);
+    normal[0] = x / length;
+    normal[1] = y / length;
+    normal[2] = z / length;
+}
+
+// positions are stored relative to the mesh bounds, so 16 bits cover the whole mesh uniformly
+inline NanoQuantizedVertex QuantizeVertex(const NanoVertex& vertex, const NanoMeshHeader& header) {
+    NanoQuantizedVertex quantized{};
+    for (int i = 0; i < 3; i++) {
+        float normalized = (vertex.position[i] - header.quantizationOffset[i]) / header.quantizationScale[i];
+        quantized.position[i] = FloatToUnorm16(normalized);
+    }
+    quantized.position[3] = 0;
+    OctahedralEncode(vertex.normal, quantized.normal);
+    quantized.uv[0] = FloatToHalf(vertex.uv[0]);
+    quantized.uv[1] = FloatToHalf(vertex.uv[1]);
+    return quantized;
+}
+
+inline NanoVertex DequantizeVertex(const NanoQuantizedVertex& quantized, const NanoMeshHeader& header) {
+    NanoVertex vertex{};
+    for (int i = 0; i < 3; i++) {
+        vertex.position[i] = header.quantizationOffset[i] + (static_cast<float>(quantized.position[i]) / 65535.0f) * header.quantizationScale[i];
+    }
+    OctahedralDecode(quantized.normal, vertex.normal);
+    vertex.uv[0] = HalfToFloat(quantized.uv[0]);
+    vertex.uv[1] = HalfToFloat(quantized.uv[1]);
+    return vertex;
+}
+
+} // namespace MeshQuantization
+
+// Zero copy view over a .nmesh image (usually a mapped file). Only validates, never copies
+struct NanoMeshView {
+    const NanoMeshHeader *header = nullptr;
+    const NanoMeshStream *streams = nullptr;
+    const uint8_t *fileData = nullptr;
+
+    const NanoMeshStream *FindStream(NanoMeshStreamType type) const {
+        for (uint32_t i = 0; header && i < header->streamCount; i++) {
+            if (streams[i].type == type) {
+                return &streams[i];
+            }
+        }
+        return nullptr;
+    }
+
+    const uint8_t *GetStreamData(const NanoMeshStream &stream) const { return fileData + stream.offset; }
+
+    ERR Open(const uint8_t *data, size_t size) {
+        if (size < sizeof(NanoMeshHeader)) {
+            return ERR::INVALID;
+        }
+        const NanoMeshHeader *fileHeader = reinterpret_cast<const NanoMeshHeader *>(data);
+        if (fileHeader->magic != NANOMESH_MAGIC || fileHeader->versionMajor != NANOMESH_VERSION_MAJOR ||
+            fileHeader->headerSize < sizeof(NanoMeshHeader)) {
+            return ERR::INVALID;
+        }
+
+        uint64_t streamTableEnd = fileHeader->headerSize + static_cast<uint64_t>(fileHeader->streamCount) * sizeof(NanoMeshStream);
+        if (streamTableEnd > size) {
+            return ERR::INVALID;
+        }
+
+        const NanoMeshStream *fileStreams = reinterpret_cast<const NanoMeshStream *>(data + fileHeader->headerSize);
+        for (uint32_t i = 0; i < fileHeader->streamCount; i++) {
+            if (fileStreams[i].offset % NANOMESH_STREAM_ALIGNMENT != 0 || fileStreams[i].offset + fileStreams[i].size > size) {
+                return ERR::INVALID;
+            }
+        }
+
+        header = fileHeader;
+        streams = fileStreams;
+        fileData = data;
+        return ERR::OK;
+    }
+};
+
+#endif // NANOMESHFORMAT_H_
@@ -0,0 +1,393 @@
+#include "NanoOcclusionCuller.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cfloat>
+
+#ifdef NANO_CULLING_X86
+#include <immintrin.h>
+#endif
+
+static constexpr uint32_t BAND_LEVELS = 4; // pyramid levels that still have whole rows inside a band
+static_assert(NanoOcclusionCuller::BAND_HEIGHT == 1u << BAND_LEVELS, "bands must cover whole texels on every band level");
+
+// inside when dot(plane, clip position) >= 0
+static const glm::vec4 CLIP_PLANES[5] = {
+    {0.0f, 0.0f, 1.0f, 0.0f},
+    {-1.0f, 0.0f, 0.0f, NanoOcclusionCuller::GUARD_BAND},
+    {1.0f, 0.0f, 0.0f, NanoOcclusionCuller::GUARD_BAND},
+    {0.0f, -1.0f, 0.0f, NanoOcclusionCuller::GUARD_BAND},
+    {0.0f, 1.0f, 0.0f, NanoOcclusionCuller::GUARD_BAND},
+};
+
+void NanoOcclusionCuller::Init(uint32_t width, uint32_t height) {
+    m_width = std::max(1u, (width + BAND_HEIGHT - 1) / BAND_HEIGHT) * BAND_HEIGHT;
+    m_height = std::max(1u, (height + BAND_HEIGHT - 1) / BAND_HEIGHT) * BAND_HEIGHT;
+
+    m_levels.clear();
+    uint32_t levelWidth = m_width, levelHeight = m_height;
+    while (true) {
+        m_levels.push_back({levelWidth, levelHeight, std::vector<float>(static_cast<size_t>(levelWidth) * levelHeight, 1.0f)});
+        if (levelWidth == 1 && levelHeight == 1) {
+            break;
+        }
+        levelWidth = (levelWidth + 1) / 2;
+        levelHeight = (levelHeight + 1) / 2;
+    }
+    m_bandTriangles.assign(m_height / BAND_HEIGHT, {});
+    m_triangles.clear();
+}
+
+void NanoOcclusionCuller::BeginFrame(const glm::mat4& viewProjection) {
+    m_viewProjection = viewProjection;
+    m_triangles.clear();
+    for (auto& band : m_bandTriangles) {
+        band.clear();
+    }
+    m_stats = {};
+}
+
+void NanoOcclusionCuller::AddOccluder(const glm::vec3* vertices, const uint32_t* indices, uint32_t indexCount, const glm::mat4& world,
+                                      bool twoSided) {
+    glm::mat4 worldViewProjection = m_viewProjection * world;
+    float width = static_cast<float>(m_width), height = static_cast<float>(m_height);
+    uint32_t triangleCount = indexCount / 3;
+    m_stats.occluderTriangles += triangleCount;
+
+    // Clockwise on screen, from the sign of the x, y, w determinant. That works for triangles crossing the near plane too.
+    // An edge shared by two front facing triangles is inside the occluder's silhouette, so it is sampled at the pixel
+    // centers instead of shrunk, or every mesh would be full of cracks. A pixel on such an edge also shows a bit of the
+    // neighbors, so it gets the farthest depth of every front facing triangle touching the vertices of its own
+    m_clipVertices.resize(indexCount);
+    m_frontFacing.resize(triangleCount);
+    m_sharedEdges.clear();
+    uint32_t vertexCount = indexCount > 0 ? *std::max_element(indices, indices + indexCount) + 1 : 0;
+    m_vertexDepth.assign(vertexCount, 0.0f);
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        glm::vec4* clip = m_clipVertices.data() + 3 * t;
+        for (int k = 0; k < 3; k++) {
+            clip[k] = worldViewProjection * glm::vec4(vertices[indices[3 * t + k]], 1.0f);
+        }
+        glm::vec3 r0(clip[0].x, clip[0].y, clip[0].w), r1(clip[1].x, clip[1].y, clip[1].w), r2(clip[2].x, clip[2].y, clip[2].w);
+        m_frontFacing[t] = glm::dot(r0, glm::cross(r1, r2)) > 0.0f;
+        if (!m_frontFacing[t] || twoSided) {
+            continue;
+        }
+
+        // vertices behind the near plane get clipped to depth 0, so they don't count
+        float farthest = 0.0f;
+        for (int k = 0; k < 3; k++) {
+            if (clip[k].z >= 0.0f && clip[k].w >= NEAR_CLIP_W) {
+                farthest = std::max(farthest, std::min(1.0f, clip[k].z / clip[k].w));
+            }
+        }
+        for (int k = 0; k < 3; k++) {
+            m_sharedEdges.push_back(static_cast<uint64_t>(indices[3 * t + k]) << 32 | indices[3 * t + (k + 1) % 3]);
+            m_vertexDepth[indices[3 * t + k]] = std::max(m_vertexDepth[indices[3 * t + k]], farthest);
+        }
+    }
+    std::sort(m_sharedEdges.begin(), m_sharedEdges.end());
+
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        if (!m_frontFacing[t] && !twoSided) {
+            continue;
+        }
+        float partialDepth = 1.0f;
+        if (!twoSided) {
+            partialDepth = std::max({m_vertexDepth[indices[3 * t]], m_vertexDepth[indices[3 * t + 1]], m_vertexDepth[indices[3 * t + 2]]});
+        }
+
+        // every vertex carries whether the edge to the next one is shared
+        glm::vec4 polygon[8];
+        bool shared[8];
+        uint32_t polygonSize = 3;
+        for (int k = 0; k < 3; k++) {
+            polygon[k] = m_clipVertices[3 * t + k];
+            uint64_t reverse = static_cast<uint64_t>(indices[3 * t + (k + 1) % 3]) << 32 | indices[3 * t + k];
+            shared[k] = !twoSided && std::binary_search(m_sharedEdges.begin(), m_sharedEdges.end(), reverse);
+        }
+
+        // walls right next to the camera are the best occluders, so triangles are clipped instead of dropped: at the
+        // near plane, and at the guard band because far outside the screen the edge functions lose too much precision.
+        // The new edges along a clip plane are outlines like any other
+        for (const glm::vec4& plane : CLIP_PLANES) {
+            glm::vec4 clipped[8];
+            bool clippedShared[8];
+            uint32_t clippedSize = 0;
+            for (uint32_t k = 0; k < polygonSize; k++) {
+                const glm::vec4& p = polygon[k];
+                const glm::vec4& q = polygon[(k + 1) % polygonSize];
+                float pDistance = glm::dot(plane, p), qDistance = glm::dot(plane, q);
+                if (pDistance >= 0.0f) {
+                    clippedShared[clippedSize] = shared[k];
+                    clipped[clippedSize++] = p;
+                }
+                if ((pDistance >= 0.0f) != (qDistance >= 0.0f)) {
+                    clippedShared[clippedSize] = pDistance < 0.0f && shared[k];
+                    clipped[clippedSize++] = p + (q - p) * (pDistance / (pDistance - qDistance));
+                }
+            }
+            std::copy(clipped, clipped + clippedSize, polygon);
+            std::copy(clippedShared, clippedShared + clippedSize, shared);
+            polygonSize = clippedSize;
+        }
+
+        glm::vec3 screen[8];
+        bool degenerate = polygonSize < 3;
+        for (uint32_t k = 0; k < polygonSize; k++) {
+            const glm::vec4& p = polygon[k];
+            degenerate |= p.w < NEAR_CLIP_W;
+            screen[k] = glm::vec3((p.x / p.w * 0.5f + 0.5f) * width, (p.y / p.w * 0.5f + 0.5f) * height, std::max(0.0f, p.z / p.w));
+        }
+        if (degenerate) {
+            continue;
+        }
+        // fan, the diagonals are shared between neighboring triangles of the fan
+        for (uint32_t k = 2; k < polygonSize; k++) {
+            const bool edges[3] = {k == 2 ? shared[0] : true, shared[k - 1], k + 1 == polygonSize ? shared[k] : true};
+            AddTriangle(screen[0], screen[k - 1], screen[k], edges, partialDepth, twoSided);
+        }
+    }
+}
+
+void NanoOcclusionCuller::AddTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, const bool sharedEdges[3], float partialDepth,
+                                      bool twoSided) {
+    float width = static_cast<float>(m_width), height = static_cast<float>(m_height);
+    const glm::vec3 screen[3] = {v0, v1, v2};
+    // y points down, so a positive area is clockwise on screen
+    float area = 0.0f;
+    for (int k = 0; k < 3; k++) {
+        const glm::vec3& p = screen[k];
+        const glm::vec3& q = screen[(k + 1) % 3];
+        area += p.x * q.y - q.x * p.y;
+    }
+    if (area == 0.0f || (area < 0.0f && !twoSided)) {
+        return;
+    }
+    float sign = area > 0.0f ? 1.0f : -1.0f;
+
+    // pixels whose center is inside
+    glm::vec3 boundsMin = glm::min(screen[0], glm::min(screen[1], screen[2]));
+    glm::vec3 boundsMax = glm::max(screen[0], glm::max(screen[1], screen[2]));
+    Triangle triangle{};
+    triangle.minX = static_cast<int32_t>(std::ceil(std::clamp(boundsMin.x, 0.0f, width) - 0.5f));
+    triangle.minY = static_cast<int32_t>(std::ceil(std::clamp(boundsMin.y, 0.0f, height) - 0.5f));
+    triangle.maxX = std::min(static_cast<int32_t>(m_width) - 1, static_cast<int32_t>(std::floor(std::clamp(boundsMax.x, 0.0f, width) - 0.5f)));
+    triangle.maxY = std::min(static_cast<int32_t>(m_height) - 1, static_cast<int32_t>(std::floor(std::clamp(boundsMax.y, 0.0f, height) - 0.5f)));
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+        return;
+    }
+
+    for (int k = 0; k < 3; k++) {
+        const glm::vec3& p = screen[k];
+        const glm::vec3& q = screen[(k + 1) % 3];
+        float dx = q.x - p.x, dy = q.y - p.y;
+        triangle.a[k] = -dy * sign;
+        triangle.b[k] = dx * sign;
+        triangle.c[k] = (dy * p.x - dx * p.y) * sign;
+        float halfPixel = (std::abs(triangle.a[k]) + std::abs(triangle.b[k])) * 0.5f;
+        triangle.sampleOffset[k] = sharedEdges[k] ? 0.0f : halfPixel;
+        triangle.coverOffset[k] = halfPixel - triangle.sampleOffset[k];
+    }
+
+    glm::vec3 e1 = screen[1] - screen[0], e2 = screen[2] - screen[0];
+    float determinant = e1.x * e2.y - e2.x * e1.y;
+    triangle.depthDX = (e1.z * e2.y - e2.z * e1.y) / determinant;
+    triangle.depthDY = (e2.z * e1.x - e1.z * e2.x) / determinant;
+    triangle.depthC = screen[0].z - triangle.depthDX * screen[0].x - triangle.depthDY * screen[0].y;
+    triangle.depthOffset = (std::abs(triangle.depthDX) + std::abs(triangle.depthDY)) * 0.5f;
+    triangle.partialDepth = partialDepth;
+
+    uint32_t index = static_cast<uint32_t>(m_triangles.size());
+    m_triangles.push_back(triangle);
+    for (uint32_t band = triangle.minY / BAND_HEIGHT; band <= triangle.maxY / BAND_HEIGHT; band++) {
+        m_bandTriangles[band].push_back(index);
+    }
+    m_stats.rasterizedTriangles++;
+}
+
+void NanoOcclusionCuller::DownsampleRows(uint32_t level, uint32_t rowBegin, uint32_t rowEnd) {
+    const Level& source = m_levels[level - 1];
+    Level& target = m_levels[level];
+    for (uint32_t y = rowBegin; y < rowEnd; y++) {
+        const float* row0 = source.depth.data() + static_cast<size_t>(2 * y) * source.width;
+        const float* row1 = source.depth.data() + static_cast<size_t>(std::min(2 * y + 1, source.height - 1)) * source.width;
+        float* out = target.depth.data() + static_cast<size_t>(y) * target.width;
+        for (uint32_t x = 0; x < target.width; x++) {
+            uint32_t x0 = 2 * x, x1 = std::min(2 * x + 1, source.width - 1);
+            out[x] = std::max(std::max(row0[x0], row0[x1]), std::max(row1[x0], row1[x1]));
+        }
+    }
+}
+
+void NanoOcclusionCuller::RasterizeBand(uint32_t band, NanoCullingKernel kernel) {
+    uint32_t bandBegin = band * BAND_HEIGHT;
+    uint32_t bandEnd = bandBegin + BAND_HEIGHT;
+    float* depth = m_levels[0].depth.data();
+    std::fill(depth + static_cast<size_t>(bandBegin) * m_width, depth + static_cast<size_t>(bandEnd) * m_width, 1.0f);
+
+    // a pixel is written when every edge function at its center clears the sample offset, with the depth plane's
+    // farthest value inside the pixel. When it doesn't clear the cover offsets too, the pixel may show the neighbors
+    for (uint32_t index : m_bandTriangles[band]) {
+        const Triangle& triangle = m_triangles[index];
+        int32_t rowBegin = std::max(triangle.minY, static_cast<int32_t>(bandBegin));
+        int32_t rowEnd = std::min(triangle.maxY + 1, static_cast<int32_t>(bandEnd));
+        for (int32_t y = rowBegin; y < rowEnd; y++) {
+            float centerY = static_cast<float>(y) + 0.5f;
+            float row[3];
+            for (int k = 0; k < 3; k++) {
+                row[k] = triangle.b[k] * centerY + triangle.c[k] - triangle.sampleOffset[k];
+            }
+            float depthRow = triangle.depthDY * centerY + triangle.depthC + triangle.depthOffset;
+            float* out = depth + static_cast<size_t>(y) * m_width;
+
+#ifdef NANO_CULLING_X86
+            if (kernel != NanoCullingKernel::SCALAR) {
+                // groups of 4 aligned pixels, the ones of a group outside the triangle fail the edge test anyway
+                __m128 a0 = _mm_set1_ps(triangle.a[0]), a1 = _mm_set1_ps(triangle.a[1]), a2 = _mm_set1_ps(triangle.a[2]);
+                __m128 row0 = _mm_set1_ps(row[0]), row1 = _mm_set1_ps(row[1]), row2 = _mm_set1_ps(row[2]);
+                __m128 cover0 = _mm_set1_ps(triangle.coverOffset[0]), cover1 = _mm_set1_ps(triangle.coverOffset[1]);
+                __m128 cover2 = _mm_set1_ps(triangle.coverOffset[2]);
+                __m128 depthX = _mm_set1_ps(triangle.depthDX), depthBase = _mm_set1_ps(depthRow);
+                __m128 partialDepth = _mm_set1_ps(triangle.partialDepth);
+                __m128 zero = _mm_setzero_ps();
+                for (int32_t x = triangle.minX & ~3; x <= triangle.maxX; x += 4) {
+                    __m128 centerX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+                    __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, centerX), row0);
+                    __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, centerX), row1);
+                    __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, centerX), row2);
+                    __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+                    if (_mm_movemask_ps(inside) == 0) {
+                        continue;
+                    }
+                    __m128 covered = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, cover0), _mm_cmpge_ps(e1, cover1)), _mm_cmpge_ps(e2, cover2));
+                    __m128 planeDepth = _mm_add_ps(_mm_mul_ps(depthX, centerX), depthBase);
+                    planeDepth = _mm_or_ps(_mm_and_ps(covered, planeDepth), _mm_andnot_ps(covered, _mm_max_ps(planeDepth, partialDepth)));
+                    __m128 current = _mm_loadu_ps(out + x);
+                    __m128 nearest = _mm_min_ps(current, planeDepth);
+                    _mm_storeu_ps(out + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+                }
+                continue;
+            }
+#endif
+            for (int32_t x = triangle.minX; x <= triangle.maxX; x++) {
+                float centerX = static_cast<float>(x) + 0.5f;
+                float e0 = triangle.a[0] * centerX + row[0], e1 = triangle.a[1] * centerX + row[1], e2 = triangle.a[2] * centerX + row[2];
+                if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f) {
+                    float planeDepth = triangle.depthDX * centerX + depthRow;
+                    if (e0 < triangle.coverOffset[0] || e1 < triangle.coverOffset[1] || e2 < triangle.coverOffset[2]) {
+                        planeDepth = std::max(planeDepth, triangle.partialDepth);
+                    }
+                    out[x] = std::min(out[x], planeDepth);
+                }
+            }
+        }
+    }
+
+    for (uint32_t level = 1; level <= BAND_LEVELS && level < m_levels.size(); level++) {
+        DownsampleRows(level, bandBegin >> level, bandEnd >> level);
+    }
+}
+
+void NanoOcclusionCuller::Rasterize(NanoJobSystem& jobSystem, NanoCullingKernel kernel) {
+    auto start = std::chrono::steady_clock::now();
+
+    // bands share nothing, every triangle was already sorted into the bands it touches
+    jobSystem.ParallelFor(static_cast<uint32_t>(m_bandTriangles.size()), 1, [this, kernel](uint32_t begin, uint32_t end) {
+        for (uint32_t band = begin; band < end; band++) {
+            RasterizeBand(band, kernel);
+        }
+    });
+    for (uint32_t level = BAND_LEVELS + 1; level < m_levels.size(); level++) {
+        DownsampleRows(level, 0, m_levels[level].height);
+    }
+
+    m_stats.rasterizeMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool NanoOcclusionCuller::IsVisible(const glm::vec3& min, const glm::vec3& max) const {
+    // screen rectangle and nearest depth of the 8 corners, each corner is the min corner plus some of the box axes
+    glm::vec4 base = m_viewProjection * glm::vec4(min, 1.0f);
+    glm::vec4 axisX = m_viewProjection[0] * (max.x - min.x);
+    glm::vec4 axisY = m_viewProjection[1] * (max.y - min.y);
+    glm::vec4 axisZ = m_viewProjection[2] * (max.z - min.z);
+    glm::vec2 screenMin(FLT_MAX), screenMax(-FLT_MAX);
+    float nearest = FLT_MAX;
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec4 clip = base;
+        if (corner & 1) {
+            clip += axisX;
+        }
+        if (corner & 2) {
+            clip += axisY;
+        }
+        if (corner & 4) {
+            clip += axisZ;
+        }
+        if (clip.z < 0.0f || clip.w < NEAR_CLIP_W) {
+            return true; // crosses the near plane, the camera may well be inside
+        }
+        glm::vec2 screen((clip.x / clip.w * 0.5f + 0.5f) * m_width, (clip.y / clip.w * 0.5f + 0.5f) * m_height);
+        screenMin = glm::min(screenMin, screen);
+        screenMax = glm::max(screenMax, screen);
+        nearest = std::min(nearest, clip.z / clip.w);
+    }
+    if (screenMax.x <= 0.0f || screenMax.y <= 0.0f || screenMin.x >= m_width || screenMin.y >= m_height) {
+        return true; // that's for the frustum culler to decide
+    }
+
+    float width = static_cast<float>(m_width), height = static_cast<float>(m_height);
+    int32_t x0 = static_cast<int32_t>(std::floor(std::clamp(screenMin.x, 0.0f, width - 1.0f)));
+    int32_t y0 = static_cast<int32_t>(std::floor(std::clamp(screenMin.y, 0.0f, height - 1.0f)));
+    int32_t x1 = std::max(x0, static_cast<int32_t>(std::ceil(std::clamp(screenMax.x, 0.0f, width))) - 1);
+    int32_t y1 = std::max(y0, static_cast<int32_t>(std::ceil(std::clamp(screenMax.y, 0.0f, height))) - 1);
+
+    // coarsest level first that still has at most 4x4 texels under the rectangle
+    uint32_t level = 0;
+    while (level + 1 < m_levels.size() && ((x1 >> level) - (x0 >> level) > 3 || (y1 >> level) - (y0 >> level) > 3)) {
+        level++;
+    }
+    const Level& texels = m_levels[level];
+    for (int32_t y = y0 >> level; y <= y1 >> level; y++) {
+        const float* row = texels.depth.data() + static_cast<size_t>(y) * texels.width;
+        for (int32_t x = x0 >> level; x <= x1 >> level; x++) {
+            if (row[x] >= nearest) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+uint32_t NanoOcclusionCuller::Cull(const NanoFrustumCuller& bounds, const uint32_t* indices, uint32_t count, NanoJobSystem& jobSystem) {
+    auto start = std::chrono::steady_clock::now();
+    m_visibleFlags.resize(count);
+    m_visible.resize(count);
+
+    jobSystem.ParallelFor(count, TEST_CHUNK, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            glm::vec3 min, max;
+            bounds.GetBounds(indices[i], min, max);
+            m_visibleFlags[i] = IsVisible(min, max);
+        }
+    });
+
+    uint32_t visibleCount = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        m_visible[visibleCount] = indices[i];
+        visibleCount += m_visibleFlags[i];
+    }
+    m_visibleCount = visibleCount;
+
+    m_stats.testedObjects += count;
+    m_stats.culledObjects += count - visibleCount;
+    m_stats.testMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return visibleCount;
+}
+
+const float* NanoOcclusionCuller::GetLevel(uint32_t level, uint32_t& width, uint32_t& height) {
+    width = m_levels[level].width;
+    height = m_levels[level].height;
+    return m_levels[level].depth.data();
+}
@@ -0,0 +1,101 @@
+#ifndef NANOOCCLUSIONCULLER_H_
+#define NANOOCCLUSIONCULLER_H_
+
+#include "NanoFrustumCuller.hpp"
+#include "NanoJobSystem.hpp"
+
+#include "glm/glm.hpp"
+
+#include <cstdint>
+#include <vector>
+
+struct NanoOcclusionStats {
+    uint32_t occluderTriangles = 0;   // submitted with AddOccluder
+    uint32_t rasterizedTriangles = 0; // left after near plane, back face and screen rejection
+    uint32_t testedObjects = 0;
+    uint32_t culledObjects = 0;
+    double rasterizeMs = 0.0;
+    double testMs = 0.0;
+};
+
+// Software occlusion culling. A few big occluder meshes are rasterized into a small depth buffer on the CPU, then the
+// boxes of the objects that survived frustum culling are tested against a max depth pyramid built from it.
+// Along the outline of an occluder only pixels it covers completely are filled, with the farthest depth inside the pixel,
+// so an object is only culled when it's hidden at the resolution of the buffer. Edges shared by two triangles of the same
+// occluder are sampled at the pixel centers instead, which keeps meshes free of cracks, and the pixels along them take the
+// farthest depth of all the triangles around. Where the outline turns at such an edge a covered pixel can reach about a
+// pixel past it, so objects seen only through gaps that small may be culled. Occluders don't have to be the render meshes,
+// a handful of low poly walls and buildings is enough, as long as their triangles are not much smaller than a pixel.
+// Each frame: BeginFrame, AddOccluder for every occluder, Rasterize, then Cull
+class NanoOcclusionCuller {
+  public:
+    static constexpr uint32_t BAND_HEIGHT = 16;   // rows per rasterizer job, the pyramid levels inside a band are built by the same job
+    static constexpr uint32_t TEST_CHUNK = 1024;  // objects per job
+    static constexpr float NEAR_CLIP_W = 1e-5f;
+    static constexpr float GUARD_BAND = 8.0f; // occluders are clipped this far outside the screen, in NDC
+
+    // sizes are rounded up to BAND_HEIGHT
+    void Init(uint32_t width, uint32_t height);
+    uint32_t GetWidth() { return m_width; }
+    uint32_t GetHeight() { return m_height; }
+
+    // Vulkan clip space like the frustum culler, depth in [0, 1]
+    void BeginFrame(const glm::mat4& viewProjection);
+    // triangle list, clockwise on screen is front facing like in the graphics pipeline
+    void AddOccluder(const glm::vec3* vertices, const uint32_t* indices, uint32_t indexCount, const glm::mat4& world, bool twoSided = false);
+    // AUTO and AVX2 use the SSE kernel, 4 pixels per iteration
+    void Rasterize(NanoJobSystem& jobSystem, NanoCullingKernel kernel = NanoCullingKernel::AUTO);
+
+    // false only when the box is completely behind the occluders
+    bool IsVisible(const glm::vec3& min, const glm::vec3& max) const;
+    // keeps the objects among indices (e.g. the output of NanoFrustumCuller::Cull) that are not occluded, in the same order.
+    // The result stays valid until the next call
+    uint32_t Cull(const NanoFrustumCuller& bounds, const uint32_t* indices, uint32_t count, NanoJobSystem& jobSystem);
+    const uint32_t* GetVisibleIndices() { return m_visible.data(); }
+    uint32_t GetVisibleCount() { return m_visibleCount; }
+
+    // since BeginFrame
+    const NanoOcclusionStats& GetStats() { return m_stats; }
+    // level 0 is the rasterized depth, every level above holds the max of 2x2 texels below
+    uint32_t GetLevelCount() { return static_cast<uint32_t>(m_levels.size()); }
+    const float* GetLevel(uint32_t level, uint32_t& width, uint32_t& height);
+
+  private:
+    // edge functions a * x + b * y + c, positive inside, and the depth plane, all in pixels
+    struct Triangle {
+        float a[3], b[3], c[3];
+        float sampleOffset[3]; // half a pixel along the edge normal for outline edges, so the whole pixel is inside, 0 for shared ones
+        float coverOffset[3];  // what's left to the half pixel, a pixel past both offsets is covered completely
+        float depthC, depthDX, depthDY;
+        float depthOffset;  // from the pixel center to its farthest corner
+        float partialDepth; // farthest depth around the triangle, for pixels it only partly covers
+        int32_t minX, maxX, minY, maxY;
+    };
+    struct Level {
+        uint32_t width, height;
+        std::vector<float> depth;
+    };
+
+    void AddTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, const bool sharedEdges[3], float partialDepth, bool twoSided);
+    void RasterizeBand(uint32_t band, NanoCullingKernel kernel);
+    void DownsampleRows(uint32_t level, uint32_t rowBegin, uint32_t rowEnd);
+
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    glm::mat4 m_viewProjection{1.0f};
+    std::vector<Level> m_levels{};
+    std::vector<Triangle> m_triangles{};
+    std::vector<std::vector<uint32_t>> m_bandTriangles{};
+    // scratch for AddOccluder
+    std::vector<glm::vec4> m_clipVertices{};
+    std::vector<uint8_t> m_frontFacing{};
+    std::vector<uint64_t> m_sharedEdges{};
+    std::vector<float> m_vertexDepth{};
+
+    std::vector<uint8_t> m_visibleFlags{};
+    std::vector<uint32_t> m_visible{};
+    uint32_t m_visibleCount = 0;
+    NanoOcclusionStats m_stats{};
+};
+
+#endif // NANOOCCLUSIONCULLER_H_
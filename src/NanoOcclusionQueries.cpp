@@ -0,0 +1,207 @@
+#include "NanoOcclusionQueries.hpp"
+#include "NanoLogger.hpp"
+
+#include <stdexcept>
+
+ERR NanoOcclusionQueries::Init(VkDevice& device, const VkPhysicalDevice& physicalDevice, uint32_t maxQueriesPerFrame, bool conditionalRendering) {
+    ERR err = ERR::OK;
+    _device = device;
+    m_maxQueries = maxQueriesPerFrame;
+
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_OCCLUSION;
+    poolInfo.queryCount = m_maxQueries;
+
+    for (uint32_t i = 0; i < Config::MAX_FRAMES_IN_FLIGHT; i++) {
+        if (vkCreateQueryPool(_device, &poolInfo, nullptr, &m_pools[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create occlusion query pool!");
+        }
+        m_queryObjects[i].clear();
+        m_queryObjects[i].reserve(m_maxQueries);
+        m_slotFrame[i] = 0;
+    }
+    m_results.assign(static_cast<size_t>(m_maxQueries) * 2, 0);
+
+    m_conditionalRendering = false;
+    if (conditionalRendering) {
+        m_cmdBeginConditionalRendering =
+            (PFN_vkCmdBeginConditionalRenderingEXT)vkGetDeviceProcAddr(_device, "vkCmdBeginConditionalRenderingEXT");
+        m_cmdEndConditionalRendering = (PFN_vkCmdEndConditionalRenderingEXT)vkGetDeviceProcAddr(_device, "vkCmdEndConditionalRenderingEXT");
+        if (m_cmdBeginConditionalRendering && m_cmdEndConditionalRendering) {
+            m_predicateBuffer.Init(device, physicalDevice, getPredicateOffset(Config::MAX_FRAMES_IN_FLIGHT, 0),
+                                   VK_BUFFER_USAGE_CONDITIONAL_RENDERING_BIT_EXT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            m_conditionalRendering = true;
+        } else {
+            LOG_MSG(ERRLevel::WARNING, "conditional rendering entry points are missing, occluded objects won't be predicated");
+        }
+    }
+
+    m_frameNumber = 0;
+    m_recordedFrameStart = false;
+    m_predicatesWanted = false;
+    m_predicatesLastFrame = false;
+    m_copiedPredicates = false;
+    m_stats = {};
+    LOG_MSG(ERRLevel::INFO, "Occlusion queries: %d per frame, conditional rendering %s", m_maxQueries, m_conditionalRendering ? "on" : "off");
+
+    m_isInit = true;
+    return err;
+}
+
+void NanoOcclusionQueries::CleanUp() {
+    if (!m_isInit) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < Config::MAX_FRAMES_IN_FLIGHT; i++) {
+        vkDestroyQueryPool(_device, m_pools[i], nullptr);
+        m_pools[i] = VK_NULL_HANDLE;
+    }
+    m_predicateBuffer.CleanUp();
+    m_isInit = false;
+}
+
+void NanoOcclusionQueries::Resize(uint32_t objectCount) {
+    m_objects.resize(objectCount);
+}
+
+void NanoOcclusionQueries::BeginFrame(uint32_t frameIndex) {
+    ASSERT(m_isInit, "Occlusion queries used before Init");
+    m_previousFrameIndex = m_frameIndex;
+    m_frameIndex = frameIndex;
+    m_frameNumber++;
+    m_recordedFrameStart = false;
+    m_predicatesLastFrame = m_predicatesWanted;
+    m_predicatesWanted = false;
+    m_copiedPredicates = false;
+    m_stats = {};
+
+    // the fence of the frame that last used this slot was just waited on, its results are there without waiting.
+    // Slots come around in order, so each result is newer than whatever the object had before
+    std::vector<uint32_t>& queryObjects = m_queryObjects[frameIndex];
+    uint32_t queryCount = static_cast<uint32_t>(queryObjects.size());
+    if (queryCount > 0) {
+        vkGetQueryPoolResults(_device, m_pools[frameIndex], 0, queryCount, queryCount * 2 * sizeof(uint64_t), m_results.data(),
+                              2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        for (uint32_t i = 0; i < queryCount; i++) {
+            uint32_t object = queryObjects[i];
+            if (object >= m_objects.size()) {
+                continue; // resized away since
+            }
+            bool available = m_results[i * 2 + 1] != 0;
+            m_objects[object].visible = !available || m_results[i * 2] != 0;
+            if (!m_objects[object].visible) {
+                m_stats.occludedObjects++;
+            }
+        }
+    }
+    queryObjects.clear();
+    m_slotFrame[frameIndex] = m_frameNumber;
+}
+
+void NanoOcclusionQueries::RecordFrameStart(VkCommandBuffer& commandBuffer) {
+    ASSERT(m_isInit, "Occlusion queries used before Init");
+    // no objects, no queries (none this frame and none last frame to copy), so nothing to reset either
+    if (m_objects.empty()) {
+        m_recordedFrameStart = false;
+        return;
+    }
+    vkCmdResetQueryPool(commandBuffer, m_pools[m_frameIndex], 0, m_maxQueries);
+
+    // last frame was submitted before this one, so on the queue its queries are done by the time this copy runs.
+    // The copy only waits on the GPU, the CPU never sees these results. Skipped while nothing predicates its draws
+    uint32_t previousCount = static_cast<uint32_t>(m_queryObjects[m_previousFrameIndex].size());
+    if (m_conditionalRendering && m_predicatesLastFrame && previousCount > 0 && m_slotFrame[m_previousFrameIndex] + 1 == m_frameNumber) {
+        vkCmdCopyQueryPoolResults(commandBuffer, m_pools[m_previousFrameIndex], 0, previousCount, m_predicateBuffer.GetBuffer(),
+                                  getPredicateOffset(m_frameIndex, 0), sizeof(uint32_t), VK_QUERY_RESULT_WAIT_BIT);
+
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_CONDITIONAL_RENDERING_READ_BIT_EXT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = m_predicateBuffer.GetBuffer();
+        barrier.offset = getPredicateOffset(m_frameIndex, 0);
+        barrier.size = previousCount * sizeof(uint32_t);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_CONDITIONAL_RENDERING_BIT_EXT, 0, 0, nullptr,
+                             1, &barrier, 0, nullptr);
+        m_copiedPredicates = true;
+    }
+    m_recordedFrameStart = true;
+}
+
+bool NanoOcclusionQueries::NeedsQuery(uint32_t object) {
+    const ObjectState& state = m_objects[object];
+    if (state.queryFrame[0] == m_frameNumber) {
+        return false;
+    }
+    if (!state.visible) {
+        return true;
+    }
+    if ((m_frameNumber + object) % VISIBLE_QUERY_INTERVAL == 0) {
+        return true;
+    }
+    m_stats.skippedQueries++;
+    return false;
+}
+
+bool NanoOcclusionQueries::BeginQuery(VkCommandBuffer& commandBuffer, uint32_t object) {
+    ASSERT(m_recordedFrameStart, "RecordFrameStart has to come before the frame's first query");
+    std::vector<uint32_t>& queryObjects = m_queryObjects[m_frameIndex];
+    if (queryObjects.size() >= m_maxQueries) {
+        m_stats.droppedQueries++;
+        return false;
+    }
+
+    uint32_t query = static_cast<uint32_t>(queryObjects.size());
+    queryObjects.push_back(object);
+    ObjectState& state = m_objects[object];
+    if (state.queryFrame[0] != m_frameNumber) {
+        state.queryFrame[1] = state.queryFrame[0];
+        state.query[1] = state.query[0];
+    }
+    state.queryFrame[0] = m_frameNumber;
+    state.query[0] = query;
+
+    // any sample passing is enough, no need for the precise count
+    vkCmdBeginQuery(commandBuffer, m_pools[m_frameIndex], query, 0);
+    m_stats.issuedQueries++;
+    return true;
+}
+
+void NanoOcclusionQueries::EndQuery(VkCommandBuffer& commandBuffer) {
+    uint32_t query = static_cast<uint32_t>(m_queryObjects[m_frameIndex].size()) - 1;
+    vkCmdEndQuery(commandBuffer, m_pools[m_frameIndex], query);
+}
+
+bool NanoOcclusionQueries::BeginConditionalRendering(VkCommandBuffer& commandBuffer, uint32_t object) {
+    m_predicatesWanted = true;
+    if (!m_conditionalRendering || !m_copiedPredicates) {
+        return false;
+    }
+
+    const ObjectState& state = m_objects[object];
+    uint32_t query = UINT32_MAX;
+    for (uint32_t i = 0; i < 2; i++) {
+        if (state.queryFrame[i] == m_frameNumber - 1) {
+            query = state.query[i];
+        }
+    }
+    if (query == UINT32_MAX) {
+        return false;
+    }
+
+    VkConditionalRenderingBeginInfoEXT beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_CONDITIONAL_RENDERING_BEGIN_INFO_EXT;
+    beginInfo.buffer = m_predicateBuffer.GetBuffer();
+    beginInfo.offset = getPredicateOffset(m_frameIndex, query);
+    m_cmdBeginConditionalRendering(commandBuffer, &beginInfo);
+    return true;
+}
+
+void NanoOcclusionQueries::EndConditionalRendering(VkCommandBuffer& commandBuffer) {
+    m_cmdEndConditionalRendering(commandBuffer);
+}
@@ -0,0 +1,106 @@
+#ifndef NANOOCCLUSIONQUERIES_H_
+#define NANOOCCLUSIONQUERIES_H_
+
+#include "NanoBuffer.hpp"
+#include "NanoConfig.hpp"
+#include "NanoError.hpp"
+
+#include "vulkan/vulkan_core.h"
+#include <cstdint>
+#include <vector>
+
+struct NanoOcclusionQueryStats {
+    uint32_t issuedQueries = 0;
+    uint32_t skippedQueries = 0;  // visible objects that were drawn without a query thanks to temporal coherence
+    uint32_t droppedQueries = 0;  // the pool was full
+    uint32_t occludedObjects = 0; // results read this frame that came back with no samples
+};
+
+// Hardware occlusion queries for big objects, as a second line behind the CPU culling.
+// One query pool per frame in flight: a frame's results are read back when its slot comes around again, right after the
+// inFlightFence was waited on, so reading them never stalls. Temporal coherence keeps the query count down: an object
+// that was visible is simply drawn and only queried again every VISIBLE_QUERY_INTERVAL frames (with its real draw inside
+// the query), an occluded one is not drawn but has its bounding box queried every frame until it comes back.
+// The CPU only learns about that MAX_FRAMES_IN_FLIGHT frames later. With conditional rendering the draw of an occluded
+// object can be predicated on the GPU with last frame's result instead, which hides the popping.
+// Results that are not available count as visible, so a late query never hides anything.
+// Queries only mean something once the pass has a depth attachment to test against.
+// Per frame: BeginFrame, RecordFrameStart before the render pass, then NeedsQuery / BeginQuery / EndQuery per object.
+// The engine draws its scene in one indirect draw, so it has no per object draws: NanoGraphics registers its large
+// instances, queries their bounding boxes after the depth pre-pass and turns the results into instance flags the GPU
+// culling skips. Last frame's results are only copied for conditional rendering when something asked for them
+class NanoOcclusionQueries {
+  public:
+    static constexpr uint32_t VISIBLE_QUERY_INTERVAL = 8; // frames, staggered by object index so the queries are spread out
+
+    // conditionalRendering needs VK_EXT_conditional_rendering enabled on the device
+    ERR Init(VkDevice& device, const VkPhysicalDevice& physicalDevice, uint32_t maxQueriesPerFrame, bool conditionalRendering);
+    void CleanUp();
+    // objects start out visible
+    void Resize(uint32_t objectCount);
+
+    // must be called right after the frame's inFlightFence has been waited on and before recording
+    void BeginFrame(uint32_t frameIndex);
+    // outside of a render pass, before the first query of the frame. Resets the frame's pool and copies last frame's
+    // results where conditional rendering reads them. Nothing at all while no objects are registered (Resize)
+    void RecordFrameStart(VkCommandBuffer& commandBuffer);
+
+    // last known result, visible objects are drawn normally, occluded ones are skipped or predicated
+    bool IsVisible(uint32_t object) const { return m_objects[object].visible; }
+    // e.g. the camera is inside its bounding box, which would be clipped and could come back with no samples
+    void MarkVisible(uint32_t object) { m_objects[object].visible = true; }
+    bool NeedsQuery(uint32_t object);
+    // around the object's draw when it is visible, around its bounding box (depth test on, no writes) when it is not.
+    // Returns false when the pool is full, EndQuery must not be called then
+    bool BeginQuery(VkCommandBuffer& commandBuffer, uint32_t object);
+    void EndQuery(VkCommandBuffer& commandBuffer);
+
+    // predicates the following draws on the object's query from last frame. Returns false when there is no such query or
+    // conditional rendering is off, the draw should then follow IsVisible. The first call only asks for the predicates,
+    // they are there from the next frame on
+    bool BeginConditionalRendering(VkCommandBuffer& commandBuffer, uint32_t object);
+    void EndConditionalRendering(VkCommandBuffer& commandBuffer);
+
+    bool IsInit() { return m_isInit; }
+    bool HasConditionalRendering() { return m_conditionalRendering; }
+    const NanoOcclusionQueryStats& GetStats() { return m_stats; }
+
+  private:
+    struct ObjectState {
+        bool visible = true;
+        // the two most recent queries, index in the pool of the frame they were issued in. The older one is still
+        // needed when the object is queried again before its draw is predicated on last frame's result
+        uint64_t queryFrame[2] = {UINT64_MAX, UINT64_MAX};
+        uint32_t query[2] = {0, 0};
+    };
+
+    VkDeviceSize getPredicateOffset(uint32_t frameIndex, uint32_t query) {
+        return (static_cast<VkDeviceSize>(frameIndex) * m_maxQueries + query) * sizeof(uint32_t);
+    }
+
+    VkDevice _device{};
+    bool m_isInit = false;
+    bool m_conditionalRendering = false;
+    uint32_t m_maxQueries = 0;
+    VkQueryPool m_pools[Config::MAX_FRAMES_IN_FLIGHT]{};
+    std::vector<uint32_t> m_queryObjects[Config::MAX_FRAMES_IN_FLIGHT]{}; // object behind every query issued in that slot
+    uint64_t m_slotFrame[Config::MAX_FRAMES_IN_FLIGHT]{};                 // frame number the slot was last recorded in
+    std::vector<uint64_t> m_results{};                                    // result and availability pairs
+
+    // one region of m_maxQueries 32 bit predicates per frame in flight
+    NanoBuffer m_predicateBuffer{};
+    PFN_vkCmdBeginConditionalRenderingEXT m_cmdBeginConditionalRendering = nullptr;
+    PFN_vkCmdEndConditionalRenderingEXT m_cmdEndConditionalRendering = nullptr;
+
+    std::vector<ObjectState> m_objects{};
+    uint32_t m_frameIndex = 0;
+    uint32_t m_previousFrameIndex = 0;
+    uint64_t m_frameNumber = 0;
+    bool m_recordedFrameStart = false;
+    bool m_predicatesWanted = false;     // BeginConditionalRendering was called this frame
+    bool m_predicatesLastFrame = false;  // ... last frame, RecordFrameStart copies the results then
+    bool m_copiedPredicates = false;
+    NanoOcclusionQueryStats m_stats{};
+};
+
+#endif // NANOOCCLUSIONQUERIES_H_
@@ -0,0 +1,138 @@
+#include "NanoPipelineLayoutCache.hpp"
+#include "NanoConfig.hpp"
+#include "NanoLogger.hpp"
+
+#include <algorithm>
+
+// what a runtime array outside of the bindless set is clamped to, the same as the bindless fallback of its type
+static uint32_t getFallbackDescriptorCount(VkDescriptorType type) {
+    switch (type) {
+    case VK_DESCRIPTOR_TYPE_SAMPLER:
+        return Config::BINDLESS_FALLBACK_MAX_SAMPLERS;
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+        return Config::BINDLESS_FALLBACK_MAX_STORAGE_BUFFERS;
+    default:
+        return Config::BINDLESS_FALLBACK_MAX_SAMPLED_IMAGES;
+    }
+}
+
+void NanoPipelineLayoutCache::Init(VkDevice& device) {
+    _device = device;
+}
+
+void NanoPipelineLayoutCache::CleanUp() {
+    for (auto& [key, pipelineLayout] : m_pipelineLayouts) {
+        vkDestroyPipelineLayout(_device, pipelineLayout, nullptr);
+    }
+    m_pipelineLayouts.clear();
+
+    for (auto& [key, setLayout] : m_setLayouts) {
+        vkDestroyDescriptorSetLayout(_device, setLayout, nullptr);
+    }
+    m_setLayouts.clear();
+}
+
+VkDescriptorSetLayout NanoPipelineLayoutCache::GetDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings) {
+    std::vector<VkDescriptorSetLayoutBinding> sortedBindings = bindings;
+    std::sort(sortedBindings.begin(), sortedBindings.end(),
+              [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+
+    std::vector<uint64_t> key{};
+    key.reserve(sortedBindings.size() * 4);
+    for (const auto& binding : sortedBindings) {
+        key.push_back(binding.binding);
+        key.push_back(binding.descriptorType);
+        key.push_back(binding.descriptorCount);
+        key.push_back(binding.stageFlags);
+    }
+
+    auto it = m_setLayouts.find(key);
+    if (it != m_setLayouts.end()) {
+        return it->second;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(sortedBindings.size());
+    layoutInfo.pBindings = sortedBindings.data();
+
+    VkDescriptorSetLayout setLayout{};
+    if (vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor set layout!");
+    }
+
+    m_setLayouts.emplace(std::move(key), setLayout);
+    return setLayout;
+}
+
+VkPipelineLayout NanoPipelineLayoutCache::GetPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts,
+                                                            const std::vector<VkPushConstantRange>& pushConstantRanges) {
+    std::vector<uint64_t> key{};
+    key.reserve(setLayouts.size() + pushConstantRanges.size() * 3 + 1);
+    key.push_back(setLayouts.size());
+    for (const auto& setLayout : setLayouts) {
+        key.push_back(reinterpret_cast<uint64_t>(setLayout));
+    }
+    for (const auto& range : pushConstantRanges) {
+        key.push_back(range.stageFlags);
+        key.push_back(range.offset);
+        key.push_back(range.size);
+    }
+
+    auto it = m_pipelineLayouts.find(key);
+    if (it != m_pipelineLayouts.end()) {
+        return it->second;
+    }
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+    pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+
+    VkPipelineLayout pipelineLayout{};
+    if (vkCreatePipelineLayout(_device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+
+    m_pipelineLayouts.emplace(std::move(key), pipelineLayout);
+    LOG_MSG(ERRLevel::INFO, "Pipeline layout cache: %d set layouts, %d pipeline layouts", static_cast<int>(m_setLayouts.size()),
+            static_cast<int>(m_pipelineLayouts.size()));
+    return pipelineLayout;
+}
+
+VkPipelineLayout NanoPipelineLayoutCache::GetPipelineLayout(const ShaderReflection& reflection, const std::vector<VkDescriptorSetLayout>& overrideSetLayouts) {
+    uint32_t setCount = std::max<uint32_t>(reflection.GetSetCount(), static_cast<uint32_t>(overrideSetLayouts.size()));
+
+    std::vector<VkDescriptorSetLayout> setLayouts(setCount, VK_NULL_HANDLE);
+    for (uint32_t set = 0; set < setCount; set++) {
+        if (set < overrideSetLayouts.size() && overrideSetLayouts[set] != VK_NULL_HANDLE) {
+            setLayouts[set] = overrideSetLayouts[set];
+            continue;
+        }
+
+        // sets that no stage uses still need a (empty) layout so the set indices stay where the shaders expect them
+        std::vector<VkDescriptorSetLayoutBinding> bindings{};
+        for (const auto& reflected : reflection.descriptorBindings) {
+            if (reflected.set != set) {
+                continue;
+            }
+            VkDescriptorSetLayoutBinding binding{};
+            binding.binding = reflected.binding;
+            binding.descriptorType = reflected.descriptorType;
+            binding.descriptorCount = reflected.descriptorCount;
+            binding.stageFlags = reflected.stageFlags;
+            if (binding.descriptorCount == 0) {
+                binding.descriptorCount = getFallbackDescriptorCount(binding.descriptorType);
+                LOG_MSG(ERRLevel::WARNING, "Runtime array %s outside of the bindless set, clamped to %d descriptors", reflected.name.c_str(),
+                        static_cast<int>(binding.descriptorCount));
+            }
+            bindings.push_back(binding);
+        }
+        setLayouts[set] = GetDescriptorSetLayout(bindings);
+    }
+
+    return GetPipelineLayout(setLayouts, reflection.pushConstantRanges);
+}
@@ -0,0 +1,35 @@
+#ifndef NANOPIPELINELAYOUTCACHE_H_
+#define NANOPIPELINELAYOUTCACHE_H_
+
+#include "NanoError.hpp"
+#include "NanoShaderReflection.hpp"
+
+#include "vulkan/vulkan_core.h"
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Deduplicates descriptor set layouts and pipeline layouts. Two pipelines whose shaders expose the same interface
+// get the exact same VkPipelineLayout, so descriptor sets bound for one stay valid after switching to the other.
+class NanoPipelineLayoutCache {
+  public:
+    void Init(VkDevice& device);
+    void CleanUp();
+
+    VkDescriptorSetLayout GetDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+    VkPipelineLayout GetPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstantRanges);
+
+    // builds (or fetches) the pipeline layout for a reflected interface.
+    // overrideSetLayouts[set], when not VK_NULL_HANDLE, replaces whatever the reflection found for that set (e.g. the bindless set)
+    VkPipelineLayout GetPipelineLayout(const ShaderReflection& reflection, const std::vector<VkDescriptorSetLayout>& overrideSetLayouts = {});
+
+    size_t GetDescriptorSetLayoutCount() { return m_setLayouts.size(); }
+    size_t GetPipelineLayoutCount() { return m_pipelineLayouts.size(); }
+
+  private:
+    VkDevice _device{};
+    std::map<std::vector<uint64_t>, VkDescriptorSetLayout> m_setLayouts{};
+    std::map<std::vector<uint64_t>, VkPipelineLayout> m_pipelineLayouts{};
+};
+
+#endif // NANOPIPELINELAYOUTCACHE_H_
@@ -0,0 +1,385 @@
+#include "NanoProfiler.hpp"
+#include "NanoJobSystem.hpp"
+#include "NanoLogger.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+namespace {
+struct OpenCpuZone {
+    const char* name;
+    double startMs;
+};
+thread_local std::vector<OpenCpuZone> t_openCpuZones{};
+
+void writeJsonString(std::ofstream& file, const std::string& text) {
+    file << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            file << '\\';
+        }
+        file << c;
+    }
+    file << '"';
+}
+
+void writeCsvString(std::ofstream& file, const std::string& text) {
+    file << '"';
+    for (char c : text) {
+        file << c;
+        if (c == '"') {
+            file << c;
+        }
+    }
+    file << '"';
+}
+} // namespace
+
+ERR NanoProfiler::Init(uint32_t historyFrames) {
+    ERR err = ERR::OK;
+    m_origin = std::chrono::steady_clock::now();
+    m_frames.assign(std::max(historyFrames, 2u), NanoProfileFrame{});
+    m_frameNumber = 0;
+    m_lastResolvedFrame = 0;
+    m_lastGpuEndMs = 0.0;
+    m_isInit = true;
+    return err;
+}
+
+ERR NanoProfiler::InitGpu(VkDevice& device, float timestampPeriod, uint32_t timestampValidBits, bool pipelineStatistics) {
+    ERR err = ERR::OK;
+    if (timestampValidBits == 0 || timestampPeriod <= 0.0f) {
+        LOG_MSG(ERRLevel::WARNING, "profiler: the graphics queue has no timestamps, GPU zones are off");
+        return ERR::INVALID;
+    }
+    _device = device;
+    m_tickMs = timestampPeriod / 1e6;
+    m_timestampMask = timestampValidBits >= 64 ? UINT64_MAX : (1ull << timestampValidBits) - 1;
+    m_pipelineStatistics = pipelineStatistics;
+
+    VkQueryPoolCreateInfo timestampInfo{};
+    timestampInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    timestampInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    timestampInfo.queryCount = Config::PROFILER_MAX_GPU_ZONES * 2;
+
+    VkQueryPoolCreateInfo statisticsInfo{};
+    statisticsInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    statisticsInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    statisticsInfo.queryCount = Config::PROFILER_MAX_GPU_ZONES;
+    // results come in bit order: vertex, then fragment invocations
+    statisticsInfo.pipelineStatistics =
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+    for (GpuSlot& slot : m_slots) {
+        if (vkCreateQueryPool(_device, &timestampInfo, nullptr, &slot.timestamps) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create timestamp query pool!");
+        }
+        if (m_pipelineStatistics && vkCreateQueryPool(_device, &statisticsInfo, nullptr, &slot.statistics) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline statistics query pool!");
+        }
+        slot.frame = 0;
+        slot.zones.clear();
+        slot.zones.reserve(Config::PROFILER_MAX_GPU_ZONES);
+    }
+    m_results.assign(Config::PROFILER_MAX_GPU_ZONES * 2, 0);
+    LOG_MSG(ERRLevel::INFO, "profiler: GPU timestamps at %f ns, pipeline statistics %s", timestampPeriod, m_pipelineStatistics ? "on" : "off");
+
+    m_gpuInit = true;
+    return err;
+}
+
+void NanoProfiler::CleanUpGpu() {
+    if (!m_gpuInit) {
+        return;
+    }
+    for (GpuSlot& slot : m_slots) {
+        vkDestroyQueryPool(_device, slot.timestamps, nullptr);
+        vkDestroyQueryPool(_device, slot.statistics, nullptr);
+        slot.timestamps = VK_NULL_HANDLE;
+        slot.statistics = VK_NULL_HANDLE;
+        slot.frame = 0;
+    }
+    m_gpuInit = false;
+}
+
+void NanoProfiler::CleanUp() {
+    CleanUpGpu();
+    m_frames.clear();
+    m_isInit = false;
+}
+
+double NanoProfiler::now() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_origin).count();
+}
+
+void NanoProfiler::BeginFrame() {
+    if (!m_isInit) {
+        return;
+    }
+    double time = now();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_frameNumber > 0) {
+        NanoProfileFrame& previous = m_frames[m_frameNumber % m_frames.size()];
+        previous.cpuMs = time - previous.startMs;
+    }
+    m_frameNumber++;
+    NanoProfileFrame& frame = m_frames[m_frameNumber % m_frames.size()];
+    frame.frame = m_frameNumber;
+    frame.startMs = time;
+    frame.cpuMs = 0.0;
+    frame.gpuMs = 0.0;
+    frame.gpuResolved = false;
+    frame.zones.clear();
+}
+
+void NanoProfiler::BeginCpuZone(const char* name) {
+    if (m_isInit) {
+        t_openCpuZones.push_back({name, now()});
+    }
+}
+
+void NanoProfiler::EndCpuZone() {
+    if (!m_isInit || t_openCpuZones.empty()) {
+        return;
+    }
+    OpenCpuZone open = t_openCpuZones.back();
+    t_openCpuZones.pop_back();
+
+    NanoProfileZone zone{};
+    zone.name = open.name;
+    zone.thread = NanoJobSystem::GetThreadIndex();
+    zone.depth = static_cast<uint32_t>(t_openCpuZones.size());
+    zone.startMs = open.startMs;
+    zone.durationMs = now() - open.startMs;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_frameNumber > 0) {
+        m_frames[m_frameNumber % m_frames.size()].zones.push_back(std::move(zone));
+    }
+}
+
+void NanoProfiler::BeginGpuFrame(uint32_t frameIndex) {
+    if (!m_gpuInit) {
+        return;
+    }
+    m_frameIndex = frameIndex;
+    resolveSlot(m_slots[frameIndex]);
+}
+
+void NanoProfiler::RecordGpuFrameStart(VkCommandBuffer& commandBuffer) {
+    if (!m_gpuInit) {
+        return;
+    }
+    GpuSlot& slot = m_slots[m_frameIndex];
+    slot.frame = m_frameNumber;
+    slot.zones.clear();
+    slot.statisticsQueries = 0;
+    m_openGpuZones.clear();
+    m_openStatisticsZone = UINT32_MAX;
+
+    vkCmdResetQueryPool(commandBuffer, slot.timestamps, 0, Config::PROFILER_MAX_GPU_ZONES * 2);
+    if (m_pipelineStatistics) {
+        vkCmdResetQueryPool(commandBuffer, slot.statistics, 0, Config::PROFILER_MAX_GPU_ZONES);
+    }
+}
+
+void NanoProfiler::BeginGpuZone(VkCommandBuffer& commandBuffer, const std::string& name) {
+    if (!m_gpuInit) {
+        return;
+    }
+    GpuSlot& slot = m_slots[m_frameIndex];
+    if (slot.zones.size() == Config::PROFILER_MAX_GPU_ZONES) {
+        m_openGpuZones.push_back(UINT32_MAX); // over the limit, not recorded
+        return;
+    }
+
+    uint32_t index = static_cast<uint32_t>(slot.zones.size());
+    GpuZone zone{};
+    zone.name = name;
+    zone.depth = static_cast<uint32_t>(m_openGpuZones.size());
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot.timestamps, index * 2);
+    // statistics queries can't nest, only the outermost zone gets one
+    if (m_pipelineStatistics && m_openStatisticsZone == UINT32_MAX) {
+        zone.statisticsQuery = slot.statisticsQueries++;
+        vkCmdBeginQuery(commandBuffer, slot.statistics, zone.statisticsQuery, 0);
+        m_openStatisticsZone = index;
+    }
+    slot.zones.push_back(std::move(zone));
+    m_openGpuZones.push_back(index);
+}
+
+void NanoProfiler::EndGpuZone(VkCommandBuffer& commandBuffer) {
+    if (!m_gpuInit || m_openGpuZones.empty()) {
+        return;
+    }
+    uint32_t index = m_openGpuZones.back();
+    m_openGpuZones.pop_back();
+    if (index == UINT32_MAX) {
+        return;
+    }
+
+    GpuSlot& slot = m_slots[m_frameIndex];
+    if (m_openStatisticsZone == index) {
+        vkCmdEndQuery(commandBuffer, slot.statistics, slot.zones[index].statisticsQuery);
+        m_openStatisticsZone = UINT32_MAX;
+    }
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slot.timestamps, index * 2 + 1);
+}
+
+void NanoProfiler::MarkSubmit() {
+    if (m_gpuInit) {
+        m_slots[m_frameIndex].submitMs = now();
+    }
+}
+
+void NanoProfiler::ResolveGpu() {
+    if (!m_gpuInit) {
+        return;
+    }
+    // oldest first, the placement of a frame depends on the one before it
+    std::vector<GpuSlot*> pending{};
+    for (GpuSlot& slot : m_slots) {
+        if (slot.frame != 0) {
+            pending.push_back(&slot);
+        }
+    }
+    std::sort(pending.begin(), pending.end(), [](const GpuSlot* a, const GpuSlot* b) { return a->frame < b->frame; });
+    for (GpuSlot* slot : pending) {
+        resolveSlot(*slot);
+    }
+}
+
+void NanoProfiler::resolveSlot(GpuSlot& slot) {
+    uint64_t frameNumber = slot.frame;
+    slot.frame = 0;
+    uint32_t zoneCount = static_cast<uint32_t>(slot.zones.size());
+    if (frameNumber == 0 || zoneCount == 0) {
+        return;
+    }
+
+    // the fence was waited on, no WAIT_BIT. Should a result still be missing, the frame simply has no GPU zones
+    if (vkGetQueryPoolResults(_device, slot.timestamps, 0, zoneCount * 2, zoneCount * 2 * sizeof(uint64_t), m_results.data(),
+                              sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+        return;
+    }
+    uint64_t firstTick = m_results[0];
+    uint64_t lastTick = 0; // relative to firstTick
+    for (uint32_t i = 0; i < zoneCount * 2; i++) {
+        m_results[i] = (m_results[i] - firstTick) & m_timestampMask;
+        lastTick = std::max(lastTick, m_results[i]);
+    }
+
+    double startMs = std::max(slot.submitMs, m_lastGpuEndMs);
+    m_lastGpuEndMs = startMs + lastTick * m_tickMs;
+
+    std::vector<NanoProfileZone> zones(zoneCount);
+    for (uint32_t i = 0; i < zoneCount; i++) {
+        zones[i].name = slot.zones[i].name;
+        zones[i].gpu = true;
+        zones[i].thread = UINT32_MAX;
+        zones[i].depth = slot.zones[i].depth;
+        zones[i].startMs = startMs + m_results[i * 2] * m_tickMs;
+        zones[i].durationMs = (m_results[i * 2 + 1] - m_results[i * 2]) * m_tickMs;
+    }
+    if (m_pipelineStatistics && slot.statisticsQueries > 0 &&
+        vkGetQueryPoolResults(_device, slot.statistics, 0, slot.statisticsQueries, slot.statisticsQueries * 2 * sizeof(uint64_t),
+                              m_results.data(), 2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+        for (uint32_t i = 0; i < zoneCount; i++) {
+            uint32_t query = slot.zones[i].statisticsQuery;
+            if (query != UINT32_MAX) {
+                zones[i].vertexInvocations = m_results[query * 2];
+                zones[i].fragmentInvocations = m_results[query * 2 + 1];
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    NanoProfileFrame& frame = m_frames[frameNumber % m_frames.size()];
+    if (frame.frame != frameNumber) {
+        return; // the history wrapped around already
+    }
+    frame.gpuMs = lastTick * m_tickMs;
+    frame.gpuResolved = true;
+    frame.zones.insert(frame.zones.end(), std::make_move_iterator(zones.begin()), std::make_move_iterator(zones.end()));
+    m_lastResolvedFrame = std::max(m_lastResolvedFrame, frameNumber);
+}
+
+const NanoProfileFrame* NanoProfiler::GetLastFrame() {
+    uint64_t frame = m_gpuInit ? m_lastResolvedFrame : (m_frameNumber > 0 ? m_frameNumber - 1 : 0);
+    return GetFrame(frame);
+}
+
+const NanoProfileFrame* NanoProfiler::GetFrame(uint64_t frame) {
+    if (frame == 0 || m_frames.empty()) {
+        return nullptr;
+    }
+    const NanoProfileFrame& entry = m_frames[frame % m_frames.size()];
+    return entry.frame == frame ? &entry : nullptr;
+}
+
+uint64_t NanoProfiler::firstFrame() {
+    uint64_t historySize = m_frames.size();
+    return m_frameNumber > historySize ? m_frameNumber - historySize + 1 : 1;
+}
+
+ERR NanoProfiler::WriteCSV(const std::string& fileName) {
+    std::ofstream file(fileName, std::ios::trunc);
+    if (!file.is_open()) {
+        LOG_MSG(ERRLevel::WARNING, "could not open output file: %s", fileName.c_str());
+        return ERR::NOT_FOUND;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    file << "frame,cpu_ms,gpu_ms,zone,source,thread,depth,start_ms,duration_ms,vertex_invocations,fragment_invocations\n";
+    file << std::fixed << std::setprecision(4);
+    for (uint64_t f = firstFrame(); f < m_frameNumber; f++) {
+        const NanoProfileFrame& frame = m_frames[f % m_frames.size()];
+        for (const NanoProfileZone& zone : frame.zones) {
+            file << frame.frame << ',' << frame.cpuMs << ',' << frame.gpuMs << ',';
+            writeCsvString(file, zone.name);
+            file << ',' << (zone.gpu ? "gpu" : "cpu") << ','
+                 << (zone.gpu || zone.thread == UINT32_MAX ? -1 : static_cast<int64_t>(zone.thread)) << ',' << zone.depth << ',' << zone.startMs
+                 << ',' << zone.durationMs << ',' << zone.vertexInvocations << ',' << zone.fragmentInvocations << '\n';
+        }
+    }
+    return file.good() ? ERR::OK : ERR::INVALID;
+}
+
+ERR NanoProfiler::WriteTrace(const std::string& fileName) {
+    std::ofstream file(fileName, std::ios::trunc);
+    if (!file.is_open()) {
+        LOG_MSG(ERRLevel::WARNING, "could not open output file: %s", fileName.c_str());
+        return ERR::NOT_FOUND;
+    }
+
+    // tids: frames, then job system threads, other threads and the GPU last
+    constexpr uint32_t FRAME_TID = 0;
+    constexpr uint32_t OTHER_TID = 1000;
+    constexpr uint32_t GPU_TID = 1001;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    file << std::fixed << std::setprecision(3);
+    file << "{\"traceEvents\":[\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << FRAME_TID << ",\"args\":{\"name\":\"frames\"}},\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << OTHER_TID << ",\"args\":{\"name\":\"other threads\"}},\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << GPU_TID << ",\"args\":{\"name\":\"GPU\"}}";
+    for (uint64_t f = firstFrame(); f < m_frameNumber; f++) {
+        const NanoProfileFrame& frame = m_frames[f % m_frames.size()];
+        file << ",\n{\"name\":\"frame " << frame.frame << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << FRAME_TID << ",\"ts\":" << frame.startMs * 1000.0
+             << ",\"dur\":" << frame.cpuMs * 1000.0 << ",\"args\":{\"gpu_ms\":" << frame.gpuMs << "}}";
+        for (const NanoProfileZone& zone : frame.zones) {
+            uint32_t tid = zone.gpu ? GPU_TID : zone.thread == UINT32_MAX ? OTHER_TID : zone.thread + 1;
+            file << ",\n{\"name\":";
+            writeJsonString(file, zone.name);
+            file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid << ",\"ts\":" << zone.startMs * 1000.0 << ",\"dur\":" << zone.durationMs * 1000.0
+                 << ",\"args\":{\"frame\":" << frame.frame;
+            if (zone.gpu && (zone.vertexInvocations > 0 || zone.fragmentInvocations > 0)) {
+                file << ",\"vertex_invocations\":" << zone.vertexInvocations << ",\"fragment_invocations\":" << zone.fragmentInvocations;
+            }
+            file << "}}";
+        }
+    }
+    file << "\n]}\n";
+    return file.good() ? ERR::OK : ERR::INVALID;
+}
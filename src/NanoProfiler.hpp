@@ -0,0 +1,137 @@
+#ifndef NANOPROFILER_H_
+#define NANOPROFILER_H_
+
+#include "NanoConfig.hpp"
+#include "NanoError.hpp"
+
+#include "vulkan/vulkan_core.h"
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct NanoProfileZone {
+    std::string name{};
+    bool gpu = false;
+    uint32_t thread = 0; // job system thread index of CPU zones, UINT32_MAX outside of it
+    uint32_t depth = 0;  // nesting, per thread (CPU) or per command buffer (GPU)
+    double startMs = 0.0; // since Init. GPU zones are moved onto the CPU clock, see NanoProfiler
+    double durationMs = 0.0;
+    // pipeline statistics, outermost GPU zones only
+    uint64_t vertexInvocations = 0;
+    uint64_t fragmentInvocations = 0;
+};
+
+struct NanoProfileFrame {
+    uint64_t frame = 0; // from 1, in BeginFrame order
+    double startMs = 0.0;
+    double cpuMs = 0.0;       // BeginFrame to the next one
+    double gpuMs = 0.0;       // first to last timestamp
+    bool gpuResolved = false; // GPU zones come in a few frames later, once the frame's fence signaled
+    std::vector<NanoProfileZone> zones{}; // CPU zones in the order they ended, then the GPU zones
+};
+
+// CPU and GPU zones of the last Config::PROFILER_HISTORY_FRAMES frames, in one timeline.
+// CPU zones can be opened on any thread (NanoProfileScope). GPU zones are pairs of timestamps written into the frame's
+// own query pool, one per frame in flight like the occlusion queries. They are read back when the frame's slot comes
+// around again, after its fence was waited on, so reading never waits. Outermost zones also get a pipeline statistics
+// query (vertex and fragment shader invocations) when the device supports them.
+// The GPU clock has no relation to the CPU one, so each frame's timestamps are placed at its submit, or right after the
+// previous frame's GPU work when that ended later: a queue runs its submissions in order, and starts them no earlier
+// than they were submitted. Good enough to see which side a frame waited on, not to line up single events
+class NanoProfiler {
+  public:
+    ERR Init(uint32_t historyFrames = Config::PROFILER_HISTORY_FRAMES);
+    // timestampPeriod and validBits come from the device limits and the queue family the frames are submitted to
+    ERR InitGpu(VkDevice& device, float timestampPeriod, uint32_t timestampValidBits, bool pipelineStatistics);
+    void CleanUpGpu(); // before the device goes
+    void CleanUp();
+
+    void BeginFrame();
+    void BeginCpuZone(const char* name);
+    void EndCpuZone();
+
+    // once the slot's fence was waited on: the frame recorded into it last is read back
+    void BeginGpuFrame(uint32_t frameIndex);
+    // outside of a render pass, before the first zone
+    void RecordGpuFrameStart(VkCommandBuffer& commandBuffer);
+    void BeginGpuZone(VkCommandBuffer& commandBuffer, const std::string& name);
+    void EndGpuZone(VkCommandBuffer& commandBuffer);
+    // right before the frame is submitted, see above
+    void MarkSubmit();
+    // reads back every frame in flight, only once the GPU is known to be done with them (e.g. before writing a dump)
+    void ResolveGpu();
+
+    bool IsGpuInit() { return m_gpuInit; }
+    bool HasPipelineStatistics() { return m_pipelineStatistics; }
+    // the latest frame with its GPU zones read back (the latest finished one without GPU timing), nullptr before that.
+    // Valid until the history wraps around
+    const NanoProfileFrame* GetLastFrame();
+    const NanoProfileFrame* GetFrame(uint64_t frame); // nullptr when it's not in the history (anymore)
+
+    // one row per zone of every finished frame in the history
+    ERR WriteCSV(const std::string& fileName);
+    // Chrome trace event format (chrome://tracing, Perfetto), one track per thread and one for the GPU
+    ERR WriteTrace(const std::string& fileName);
+
+  private:
+    struct GpuZone {
+        std::string name{};
+        uint32_t depth = 0;
+        uint32_t statisticsQuery = UINT32_MAX;
+    };
+    struct GpuSlot {
+        VkQueryPool timestamps = VK_NULL_HANDLE;
+        VkQueryPool statistics = VK_NULL_HANDLE;
+        uint64_t frame = 0; // recorded into it, 0 once read back
+        double submitMs = 0.0;
+        std::vector<GpuZone> zones{}; // timestamps 2 * i and 2 * i + 1
+        uint32_t statisticsQueries = 0;
+    };
+
+    double now();
+    void resolveSlot(GpuSlot& slot);
+    uint64_t firstFrame(); // oldest finished frame still in the history
+
+    bool m_isInit = false;
+    std::chrono::steady_clock::time_point m_origin{};
+    std::mutex m_mutex{};
+    std::vector<NanoProfileFrame> m_frames{}; // ring, frame % size
+    uint64_t m_frameNumber = 0;
+
+    VkDevice _device{};
+    bool m_gpuInit = false;
+    bool m_pipelineStatistics = false;
+    double m_tickMs = 0.0;
+    uint64_t m_timestampMask = 0;
+    GpuSlot m_slots[Config::MAX_FRAMES_IN_FLIGHT]{};
+    uint32_t m_frameIndex = 0;
+    std::vector<uint32_t> m_openGpuZones{};
+    uint32_t m_openStatisticsZone = UINT32_MAX;
+    double m_lastGpuEndMs = 0.0;
+    uint64_t m_lastResolvedFrame = 0;
+    std::vector<uint64_t> m_results{}; // scratch
+};
+
+// CPU zone from construction to destruction. profiler can be nullptr
+class NanoProfileScope {
+  public:
+    NanoProfileScope(NanoProfiler* profiler, const char* name) : _profiler(profiler) {
+        if (_profiler) {
+            _profiler->BeginCpuZone(name);
+        }
+    }
+    ~NanoProfileScope() {
+        if (_profiler) {
+            _profiler->EndCpuZone();
+        }
+    }
+    NanoProfileScope(const NanoProfileScope&) = delete;
+    NanoProfileScope& operator=(const NanoProfileScope&) = delete;
+
+  private:
+    NanoProfiler* _profiler;
+};
+
+#endif // NANOPROFILER_H_
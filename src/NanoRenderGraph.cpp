@@ -0,0 +1,819 @@
+#include "NanoRenderGraph.hpp"
+#include "NanoBuffer.hpp"
+#include "NanoLogger.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+// what an access means for the barriers, the layout and the image usage
+struct AccessInfo {
+    VkPipelineStageFlags2KHR stages;
+    VkAccessFlags2KHR access;
+    VkImageLayout layout;
+    VkImageUsageFlags usage;
+    bool write;
+    bool attachment;
+};
+
+// every use of the same resource in a pass, merged into one
+struct PassUse {
+    NanoRGResource resource;
+    AccessInfo info;
+    bool hasClear;
+    VkClearValue clearValue;
+};
+
+constexpr VkAccessFlags2KHR WRITE_ACCESS = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR |
+                                           VK_ACCESS_2_SHADER_WRITE_BIT_KHR | VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR;
+
+AccessInfo getAccessInfo(NanoRGAccess access, NanoRGPassType type) {
+    VkPipelineStageFlags2KHR shaderStages = type == NanoRGPassType::COMPUTE
+                                                ? VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR
+                                                : VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR;
+    VkPipelineStageFlags2KHR fragmentTests = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR;
+    switch (access) {
+    case NanoRGAccess::COLOR_WRITE:
+        return {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+                VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT_KHR | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, true, true};
+    case NanoRGAccess::DEPTH_WRITE:
+        return {fragmentTests, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true, true};
+    case NanoRGAccess::DEPTH_READ:
+        return {fragmentTests, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, false, true};
+    case NanoRGAccess::SAMPLED:
+        return {shaderStages, VK_ACCESS_2_SHADER_READ_BIT_KHR, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, false, false};
+    case NanoRGAccess::SHADER_READ:
+        return {shaderStages, VK_ACCESS_2_SHADER_READ_BIT_KHR, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, false, false};
+    case NanoRGAccess::SHADER_WRITE:
+        return {shaderStages, VK_ACCESS_2_SHADER_READ_BIT_KHR | VK_ACCESS_2_SHADER_WRITE_BIT_KHR, VK_IMAGE_LAYOUT_GENERAL,
+                VK_IMAGE_USAGE_STORAGE_BIT, true, false};
+    case NanoRGAccess::INDIRECT_READ:
+        return {VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT_KHR, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT_KHR, VK_IMAGE_LAYOUT_UNDEFINED, 0, false, false};
+    case NanoRGAccess::VERTEX_READ:
+        return {VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT_KHR, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT_KHR | VK_ACCESS_2_INDEX_READ_BIT_KHR,
+                VK_IMAGE_LAYOUT_UNDEFINED, 0, false, false};
+    case NanoRGAccess::TRANSFER_READ:
+        return {VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT_KHR, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_IMAGE_USAGE_TRANSFER_SRC_BIT, false, false};
+    case NanoRGAccess::TRANSFER_WRITE:
+        return {VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT, true, false};
+    }
+    return {};
+}
+
+// ResourceUse is private to the graph, the template only needs its fields
+template <typename UseT>
+std::vector<PassUse> mergePassUses(const std::vector<UseT>& uses, NanoRGPassType type) {
+    std::vector<PassUse> merged{};
+    for (const UseT& use : uses) {
+        AccessInfo info = getAccessInfo(use.access, type);
+        auto it = std::find_if(merged.begin(), merged.end(), [&use](const PassUse& other) { return other.resource == use.resource; });
+        if (it == merged.end()) {
+            merged.push_back({use.resource, info, use.hasClear, use.clearValue});
+            continue;
+        }
+        // an image used two ways in one pass (copied to, then written by a shader) stays in GENERAL
+        if (it->info.layout != info.layout) {
+            it->info.layout = VK_IMAGE_LAYOUT_GENERAL;
+        }
+        it->info.stages |= info.stages;
+        it->info.access |= info.access;
+        it->info.usage |= info.usage;
+        it->info.write |= info.write;
+        it->info.attachment |= info.attachment;
+        if (use.hasClear) {
+            it->hasClear = true;
+            it->clearValue = use.clearValue;
+        }
+    }
+    return merged;
+}
+
+bool isDepthFormat(VkFormat format) {
+    return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_D32_SFLOAT || format == VK_FORMAT_D24_UNORM_S8_UINT ||
+           format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+bool hasStencil(VkFormat format) { return format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT; }
+
+VkImageSubresourceRange getSubresourceRange(VkFormat format) {
+    VkImageSubresourceRange range{};
+    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    if (isDepthFormat(format)) {
+        range.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | (hasStencil(format) ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+    }
+    range.baseMipLevel = 0;
+    range.levelCount = 1;
+    range.baseArrayLayer = 0;
+    range.layerCount = 1;
+    return range;
+}
+
+// FindMemoryType throws, lazily allocated memory is optional so UINT32_MAX when there is none
+uint32_t findLazyMemoryType(const VkPhysicalDevice& physicalDevice, uint32_t typeFilter) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+            return i;
+        }
+    }
+    return UINT32_MAX;
+}
+} // namespace
+
+ERR NanoRenderGraph::Init(VkDevice& device, const VkPhysicalDevice& physicalDevice, bool synchronization2) {
+    ERR err = ERR::OK;
+    _device = device;
+    _physicalDevice = physicalDevice;
+    m_cmdPipelineBarrier2 = nullptr;
+    if (synchronization2) {
+        m_cmdPipelineBarrier2 = (PFN_vkCmdPipelineBarrier2KHR)vkGetDeviceProcAddr(device, "vkCmdPipelineBarrier2KHR");
+    }
+    m_stats = {};
+    m_stats.synchronization2 = m_cmdPipelineBarrier2 != nullptr;
+    m_dirty = true;
+    m_isInit = true;
+    return err;
+}
+
+void NanoRenderGraph::CleanUp() {
+    if (!m_isInit) {
+        return;
+    }
+    releaseCompiled();
+    for (CachedRenderPass& cached : m_renderPassCache) {
+        vkDestroyRenderPass(_device, cached.renderPass, nullptr);
+    }
+    m_renderPassCache.clear();
+    m_resources.clear();
+    m_passes.clear();
+    m_schedule.clear();
+    m_barriers.clear();
+    m_isInit = false;
+}
+
+NanoRGResource NanoRenderGraph::ImportImage(const std::string& name, VkFormat format, const std::vector<VkImage>& images,
+                                            const std::vector<VkImageView>& views, VkImageLayout finalLayout) {
+    Resource resource{};
+    resource.name = name;
+    resource.isImage = true;
+    resource.imported = true;
+    resource.output = true;
+    resource.format = format;
+    resource.finalLayout = finalLayout;
+    resource.importedImages = images;
+    resource.importedViews = views;
+    m_resources.push_back(resource);
+    m_dirty = true;
+    return static_cast<NanoRGResource>(m_resources.size() - 1);
+}
+
+void NanoRenderGraph::SetImportedImages(NanoRGResource resource, const std::vector<VkImage>& images, const std::vector<VkImageView>& views) {
+    m_resources[resource].importedImages = images;
+    m_resources[resource].importedViews = views;
+    m_dirty = true;
+}
+
+NanoRGResource NanoRenderGraph::ImportBuffer(const std::string& name) {
+    Resource resource{};
+    resource.name = name;
+    resource.imported = true;
+    m_resources.push_back(resource);
+    m_dirty = true;
+    return static_cast<NanoRGResource>(m_resources.size() - 1);
+}
+
+NanoRGResource NanoRenderGraph::CreateImage(const std::string& name, VkFormat format) {
+    Resource resource{};
+    resource.name = name;
+    resource.isImage = true;
+    resource.format = format;
+    m_resources.push_back(resource);
+    m_dirty = true;
+    return static_cast<NanoRGResource>(m_resources.size() - 1);
+}
+
+void NanoRenderGraph::MarkOutput(NanoRGResource resource) {
+    m_resources[resource].output = true;
+    m_dirty = true;
+}
+
+NanoRGPass NanoRenderGraph::AddPass(const std::string& name, NanoRGPassType type, std::function<void(VkCommandBuffer& commandBuffer)> record) {
+    Pass pass{};
+    pass.name = name;
+    pass.type = type;
+    pass.record = std::move(record);
+    m_passes.push_back(std::move(pass));
+    m_dirty = true;
+    return static_cast<NanoRGPass>(m_passes.size() - 1);
+}
+
+void NanoRenderGraph::Use(NanoRGPass pass, NanoRGResource resource, NanoRGAccess access, const VkClearValue* clearValue) {
+    m_passes[pass].uses.push_back({resource, access, clearValue != nullptr, clearValue ? *clearValue : VkClearValue{}});
+    m_dirty = true;
+}
+
+void NanoRenderGraph::SetExtent(const VkExtent2D& extent) {
+    if (extent.width != m_extent.width || extent.height != m_extent.height) {
+        m_extent = extent;
+        m_dirty = true;
+    }
+}
+
+ERR NanoRenderGraph::Compile() {
+    ERR err = ERR::OK;
+    releaseCompiled();
+    cullPasses();
+    computeLifetimes();
+    err = createTransientImages();
+    if (err != ERR::OK) {
+        return err;
+    }
+    buildBarriers();
+    err = createRenderPasses();
+    if (err != ERR::OK) {
+        return err;
+    }
+    m_compiled = true;
+    m_dirty = false;
+    m_stats.compiles++;
+    LOG_MSG(ERRLevel::INFO, "Render graph: %d passes (%d culled), %d barrier batches, transient images %lu bytes in %lu", m_stats.passes,
+            m_stats.culledPasses, m_stats.barrierBatches, m_stats.transientBytes, m_stats.allocatedBytes);
+    return err;
+}
+
+// Backwards from the outputs: a pass lives when one of its writes is still needed. What it reads is needed from then
+// on, and so is what it writes without replacing it (loaded attachments, storage and transfer writes)
+void NanoRenderGraph::cullPasses() {
+    std::vector<bool> needed(m_resources.size());
+    for (size_t i = 0; i < m_resources.size(); i++) {
+        needed[i] = m_resources[i].output;
+    }
+    std::vector<bool> alive(m_passes.size(), false);
+    for (size_t p = m_passes.size(); p-- > 0;) {
+        std::vector<PassUse> uses = mergePassUses(m_passes[p].uses, m_passes[p].type);
+        for (const PassUse& use : uses) {
+            if (use.info.write && needed[use.resource]) {
+                alive[p] = true;
+            }
+        }
+        if (!alive[p]) {
+            continue;
+        }
+        for (const PassUse& use : uses) {
+            needed[use.resource] = !(use.info.write && use.info.attachment && use.hasClear);
+        }
+    }
+    m_schedule.clear();
+    for (size_t p = 0; p < m_passes.size(); p++) {
+        if (alive[p]) {
+            m_schedule.push_back(static_cast<NanoRGPass>(p));
+        }
+    }
+    m_stats.passes = static_cast<uint32_t>(m_schedule.size());
+    m_stats.culledPasses = static_cast<uint32_t>(m_passes.size() - m_schedule.size());
+}
+
+void NanoRenderGraph::computeLifetimes() {
+    for (Resource& resource : m_resources) {
+        resource.firstUse = UINT32_MAX;
+        resource.lastUse = 0;
+        resource.usage = 0;
+        resource.block = UINT32_MAX;
+    }
+    for (uint32_t s = 0; s < m_schedule.size(); s++) {
+        const Pass& pass = m_passes[m_schedule[s]];
+        for (const PassUse& use : mergePassUses(pass.uses, pass.type)) {
+            Resource& resource = m_resources[use.resource];
+            resource.firstUse = std::min(resource.firstUse, s);
+            resource.lastUse = std::max(resource.lastUse, s);
+            resource.usage |= use.info.usage;
+        }
+    }
+}
+
+ERR NanoRenderGraph::createTransientImages() {
+    m_stats.transientImages = 0;
+    m_stats.lazyImages = 0;
+    m_stats.transientBytes = 0;
+    m_stats.allocatedBytes = 0;
+
+    std::vector<VkMemoryRequirements> requirements(m_resources.size());
+    std::vector<NanoRGResource> aliased{};
+    for (NanoRGResource r = 0; r < m_resources.size(); r++) {
+        Resource& resource = m_resources[r];
+        if (!resource.isImage || resource.imported || resource.firstUse == UINT32_MAX) {
+            continue;
+        }
+        // only ever an attachment of one pass: the contents never have to leave the tile
+        bool tileLocal = !resource.output && resource.firstUse == resource.lastUse &&
+                         (resource.usage & ~(VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) == 0;
+        if (tileLocal) {
+            resource.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        }
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = resource.format;
+        imageInfo.extent = {m_extent.width, m_extent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = resource.usage;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        if (vkCreateImage(_device, &imageInfo, nullptr, &resource.image) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render graph image " + resource.name);
+        }
+        vkGetImageMemoryRequirements(_device, resource.image, &requirements[r]);
+        m_stats.transientImages++;
+        m_stats.transientBytes += requirements[r].size;
+
+        uint32_t lazyType = tileLocal ? findLazyMemoryType(_physicalDevice, requirements[r].memoryTypeBits) : UINT32_MAX;
+        if (lazyType == UINT32_MAX) {
+            aliased.push_back(r);
+            continue;
+        }
+        MemoryBlock block{};
+        block.size = requirements[r].size;
+        block.memoryTypeBits = 1u << lazyType;
+        block.lazy = true;
+        block.resources.push_back(r);
+        resource.block = static_cast<uint32_t>(m_blocks.size());
+        m_blocks.push_back(block);
+        m_stats.lazyImages++;
+    }
+
+    // biggest first, each into the first block it fits next to without overlapping lifetimes
+    std::stable_sort(aliased.begin(), aliased.end(),
+                     [&requirements](NanoRGResource a, NanoRGResource b) { return requirements[a].size > requirements[b].size; });
+    for (NanoRGResource r : aliased) {
+        Resource& resource = m_resources[r];
+        for (uint32_t b = 0; b < m_blocks.size() && resource.block == UINT32_MAX; b++) {
+            MemoryBlock& block = m_blocks[b];
+            if (block.lazy || (block.memoryTypeBits & requirements[r].memoryTypeBits) == 0) {
+                continue;
+            }
+            bool overlaps = std::any_of(block.resources.begin(), block.resources.end(), [&](NanoRGResource other) {
+                return m_resources[other].firstUse <= resource.lastUse && resource.firstUse <= m_resources[other].lastUse;
+            });
+            if (overlaps) {
+                continue;
+            }
+            block.size = std::max(block.size, requirements[r].size);
+            block.memoryTypeBits &= requirements[r].memoryTypeBits;
+            block.resources.push_back(r);
+            resource.block = b;
+        }
+        if (resource.block == UINT32_MAX) {
+            MemoryBlock block{};
+            block.size = requirements[r].size;
+            block.memoryTypeBits = requirements[r].memoryTypeBits;
+            block.resources.push_back(r);
+            resource.block = static_cast<uint32_t>(m_blocks.size());
+            m_blocks.push_back(block);
+        }
+    }
+
+    for (MemoryBlock& block : m_blocks) {
+        std::sort(block.resources.begin(), block.resources.end(),
+                  [this](NanoRGResource a, NanoRGResource b) { return m_resources[a].firstUse < m_resources[b].firstUse; });
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = block.size;
+        allocInfo.memoryTypeIndex = block.lazy ? findLazyMemoryType(_physicalDevice, block.memoryTypeBits)
+                                               : FindMemoryType(_physicalDevice, block.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if (vkAllocateMemory(_device, &allocInfo, nullptr, &block.memory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate render graph memory");
+        }
+        if (!block.lazy) {
+            m_stats.allocatedBytes += block.size;
+        }
+        for (NanoRGResource r : block.resources) {
+            Resource& resource = m_resources[r];
+            vkBindImageMemory(_device, resource.image, block.memory, 0);
+
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = resource.image;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = resource.format;
+            viewInfo.subresourceRange = getSubresourceRange(resource.format);
+            if (vkCreateImageView(_device, &viewInfo, nullptr, &resource.view) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create render graph image view " + resource.name);
+            }
+        }
+    }
+    return ERR::OK;
+}
+
+// Walks the schedule keeping each resource's state and emits a barrier whenever a use isn't covered by it: any write,
+// a layout change, or a read the last write wasn't made visible to yet. The walk runs twice, the first one only to find
+// the state the previous frame leaves everything in
+void NanoRenderGraph::buildBarriers() {
+    std::vector<AccessState> states(m_resources.size(), AccessState{});
+    for (uint32_t round = 0; round < 2; round++) {
+        m_barriers.assign(m_schedule.size() + 1, BarrierBatch{});
+        for (uint32_t s = 0; s < m_schedule.size(); s++) {
+            const Pass& pass = m_passes[m_schedule[s]];
+            BarrierBatch& batch = m_barriers[s];
+            for (const PassUse& use : mergePassUses(pass.uses, pass.type)) {
+                const Resource& resource = m_resources[use.resource];
+                AccessState& state = states[use.resource];
+                if (s == resource.firstUse && resource.imported && resource.isImage) {
+                    // the stage the acquire semaphore is waited on at, the contents are undefined
+                    state = {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, 0, 0, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED};
+                } else if (s == resource.firstUse && resource.block != UINT32_MAX) {
+                    // aliased memory: wait on whoever had the block before, last frame's last occupant for the first one
+                    const std::vector<NanoRGResource>& occupants = m_blocks[resource.block].resources;
+                    size_t index = std::find(occupants.begin(), occupants.end(), use.resource) - occupants.begin();
+                    state = states[occupants[(index + occupants.size() - 1) % occupants.size()]];
+                    state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+                }
+
+                // an attachment nothing earlier wrote this frame has nothing worth keeping
+                bool discard = use.info.attachment && (use.hasClear || s == resource.firstUse);
+                VkImageLayout oldLayout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+                bool layoutChange = resource.isImage && (oldLayout != use.info.layout);
+                bool hazard = layoutChange;
+                if (use.info.write) {
+                    hazard |= state.writeStages != 0 || state.readStages != 0;
+                } else if (state.writeStages != 0) {
+                    hazard |= (use.info.stages & ~state.visibleStages) != 0 || (use.info.access & ~state.visibleAccess) != 0;
+                }
+
+                if (hazard) {
+                    VkPipelineStageFlags2KHR srcStages = state.writeStages;
+                    if (use.info.write || layoutChange) {
+                        srcStages |= state.readStages;
+                    }
+                    if (resource.isImage) {
+                        ImageBarrier barrier{};
+                        barrier.resource = use.resource;
+                        barrier.barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+                        barrier.barrier.srcStageMask = srcStages;
+                        barrier.barrier.srcAccessMask = state.writeAccess;
+                        barrier.barrier.dstStageMask = use.info.stages;
+                        barrier.barrier.dstAccessMask = use.info.access;
+                        barrier.barrier.oldLayout = oldLayout;
+                        barrier.barrier.newLayout = use.info.layout;
+                        barrier.barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                        barrier.barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                        barrier.barrier.subresourceRange = getSubresourceRange(resource.format);
+                        batch.imageBarriers.push_back(barrier);
+                    } else {
+                        batch.hasMemoryBarrier = true;
+                        batch.memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR;
+                        batch.memoryBarrier.srcStageMask |= srcStages;
+                        batch.memoryBarrier.srcAccessMask |= state.writeAccess;
+                        batch.memoryBarrier.dstStageMask |= use.info.stages;
+                        batch.memoryBarrier.dstAccessMask |= use.info.access;
+                    }
+                }
+
+                if (use.info.write) {
+                    state = {use.info.stages, use.info.access & WRITE_ACCESS, 0, 0, 0, use.info.layout};
+                } else if (layoutChange) {
+                    // the transition is a write, later readers in other stages chain on this one
+                    state = {use.info.stages, 0, use.info.stages, use.info.stages, use.info.access, use.info.layout};
+                } else {
+                    state.readStages |= use.info.stages;
+                    if (hazard) {
+                        state.visibleStages |= use.info.stages;
+                        state.visibleAccess |= use.info.access;
+                    }
+                }
+            }
+        }
+
+        // imported images are handed back in their final layout
+        BarrierBatch& last = m_barriers.back();
+        for (NanoRGResource r = 0; r < m_resources.size(); r++) {
+            const Resource& resource = m_resources[r];
+            AccessState& state = states[r];
+            if (!resource.imported || !resource.isImage || resource.firstUse == UINT32_MAX || state.layout == resource.finalLayout) {
+                continue;
+            }
+            ImageBarrier barrier{};
+            barrier.resource = r;
+            barrier.barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+            barrier.barrier.srcStageMask = state.writeStages | state.readStages;
+            barrier.barrier.srcAccessMask = state.writeAccess;
+            barrier.barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE_KHR;
+            barrier.barrier.dstAccessMask = VK_ACCESS_2_NONE_KHR;
+            barrier.barrier.oldLayout = state.layout;
+            barrier.barrier.newLayout = resource.finalLayout;
+            barrier.barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.barrier.subresourceRange = getSubresourceRange(resource.format);
+            last.imageBarriers.push_back(barrier);
+            state = {barrier.barrier.srcStageMask, 0, 0, 0, 0, resource.finalLayout};
+        }
+    }
+
+    m_stats.barrierBatches = 0;
+    m_stats.imageBarriers = 0;
+    m_stats.memoryBarriers = 0;
+    for (const BarrierBatch& batch : m_barriers) {
+        if (batch.hasMemoryBarrier || !batch.imageBarriers.empty()) {
+            m_stats.barrierBatches++;
+        }
+        m_stats.imageBarriers += static_cast<uint32_t>(batch.imageBarriers.size());
+        m_stats.memoryBarriers += batch.hasMemoryBarrier ? 1 : 0;
+    }
+}
+
+ERR NanoRenderGraph::createRenderPasses() {
+    for (uint32_t s = 0; s < m_schedule.size(); s++) {
+        Pass& pass = m_passes[m_schedule[s]];
+        if (pass.type != NanoRGPassType::GRAPHICS) {
+            continue;
+        }
+        // colors in declaration order, then the depth attachment
+        std::vector<PassUse> attachmentUses{};
+        std::vector<PassUse> depthUses{};
+        for (const PassUse& use : mergePassUses(pass.uses, pass.type)) {
+            if (use.info.attachment) {
+                (isDepthFormat(m_resources[use.resource].format) ? depthUses : attachmentUses).push_back(use);
+            }
+        }
+        if (depthUses.size() > 1) {
+            throw std::runtime_error("render graph pass " + pass.name + " has more than one depth attachment");
+        }
+        uint32_t colorCount = static_cast<uint32_t>(attachmentUses.size());
+        attachmentUses.insert(attachmentUses.end(), depthUses.begin(), depthUses.end());
+
+        std::vector<VkAttachmentDescription> attachments{};
+        pass.clearValues.clear();
+        uint32_t framebufferCount = 1;
+        for (const PassUse& use : attachmentUses) {
+            const Resource& resource = m_resources[use.resource];
+            VkAttachmentDescription attachment{};
+            attachment.format = resource.format;
+            attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+            attachment.loadOp = use.hasClear ? VK_ATTACHMENT_LOAD_OP_CLEAR
+                                             : (s != resource.firstUse ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+            attachment.storeOp = s != resource.lastUse || resource.output ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            attachment.stencilLoadOp = hasStencil(resource.format) ? attachment.loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            attachment.stencilStoreOp = hasStencil(resource.format) ? attachment.storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            attachment.initialLayout = use.info.layout;
+            attachment.finalLayout = use.info.layout;
+            attachments.push_back(attachment);
+            pass.clearValues.push_back(use.clearValue);
+            if (resource.imported) {
+                framebufferCount = std::max(framebufferCount, static_cast<uint32_t>(resource.importedViews.size()));
+            }
+        }
+        pass.renderPass = getRenderPass(attachments, colorCount, !depthUses.empty());
+
+        pass.framebuffers.assign(framebufferCount, VK_NULL_HANDLE);
+        for (uint32_t i = 0; i < framebufferCount; i++) {
+            std::vector<VkImageView> views{};
+            for (const PassUse& use : attachmentUses) {
+                const Resource& resource = m_resources[use.resource];
+                views.push_back(resource.imported ? resource.importedViews[std::min<size_t>(i, resource.importedViews.size() - 1)] : resource.view);
+            }
+            VkFramebufferCreateInfo framebufferInfo{};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = pass.renderPass;
+            framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+            framebufferInfo.pAttachments = views.data();
+            framebufferInfo.width = m_extent.width;
+            framebufferInfo.height = m_extent.height;
+            framebufferInfo.layers = 1;
+            if (vkCreateFramebuffer(_device, &framebufferInfo, nullptr, &pass.framebuffers[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create framebuffer for render graph pass " + pass.name);
+            }
+        }
+    }
+    return ERR::OK;
+}
+
+// a single subpass and no dependencies, the graph's barriers are all outside the render pass
+VkRenderPass NanoRenderGraph::getRenderPass(const std::vector<VkAttachmentDescription>& attachments, uint32_t colorCount, bool hasDepth) {
+    std::vector<uint32_t> key{colorCount, hasDepth ? 1u : 0u};
+    for (const VkAttachmentDescription& attachment : attachments) {
+        key.insert(key.end(), {static_cast<uint32_t>(attachment.format), static_cast<uint32_t>(attachment.loadOp),
+                               static_cast<uint32_t>(attachment.storeOp), static_cast<uint32_t>(attachment.stencilLoadOp),
+                               static_cast<uint32_t>(attachment.stencilStoreOp), static_cast<uint32_t>(attachment.initialLayout),
+                               static_cast<uint32_t>(attachment.finalLayout)});
+    }
+    for (const CachedRenderPass& cached : m_renderPassCache) {
+        if (cached.key == key) {
+            return cached.renderPass;
+        }
+    }
+
+    std::vector<VkAttachmentReference> colorRefs{};
+    for (uint32_t i = 0; i < colorCount; i++) {
+        colorRefs.push_back({i, attachments[i].finalLayout});
+    }
+    VkAttachmentReference depthRef{};
+    if (hasDepth) {
+        depthRef = {colorCount, attachments[colorCount].finalLayout};
+    }
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = colorCount;
+    subpass.pColorAttachments = colorRefs.data();
+    subpass.pDepthStencilAttachment = hasDepth ? &depthRef : nullptr;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+
+    CachedRenderPass cached{};
+    cached.key = key;
+    if (vkCreateRenderPass(_device, &renderPassInfo, nullptr, &cached.renderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render graph render pass");
+    }
+    m_renderPassCache.push_back(cached);
+    return cached.renderPass;
+}
+
+VkRenderPass NanoRenderGraph::GetCompatibleRenderPass(const std::vector<VkFormat>& colorFormats, VkFormat depthFormat) {
+    // compatibility only looks at the formats and sample counts, the ops and layouts are whatever
+    std::vector<VkAttachmentDescription> attachments{};
+    for (VkFormat format : colorFormats) {
+        VkAttachmentDescription attachment{};
+        attachment.format = format;
+        attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        attachments.push_back(attachment);
+    }
+    bool hasDepth = depthFormat != VK_FORMAT_UNDEFINED;
+    if (hasDepth) {
+        VkAttachmentDescription attachment{};
+        attachment.format = depthFormat;
+        attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        attachments.push_back(attachment);
+    }
+    return getRenderPass(attachments, static_cast<uint32_t>(colorFormats.size()), hasDepth);
+}
+
+VkRenderPass NanoRenderGraph::GetRenderPass(NanoRGPass pass) { return m_passes[pass].renderPass; }
+
+VkImageView NanoRenderGraph::GetImageView(NanoRGResource resource) { return m_resources[resource].view; }
+
+void NanoRenderGraph::releaseCompiled() {
+    if (!m_compiled) {
+        return;
+    }
+    // frames in flight may still use the framebuffers and images
+    vkDeviceWaitIdle(_device);
+    for (Pass& pass : m_passes) {
+        for (VkFramebuffer framebuffer : pass.framebuffers) {
+            vkDestroyFramebuffer(_device, framebuffer, nullptr);
+        }
+        pass.framebuffers.clear();
+        pass.renderPass = VK_NULL_HANDLE;
+    }
+    for (Resource& resource : m_resources) {
+        if (resource.view != VK_NULL_HANDLE) {
+            vkDestroyImageView(_device, resource.view, nullptr);
+            resource.view = VK_NULL_HANDLE;
+        }
+        if (resource.image != VK_NULL_HANDLE) {
+            vkDestroyImage(_device, resource.image, nullptr);
+            resource.image = VK_NULL_HANDLE;
+        }
+    }
+    for (MemoryBlock& block : m_blocks) {
+        vkFreeMemory(_device, block.memory, nullptr);
+    }
+    m_blocks.clear();
+    m_compiled = false;
+}
+
+void NanoRenderGraph::Execute(VkCommandBuffer& commandBuffer, uint32_t imageIndex) {
+    if (m_dirty) {
+        Compile();
+    }
+    for (uint32_t s = 0; s < m_schedule.size(); s++) {
+        recordBarriers(commandBuffer, m_barriers[s], imageIndex);
+        Pass& pass = m_passes[m_schedule[s]];
+        if (_profiler) {
+            _profiler->BeginGpuZone(commandBuffer, pass.name);
+        }
+        if (pass.type != NanoRGPassType::GRAPHICS) {
+            pass.record(commandBuffer);
+            if (_profiler) {
+                _profiler->EndGpuZone(commandBuffer);
+            }
+            continue;
+        }
+
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = pass.renderPass;
+        renderPassInfo.framebuffer = pass.framebuffers[std::min<size_t>(imageIndex, pass.framebuffers.size() - 1)];
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = m_extent;
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(pass.clearValues.size());
+        renderPassInfo.pClearValues = pass.clearValues.data();
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(m_extent.width);
+        viewport.height = static_cast<float>(m_extent.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        VkRect2D scissor{};
+        scissor.offset = {0, 0};
+        scissor.extent = m_extent;
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        pass.record(commandBuffer);
+        vkCmdEndRenderPass(commandBuffer);
+        if (_profiler) {
+            _profiler->EndGpuZone(commandBuffer);
+        }
+    }
+    recordBarriers(commandBuffer, m_barriers.back(), imageIndex);
+}
+
+void NanoRenderGraph::recordBarriers(VkCommandBuffer& commandBuffer, const BarrierBatch& batch, uint32_t imageIndex) {
+    if (!batch.hasMemoryBarrier && batch.imageBarriers.empty()) {
+        return;
+    }
+    m_imageBarrierScratch.clear();
+    for (const ImageBarrier& imageBarrier : batch.imageBarriers) {
+        const Resource& resource = m_resources[imageBarrier.resource];
+        VkImageMemoryBarrier2KHR barrier = imageBarrier.barrier;
+        barrier.image = resource.imported ? resource.importedImages[std::min<size_t>(imageIndex, resource.importedImages.size() - 1)]
+                                          : resource.image;
+        m_imageBarrierScratch.push_back(barrier);
+    }
+
+    if (m_cmdPipelineBarrier2) {
+        VkDependencyInfoKHR dependencyInfo{};
+        dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+        dependencyInfo.memoryBarrierCount = batch.hasMemoryBarrier ? 1 : 0;
+        dependencyInfo.pMemoryBarriers = &batch.memoryBarrier;
+        dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(m_imageBarrierScratch.size());
+        dependencyInfo.pImageMemoryBarriers = m_imageBarrierScratch.data();
+        m_cmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+        return;
+    }
+
+    // the same batch as one legacy barrier, every stage and access bit the graph uses has the same value in both
+    VkPipelineStageFlags srcStages = 0;
+    VkPipelineStageFlags dstStages = 0;
+    VkMemoryBarrier memoryBarrier{};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    if (batch.hasMemoryBarrier) {
+        srcStages |= static_cast<VkPipelineStageFlags>(batch.memoryBarrier.srcStageMask);
+        dstStages |= static_cast<VkPipelineStageFlags>(batch.memoryBarrier.dstStageMask);
+        memoryBarrier.srcAccessMask = static_cast<VkAccessFlags>(batch.memoryBarrier.srcAccessMask);
+        memoryBarrier.dstAccessMask = static_cast<VkAccessFlags>(batch.memoryBarrier.dstAccessMask);
+    }
+    std::vector<VkImageMemoryBarrier> imageBarriers{};
+    for (const VkImageMemoryBarrier2KHR& barrier2 : m_imageBarrierScratch) {
+        srcStages |= static_cast<VkPipelineStageFlags>(barrier2.srcStageMask);
+        dstStages |= static_cast<VkPipelineStageFlags>(barrier2.dstStageMask);
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = static_cast<VkAccessFlags>(barrier2.srcAccessMask);
+        barrier.dstAccessMask = static_cast<VkAccessFlags>(barrier2.dstAccessMask);
+        barrier.oldLayout = barrier2.oldLayout;
+        barrier.newLayout = barrier2.newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = barrier2.image;
+        barrier.subresourceRange = barrier2.subresourceRange;
+        imageBarriers.push_back(barrier);
+    }
+    if (srcStages == 0) {
+        srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    }
+    if (dstStages == 0) {
+        dstStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    }
+    vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, batch.hasMemoryBarrier ? 1 : 0, &memoryBarrier, 0, nullptr,
+                         static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
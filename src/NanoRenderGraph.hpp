@@ -0,0 +1,197 @@
+#ifndef NANORENDERGRAPH_H_
+#define NANORENDERGRAPH_H_
+
+#include "NanoError.hpp"
+#include "NanoProfiler.hpp"
+
+#include "vulkan/vulkan_core.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+using NanoRGResource = uint32_t;
+using NanoRGPass = uint32_t;
+
+enum class NanoRGPassType {
+    GRAPHICS, // one render pass over its attachments, the viewport and scissor cover the graph's extent
+    COMPUTE,
+    TRANSFER,
+};
+
+// How a pass uses a resource, each one is a fixed stage / access / layout. Shader accesses are in the stages of the pass:
+// vertex and fragment for graphics passes, compute for compute passes
+enum class NanoRGAccess {
+    COLOR_WRITE,  // color attachment
+    DEPTH_WRITE,  // depth attachment, tested and written
+    DEPTH_READ,   // depth attachment, tested only (e.g. EQUAL after a depth pre-pass)
+    SAMPLED,      // sampled image
+    SHADER_READ,  // storage buffer or image
+    SHADER_WRITE, // storage buffer or image, read and written
+    INDIRECT_READ,
+    VERTEX_READ, // vertex and index buffers
+    TRANSFER_READ,
+    TRANSFER_WRITE,
+};
+
+struct NanoRenderGraphStats {
+    uint32_t passes = 0;       // scheduled
+    uint32_t culledPasses = 0; // none of their results reach an output
+    uint32_t barrierBatches = 0; // pipeline barrier calls per frame, at most one before each pass and one at the end
+    uint32_t imageBarriers = 0;
+    uint32_t memoryBarriers = 0;
+    uint32_t transientImages = 0;
+    uint32_t lazyImages = 0; // tile local, backed by lazily allocated memory
+    uint64_t transientBytes = 0; // what the transient images would take on their own
+    uint64_t allocatedBytes = 0; // what they take once aliased
+    uint32_t compiles = 0;
+    bool synchronization2 = false;
+};
+
+// Frame graph. Passes are declared once, in execution order, with the resources they use, and Compile turns that into a
+// fixed schedule that Execute replays every frame:
+// - passes whose writes never reach an output (imported images, MarkOutput) are culled
+// - every barrier is derived from the declared uses and batched into one vkCmdPipelineBarrier2 before each pass, with
+//   only the stages that actually touched the resource. Reads after reads and writes that are already visible get none.
+//   The schedule wraps around, so a frame's first uses wait on the previous frame's last ones
+// - transient images are created by the graph and alias memory when their lifetimes don't overlap. One only used
+//   as an attachment of a single pass never leaves the tile: transient usage and lazily allocated memory when the device
+//   has it
+// - load and store ops follow from the schedule: LOAD when an earlier pass wrote the attachment, CLEAR when the pass
+//   gave a clear value, STORE only when a later pass or the output needs it
+// Compiling again only happens when the structure changed (passes, resources, extent or imported images).
+// Render passes are cached by their attachments and live until CleanUp, pipelines can be built against
+// GetCompatibleRenderPass before the graph is declared.
+// Without VK_KHR_synchronization2 the same batches go through vkCmdPipelineBarrier
+class NanoRenderGraph {
+  public:
+    ERR Init(VkDevice& device, const VkPhysicalDevice& physicalDevice, bool synchronization2);
+    void CleanUp();
+
+    // one image per swapchain image (or just one), Execute picks which. Contents are undefined when a frame starts, and
+    // the image is left in finalLayout. Imported images are outputs
+    NanoRGResource ImportImage(const std::string& name, VkFormat format, const std::vector<VkImage>& images,
+                               const std::vector<VkImageView>& views, VkImageLayout finalLayout);
+    // replaces the images of an import, e.g. after the swapchain was recreated
+    void SetImportedImages(NanoRGResource resource, const std::vector<VkImage>& images, const std::vector<VkImageView>& views);
+    // a buffer the passes bind themselves, only its uses are tracked (with global memory barriers)
+    NanoRGResource ImportBuffer(const std::string& name);
+    // created by the graph at its extent, lives for the frame only
+    NanoRGResource CreateImage(const std::string& name, VkFormat format);
+    // writers of an output are never culled
+    void MarkOutput(NanoRGResource resource);
+
+    NanoRGPass AddPass(const std::string& name, NanoRGPassType type, std::function<void(VkCommandBuffer& commandBuffer)> record);
+    // clearValue only for attachments: the pass starts from it instead of what was there
+    void Use(NanoRGPass pass, NanoRGResource resource, NanoRGAccess access, const VkClearValue* clearValue = nullptr);
+
+    void SetExtent(const VkExtent2D& extent);
+    // every scheduled pass becomes a GPU zone of the pass's name, barriers before it excluded. nullptr turns it off
+    void SetProfiler(NanoProfiler* profiler) { _profiler = profiler; }
+    ERR Compile();
+    // compiles first if the structure changed. imageIndex picks the imported images
+    void Execute(VkCommandBuffer& commandBuffer, uint32_t imageIndex);
+
+    // a render pass compatible with the one a graphics pass with these attachments gets, for pipeline creation
+    VkRenderPass GetCompatibleRenderPass(const std::vector<VkFormat>& colorFormats, VkFormat depthFormat);
+    VkRenderPass GetRenderPass(NanoRGPass pass); // VK_NULL_HANDLE until compiled, or when the pass was culled
+    VkImageView GetImageView(NanoRGResource resource); // transient images, once compiled
+    const VkExtent2D& GetExtent() { return m_extent; }
+    bool IsInit() { return m_isInit; }
+    const NanoRenderGraphStats& GetStats() { return m_stats; }
+
+  private:
+    struct Resource {
+        std::string name{};
+        bool isImage = false;
+        bool imported = false;
+        bool output = false;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED; // imported images
+        std::vector<VkImage> importedImages{};
+        std::vector<VkImageView> importedViews{};
+        // transient images, per compile
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkImageUsageFlags usage = 0;
+        uint32_t firstUse = UINT32_MAX; // in the schedule
+        uint32_t lastUse = 0;
+        uint32_t block = UINT32_MAX; // memory block, for aliasing
+    };
+    struct ResourceUse {
+        NanoRGResource resource;
+        NanoRGAccess access;
+        bool hasClear;
+        VkClearValue clearValue;
+    };
+    struct Pass {
+        std::string name{};
+        NanoRGPassType type = NanoRGPassType::GRAPHICS;
+        std::function<void(VkCommandBuffer&)> record{};
+        std::vector<ResourceUse> uses{};
+        // per compile
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        std::vector<VkFramebuffer> framebuffers{}; // one per imported image when an attachment is imported
+        std::vector<VkClearValue> clearValues{};
+    };
+    // the state of a resource between two passes
+    struct AccessState {
+        VkPipelineStageFlags2KHR writeStages;
+        VkAccessFlags2KHR writeAccess;
+        VkPipelineStageFlags2KHR readStages; // since the last write
+        VkPipelineStageFlags2KHR visibleStages; // readers the last write was already made visible to
+        VkAccessFlags2KHR visibleAccess;
+        VkImageLayout layout;
+    };
+    struct ImageBarrier {
+        NanoRGResource resource;
+        VkImageMemoryBarrier2KHR barrier;
+    };
+    struct BarrierBatch {
+        bool hasMemoryBarrier = false;
+        VkMemoryBarrier2KHR memoryBarrier{};
+        std::vector<ImageBarrier> imageBarriers{};
+    };
+    struct MemoryBlock {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        uint32_t memoryTypeBits = 0;
+        bool lazy = false;
+        std::vector<NanoRGResource> resources{}; // in schedule order
+    };
+    struct CachedRenderPass {
+        std::vector<uint32_t> key{};
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+    };
+
+    void cullPasses();
+    void computeLifetimes();
+    ERR createTransientImages();
+    void buildBarriers();
+    ERR createRenderPasses();
+    void releaseCompiled();
+    VkRenderPass getRenderPass(const std::vector<VkAttachmentDescription>& attachments, uint32_t colorCount, bool hasDepth);
+    void recordBarriers(VkCommandBuffer& commandBuffer, const BarrierBatch& batch, uint32_t imageIndex);
+
+    VkDevice _device{};
+    VkPhysicalDevice _physicalDevice{};
+    NanoProfiler* _profiler = nullptr;
+    PFN_vkCmdPipelineBarrier2KHR m_cmdPipelineBarrier2 = nullptr;
+    bool m_isInit = false;
+    bool m_dirty = true;
+    bool m_compiled = false;
+    VkExtent2D m_extent{};
+
+    std::vector<Resource> m_resources{};
+    std::vector<Pass> m_passes{};
+    std::vector<NanoRGPass> m_schedule{};
+    std::vector<BarrierBatch> m_barriers{}; // before each scheduled pass, plus one at the end
+    std::vector<MemoryBlock> m_blocks{};
+    std::vector<CachedRenderPass> m_renderPassCache{};
+
+    // scratch for recording
+    std::vector<VkImageMemoryBarrier2KHR> m_imageBarrierScratch{};
+    NanoRenderGraphStats m_stats{};
+};
+
+#endif // NANORENDERGRAPH_H_
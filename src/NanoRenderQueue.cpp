@@ -0,0 +1,287 @@
+#include "NanoRenderQueue.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+ERR NanoRenderQueue::Init(VkDevice& device, const VkPhysicalDevice& physicalDevice, uint32_t instanceCapacity) {
+    ERR err = ERR::OK;
+    _device = device;
+    _physicalDevice = physicalDevice;
+    for (uint32_t i = 0; i < Config::MAX_FRAMES_IN_FLIGHT; i++) {
+        m_instanceBuffers[i].Init(device, physicalDevice, static_cast<VkDeviceSize>(instanceCapacity) * sizeof(uint32_t),
+                                  VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    }
+    m_isInit = true;
+    return err;
+}
+
+uint32_t NanoRenderQueue::AddPipeline(VkPipeline pipeline, VkPipelineLayout pipelineLayout) {
+    if (m_pipelines.size() >= MAX_PIPELINES) {
+        return UINT32_MAX;
+    }
+    m_pipelines.push_back({pipeline, pipelineLayout});
+    return static_cast<uint32_t>(m_pipelines.size() - 1);
+}
+
+uint32_t NanoRenderQueue::AddMaterial(const NanoMaterialIndices& material) {
+    if (m_materials.size() >= MAX_MATERIALS) {
+        return UINT32_MAX;
+    }
+    m_materials.push_back(material);
+    return static_cast<uint32_t>(m_materials.size() - 1);
+}
+
+uint32_t NanoRenderQueue::AddMesh(const NanoQueueMesh& mesh) {
+    m_meshes.push_back(mesh);
+    return static_cast<uint32_t>(m_meshes.size() - 1);
+}
+
+void NanoRenderQueue::SetMesh(uint32_t mesh, const NanoQueueMesh& data) {
+    if (mesh < m_meshes.size()) {
+        m_meshes[mesh] = data;
+    }
+}
+
+void NanoRenderQueue::CleanUp() {
+    if (m_isInit) {
+        for (uint32_t i = 0; i < Config::MAX_FRAMES_IN_FLIGHT; i++) {
+            m_instanceBuffers[i].CleanUp();
+        }
+        m_isInit = false;
+    }
+    m_pipelines.clear();
+    m_materials.clear();
+    m_meshes.clear();
+    m_entries.clear();
+    m_scratch.clear();
+    m_stats = {};
+}
+
+void NanoRenderQueue::BeginFrame(uint32_t frameIndex) {
+    m_frameIndex = frameIndex;
+    m_entries.clear();
+    m_stats = {};
+}
+
+uint64_t NanoRenderQueue::MakeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float viewDepth, bool transparent) {
+    // the bits of a positive float sort like the float itself
+    if (!(viewDepth > 0.0f)) {
+        viewDepth = 0.0f;
+    }
+    uint32_t depthBits = 0;
+    memcpy(&depthBits, &viewDepth, sizeof(float));
+
+    uint64_t key = static_cast<uint64_t>(pass & 0xf) << 60;
+    if (transparent) {
+        key |= 1ull << 59;
+        key |= static_cast<uint64_t>(~depthBits & 0x7fffffffu) << 28;
+        key |= static_cast<uint64_t>(pipeline & 0x3ff) << 18;
+        key |= static_cast<uint64_t>(material & 0xffff) << 2;
+    } else {
+        key |= static_cast<uint64_t>(pipeline & 0x3ff) << 49;
+        key |= static_cast<uint64_t>(material & 0xffff) << 33;
+        key |= static_cast<uint64_t>(mesh & 0xffff) << 17;
+        key |= depthBits >> 14;
+    }
+    return key;
+}
+
+uint32_t NanoRenderQueue::GetPipeline(uint64_t key) {
+    return static_cast<uint32_t>(IsTransparent(key) ? (key >> 18) & 0x3ff : (key >> 49) & 0x3ff);
+}
+
+uint32_t NanoRenderQueue::GetMaterial(uint64_t key) {
+    return static_cast<uint32_t>(IsTransparent(key) ? (key >> 2) & 0xffff : (key >> 33) & 0xffff);
+}
+
+void NanoRenderQueue::Submit(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float viewDepth, bool transparent,
+                             uint32_t instance) {
+    if (pass >= MAX_PASSES || pipeline >= m_pipelines.size() || material >= m_materials.size() || mesh >= m_meshes.size()) {
+        return;
+    }
+    m_entries.push_back({MakeKey(pass, pipeline, material, mesh, viewDepth, transparent), mesh, instance});
+}
+
+void NanoRenderQueue::forEachChunk(NanoJobSystem* jobSystem, uint32_t chunkCount, const std::function<void(uint32_t chunk)>& function) {
+    if (chunkCount == 1) {
+        function(0);
+        return;
+    }
+    jobSystem->ParallelFor(chunkCount, 1, [&function](uint32_t begin, uint32_t end) {
+        for (uint32_t chunk = begin; chunk < end; chunk++) {
+            function(chunk);
+        }
+    });
+}
+
+void NanoRenderQueue::Sort(NanoJobSystem* jobSystem) {
+    auto start = std::chrono::steady_clock::now();
+    uint32_t count = GetDrawCount();
+    if (count > 1) {
+        uint32_t chunkCount = 1;
+        if (jobSystem && jobSystem->IsInit() && count >= PARALLEL_SORT_THRESHOLD) {
+            chunkCount = std::max(1u, std::min(jobSystem->GetThreadCount(), count / SORT_CHUNK));
+        }
+        uint32_t chunkSize = (count + chunkCount - 1) / chunkCount;
+        m_scratch.resize(count);
+        m_histograms.resize(static_cast<size_t>(chunkCount) * 256);
+        m_chunkDifferences.assign(chunkCount, 0);
+
+        Entry* src = m_entries.data();
+        Entry* dst = m_scratch.data();
+        uint64_t firstKey = src[0].key;
+        forEachChunk(jobSystem, chunkCount, [&](uint32_t chunk) {
+            uint64_t differences = 0;
+            for (uint32_t i = chunk * chunkSize; i < std::min(count, (chunk + 1) * chunkSize); i++) {
+                differences |= src[i].key ^ firstKey;
+            }
+            m_chunkDifferences[chunk] = differences;
+        });
+        uint64_t differences = 0;
+        for (uint64_t chunkDifferences : m_chunkDifferences) {
+            differences |= chunkDifferences;
+        }
+
+        // LSD, each chunk scatters its entries in order so every pass is stable
+        for (uint32_t shift = 0; shift < 64; shift += 8) {
+            if (((differences >> shift) & 0xff) == 0) {
+                continue;
+            }
+            forEachChunk(jobSystem, chunkCount, [&](uint32_t chunk) {
+                uint32_t* histogram = &m_histograms[static_cast<size_t>(chunk) * 256];
+                std::fill(histogram, histogram + 256, 0);
+                for (uint32_t i = chunk * chunkSize; i < std::min(count, (chunk + 1) * chunkSize); i++) {
+                    histogram[(src[i].key >> shift) & 0xff]++;
+                }
+            });
+            // digit major, chunk minor: chunk c's entries of a digit land after those of the chunks before it
+            uint32_t offset = 0;
+            for (uint32_t digit = 0; digit < 256; digit++) {
+                for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+                    uint32_t& slot = m_histograms[static_cast<size_t>(chunk) * 256 + digit];
+                    uint32_t digitCount = slot;
+                    slot = offset;
+                    offset += digitCount;
+                }
+            }
+            forEachChunk(jobSystem, chunkCount, [&](uint32_t chunk) {
+                uint32_t* histogram = &m_histograms[static_cast<size_t>(chunk) * 256];
+                for (uint32_t i = chunk * chunkSize; i < std::min(count, (chunk + 1) * chunkSize); i++) {
+                    dst[histogram[(src[i].key >> shift) & 0xff]++] = src[i];
+                }
+            });
+            std::swap(src, dst);
+        }
+        if (src != m_entries.data()) {
+            m_entries.swap(m_scratch);
+        }
+    }
+    writeInstances();
+    m_stats.sortMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void NanoRenderQueue::writeInstances() {
+    if (!m_isInit || m_entries.empty()) {
+        return;
+    }
+    // the frame's previous submission is done (BeginFrame), so its buffer can simply be replaced by a bigger one
+    NanoBuffer& instanceBuffer = m_instanceBuffers[m_frameIndex];
+    VkDeviceSize size = static_cast<VkDeviceSize>(m_entries.size()) * sizeof(uint32_t);
+    if (size > instanceBuffer.GetSize()) {
+        VkDeviceSize newSize = std::max(size, instanceBuffer.GetSize() * 2);
+        instanceBuffer.CleanUp();
+        instanceBuffer.Init(_device, _physicalDevice, newSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    }
+    uint32_t* instances = static_cast<uint32_t*>(instanceBuffer.GetMappedData());
+    for (size_t i = 0; i < m_entries.size(); i++) {
+        instances[i] = m_entries[i].instance;
+    }
+}
+
+void NanoRenderQueue::Record(VkCommandBuffer& commandBuffer, uint32_t pass, NanoBindlessHeap* bindlessHeap) {
+    auto begin = std::partition_point(m_entries.begin(), m_entries.end(), [pass](const Entry& entry) { return GetPass(entry.key) < pass; });
+    auto end = std::partition_point(begin, m_entries.end(), [pass](const Entry& entry) { return GetPass(entry.key) <= pass; });
+    if (begin == end) {
+        return;
+    }
+
+    bool bindless = bindlessHeap && bindlessHeap->IsInit();
+    VkShaderStageFlags pushConstantStages = NanoBindlessHeap::GetPushConstantRange().stageFlags;
+    uint32_t boundPipeline = UINT32_MAX;
+    uint32_t boundMaterial = UINT32_MAX;
+    VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+    VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+    VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+    VkIndexType boundIndexType = VK_INDEX_TYPE_UINT32;
+
+    if (m_isInit) {
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(commandBuffer, Config::INSTANCE_VERTEX_BINDING, 1, &m_instanceBuffers[m_frameIndex].GetBuffer(), &offset);
+        m_stats.vertexBufferBinds++;
+    }
+
+    for (auto entry = begin; entry != end;) {
+        uint32_t pipelineId = GetPipeline(entry->key);
+        uint32_t materialId = GetMaterial(entry->key);
+        const Pipeline& pipeline = m_pipelines[pipelineId];
+        const NanoQueueMesh& mesh = m_meshes[entry->mesh];
+        uint32_t binds = 0;
+
+        // the neighbours that only differ by depth and instance go out with this draw
+        auto runEnd = entry + 1;
+        while (runEnd != end && runEnd->mesh == entry->mesh && GetPipeline(runEnd->key) == pipelineId && GetMaterial(runEnd->key) == materialId) {
+            runEnd++;
+        }
+        uint32_t instanceCount = static_cast<uint32_t>(runEnd - entry);
+        uint32_t firstInstance = static_cast<uint32_t>(entry - m_entries.begin());
+
+        if (pipelineId != boundPipeline) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+            boundPipeline = pipelineId;
+            m_stats.pipelineBinds++;
+            binds++;
+            // the set and the push constants stay valid across pipelines that share the layout
+            if (bindless && pipeline.layout != boundLayout) {
+                bindlessHeap->Bind(commandBuffer, pipeline.layout);
+                boundLayout = pipeline.layout;
+                boundMaterial = UINT32_MAX;
+                m_stats.descriptorSetBinds++;
+                binds++;
+            }
+        }
+        if (bindless && materialId != boundMaterial) {
+            vkCmdPushConstants(commandBuffer, pipeline.layout, pushConstantStages, 0, sizeof(NanoMaterialIndices), &m_materials[materialId]);
+            boundMaterial = materialId;
+            m_stats.pushConstantUpdates++;
+            binds++;
+        }
+        if (mesh.vertexBuffer != VK_NULL_HANDLE && mesh.vertexBuffer != boundVertexBuffer) {
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &mesh.vertexBuffer, &offset);
+            boundVertexBuffer = mesh.vertexBuffer;
+            m_stats.vertexBufferBinds++;
+            binds++;
+        }
+        if (mesh.indexBuffer != VK_NULL_HANDLE && (mesh.indexBuffer != boundIndexBuffer || mesh.indexType != boundIndexType)) {
+            vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer, 0, mesh.indexType);
+            boundIndexBuffer = mesh.indexBuffer;
+            boundIndexType = mesh.indexType;
+            m_stats.indexBufferBinds++;
+            binds++;
+        }
+
+        if (mesh.indexBuffer != VK_NULL_HANDLE) {
+            vkCmdDrawIndexed(commandBuffer, mesh.count, instanceCount, mesh.firstIndex, mesh.vertexOffset, firstInstance);
+        } else {
+            vkCmdDraw(commandBuffer, mesh.count, instanceCount, mesh.firstIndex, firstInstance);
+        }
+        m_stats.draws++;
+        m_stats.instances += instanceCount;
+
+        uint32_t naiveBinds = 1 + (bindless ? 2 : 0) + (mesh.vertexBuffer != VK_NULL_HANDLE) + (mesh.indexBuffer != VK_NULL_HANDLE);
+        m_stats.skippedBinds += naiveBinds * instanceCount - binds;
+        entry = runEnd;
+    }
+}
@@ -0,0 +1,118 @@
+#ifndef NANORENDERQUEUE_H_
+#define NANORENDERQUEUE_H_
+
+#include "NanoBindlessHeap.hpp"
+#include "NanoBuffer.hpp"
+#include "NanoConfig.hpp"
+#include "NanoError.hpp"
+#include "NanoJobSystem.hpp"
+
+#include "vulkan/vulkan_core.h"
+#include <cstdint>
+#include <vector>
+
+// geometry a queued draw uses. No index buffer means a non indexed draw of count vertices
+struct NanoQueueMesh {
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+    uint32_t count = 0; // indices, or vertices without an index buffer
+    uint32_t firstIndex = 0; // first vertex without an index buffer
+    int32_t vertexOffset = 0;
+};
+
+// state changes recorded this frame, and what the sorted order saved
+struct NanoRenderQueueStats {
+    uint32_t draws = 0;     // draw calls
+    uint32_t instances = 0; // submitted draws, draws / instances is what batching saved
+    uint32_t pipelineBinds = 0;
+    uint32_t descriptorSetBinds = 0;
+    uint32_t pushConstantUpdates = 0;
+    uint32_t vertexBufferBinds = 0;
+    uint32_t indexBufferBinds = 0;
+    uint32_t skippedBinds = 0; // binds an unsorted, unfiltered submission would have paid for
+    double sortMs = 0.0;
+};
+
+// Per frame list of draws, each with a 64 bit key, radix sorted so that recording walks it in order and only binds what
+// changed from the previous draw. Pipelines, materials and meshes are registered once and referenced by id.
+//   opaque:      pass:4 | 0:1 | pipeline:10 | material:16 | mesh:16 | depth:17
+//   transparent: pass:4 | 1:1 | ~depth:31   | pipeline:10 | material:16 | 0:2
+// Opaque draws are grouped by state first and go front to back inside a group (depth is the top bits of the float, so
+// logarithmic), which is where early z still pays once the state is fixed. Transparent draws have to blend back to front,
+// so there depth comes first and the state only breaks ties. Passes are recorded one at a time, in key order.
+// Batching: neighbours in the sorted list with the same pipeline, material and mesh become one instanced draw. Once sorted,
+// the submitted instance values are written in list order to the frame's instance buffer, so a run [begin, end) is simply
+// firstInstance = begin, instanceCount = end - begin. Shaders read their value as a per instance uint vertex input at
+// Config::INSTANCE_VERTEX_BINDING (NanoGraphicsPipeline::AddInstanceInputs), which works the same for a run of one
+class NanoRenderQueue {
+  public:
+    static constexpr uint32_t MAX_PASSES = 16;
+    static constexpr uint32_t MAX_PIPELINES = 1024;
+    static constexpr uint32_t MAX_MATERIALS = 65536;
+    static constexpr uint32_t PARALLEL_SORT_THRESHOLD = 8192; // draws below this are sorted on the calling thread
+    static constexpr uint32_t SORT_CHUNK = 4096;              // minimum draws per job
+
+    // one instance buffer per frame in flight, host visible
+    ERR Init(VkDevice& device, const VkPhysicalDevice& physicalDevice, uint32_t instanceCapacity);
+    // ids are handed out in order and stay valid until CleanUp. UINT32_MAX once the table is full
+    uint32_t AddPipeline(VkPipeline pipeline, VkPipelineLayout pipelineLayout);
+    uint32_t AddMaterial(const NanoMaterialIndices& material);
+    uint32_t AddMesh(const NanoQueueMesh& mesh);
+    // e.g. once the mesh arena was compacted. Takes effect with the next Record
+    void SetMesh(uint32_t mesh, const NanoQueueMesh& data);
+    void CleanUp();
+
+    // at the start of every frame, once the frame's fence was waited on. The tables are kept
+    void BeginFrame(uint32_t frameIndex);
+    // viewDepth: distance along the view direction, >= 0. instance is the value the shaders get as their instance input
+    void Submit(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float viewDepth, bool transparent = false,
+                uint32_t instance = 0);
+    // radix sort, 8 bits per pass, skipping the bytes every key has in common. In chunks over the job system when there
+    // are enough draws, jobSystem can be nullptr. Then fills the frame's instance buffer
+    void Sort(NanoJobSystem* jobSystem);
+    // the pass's draws, sorted. Inside a render pass with the viewport and scissor already set. bindlessHeap can be
+    // nullptr when the pipelines don't use the bindless set
+    void Record(VkCommandBuffer& commandBuffer, uint32_t pass, NanoBindlessHeap* bindlessHeap);
+
+    uint32_t GetDrawCount() { return static_cast<uint32_t>(m_entries.size()); }
+    const NanoRenderQueueStats& GetStats() { return m_stats; }
+
+    static uint64_t MakeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float viewDepth, bool transparent);
+    static uint32_t GetPass(uint64_t key) { return static_cast<uint32_t>(key >> 60); }
+    static bool IsTransparent(uint64_t key) { return (key >> 59) & 1; }
+    static uint32_t GetPipeline(uint64_t key);
+    static uint32_t GetMaterial(uint64_t key);
+
+  private:
+    struct Pipeline {
+        VkPipeline pipeline;
+        VkPipelineLayout layout;
+    };
+    struct Entry {
+        uint64_t key;
+        uint32_t mesh; // the transparent key has no room for it
+        uint32_t instance;
+    };
+
+    void forEachChunk(NanoJobSystem* jobSystem, uint32_t chunkCount, const std::function<void(uint32_t chunk)>& function);
+    void writeInstances();
+
+    VkDevice _device{};
+    VkPhysicalDevice _physicalDevice{};
+    bool m_isInit = false;
+    uint32_t m_frameIndex = 0;
+    NanoBuffer m_instanceBuffers[Config::MAX_FRAMES_IN_FLIGHT]{};
+
+    std::vector<Pipeline> m_pipelines{};
+    std::vector<NanoMaterialIndices> m_materials{};
+    std::vector<NanoQueueMesh> m_meshes{};
+
+    std::vector<Entry> m_entries{};
+    std::vector<Entry> m_scratch{};
+    std::vector<uint32_t> m_histograms{}; // 256 per chunk
+    std::vector<uint64_t> m_chunkDifferences{};
+    NanoRenderQueueStats m_stats{};
+};
+
+#endif // NANORENDERQUEUE_H_
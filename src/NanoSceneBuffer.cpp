@@ -0,0 +1,214 @@
+#include "NanoSceneBuffer.hpp"
+#include "NanoConfig.hpp"
+#include "NanoLogger.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+ERR NanoSceneBuffer::Init(VkDevice& device, const VkPhysicalDevice& physicalDevice, uint32_t capacity) {
+    ERR err = ERR::OK;
+    m_capacity = capacity;
+    m_instances.clear();
+    m_instances.reserve(capacity);
+    m_freeInstances.clear();
+    m_dirtyMask.assign((static_cast<size_t>(capacity) + 63) / 64, 0);
+    m_dirtyWords.clear();
+    m_movedMask.assign((static_cast<size_t>(capacity) + 63) / 64, 0);
+    m_movedInstances.clear();
+    m_stats = {};
+
+    m_buffer.Init(device, physicalDevice, static_cast<VkDeviceSize>(capacity) * sizeof(NanoGPUInstance),
+                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    m_isInit = true;
+    return err;
+}
+
+void NanoSceneBuffer::CleanUp() {
+    if (!m_isInit) {
+        return;
+    }
+    m_buffer.CleanUp();
+    m_instances.clear();
+    m_freeInstances.clear();
+    m_dirtyMask.clear();
+    m_dirtyWords.clear();
+    m_movedMask.clear();
+    m_movedInstances.clear();
+    m_isInit = false;
+}
+
+uint32_t NanoSceneBuffer::Add(const NanoGPUInstance& data) {
+    if (!m_freeInstances.empty()) {
+        uint32_t instance = m_freeInstances.back();
+        m_freeInstances.pop_back();
+        m_instances[instance] = data;
+        m_instances[instance].flags &= ~NANO_INSTANCE_REMOVED;
+        markDirty(instance);
+        MarkMoved(instance);
+        return instance;
+    }
+    if (m_instances.size() >= m_capacity) {
+        return UINT32_MAX;
+    }
+    uint32_t instance = static_cast<uint32_t>(m_instances.size());
+    m_instances.push_back(data);
+    markDirty(instance);
+    MarkMoved(instance);
+    return instance;
+}
+
+void NanoSceneBuffer::Remove(uint32_t instance) {
+    if (instance >= m_instances.size() || IsRemoved(instance)) {
+        return;
+    }
+    m_instances[instance].flags |= NANO_INSTANCE_REMOVED;
+    m_freeInstances.push_back(instance);
+    markDirty(instance);
+    MarkMoved(instance);
+}
+
+void NanoSceneBuffer::Set(uint32_t instance, const NanoGPUInstance& data) {
+    if (instance >= m_instances.size()) {
+        return;
+    }
+    m_instances[instance] = data;
+    markDirty(instance);
+    MarkMoved(instance);
+}
+
+void NanoSceneBuffer::SetTransform(uint32_t instance, const glm::mat4& world) {
+    if (instance >= m_instances.size()) {
+        return;
+    }
+    m_instances[instance].world = world;
+    markDirty(instance);
+    MarkMoved(instance);
+}
+
+void NanoSceneBuffer::SetFlags(uint32_t instance, uint32_t flags) {
+    if (instance >= m_instances.size() || m_instances[instance].flags == flags) {
+        return;
+    }
+    m_instances[instance].flags = flags;
+    markDirty(instance);
+}
+
+void NanoSceneBuffer::SetMaterial(uint32_t instance, uint32_t material) {
+    if (instance >= m_instances.size()) {
+        return;
+    }
+    m_instances[instance].material = material;
+    markDirty(instance);
+}
+
+void NanoSceneBuffer::TakeMoved(std::vector<uint32_t>& instances) {
+    instances.swap(m_movedInstances);
+    m_movedInstances.clear();
+    for (uint32_t instance : instances) {
+        m_movedMask[instance / 64] &= ~(1ull << (instance % 64));
+    }
+}
+
+void NanoSceneBuffer::MarkMoved(uint32_t instance) {
+    uint64_t bit = 1ull << (instance % 64);
+    if (instance < m_instances.size() && !(m_movedMask[instance / 64] & bit)) {
+        m_movedMask[instance / 64] |= bit;
+        m_movedInstances.push_back(instance);
+    }
+}
+
+void NanoSceneBuffer::markDirty(uint32_t instance) {
+    uint32_t word = instance / 64;
+    if (m_dirtyMask[word] == 0) {
+        m_dirtyWords.push_back(word);
+    }
+    m_dirtyMask[word] |= 1ull << (instance % 64);
+}
+
+void NanoSceneBuffer::buildRuns() {
+    m_runs.clear();
+    std::sort(m_dirtyWords.begin(), m_dirtyWords.end());
+    for (uint32_t word : m_dirtyWords) {
+        uint64_t bits = m_dirtyMask[word];
+        for (uint32_t bit = 0; bits != 0; bit++, bits >>= 1) {
+            if (!(bits & 1)) {
+                continue;
+            }
+            uint32_t instance = word * 64 + bit;
+            if (!m_runs.empty() && m_runs.back().end == instance) {
+                m_runs.back().end++;
+            } else {
+                m_runs.push_back({instance, instance + 1});
+            }
+            m_stats.dirtyInstances++;
+        }
+    }
+
+    // the gap ends up larger than the whole buffer at worst, which leaves a single run
+    uint32_t gap = Config::SCENE_UPLOAD_MERGE_GAP;
+    while (true) {
+        size_t merged = 0;
+        for (size_t i = 1; i < m_runs.size(); i++) {
+            if (m_runs[i].begin - m_runs[merged].end <= gap) {
+                m_runs[merged].end = m_runs[i].end;
+            } else {
+                m_runs[++merged] = m_runs[i];
+            }
+        }
+        m_runs.resize(std::min(m_runs.size(), merged + 1));
+        if (m_runs.size() <= Config::SCENE_MAX_COPY_REGIONS) {
+            break;
+        }
+        gap = gap * 2 + 1;
+    }
+}
+
+void NanoSceneBuffer::RecordUpload(VkCommandBuffer& commandBuffer, NanoStagingRing& stagingRing) {
+    m_stats = {};
+    if (m_dirtyWords.empty()) {
+        return;
+    }
+    buildRuns();
+
+    // runs that don't fit in the ring this frame stay dirty and go out with the next one
+    m_regions.clear();
+    for (const Run& run : m_runs) {
+        VkDeviceSize size = static_cast<VkDeviceSize>(run.end - run.begin) * sizeof(NanoGPUInstance);
+        VkDeviceSize stagingOffset = 0;
+        void* mappedData = nullptr;
+        if (!stagingRing.Allocate(size, 16, stagingOffset, mappedData)) {
+            break;
+        }
+        memcpy(mappedData, m_instances.data() + run.begin, size);
+
+        VkBufferCopy region{};
+        region.srcOffset = stagingOffset;
+        region.dstOffset = static_cast<VkDeviceSize>(run.begin) * sizeof(NanoGPUInstance);
+        region.size = size;
+        m_regions.push_back(region);
+        m_stats.uploadedInstances += run.end - run.begin;
+        m_stats.uploadedBytes += size;
+    }
+    if (m_regions.empty()) {
+        return;
+    }
+    m_stats.copyRegions = static_cast<uint32_t>(m_regions.size());
+
+    vkCmdCopyBuffer(commandBuffer, stagingRing.GetBuffer(), m_buffer.GetBuffer(), m_stats.copyRegions, m_regions.data());
+
+    if (m_regions.size() == m_runs.size()) {
+        for (uint32_t word : m_dirtyWords) {
+            m_dirtyMask[word] = 0;
+        }
+        m_dirtyWords.clear();
+        return;
+    }
+    for (size_t i = 0; i < m_regions.size(); i++) {
+        for (uint32_t instance = m_runs[i].begin; instance < m_runs[i].end; instance++) {
+            m_dirtyMask[instance / 64] &= ~(1ull << (instance % 64));
+        }
+    }
+    m_dirtyWords.erase(std::remove_if(m_dirtyWords.begin(), m_dirtyWords.end(), [this](uint32_t word) { return m_dirtyMask[word] == 0; }),
+                       m_dirtyWords.end());
+}
@@ -0,0 +1,100 @@
+#ifndef NANOSCENEBUFFER_H_
+#define NANOSCENEBUFFER_H_
+
+#include "NanoBuffer.hpp"
+#include "NanoError.hpp"
+#include "NanoStagingRing.hpp"
+
+#include "glm/glm.hpp"
+#include "vulkan/vulkan_core.h"
+#include <cstdint>
+#include <vector>
+
+constexpr uint32_t NANO_INSTANCE_HIDDEN = 1u << 0;   // culled on the CPU already (NanoEngine's culling stage), the GPU skips it
+constexpr uint32_t NANO_INSTANCE_REMOVED = 1u << 1;  // a free slot, skipped by the GPU until Add hands it out again
+constexpr uint32_t NANO_INSTANCE_QUEUED = 1u << 2;   // drawn through the render queue (AddQueuedInstance), not by the GPU driven path
+constexpr uint32_t NANO_INSTANCE_OCCLUDED = 1u << 3; // its bounding box came back from an occlusion query with no samples
+
+// what the culling and vertex shaders know about an instance. 80 bytes, std430
+struct NanoGPUInstance {
+    glm::mat4 world{1.0f};
+    uint32_t mesh = 0; // in the mesh arena
+    uint32_t material = 0;
+    uint32_t flags = 0; // NANO_INSTANCE_*
+    uint32_t reserved = 0;
+};
+
+static_assert(sizeof(NanoGPUInstance) == 80, "NanoGPUInstance is read as a std430 struct");
+
+struct NanoSceneUploadStats {
+    uint32_t dirtyInstances = 0;
+    uint32_t uploadedInstances = 0; // dirty ones plus the clean ones between them that were merged into a region
+    uint32_t copyRegions = 0;
+    uint64_t uploadedBytes = 0;
+};
+
+// Every instance's data lives in one device local buffer for the lifetime of the scene, the CPU keeps a copy and a dirty
+// bit per instance. Each frame only the dirty instances go through the staging ring: neighbours are coalesced into runs,
+// runs closer than SCENE_UPLOAD_MERGE_GAP instances are merged (re-sending a few clean instances is cheaper than another
+// region) and the gap grows until there are at most SCENE_MAX_COPY_REGIONS, all of it in a single vkCmdCopyBuffer.
+// A frame where nothing changed records nothing at all.
+// The buffer is shared by every frame in flight. RecordUpload only records the copy, the render graph's "scene upload"
+// pass puts the barriers around it (previous frames' readers before, this frame's cull and draw after)
+class NanoSceneBuffer {
+  public:
+    ERR Init(VkDevice& device, const VkPhysicalDevice& physicalDevice, uint32_t capacity);
+    void CleanUp();
+
+    // returns UINT32_MAX when the buffer is full. Removed slots are reused first
+    uint32_t Add(const NanoGPUInstance& instance);
+    void Remove(uint32_t instance);
+    bool IsRemoved(uint32_t instance) { return (m_instances[instance].flags & NANO_INSTANCE_REMOVED) != 0; }
+    void Set(uint32_t instance, const NanoGPUInstance& data);
+    void SetTransform(uint32_t instance, const glm::mat4& world);
+    void SetMaterial(uint32_t instance, uint32_t material);
+    // only uploaded when they changed, visibility flips every few frames at most
+    void SetFlags(uint32_t instance, uint32_t flags);
+    const NanoGPUInstance& Get(uint32_t instance) { return m_instances[instance]; }
+    // instances added, removed or moved since the last TakeMoved, for bounds kept on the CPU. Each one is listed once
+    void TakeMoved(std::vector<uint32_t>& instances);
+    // e.g. when the mesh an instance draws is gone
+    void MarkMoved(uint32_t instance);
+
+    // records the copies of everything that changed since the last upload. Outside of a render pass, after the frame's
+    // fence was waited on (the staging ring space is reclaimed there)
+    void RecordUpload(VkCommandBuffer& commandBuffer, NanoStagingRing& stagingRing);
+
+    bool IsInit() { return m_isInit; }
+    NanoBuffer& GetBuffer() { return m_buffer; } // NanoGPUInstance[], storage buffer
+    uint32_t GetCount() { return static_cast<uint32_t>(m_instances.size()); }
+    uint32_t GetCapacity() { return m_capacity; }
+    bool HasPendingUploads() { return !m_dirtyWords.empty(); }
+    const NanoSceneUploadStats& GetStats() { return m_stats; }
+
+  private:
+    struct Run {
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    void markDirty(uint32_t instance);
+    void buildRuns();
+
+    bool m_isInit = false;
+    uint32_t m_capacity = 0;
+    NanoBuffer m_buffer{};
+    std::vector<NanoGPUInstance> m_instances{};
+    std::vector<uint32_t> m_freeInstances{};
+
+    // one bit per instance, plus the words that have any bit set so a frame only looks at what changed
+    std::vector<uint64_t> m_dirtyMask{};
+    std::vector<uint32_t> m_dirtyWords{};
+    std::vector<Run> m_runs{};
+    std::vector<VkBufferCopy> m_regions{};
+    // same as the dirty bits but only cleared by TakeMoved
+    std::vector<uint64_t> m_movedMask{};
+    std::vector<uint32_t> m_movedInstances{};
+    NanoSceneUploadStats m_stats{};
+};
+
+#endif // NANOSCENEBUFFER_H_
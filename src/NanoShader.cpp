@@ -4,14 +4,19 @@
 
 #ifdef _WIN64
 #include <windows.h>
-#elif __APPLE__
+#else
+#include <sys/wait.h>
 #include <unistd.h>
 #endif
 
+#include <filesystem>
 #include <fstream>
 
 void NanoShader::CleanUp(){
-    vkDestroyShaderModule(_device, m_shaderModule, nullptr);
+    if(m_shaderModule != VK_NULL_HANDLE){
+        vkDestroyShaderModule(_device, m_shaderModule, nullptr);
+        m_shaderModule = VK_NULL_HANDLE;
+    }
 }
 
 static VkShaderModule CreateShaderModule(VkDevice& device, NanoShader& shader) {
@@ -81,7 +86,8 @@ int RunGLSLCompiler(const char* lpApplicationName, char const* fileName, const c
 
   return compilerExitCode;
 }
-#elif __APPLE__
+#else
+// macOS and Linux. Shaders get compiled from worker threads during init, so the child only calls async signal safe functions
 int RunGLSLCompiler(const char* lpApplicationName, char const* fileName, const char* outputFileName, const char* shaderName)
 {
   int err = 0;
@@ -92,23 +98,23 @@ int RunGLSLCompiler(const char* lpApplicationName, char const* fileName, const c
 
   pid = fork();
   if(pid == -1){
-    fprintf(stderr, "error pid\n");
-    exit(EXIT_FAILURE);
+    LOG_MSG(ERRLevel::WARNING, "could not fork to run glslc");
+    return -1;
   }else if(pid == 0){
-    err = execl(lpApplicationName, "", fileName, "-o", outputFileName, (char *)0);
-    LOG_MSG(ERRLevel::INFO, "finished compiling: %s\t with exit code: %d", shaderName, err);
-    exit(0);
+    execl(lpApplicationName, lpApplicationName, fileName, "-o", outputFileName, (char *)0);
+    _exit(127); // only reached when execl failed
   }else{
     if(waitpid(pid, &status, 0) > 0){
-      if (WIFEXITED(status) && !WEXITSTATUS(status) && WEXITSTATUS(status) != 127){
-        //LOG_MSG(ERRLevel::INFO, "glslc ran with no issues");
-      } else{
+      err = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+      if (err != 0){
         LOG_MSG(ERRLevel::INFO, "glslc exit with error");
       }
     } else {
         LOG_MSG(ERRLevel::FATAL, "error occured with waitpid");
+        err = -1;
     }
   }
+  LOG_MSG(ERRLevel::INFO, "finished compiling: %s\t with exit code: %d", shaderName, err);
   return err;
 }
 #endif
@@ -135,7 +141,35 @@ void NanoShader::Init(VkDevice& device, const std::string& shaderCodeFile){
     _device = device;
 }
 
+void NanoShader::Init(const std::string& shaderCodeFile){
+    m_fileFullPath = shaderCodeFile;
+}
+
+void NanoShader::CreateModule(VkDevice& device){
+    _device = device;
+    m_shaderModule = CreateShaderModule(_device, *this);
+}
+
 int NanoShader::Compile(bool forceCompile){
+    int exitCode = CompileSpirv(forceCompile);
+    if(!exitCode){
+      m_shaderModule = CreateShaderModule(_device, *this);
+    }
+    return exitCode;
+}
+
+// the spv is only stale when the source changed after it was written
+static bool isSpirvUpToDate(const std::string& sourceFile, const std::string& spirvFile){
+    std::error_code error{};
+    auto spirvTime = std::filesystem::last_write_time(spirvFile, error);
+    if(error){
+        return false;
+    }
+    auto sourceTime = std::filesystem::last_write_time(sourceFile, error);
+    return !error && spirvTime >= sourceTime;
+}
+
+int NanoShader::CompileSpirv(bool forceCompile){
     int exitCode = 1;
     std::string outputFile = "./src/shader/";
 
@@ -168,14 +202,17 @@ int NanoShader::Compile(bool forceCompile){
 #else
     const char* executable = "./external/VULKAN/linux/glslc";
 #endif
-    exitCode = RunGLSLCompiler(executable, m_fileFullPath.c_str(), outputFile.c_str(), m_fileFullPath.substr(startIndx).c_str());
+    if(!forceCompile && isSpirvUpToDate(m_fileFullPath, outputFile)){
+      exitCode = 0;
+    } else {
+      exitCode = RunGLSLCompiler(executable, m_fileFullPath.c_str(), outputFile.c_str(), m_fileFullPath.substr(startIndx).c_str());
+    }
 
     if(!exitCode){
       LOG_MSG(ERRLevel::INFO, "Successfully compiled")
       m_isCompiled = true;
       LOG_MSG(ERRLevel::INFO, "reading raw shader code from: %s", outputFile.c_str());
       m_rawShaderCode = ReadBinaryFile(outputFile);
-      m_shaderModule = CreateShaderModule(_device, *this);
     } else {
       m_isCompiled = false;
     }
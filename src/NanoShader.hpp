@@ -10,13 +10,17 @@
 class NanoShader{
     public:
         void Init(VkDevice& device, const std::string& shaderCodeFile);
-        int Compile(bool forceCompile = false);
+        void Init(const std::string& shaderCodeFile); // no device yet, only CompileSpirv can be used until CreateModule
+        int Compile(bool forceCompile = false); // CompileSpirv + CreateModule
+        // glslc to SPIR-V and load it, skipped when the .spv is newer than the source. Doesn't touch Vulkan, safe on any thread
+        int CompileSpirv(bool forceCompile = false);
+        void CreateModule(VkDevice& device);
         void CleanUp();
         bool IsCompiled(){return m_isCompiled;};
         std::vector<char>& GetByteCode(){return m_rawShaderCode;};
         VkShaderModule& GetShaderModule(){return m_shaderModule;};
     private:
-        VkDevice _device;
+        VkDevice _device{};
         std::string m_fileFullPath{};
         std::vector<char> m_rawShaderCode{};
         bool m_isCompiled = false;
@@ -0,0 +1,491 @@
+#include "NanoShaderReflection.hpp"
+#include "NanoLogger.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+// SPIR-V constants, from the SPIR-V specification (unified 1.6). Only what the reflection needs
+namespace SpirV {
+constexpr uint32_t MAGIC = 0x07230203;
+constexpr uint32_t HEADER_SIZE = 5;
+
+enum Op : uint32_t {
+    OpName = 5,
+    OpEntryPoint = 15,
+    OpTypeBool = 20,
+    OpTypeInt = 21,
+    OpTypeFloat = 22,
+    OpTypeVector = 23,
+    OpTypeMatrix = 24,
+    OpTypeImage = 25,
+    OpTypeSampler = 26,
+    OpTypeSampledImage = 27,
+    OpTypeArray = 28,
+    OpTypeRuntimeArray = 29,
+    OpTypeStruct = 30,
+    OpTypePointer = 32,
+    OpConstant = 43,
+    OpSpecConstantTrue = 48,
+    OpSpecConstantFalse = 49,
+    OpSpecConstant = 50,
+    OpVariable = 59,
+    OpDecorate = 71,
+    OpMemberDecorate = 72,
+    OpTypeAccelerationStructureKHR = 5341,
+};
+
+enum Decoration : uint32_t {
+    SpecId = 1,
+    Block = 2,
+    BufferBlock = 3,
+    ArrayStride = 6,
+    MatrixStride = 7,
+    BuiltIn = 11,
+    Location = 30,
+    Binding = 33,
+    DescriptorSet = 34,
+    Offset = 35,
+};
+
+enum StorageClass : uint32_t {
+    UniformConstant = 0,
+    Input = 1,
+    Uniform = 2,
+    PushConstant = 9,
+    StorageBuffer = 12,
+};
+
+enum ExecutionModel : uint32_t {
+    Vertex = 0,
+    TessellationControl = 1,
+    TessellationEvaluation = 2,
+    Geometry = 3,
+    Fragment = 4,
+    GLCompute = 5,
+};
+
+enum Dim : uint32_t {
+    DimBuffer = 5,
+    DimSubpassData = 6,
+};
+} // namespace SpirV
+
+struct SpirvId {
+    uint32_t opcode = 0;
+    std::vector<uint32_t> operands{}; // everything after the result id (or the whole instruction for types without one)
+    std::string name{};
+
+    // decorations
+    uint32_t set = UINT32_MAX;
+    uint32_t binding = UINT32_MAX;
+    uint32_t location = UINT32_MAX;
+    uint32_t specId = UINT32_MAX;
+    uint32_t arrayStride = 0;
+    bool isBlock = false;
+    bool isBufferBlock = false;
+    bool isBuiltIn = false;
+
+    // member decorations, for structs
+    std::vector<uint32_t> memberOffsets{};
+    std::vector<uint32_t> memberMatrixStrides{};
+};
+
+static VkShaderStageFlags toShaderStage(uint32_t executionModel) {
+    switch (executionModel) {
+    case SpirV::Vertex:
+        return VK_SHADER_STAGE_VERTEX_BIT;
+    case SpirV::TessellationControl:
+        return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+    case SpirV::TessellationEvaluation:
+        return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+    case SpirV::Geometry:
+        return VK_SHADER_STAGE_GEOMETRY_BIT;
+    case SpirV::Fragment:
+        return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case SpirV::GLCompute:
+        return VK_SHADER_STAGE_COMPUTE_BIT;
+    default:
+        return 0;
+    }
+}
+
+static std::string readString(const uint32_t* words, uint32_t wordCount) {
+    const char* str = reinterpret_cast<const char*>(words);
+    return std::string(str, strnlen(str, wordCount * sizeof(uint32_t)));
+}
+
+// size in bytes of a type, as laid out in memory (std140/std430/scalar offsets are already baked in the decorations)
+static uint32_t typeSize(const std::unordered_map<uint32_t, SpirvId>& ids, uint32_t typeId, uint32_t matrixStride = 0) {
+    auto it = ids.find(typeId);
+    if (it == ids.end()) {
+        return 0;
+    }
+    const SpirvId& type = it->second;
+
+    switch (type.opcode) {
+    case SpirV::OpTypeBool:
+        return 4;
+    case SpirV::OpTypeInt:
+    case SpirV::OpTypeFloat:
+        return type.operands[0] / 8;
+    case SpirV::OpTypeVector:
+        return typeSize(ids, type.operands[0]) * type.operands[1];
+    case SpirV::OpTypeMatrix: {
+        uint32_t columnSize = matrixStride ? matrixStride : typeSize(ids, type.operands[0]);
+        return columnSize * type.operands[1];
+    }
+    case SpirV::OpTypeArray: {
+        auto lengthIt = ids.find(type.operands[1]);
+        uint32_t length = lengthIt != ids.end() && !lengthIt->second.operands.empty() ? lengthIt->second.operands[1] : 0;
+        uint32_t stride = type.arrayStride ? type.arrayStride : typeSize(ids, type.operands[0], matrixStride);
+        return stride * length;
+    }
+    case SpirV::OpTypeStruct: {
+        uint32_t size = 0;
+        for (size_t member = 0; member < type.operands.size(); member++) {
+            uint32_t offset = member < type.memberOffsets.size() ? type.memberOffsets[member] : size;
+            uint32_t stride = member < type.memberMatrixStrides.size() ? type.memberMatrixStrides[member] : 0;
+            size = std::max(size, offset + typeSize(ids, type.operands[member], stride));
+        }
+        return size;
+    }
+    default:
+        return 0;
+    }
+}
+
+static VkFormat toVertexFormat(const std::unordered_map<uint32_t, SpirvId>& ids, uint32_t typeId) {
+    auto it = ids.find(typeId);
+    if (it == ids.end()) {
+        return VK_FORMAT_UNDEFINED;
+    }
+    const SpirvId& type = it->second;
+
+    uint32_t componentCount = 1;
+    const SpirvId* component = &type;
+    if (type.opcode == SpirV::OpTypeVector) {
+        componentCount = type.operands[1];
+        component = &ids.at(type.operands[0]);
+    }
+
+    if (component->opcode == SpirV::OpTypeFloat && component->operands[0] == 32) {
+        constexpr VkFormat formats[] = {VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT};
+        return formats[componentCount - 1];
+    }
+    if (component->opcode == SpirV::OpTypeInt && component->operands[0] == 32) {
+        bool isSigned = component->operands[1];
+        constexpr VkFormat sintFormats[] = {VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT};
+        constexpr VkFormat uintFormats[] = {VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT};
+        return isSigned ? sintFormats[componentCount - 1] : uintFormats[componentCount - 1];
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+static VkDescriptorType toDescriptorType(const std::unordered_map<uint32_t, SpirvId>& ids, uint32_t storageClass, const SpirvId& type) {
+    switch (storageClass) {
+    case SpirV::StorageBuffer:
+        return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    case SpirV::Uniform:
+        // old style storage buffers are Uniform + BufferBlock
+        return type.isBufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    case SpirV::UniformConstant:
+        break;
+    default:
+        return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+    }
+
+    switch (type.opcode) {
+    case SpirV::OpTypeSampler:
+        return VK_DESCRIPTOR_TYPE_SAMPLER;
+    case SpirV::OpTypeSampledImage:
+        return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    case SpirV::OpTypeImage: {
+        // operands: sampled type, dim, depth, arrayed, ms, sampled, format
+        uint32_t dim = type.operands[1];
+        uint32_t sampled = type.operands[5];
+        if (dim == SpirV::DimSubpassData) {
+            return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        }
+        if (dim == SpirV::DimBuffer) {
+            return sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+        }
+        return sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    }
+    case SpirV::OpTypeAccelerationStructureKHR:
+        return VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+    default:
+        return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+    }
+}
+
+ERR ReflectSpirv(const std::vector<char>& byteCode, ShaderReflection& reflection) {
+    reflection = {};
+
+    if (byteCode.size() < SpirV::HEADER_SIZE * sizeof(uint32_t) || byteCode.size() % sizeof(uint32_t) != 0) {
+        LOG_MSG(ERRLevel::WARNING, "SPIR-V reflection: byte code is too small or not word aligned");
+        return ERR::INVALID;
+    }
+
+    std::vector<uint32_t> words(byteCode.size() / sizeof(uint32_t));
+    memcpy(words.data(), byteCode.data(), byteCode.size());
+
+    if (words[0] != SpirV::MAGIC) {
+        LOG_MSG(ERRLevel::WARNING, "SPIR-V reflection: wrong magic number");
+        return ERR::INVALID;
+    }
+
+    std::unordered_map<uint32_t, SpirvId> ids{};
+    std::vector<uint32_t> variables{};
+
+    // first pass, collect every id we care about with its decorations
+    size_t offset = SpirV::HEADER_SIZE;
+    while (offset < words.size()) {
+        uint32_t wordCount = words[offset] >> 16;
+        uint32_t opcode = words[offset] & 0xFFFF;
+        if (wordCount == 0 || offset + wordCount > words.size()) {
+            LOG_MSG(ERRLevel::WARNING, "SPIR-V reflection: malformed instruction");
+            return ERR::INVALID;
+        }
+        const uint32_t* inst = &words[offset];
+
+        switch (opcode) {
+        case SpirV::OpEntryPoint:
+            reflection.stage |= toShaderStage(inst[1]);
+            break;
+        case SpirV::OpName:
+            ids[inst[1]].name = readString(inst + 2, wordCount - 2);
+            break;
+        case SpirV::OpDecorate: {
+            SpirvId& id = ids[inst[1]];
+            switch (inst[2]) {
+            case SpirV::DescriptorSet:
+                id.set = inst[3];
+                break;
+            case SpirV::Binding:
+                id.binding = inst[3];
+                break;
+            case SpirV::Location:
+                id.location = inst[3];
+                break;
+            case SpirV::SpecId:
+                id.specId = inst[3];
+                break;
+            case SpirV::ArrayStride:
+                id.arrayStride = inst[3];
+                break;
+            case SpirV::Block:
+                id.isBlock = true;
+                break;
+            case SpirV::BufferBlock:
+                id.isBufferBlock = true;
+                break;
+            case SpirV::BuiltIn:
+                id.isBuiltIn = true;
+                break;
+            }
+            break;
+        }
+        case SpirV::OpMemberDecorate: {
+            SpirvId& id = ids[inst[1]];
+            uint32_t member = inst[2];
+            if (inst[3] == SpirV::Offset) {
+                id.memberOffsets.resize(std::max<size_t>(id.memberOffsets.size(), member + 1), 0);
+                id.memberOffsets[member] = inst[4];
+            } else if (inst[3] == SpirV::MatrixStride) {
+                id.memberMatrixStrides.resize(std::max<size_t>(id.memberMatrixStrides.size(), member + 1), 0);
+                id.memberMatrixStrides[member] = inst[4];
+            } else if (inst[3] == SpirV::BuiltIn) {
+                id.isBuiltIn = true; // gl_PerVertex style blocks
+            }
+            break;
+        }
+        case SpirV::OpTypeBool:
+        case SpirV::OpTypeInt:
+        case SpirV::OpTypeFloat:
+        case SpirV::OpTypeVector:
+        case SpirV::OpTypeMatrix:
+        case SpirV::OpTypeImage:
+        case SpirV::OpTypeSampler:
+        case SpirV::OpTypeSampledImage:
+        case SpirV::OpTypeArray:
+        case SpirV::OpTypeRuntimeArray:
+        case SpirV::OpTypeStruct:
+        case SpirV::OpTypePointer:
+        case SpirV::OpTypeAccelerationStructureKHR: {
+            SpirvId& id = ids[inst[1]];
+            id.opcode = opcode;
+            id.operands.assign(inst + 2, inst + wordCount);
+            break;
+        }
+        case SpirV::OpConstant:
+        case SpirV::OpSpecConstant:
+        case SpirV::OpSpecConstantTrue:
+        case SpirV::OpSpecConstantFalse: {
+            // operands[0] = result type, operands[1] = first word of the value
+            SpirvId& id = ids[inst[2]];
+            id.opcode = opcode;
+            id.operands.assign(inst + 1, inst + wordCount);
+            id.operands.erase(id.operands.begin() + 1); // drop the result id so the layout matches the types
+            break;
+        }
+        case SpirV::OpVariable: {
+            // result type, result id, storage class
+            SpirvId& id = ids[inst[2]];
+            id.opcode = opcode;
+            id.operands = {inst[1], inst[3]};
+            variables.push_back(inst[2]);
+            break;
+        }
+        default:
+            break;
+        }
+
+        offset += wordCount;
+    }
+
+    // second pass, resolve the variables to descriptors / push constants / vertex inputs
+    for (uint32_t variableId : variables) {
+        const SpirvId& variable = ids[variableId];
+        const uint32_t storageClass = variable.operands[1];
+
+        auto pointerIt = ids.find(variable.operands[0]);
+        if (pointerIt == ids.end() || pointerIt->second.opcode != SpirV::OpTypePointer) {
+            continue;
+        }
+        uint32_t typeId = pointerIt->second.operands[1];
+
+        if (storageClass == SpirV::PushConstant) {
+            const SpirvId& block = ids[typeId];
+            uint32_t firstOffset = block.memberOffsets.empty() ? 0 : *std::min_element(block.memberOffsets.begin(), block.memberOffsets.end());
+            VkPushConstantRange range{};
+            range.stageFlags = reflection.stage;
+            range.offset = firstOffset;
+            range.size = typeSize(ids, typeId) - firstOffset;
+            reflection.pushConstantRanges.push_back(range);
+            continue;
+        }
+
+        if (storageClass == SpirV::Input) {
+            if (!(reflection.stage & VK_SHADER_STAGE_VERTEX_BIT) || variable.isBuiltIn || ids[typeId].isBuiltIn ||
+                variable.location == UINT32_MAX) {
+                continue;
+            }
+            ReflectedVertexInput input{};
+            input.location = variable.location;
+            input.format = toVertexFormat(ids, typeId);
+            input.size = typeSize(ids, typeId);
+            input.name = variable.name;
+            reflection.vertexInputs.push_back(input);
+            continue;
+        }
+
+        if (variable.set == UINT32_MAX || variable.binding == UINT32_MAX) {
+            continue;
+        }
+
+        // unwrap arrays to get to the actual resource type
+        uint32_t descriptorCount = 1;
+        const SpirvId* type = &ids[typeId];
+        while (type->opcode == SpirV::OpTypeArray || type->opcode == SpirV::OpTypeRuntimeArray) {
+            if (type->opcode == SpirV::OpTypeRuntimeArray) {
+                descriptorCount = 0;
+            } else {
+                descriptorCount *= ids[type->operands[1]].operands[1];
+            }
+            type = &ids[type->operands[0]];
+        }
+
+        ReflectedDescriptorBinding binding{};
+        binding.set = variable.set;
+        binding.binding = variable.binding;
+        binding.descriptorType = toDescriptorType(ids, storageClass, *type);
+        binding.descriptorCount = descriptorCount;
+        binding.stageFlags = reflection.stage;
+        binding.name = variable.name;
+
+        if (binding.descriptorType == VK_DESCRIPTOR_TYPE_MAX_ENUM) {
+            LOG_MSG(ERRLevel::WARNING, "SPIR-V reflection: unsupported resource type for %s", binding.name.c_str());
+            continue;
+        }
+        reflection.descriptorBindings.push_back(binding);
+    }
+
+    for (auto& [id, spirvId] : ids) {
+        if (spirvId.specId == UINT32_MAX) {
+            continue;
+        }
+        ReflectedSpecializationConstant constant{};
+        constant.constantID = spirvId.specId;
+        constant.size = typeSize(ids, spirvId.operands.empty() ? 0 : spirvId.operands[0]);
+        constant.name = spirvId.name;
+        reflection.specializationConstants.push_back(constant);
+    }
+
+    std::sort(reflection.descriptorBindings.begin(), reflection.descriptorBindings.end(),
+              [](const ReflectedDescriptorBinding& a, const ReflectedDescriptorBinding& b) {
+                  return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+              });
+    std::sort(reflection.vertexInputs.begin(), reflection.vertexInputs.end(),
+              [](const ReflectedVertexInput& a, const ReflectedVertexInput& b) { return a.location < b.location; });
+    std::sort(reflection.specializationConstants.begin(), reflection.specializationConstants.end(),
+              [](const ReflectedSpecializationConstant& a, const ReflectedSpecializationConstant& b) { return a.constantID < b.constantID; });
+
+    return ERR::OK;
+}
+
+uint32_t ShaderReflection::GetSetCount() const {
+    return descriptorBindings.empty() ? 0 : descriptorBindings.back().set + 1;
+}
+
+ERR ShaderReflection::Merge(const ShaderReflection& other) {
+    ERR err = ERR::OK;
+    stage |= other.stage;
+
+    for (const auto& otherBinding : other.descriptorBindings) {
+        auto it = std::find_if(descriptorBindings.begin(), descriptorBindings.end(), [&](const ReflectedDescriptorBinding& binding) {
+            return binding.set == otherBinding.set && binding.binding == otherBinding.binding;
+        });
+        if (it == descriptorBindings.end()) {
+            descriptorBindings.push_back(otherBinding);
+            continue;
+        }
+        if (it->descriptorType != otherBinding.descriptorType) {
+            LOG_MSG(ERRLevel::WARNING, "SPIR-V reflection: set %d binding %d has a different type between stages", otherBinding.set,
+                    otherBinding.binding);
+            err = ERR::INVALID;
+        }
+        it->stageFlags |= otherBinding.stageFlags;
+        it->descriptorCount = std::max(it->descriptorCount, otherBinding.descriptorCount);
+    }
+    std::sort(descriptorBindings.begin(), descriptorBindings.end(), [](const ReflectedDescriptorBinding& a, const ReflectedDescriptorBinding& b) {
+        return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+    });
+
+    // a stage can only appear in one push constant range, so every stage shares a single range covering all blocks
+    for (const auto& otherRange : other.pushConstantRanges) {
+        if (pushConstantRanges.empty()) {
+            pushConstantRanges.push_back(otherRange);
+            continue;
+        }
+        VkPushConstantRange& range = pushConstantRanges.front();
+        uint32_t end = std::max(range.offset + range.size, otherRange.offset + otherRange.size);
+        range.offset = std::min(range.offset, otherRange.offset);
+        range.size = end - range.offset;
+        range.stageFlags |= otherRange.stageFlags;
+    }
+
+    if (!other.vertexInputs.empty()) {
+        vertexInputs = other.vertexInputs;
+    }
+
+    for (const auto& otherConstant : other.specializationConstants) {
+        auto it = std::find_if(specializationConstants.begin(), specializationConstants.end(),
+                               [&](const ReflectedSpecializationConstant& constant) { return constant.constantID == otherConstant.constantID; });
+        if (it == specializationConstants.end()) {
+            specializationConstants.push_back(otherConstant);
+        }
+    }
+
+    return err;
+}
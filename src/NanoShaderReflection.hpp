@@ -0,0 +1,49 @@
+#ifndef NANOSHADERREFLECTION_H_
+#define NANOSHADERREFLECTION_H_
+
+#include "NanoError.hpp"
+
+#include "vulkan/vulkan_core.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct ReflectedDescriptorBinding {
+    uint32_t set = 0;
+    uint32_t binding = 0;
+    VkDescriptorType descriptorType = VK_DESCRIPTOR_TYPE_MAX_ENUM;
+    uint32_t descriptorCount = 1; // 0 means runtime sized array
+    VkShaderStageFlags stageFlags = 0;
+    std::string name{};
+};
+
+struct ReflectedVertexInput {
+    uint32_t location = 0;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t size = 0; // in bytes
+    std::string name{};
+};
+
+struct ReflectedSpecializationConstant {
+    uint32_t constantID = 0;
+    uint32_t size = 0; // in bytes
+    std::string name{};
+};
+
+// Everything the pipeline layout and vertex input state need to know about one (or several merged) shader stage(s)
+struct ShaderReflection {
+    VkShaderStageFlags stage = 0;
+    std::vector<ReflectedDescriptorBinding> descriptorBindings{}; // sorted by set, then binding
+    std::vector<VkPushConstantRange> pushConstantRanges{};
+    std::vector<ReflectedVertexInput> vertexInputs{};           // vertex stage only, sorted by location
+    std::vector<ReflectedSpecializationConstant> specializationConstants{};
+
+    uint32_t GetSetCount() const;
+    // stage flags are or'ed together when a binding or push constant block is used by more than one stage
+    ERR Merge(const ShaderReflection& other);
+};
+
+// walks the SPIR-V module and extracts the resource interface. No external dependency, only the opcodes we need are decoded
+ERR ReflectSpirv(const std::vector<char>& byteCode, ShaderReflection& reflection);
+
+#endif // NANOSHADERREFLECTION_H_
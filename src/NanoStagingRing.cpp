@@ -0,0 +1,184 @@
+#include "NanoStagingRing.hpp"
+#include "NanoLogger.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+ERR NanoStagingRing::Init(VkDevice& device, const VkPhysicalDevice& physicalDevice, const VkQueue& queue, uint32_t queueFamilyIndex,
+                          VkDeviceSize size) {
+    ERR err = ERR::OK;
+    _device = device;
+    _queue = queue;
+    m_capacity = size;
+
+    err = m_buffer.Init(device, physicalDevice, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = queueFamilyIndex;
+
+    if (vkCreateCommandPool(_device, &poolInfo, nullptr, &m_uploadPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create staging command pool!");
+    }
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = m_uploadPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(_device, &allocInfo, &m_uploadCommandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate staging command buffer!");
+    }
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(_device, &fenceInfo, nullptr, &m_uploadFence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create staging fence!");
+    }
+
+    return err;
+}
+
+void NanoStagingRing::CleanUp() {
+    if (m_isRecording) {
+        Flush();
+    }
+    vkDestroyFence(_device, m_uploadFence, nullptr);
+    vkDestroyCommandPool(_device, m_uploadPool, nullptr);
+    m_buffer.CleanUp();
+}
+
+bool NanoStagingRing::Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset, void*& mappedData) {
+    uint64_t position = (m_head + alignment - 1) / alignment * alignment;
+
+    // an allocation never straddles the end of the buffer, skip to the start instead
+    if (position % m_capacity + size > m_capacity) {
+        position += m_capacity - position % m_capacity;
+    }
+
+    if (size > m_capacity || position + size - m_tail > m_capacity) {
+        return false;
+    }
+
+    m_head = position + size;
+    offset = position % m_capacity;
+    mappedData = static_cast<uint8_t*>(m_buffer.GetMappedData()) + offset;
+    return true;
+}
+
+void NanoStagingRing::BeginFrame() {
+    // frame N - MAX_FRAMES_IN_FLIGHT used the same fence we just waited on, it and everything before it is done
+    if (m_frameNumber > 0) {
+        m_frameMarkers.push_back({m_frameNumber - 1, m_head});
+    }
+
+    while (!m_frameMarkers.empty() && m_frameMarkers.front().frameNumber + Config::MAX_FRAMES_IN_FLIGHT <= m_frameNumber) {
+        m_tail = std::max(m_tail, m_frameMarkers.front().head);
+        m_frameMarkers.pop_front();
+    }
+
+    m_frameNumber++;
+}
+
+VkCommandBuffer& NanoStagingRing::beginUploadCommands() {
+    if (!m_isRecording) {
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        if (vkBeginCommandBuffer(m_uploadCommandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording staging command buffer!");
+        }
+        m_isRecording = true;
+    }
+    return m_uploadCommandBuffer;
+}
+
+ERR NanoStagingRing::UploadBuffer(const VkBuffer& dst, VkDeviceSize dstOffset, const void* src, VkDeviceSize size) {
+    ERR err = ERR::OK;
+    const uint8_t* source = static_cast<const uint8_t*>(src);
+    const VkDeviceSize chunkSize = m_capacity / 2; // leave room for frame uploads that might be in flight
+
+    while (size > 0) {
+        VkDeviceSize copySize = std::min(size, chunkSize);
+        VkDeviceSize offset = 0;
+        void* mappedData = nullptr;
+
+        if (!Allocate(copySize, 16, offset, mappedData)) {
+            err = Flush();
+            if (!Allocate(copySize, 16, offset, mappedData)) {
+                LOG_MSG(ERRLevel::WARNING, "staging ring is too small for upload");
+                return ERR::INVALID;
+            }
+        }
+
+        memcpy(mappedData, source, copySize);
+
+        VkBufferCopy copyRegion{};
+        copyRegion.srcOffset = offset;
+        copyRegion.dstOffset = dstOffset;
+        copyRegion.size = copySize;
+        vkCmdCopyBuffer(beginUploadCommands(), m_buffer.GetBuffer(), dst, 1, &copyRegion);
+
+        source += copySize;
+        dstOffset += copySize;
+        size -= copySize;
+    }
+
+    return err;
+}
+
+void NanoStagingRing::CopyBuffer(const VkBuffer& src, const VkBuffer& dst, uint32_t regionCount, const VkBufferCopy* regions) {
+    if (regionCount == 0) {
+        return;
+    }
+    // src may have just been written by an earlier copy, and dst still be read by one
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(beginUploadCommands(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0,
+                         nullptr);
+    vkCmdCopyBuffer(m_uploadCommandBuffer, src, dst, regionCount, regions);
+}
+
+ERR NanoStagingRing::Flush() {
+    if (!m_isRecording) {
+        return ERR::OK;
+    }
+
+    // later submissions read the uploaded data as vertex/index/storage data
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    vkCmdPipelineBarrier(m_uploadCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr,
+                         0, nullptr);
+
+    if (vkEndCommandBuffer(m_uploadCommandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record staging command buffer!");
+    }
+    m_isRecording = false;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &m_uploadCommandBuffer;
+
+    if (vkQueueSubmit(_queue, 1, &submitInfo, m_uploadFence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit staging command buffer!");
+    }
+
+    // load time path: everything submitted before is done once the queue is idle, so the whole ring is free again
+    vkQueueWaitIdle(_queue);
+    vkResetFences(_device, 1, &m_uploadFence);
+    vkResetCommandBuffer(m_uploadCommandBuffer, 0);
+    m_tail = m_head;
+    m_frameMarkers.clear();
+
+    return ERR::OK;
+}
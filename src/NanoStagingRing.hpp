@@ -0,0 +1,61 @@
+#ifndef NANOSTAGINGRING_H_
+#define NANOSTAGINGRING_H_
+
+#include "NanoBuffer.hpp"
+#include "NanoConfig.hpp"
+#include "NanoError.hpp"
+
+#include "vulkan/vulkan_core.h"
+#include <cstdint>
+#include <deque>
+
+// Persistently mapped host visible ring used for every CPU -> GPU copy.
+// Frame uploads are reclaimed once the frame's fence has been waited on (BeginFrame).
+// Load time uploads (UploadBuffer) are batched in an internal command buffer and flushed when the ring fills up.
+class NanoStagingRing {
+  public:
+    ERR Init(VkDevice& device, const VkPhysicalDevice& physicalDevice, const VkQueue& queue, uint32_t queueFamilyIndex, VkDeviceSize size);
+    void CleanUp();
+
+    // reserve size bytes in the ring. Returns false when the ring is full, nothing is reserved in that case
+    bool Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset, void*& mappedData);
+    // must be called right after the frame's inFlightFence has been waited on
+    void BeginFrame();
+
+    // copies src into the ring and records the copy to dst. Large uploads are split and flushed as the ring fills up
+    ERR UploadBuffer(const VkBuffer& dst, VkDeviceSize dstOffset, const void* src, VkDeviceSize size);
+    // device side copy recorded with the load time uploads, after everything recorded before it. Submitted by Flush
+    void CopyBuffer(const VkBuffer& src, const VkBuffer& dst, uint32_t regionCount, const VkBufferCopy* regions);
+    // submits every pending UploadBuffer copy and waits for it
+    ERR Flush();
+
+    VkBuffer& GetBuffer() { return m_buffer.GetBuffer(); }
+    VkDeviceSize GetCapacity() { return m_capacity; }
+    VkDeviceSize GetUsedBytes() { return m_head - m_tail; }
+
+  private:
+    struct FrameMarker {
+        uint64_t frameNumber;
+        uint64_t head;
+    };
+
+    VkCommandBuffer& beginUploadCommands();
+
+    VkDevice _device{};
+    VkQueue _queue{};
+    NanoBuffer m_buffer{};
+    VkDeviceSize m_capacity = 0;
+
+    // monotonic offsets, the position in the buffer is offset % capacity
+    uint64_t m_head = 0;
+    uint64_t m_tail = 0;
+    uint64_t m_frameNumber = 0;
+    std::deque<FrameMarker> m_frameMarkers{};
+
+    VkCommandPool m_uploadPool{};
+    VkCommandBuffer m_uploadCommandBuffer{};
+    VkFence m_uploadFence{};
+    bool m_isRecording = false;
+};
+
+#endif // NANOSTAGINGRING_H_
@@ -0,0 +1,181 @@
+#include "NanoTaskGraph.hpp"
+#include "NanoLogger.hpp"
+
+#include <algorithm>
+#include <thread>
+
+NanoTaskGraph::TaskID NanoTaskGraph::AddTask(const std::string& name, std::function<void()> function, NanoTaskAffinity affinity) {
+    auto task = std::make_unique<Task>();
+    task->name = name;
+    task->function = std::move(function);
+    task->affinity = affinity;
+    m_tasks.push_back(std::move(task));
+    return static_cast<TaskID>(m_tasks.size() - 1);
+}
+
+void NanoTaskGraph::AddDependency(TaskID task, TaskID dependsOn) {
+    ASSERT(task < m_tasks.size() && dependsOn < m_tasks.size(), "task graph dependency on an unknown task");
+    m_tasks[dependsOn]->dependents.push_back(task);
+    m_tasks[task]->dependencyCount++;
+}
+
+void NanoTaskGraph::Schedule(TaskID task) {
+    if (m_tasks[task]->affinity == NanoTaskAffinity::MAIN_THREAD) {
+        std::lock_guard<std::mutex> lock(m_mainThreadMutex);
+        m_mainThreadTasks.push_back(task);
+        return;
+    }
+    _jobSystem->Run([this, task]() { Execute(task); });
+}
+
+void NanoTaskGraph::Execute(TaskID taskID) {
+    Task& task = *m_tasks[taskID];
+    NanoTaskTiming& timing = m_timings[taskID];
+
+    auto start = std::chrono::steady_clock::now();
+    // once something failed, whatever is left is skipped but still walked, so the graph drains and Run can return
+    if (!m_failed.load(std::memory_order_acquire)) {
+        try {
+            task.function();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(m_exceptionMutex);
+            if (!m_exception) {
+                m_exception = std::current_exception();
+            }
+            m_failed.store(true, std::memory_order_release);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    timing.startMs = std::chrono::duration<double, std::milli>(start - m_start).count();
+    timing.durationMs = std::chrono::duration<double, std::milli>(end - start).count();
+    timing.threadIndex = NanoJobSystem::GetThreadIndex();
+
+    for (TaskID dependent : task.dependents) {
+        if (m_tasks[dependent]->remainingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            Schedule(dependent);
+        }
+    }
+    m_pendingTasks.fetch_sub(1, std::memory_order_release);
+}
+
+ERR NanoTaskGraph::Run(NanoJobSystem& jobSystem) {
+    _jobSystem = &jobSystem;
+
+    // Kahn's algorithm, a cycle would leave Run waiting forever
+    {
+        std::vector<uint32_t> remaining(m_tasks.size());
+        std::vector<TaskID> ready{};
+        for (TaskID i = 0; i < m_tasks.size(); i++) {
+            remaining[i] = m_tasks[i]->dependencyCount;
+            if (remaining[i] == 0) {
+                ready.push_back(i);
+            }
+        }
+        size_t visited = 0;
+        while (!ready.empty()) {
+            TaskID task = ready.back();
+            ready.pop_back();
+            visited++;
+            for (TaskID dependent : m_tasks[task]->dependents) {
+                if (--remaining[dependent] == 0) {
+                    ready.push_back(dependent);
+                }
+            }
+        }
+        if (visited != m_tasks.size()) {
+            LOG_MSG(ERRLevel::WARNING, "task graph has a dependency cycle, nothing was run");
+            return ERR::INVALID;
+        }
+    }
+
+    m_timings.assign(m_tasks.size(), {});
+    for (TaskID i = 0; i < m_tasks.size(); i++) {
+        m_timings[i].name = m_tasks[i]->name;
+        m_tasks[i]->remainingDependencies.store(m_tasks[i]->dependencyCount, std::memory_order_relaxed);
+    }
+    m_pendingTasks.store(static_cast<uint32_t>(m_tasks.size()), std::memory_order_relaxed);
+    m_failed.store(false);
+    m_exception = nullptr;
+    m_start = std::chrono::steady_clock::now();
+
+    for (TaskID i = 0; i < m_tasks.size(); i++) {
+        if (m_tasks[i]->dependencyCount == 0) {
+            Schedule(i);
+        }
+    }
+
+    while (m_pendingTasks.load(std::memory_order_acquire) > 0) {
+        TaskID mainThreadTask = UINT32_MAX;
+        {
+            std::lock_guard<std::mutex> lock(m_mainThreadMutex);
+            if (!m_mainThreadTasks.empty()) {
+                mainThreadTask = m_mainThreadTasks.back();
+                m_mainThreadTasks.pop_back();
+            }
+        }
+
+        if (mainThreadTask != UINT32_MAX) {
+            Execute(mainThreadTask);
+        } else if (!jobSystem.RunPendingJob()) {
+            std::this_thread::yield();
+        }
+    }
+
+    m_totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+
+    if (m_exception) {
+        std::rethrow_exception(m_exception);
+    }
+    return ERR::OK;
+}
+
+double NanoTaskGraph::GetSequentialTime() {
+    double total = 0.0;
+    for (const auto& timing : m_timings) {
+        total += timing.durationMs;
+    }
+    return total;
+}
+
+double NanoTaskGraph::GetCriticalPathTime() {
+    // longest finish time over a topological walk, using the measured durations
+    std::vector<double> finish(m_tasks.size(), 0.0);
+    std::vector<uint32_t> remaining(m_tasks.size());
+    std::vector<TaskID> ready{};
+    for (TaskID i = 0; i < m_tasks.size(); i++) {
+        remaining[i] = m_tasks[i]->dependencyCount;
+        if (remaining[i] == 0) {
+            ready.push_back(i);
+        }
+    }
+
+    double longest = 0.0;
+    while (!ready.empty()) {
+        TaskID task = ready.back();
+        ready.pop_back();
+        finish[task] += m_timings.size() > task ? m_timings[task].durationMs : 0.0;
+        longest = std::max(longest, finish[task]);
+        for (TaskID dependent : m_tasks[task]->dependents) {
+            finish[dependent] = std::max(finish[dependent], finish[task]);
+            if (--remaining[dependent] == 0) {
+                ready.push_back(dependent);
+            }
+        }
+    }
+    return longest;
+}
+
+void NanoTaskGraph::LogReport(const char* title) {
+    std::vector<const NanoTaskTiming*> ordered{};
+    for (const auto& timing : m_timings) {
+        ordered.push_back(&timing);
+    }
+    std::sort(ordered.begin(), ordered.end(), [](const NanoTaskTiming* a, const NanoTaskTiming* b) { return a->startMs < b->startMs; });
+
+    LOG_MSG(ERRLevel::INFO, "%s: %f ms (sequential %f ms, critical path %f ms)", title, m_totalMs, GetSequentialTime(), GetCriticalPathTime());
+    for (const NanoTaskTiming* timing : ordered) {
+        LOG_MSG(ERRLevel::INFO, "    %s: start %f ms, took %f ms, thread %d", timing->name.c_str(), timing->startMs, timing->durationMs,
+                static_cast<int>(timing->threadIndex));
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef NANOTASKGRAPH_H_
+#define NANOTASKGRAPH_H_
+
+#include "NanoError.hpp"
+#include "NanoJobSystem.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class NanoTaskAffinity {
+    ANY,
+    MAIN_THREAD, // e.g. GLFW window creation, only ever runs on the thread that calls Run
+};
+
+struct NanoTaskTiming {
+    std::string name{};
+    double startMs = 0.0; // since Run was called
+    double durationMs = 0.0;
+    uint32_t threadIndex = 0;
+};
+
+// One shot dependency graph on top of the job system. Every task starts as soon as all the tasks it depends on are done,
+// so independent stages overlap without anyone having to order them by hand. Each task is timed
+class NanoTaskGraph {
+  public:
+    using TaskID = uint32_t;
+
+    TaskID AddTask(const std::string& name, std::function<void()> function, NanoTaskAffinity affinity = NanoTaskAffinity::ANY);
+    void AddDependency(TaskID task, TaskID dependsOn);
+
+    // must be called from the thread that owns the job system (thread 0), which helps with the work until the graph is done.
+    // An exception thrown by a task skips every task that hasn't started yet, and is rethrown here once the graph drained
+    ERR Run(NanoJobSystem& jobSystem);
+
+    const std::vector<NanoTaskTiming>& GetTimings() { return m_timings; }
+    double GetTotalTime() { return m_totalMs; } // wall clock
+    double GetSequentialTime();                  // sum of every task, what running them one after the other would cost
+    double GetCriticalPathTime();                // longest dependency chain, the floor for any amount of threads
+    void LogReport(const char* title);
+
+  private:
+    struct Task {
+        std::string name{};
+        std::function<void()> function{};
+        NanoTaskAffinity affinity = NanoTaskAffinity::ANY;
+        std::vector<TaskID> dependents{};
+        uint32_t dependencyCount = 0;
+        std::atomic<uint32_t> remainingDependencies{0};
+    };
+
+    void Schedule(TaskID task);
+    void Execute(TaskID task);
+
+    std::vector<std::unique_ptr<Task>> m_tasks{};
+    std::vector<NanoTaskTiming> m_timings{};
+    double m_totalMs = 0.0;
+
+    NanoJobSystem* _jobSystem = nullptr;
+    std::chrono::steady_clock::time_point m_start{};
+    std::atomic<uint32_t> m_pendingTasks{0};
+
+    std::mutex m_mainThreadMutex{};
+    std::vector<TaskID> m_mainThreadTasks{};
+
+    std::mutex m_exceptionMutex{};
+    std::exception_ptr m_exception{};
+    std::atomic<bool> m_failed{false};
+};
+
+#endif // NANOTASKGRAPH_H_
@@ -0,0 +1,273 @@
+#include "NanoTransformHierarchy.hpp"
+#include "NanoLogger.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+static constexpr uint32_t NO_INDEX = UINT32_MAX;
+
+NanoNodeID NanoTransformHierarchy::AddNode(NanoNodeID parent) {
+    ASSERT(parent == NANO_INVALID_NODE || IsValid(parent), "transform parent does not exist");
+
+    NanoNodeID node{};
+    if (!m_freeNodes.empty()) {
+        node = m_freeNodes.back();
+        m_freeNodes.pop_back();
+    } else {
+        node = static_cast<NanoNodeID>(m_nodeToIndex.size());
+        m_nodeToIndex.push_back(NO_INDEX);
+    }
+
+    // appended for now, Update sorts it into its level
+    uint32_t index = static_cast<uint32_t>(m_indexToNode.size());
+    m_nodeToIndex[node] = index;
+    m_positions.emplace_back(0.0f);
+    m_rotations.emplace_back(1.0f, 0.0f, 0.0f, 0.0f);
+    m_scales.emplace_back(1.0f);
+    m_worldMatrices.emplace_back(1.0f);
+    m_parents.push_back(parent);
+    m_parentIndices.push_back(parent == NANO_INVALID_NODE ? NO_INDEX : m_nodeToIndex[parent]);
+    m_dirty.push_back(1);
+    m_updated.push_back(0);
+    m_indexToNode.push_back(node);
+
+    m_dirtyCount++;
+    m_layoutDirty = true;
+    return node;
+}
+
+void NanoTransformHierarchy::RemoveNode(NanoNodeID node) {
+    ASSERT(IsValid(node), "removing a transform that does not exist");
+
+    // 0 unknown, 1 kept, 2 removed. Walks up from every node until it hits a known answer, so each chain is only walked once
+    uint32_t count = static_cast<uint32_t>(m_indexToNode.size());
+    std::vector<uint8_t> state(count, 0);
+    std::vector<uint32_t> chain{};
+    uint32_t target = m_nodeToIndex[node];
+    for (uint32_t i = 0; i < count; i++) {
+        if (m_nodeToIndex[m_indexToNode[i]] != i) {
+            continue; // already removed, waiting for the next rebuild
+        }
+        uint32_t current = i;
+        uint8_t result = 1;
+        chain.clear();
+        while (current != NO_INDEX) {
+            if (state[current] != 0) {
+                result = state[current];
+                break;
+            }
+            chain.push_back(current);
+            if (current == target) {
+                result = 2;
+                break;
+            }
+            current = m_parentIndices[current];
+        }
+        for (uint32_t index : chain) {
+            state[index] = result;
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (state[i] == 2) {
+            m_nodeToIndex[m_indexToNode[i]] = NO_INDEX;
+            m_freeNodes.push_back(m_indexToNode[i]);
+        }
+    }
+    m_layoutDirty = true;
+}
+
+void NanoTransformHierarchy::SetParent(NanoNodeID node, NanoNodeID parent) {
+    ASSERT(IsValid(node) && (parent == NANO_INVALID_NODE || IsValid(parent)), "transform parent does not exist");
+
+    uint32_t index = m_nodeToIndex[node];
+    uint32_t parentIndex = parent == NANO_INVALID_NODE ? NO_INDEX : m_nodeToIndex[parent];
+    for (uint32_t ancestor = parentIndex; ancestor != NO_INDEX; ancestor = m_parentIndices[ancestor]) {
+        if (ancestor == index) {
+            LOG_MSG(ERRLevel::WARNING, "transform can't be parented to one of its own children");
+            return;
+        }
+    }
+
+    m_parents[index] = parent;
+    m_parentIndices[index] = parentIndex;
+    MarkDirty(index);
+    m_layoutDirty = true;
+}
+
+void NanoTransformHierarchy::Clear() {
+    *this = NanoTransformHierarchy{};
+}
+
+void NanoTransformHierarchy::MarkDirty(uint32_t index) {
+    if (!m_dirty[index]) {
+        m_dirty[index] = 1;
+        m_dirtyCount++;
+    }
+}
+
+void NanoTransformHierarchy::SetPosition(NanoNodeID node, const glm::vec3& position) {
+    uint32_t index = m_nodeToIndex[node];
+    m_positions[index] = position;
+    MarkDirty(index);
+}
+
+void NanoTransformHierarchy::SetRotation(NanoNodeID node, const glm::quat& rotation) {
+    uint32_t index = m_nodeToIndex[node];
+    m_rotations[index] = rotation;
+    MarkDirty(index);
+}
+
+void NanoTransformHierarchy::SetScale(NanoNodeID node, const glm::vec3& scale) {
+    uint32_t index = m_nodeToIndex[node];
+    m_scales[index] = scale;
+    MarkDirty(index);
+}
+
+void NanoTransformHierarchy::SetLocalTransform(NanoNodeID node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+    uint32_t index = m_nodeToIndex[node];
+    m_positions[index] = position;
+    m_rotations[index] = rotation;
+    m_scales[index] = scale;
+    MarkDirty(index);
+}
+
+// counting sort of the live nodes by depth, stable so siblings keep their relative order between rebuilds
+void NanoTransformHierarchy::Rebuild() {
+    uint32_t count = static_cast<uint32_t>(m_indexToNode.size());
+
+    std::vector<uint32_t> depths(count, NO_INDEX);
+    std::vector<uint32_t> chain{};
+    uint32_t levelCount = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (m_nodeToIndex[m_indexToNode[i]] != i) {
+            continue;
+        }
+        // walk up to the first node that already knows its depth, then fill the chain back in
+        uint32_t current = i;
+        chain.clear();
+        while (current != NO_INDEX && depths[current] == NO_INDEX) {
+            chain.push_back(current);
+            current = m_parentIndices[current];
+        }
+        uint32_t depth = current == NO_INDEX ? 0 : depths[current] + 1;
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+            depths[*it] = depth++;
+        }
+        levelCount = std::max(levelCount, depths[i] + 1);
+    }
+
+    m_levelOffsets.assign(levelCount + 1, 0);
+    for (uint32_t i = 0; i < count; i++) {
+        if (depths[i] != NO_INDEX) {
+            m_levelOffsets[depths[i] + 1]++;
+        }
+    }
+    for (uint32_t level = 0; level < levelCount; level++) {
+        m_levelOffsets[level + 1] += m_levelOffsets[level];
+    }
+
+    uint32_t liveCount = m_levelOffsets[levelCount];
+    std::vector<uint32_t> newIndices(count, NO_INDEX);
+    std::vector<uint32_t> cursor(m_levelOffsets.begin(), m_levelOffsets.end() - 1);
+    for (uint32_t i = 0; i < count; i++) {
+        if (depths[i] != NO_INDEX) {
+            newIndices[i] = cursor[depths[i]]++;
+        }
+    }
+
+    auto permute = [&](auto& values) {
+        std::remove_reference_t<decltype(values)> sorted(liveCount);
+        for (uint32_t i = 0; i < count; i++) {
+            if (newIndices[i] != NO_INDEX) {
+                sorted[newIndices[i]] = values[i];
+            }
+        }
+        values.swap(sorted);
+    };
+    permute(m_positions);
+    permute(m_rotations);
+    permute(m_scales);
+    permute(m_worldMatrices);
+    permute(m_parents);
+    permute(m_parentIndices);
+    permute(m_dirty);
+    permute(m_indexToNode);
+    m_updated.assign(liveCount, 0);
+
+    m_dirtyCount = 0;
+    for (uint32_t i = 0; i < liveCount; i++) {
+        m_nodeToIndex[m_indexToNode[i]] = i;
+        if (m_parentIndices[i] != NO_INDEX) {
+            m_parentIndices[i] = newIndices[m_parentIndices[i]];
+        }
+        m_dirtyCount += m_dirty[i];
+    }
+
+    m_layoutDirty = false;
+    m_layoutVersion++;
+}
+
+uint32_t NanoTransformHierarchy::UpdateRange(uint32_t begin, uint32_t end) {
+    uint32_t updatedCount = 0;
+    for (uint32_t i = begin; i < end; i++) {
+        uint32_t parent = m_parentIndices[i];
+        // parents are one level up, so their flag is already final for this update
+        bool update = m_dirty[i] || (parent != NO_INDEX && m_updated[parent]);
+        m_updated[i] = update;
+        if (!update) {
+            continue;
+        }
+
+        // T * R * S without going through three full matrix products
+        const glm::vec3& scale = m_scales[i];
+        glm::mat4 local = glm::mat4_cast(m_rotations[i]);
+        local[0] *= scale.x;
+        local[1] *= scale.y;
+        local[2] *= scale.z;
+        local[3] = glm::vec4(m_positions[i], 1.0f);
+
+        if (parent == NO_INDEX) {
+            m_worldMatrices[i] = local;
+        } else {
+            // both are affine, the bottom row never has to be multiplied in
+            const glm::mat4& world = m_worldMatrices[parent];
+            glm::mat4& result = m_worldMatrices[i];
+            result[0] = world[0] * local[0].x + world[1] * local[0].y + world[2] * local[0].z;
+            result[1] = world[0] * local[1].x + world[1] * local[1].y + world[2] * local[1].z;
+            result[2] = world[0] * local[2].x + world[1] * local[2].y + world[2] * local[2].z;
+            result[3] = world[0] * local[3].x + world[1] * local[3].y + world[2] * local[3].z + world[3];
+        }
+        m_dirty[i] = 0;
+        updatedCount++;
+    }
+    return updatedCount;
+}
+
+void NanoTransformHierarchy::Update(NanoJobSystem& jobSystem) {
+    if (m_layoutDirty) {
+        Rebuild();
+    }
+
+    if (m_dirtyCount == 0) {
+        if (m_updatedCount != 0) {
+            std::memset(m_updated.data(), 0, m_updated.size());
+            m_updatedCount = 0;
+        }
+        return;
+    }
+
+    std::atomic<uint32_t> updatedCount{0};
+    for (uint32_t level = 0; level < GetLevelCount(); level++) {
+        uint32_t levelBegin = m_levelOffsets[level];
+        uint32_t levelSize = m_levelOffsets[level + 1] - levelBegin;
+        jobSystem.ParallelFor(levelSize, PARALLEL_MIN_CHUNK, [this, levelBegin, &updatedCount](uint32_t begin, uint32_t end) {
+            updatedCount.fetch_add(UpdateRange(levelBegin + begin, levelBegin + end), std::memory_order_relaxed);
+        });
+    }
+
+    m_updatedCount = updatedCount.load();
+    m_dirtyCount = 0;
+}
@@ -0,0 +1,82 @@
+#ifndef NANOTRANSFORMHIERARCHY_H_
+#define NANOTRANSFORMHIERARCHY_H_
+
+#include "NanoError.hpp"
+#include "NanoJobSystem.hpp"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include <cstdint>
+#include <vector>
+
+using NanoNodeID = uint32_t;
+static constexpr NanoNodeID NANO_INVALID_NODE = UINT32_MAX;
+
+// Scene transforms as structure of arrays, sorted by depth so every parent sits before its children and a whole depth level
+// is one contiguous range. Update only recomputes nodes that were changed and whatever is below them, one level after
+// the other, with every level split across the job system. World matrices end up packed in one array, ready to be copied
+// to the GPU as is.
+// Node ids are stable, array indices are not: they change whenever the hierarchy changes (see GetLayoutVersion)
+class NanoTransformHierarchy {
+  public:
+    static constexpr uint32_t PARALLEL_MIN_CHUNK = 512; // nodes, below that a level isn't worth splitting
+
+    NanoNodeID AddNode(NanoNodeID parent = NANO_INVALID_NODE);
+    void RemoveNode(NanoNodeID node); // and everything below it
+    void SetParent(NanoNodeID node, NanoNodeID parent);
+    void Clear();
+
+    void SetPosition(NanoNodeID node, const glm::vec3& position);
+    void SetRotation(NanoNodeID node, const glm::quat& rotation);
+    void SetScale(NanoNodeID node, const glm::vec3& scale);
+    void SetLocalTransform(NanoNodeID node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+
+    const glm::vec3& GetPosition(NanoNodeID node) { return m_positions[m_nodeToIndex[node]]; }
+    const glm::quat& GetRotation(NanoNodeID node) { return m_rotations[m_nodeToIndex[node]]; }
+    const glm::vec3& GetScale(NanoNodeID node) { return m_scales[m_nodeToIndex[node]]; }
+    NanoNodeID GetParent(NanoNodeID node) { return m_parents[m_nodeToIndex[node]]; }
+
+    // jobSystem may be left uninitialized, the update then runs on the calling thread
+    void Update(NanoJobSystem& jobSystem);
+
+    // only valid after Update
+    const glm::mat4& GetWorldMatrix(NanoNodeID node) { return m_worldMatrices[m_nodeToIndex[node]]; }
+    const glm::mat4* GetWorldMatrices() { return m_worldMatrices.data(); }
+    uint32_t GetWorldMatrixIndex(NanoNodeID node) { return m_nodeToIndex[node]; }
+    // nodes whose world matrix changed in the last Update, indexed like the world matrices
+    bool WasUpdated(uint32_t index) { return m_updated[index] != 0; }
+    uint32_t GetUpdatedCount() { return m_updatedCount; }
+
+    uint32_t GetCount() { return static_cast<uint32_t>(m_indexToNode.size()); }
+    uint32_t GetLevelCount() { return static_cast<uint32_t>(m_levelOffsets.size()) - 1; }
+    uint32_t GetLayoutVersion() { return m_layoutVersion; } // bumped every time the indices were shuffled
+    bool IsValid(NanoNodeID node) { return node < m_nodeToIndex.size() && m_nodeToIndex[node] != UINT32_MAX; }
+
+  private:
+    void MarkDirty(uint32_t index);
+    void Rebuild();
+    uint32_t UpdateRange(uint32_t begin, uint32_t end); // returns how many world matrices were written
+
+    // indexed by position in the depth sorted arrays
+    std::vector<glm::vec3> m_positions{};
+    std::vector<glm::quat> m_rotations{};
+    std::vector<glm::vec3> m_scales{};
+    std::vector<glm::mat4> m_worldMatrices{};
+    std::vector<NanoNodeID> m_parents{};
+    std::vector<uint32_t> m_parentIndices{}; // UINT32_MAX for roots
+    std::vector<uint8_t> m_dirty{};           // local transform changed since the last Update
+    std::vector<uint8_t> m_updated{};         // world matrix written by the last Update
+    std::vector<NanoNodeID> m_indexToNode{};
+
+    std::vector<uint32_t> m_nodeToIndex{}; // UINT32_MAX for free ids
+    std::vector<NanoNodeID> m_freeNodes{};
+
+    std::vector<uint32_t> m_levelOffsets{0}; // level i is [m_levelOffsets[i], m_levelOffsets[i + 1])
+    bool m_layoutDirty = false;               // nodes were added, removed or moved, the arrays need sorting again
+    uint32_t m_dirtyCount = 0;
+    uint32_t m_updatedCount = 0;
+    uint32_t m_layoutVersion = 0;
+};
+
+#endif // NANOTRANSFORMHIERARCHY_H_
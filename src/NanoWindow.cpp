@@ -47,6 +47,25 @@ GLFWwindow* NanoWindow::getGLFWwindow(){
     return m_isInit ? _NanoWindow.window : nullptr;
 }
 
+void NanoWindow::GetCursorPosition(double& x, double& y){
+    x = 0.0;
+    y = 0.0;
+    if(m_isInit){
+        glfwGetCursorPos(_NanoWindow.window, &x, &y);
+    }
+}
+
+void NanoWindow::GetWindowSize(int32_t& width, int32_t& height){
+    width = 0;
+    height = 0;
+    if(m_isInit){
+        int w = 0, h = 0;
+        glfwGetWindowSize(_NanoWindow.window, &w, &h);
+        width = w;
+        height = h;
+    }
+}
+
 ERR NanoWindow::CleanUp(){
     ERR err = ERR::OK;
     if(!m_isInit){
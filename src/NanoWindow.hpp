@@ -15,6 +15,9 @@ class NanoWindow {
     bool ShouldWindowClose();
     ERR CleanUp();
     GLFWwindow* getGLFWwindow();
+    // in screen coordinates, from the top left of the content area
+    void GetCursorPosition(double& x, double& y);
+    void GetWindowSize(int32_t& width, int32_t& height);
 
   private:
     bool m_isInit = false;
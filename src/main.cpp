@@ -1,4 +1,6 @@
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 #include "NanoError.hpp"
@@ -8,9 +10,42 @@
 int main(int argc, char *argv[]) {
     Logger::setSeverity(ERRLevel::INFO);
 
+    // --headless [WIDTHxHEIGHT] renders offscreen without a window, --frames N stops after N frames,
+    // --capture png|ppm|raw [PATH] writes every frame out, --profile PATH dumps CPU and GPU zones to PATH.csv and PATH.json
+    NanoEngineOptions options{};
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            options.headless.enabled = true;
+            unsigned width = 0, height = 0;
+            if (i + 1 < argc && sscanf(argv[i + 1], "%ux%u", &width, &height) == 2 && width > 0 && height > 0) {
+                options.headless.width = width;
+                options.headless.height = height;
+                i++;
+            }
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            options.frameCount = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            options.profilePath = argv[++i];
+        } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            const char* format = argv[++i];
+            options.capture = true;
+            if (strcmp(format, "ppm") == 0) {
+                options.captureOptions.format = NanoCaptureFormat::PPM;
+            } else if (strcmp(format, "raw") == 0) {
+                options.captureOptions.format = NanoCaptureFormat::RAW_VIDEO;
+            } else if (strcmp(format, "png") != 0) {
+                std::cerr << "unknown capture format: " << format << std::endl;
+                return EXIT_FAILURE;
+            }
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                options.captureOptions.path = argv[++i];
+            }
+        }
+    }
+
     NanoEngine engine;
     try {
-        engine.Init();
+        engine.Init(options);
         engine.Run();
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
@@ -0,0 +1,32 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// depth pre-pass of the GPU driven path. Position only stream of the mesh arena, same transform as indirect.vert: both
+// are invariant so the main pass can test EQUAL against what this wrote
+layout(location = 0) in vec3 inPosition;
+
+struct Instance {
+    mat4 world;
+    uint mesh;
+    uint material;
+    uint flags;
+    uint reserved;
+};
+
+layout(set = 0, binding = 2) readonly buffer InstanceBuffer { Instance instances[]; } instanceBuffers[];
+
+layout(push_constant) uniform DrawConstants {
+    // NanoMaterialIndices, storageBuffer is the instance buffer
+    uint sampledImage;
+    uint samplerIndex;
+    uint storageBuffer;
+    uint instance;
+    mat4 viewProjection;
+} draw;
+
+invariant gl_Position;
+
+void main() {
+    Instance instance = instanceBuffers[draw.storageBuffer].instances[gl_InstanceIndex];
+    gl_Position = draw.viewProjection * (instance.world * vec4(inPosition, 1.0));
+}
@@ -0,0 +1,11 @@
+#version 450
+
+layout(location = 0) in vec3 fragNormal;
+layout(location = 1) in vec2 fragUV;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    float light = max(dot(normalize(fragNormal), normalize(vec3(0.4, 1.0, 0.3))), 0.0);
+    outColor = vec4(vec3(0.15 + 0.85 * light), 1.0);
+}
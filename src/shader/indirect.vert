@@ -0,0 +1,40 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// NanoVertex, from the mesh arena
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inUV;
+
+struct Instance {
+    mat4 world;
+    uint mesh;
+    uint material;
+    uint flags;
+    uint reserved;
+};
+
+layout(set = 0, binding = 2) readonly buffer InstanceBuffer { Instance instances[]; } instanceBuffers[];
+
+layout(push_constant) uniform DrawConstants {
+    // NanoMaterialIndices, storageBuffer is the instance buffer
+    uint sampledImage;
+    uint samplerIndex;
+    uint storageBuffer;
+    uint instance;
+    mat4 viewProjection;
+} draw;
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) out vec2 fragUV;
+
+// the depth pre-pass computes the same position, the main pass tests EQUAL against it
+invariant gl_Position;
+
+void main() {
+    // firstInstance of the indirect command is the instance the culling pass kept
+    Instance instance = instanceBuffers[draw.storageBuffer].instances[gl_InstanceIndex];
+    gl_Position = draw.viewProjection * (instance.world * vec4(inPosition, 1.0));
+    fragNormal = mat3(instance.world) * inNormal;
+    fragUV = inUV;
+}
@@ -0,0 +1,21 @@
+#version 450
+
+// bounding box of an occlusion query, depth tested against the pre-pass without writing. No vertex buffer: 36 vertices
+// of the unit cube, whose [-1, 1] corners boxToClip moves onto the instance's bounding sphere
+layout(push_constant) uniform BoxConstants {
+    mat4 boxToClip;
+} box;
+
+// corner bits are x, y and z. Culling is off for this pipeline, so the winding doesn't matter
+const uint CORNERS[36] = uint[36](0, 2, 6, 0, 6, 4,  // -x
+                                  1, 5, 7, 1, 7, 3,  // +x
+                                  0, 4, 5, 0, 5, 1,  // -y
+                                  2, 3, 7, 2, 7, 6,  // +y
+                                  0, 1, 3, 0, 3, 2,  // -z
+                                  4, 6, 7, 4, 7, 5); // +z
+
+void main() {
+    uint corner = CORNERS[gl_VertexIndex];
+    vec3 position = vec3(corner & 1u, (corner >> 1) & 1u, (corner >> 2) & 1u) * 2.0 - 1.0;
+    gl_Position = box.boxToClip * vec4(position, 1.0);
+}
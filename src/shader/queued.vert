@@ -0,0 +1,40 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// instances drawn through the render queue (NanoGraphics::AddQueuedInstance). Same vertices and instance data as
+// indirect.vert, but the instance comes from the queue's per instance input: a batched run of draws of the same mesh
+// and material is one instanced draw, each instance reads its own entry of the scene buffer
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inUV;
+layout(location = 3) in uint inInstance; // Config::INSTANCE_VERTEX_BINDING
+
+struct Instance {
+    mat4 world;
+    uint mesh;
+    uint material;
+    uint flags;
+    uint reserved;
+};
+
+layout(set = 0, binding = 2) readonly buffer InstanceBuffer { Instance instances[]; } instanceBuffers[];
+
+layout(push_constant) uniform DrawConstants {
+    // NanoMaterialIndices, storageBuffer is the instance buffer. The render queue pushes these per material, the view
+    // projection is pushed once before the queue is recorded
+    uint sampledImage;
+    uint samplerIndex;
+    uint storageBuffer;
+    uint instance;
+    mat4 viewProjection;
+} draw;
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) out vec2 fragUV;
+
+void main() {
+    Instance instance = instanceBuffers[draw.storageBuffer].instances[inInstance];
+    gl_Position = draw.viewProjection * (instance.world * vec4(inPosition, 1.0));
+    fragNormal = mat3(instance.world) * inNormal;
+    fragUV = inUV;
+}
@@ -0,0 +1,42 @@
+#include "NanoLogger.hpp"
+#include "NanoMeshIO.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// NanoMeshConverter <input.obj|input.nmesh> <output.nmesh> [--quantize] [--index32]
+int main(int argc, char *argv[]) {
+    Logger::setSeverity(ERRLevel::INFO);
+
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <input.obj|input.nmesh> <output.nmesh> [--quantize] [--index32]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    NanoMeshWriteOptions options{};
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--quantize") == 0) {
+            options.quantize = true;
+        } else if (strcmp(argv[i], "--index32") == 0) {
+            options.forceIndex32 = true;
+        } else {
+            fprintf(stderr, "unknown option: %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    MeshData mesh{};
+    if (MeshIO::LoadMesh(argv[1], mesh) != ERR::OK) {
+        return EXIT_FAILURE;
+    }
+
+    if (MeshIO::WriteNanoMesh(argv[2], mesh, options) != ERR::OK) {
+        return EXIT_FAILURE;
+    }
+
+    size_t vertexBytes = mesh.vertices.size() * (options.quantize ? sizeof(NanoQuantizedVertex) : sizeof(NanoVertex));
+    LOG_MSG(ERRLevel::INFO, "wrote %s: %d vertices (%d bytes), %d indices", argv[2], static_cast<int>(mesh.vertices.size()),
+            static_cast<int>(vertexBytes), static_cast<int>(mesh.indices.size()));
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,312 @@
+#include "NanoMeshIO.hpp"
+#include "NanoLogger.hpp"
+#include "NanoMappedFile.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <tuple>
+
+namespace MeshIO {
+
+// obj indices are 1 based, negative ones are relative to the end of the current list
+static int resolveObjIndex(int index, size_t count) {
+    if (index > 0) {
+        return index - 1;
+    }
+    if (index < 0) {
+        return static_cast<int>(count) + index;
+    }
+    return -1;
+}
+
+static void generateNormals(MeshData& mesh) {
+    for (auto& vertex : mesh.vertices) {
+        vertex.normal[0] = vertex.normal[1] = vertex.normal[2] = 0.0f;
+    }
+
+    // area weighted face normals
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        NanoVertex& a = mesh.vertices[mesh.indices[i + 0]];
+        NanoVertex& b = mesh.vertices[mesh.indices[i + 1]];
+        NanoVertex& c = mesh.vertices[mesh.indices[i + 2]];
+        float e1[3] = {b.position[0] - a.position[0], b.position[1] - a.position[1], b.position[2] - a.position[2]};
+        float e2[3] = {c.position[0] - a.position[0], c.position[1] - a.position[1], c.position[2] - a.position[2]};
+        float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+        for (NanoVertex* v : {&a, &b, &c}) {
+            v->normal[0] += n[0];
+            v->normal[1] += n[1];
+            v->normal[2] += n[2];
+        }
+    }
+
+    for (auto& vertex : mesh.vertices) {
+        float length = std::sqrt(vertex.normal[0] * vertex.normal[0] + vertex.normal[1] * vertex.normal[1] + vertex.normal[2] * vertex.normal[2]);
+        if (length > 0.0f) {
+            vertex.normal[0] /= length;
+            vertex.normal[1] /= length;
+            vertex.normal[2] /= length;
+        } else {
+            vertex.normal[2] = 1.0f;
+        }
+    }
+}
+
+ERR LoadObj(const std::string& fileName, MeshData& mesh) {
+    std::ifstream file(fileName);
+    if (!file.is_open()) {
+        LOG_MSG(ERRLevel::WARNING, "could not open obj file: %s", fileName.c_str());
+        return ERR::NOT_FOUND;
+    }
+
+    std::vector<float> positions{};
+    std::vector<float> uvs{};
+    std::vector<float> normals{};
+    std::map<std::tuple<int, int, int>, uint32_t> uniqueVertices{};
+    bool hasNormals = true;
+
+    mesh = {};
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        std::string token;
+        stream >> token;
+
+        if (token == "v") {
+            float x = 0, y = 0, z = 0;
+            stream >> x >> y >> z;
+            positions.insert(positions.end(), {x, y, z});
+        } else if (token == "vt") {
+            float u = 0, v = 0;
+            stream >> u >> v;
+            uvs.insert(uvs.end(), {u, 1.0f - v}); // obj is bottom-left, vulkan is top-left
+        } else if (token == "vn") {
+            float x = 0, y = 0, z = 0;
+            stream >> x >> y >> z;
+            normals.insert(normals.end(), {x, y, z});
+        } else if (token == "f") {
+            std::vector<uint32_t> face{};
+            std::string corner;
+            while (stream >> corner) {
+                int v = 0, vt = 0, vn = 0;
+                if (sscanf(corner.c_str(), "%d/%d/%d", &v, &vt, &vn) != 3 && sscanf(corner.c_str(), "%d//%d", &v, &vn) != 2 &&
+                    sscanf(corner.c_str(), "%d/%d", &v, &vt) != 2 && sscanf(corner.c_str(), "%d", &v) != 1) {
+                    continue;
+                }
+                int positionIndex = resolveObjIndex(v, positions.size() / 3);
+                int uvIndex = resolveObjIndex(vt, uvs.size() / 2);
+                int normalIndex = resolveObjIndex(vn, normals.size() / 3);
+                if (positionIndex < 0 || positionIndex >= static_cast<int>(positions.size() / 3)) {
+                    LOG_MSG(ERRLevel::WARNING, "obj face references a missing position: %s", line.c_str());
+                    return ERR::INVALID;
+                }
+                hasNormals = hasNormals && normalIndex >= 0;
+
+                auto key = std::make_tuple(positionIndex, uvIndex, normalIndex);
+                auto it = uniqueVertices.find(key);
+                if (it == uniqueVertices.end()) {
+                    NanoVertex vertex{};
+                    for (int i = 0; i < 3; i++) {
+                        vertex.position[i] = positions[positionIndex * 3 + i];
+                        vertex.normal[i] = normalIndex >= 0 ? normals[normalIndex * 3 + i] : 0.0f;
+                    }
+                    if (uvIndex >= 0) {
+                        vertex.uv[0] = uvs[uvIndex * 2 + 0];
+                        vertex.uv[1] = uvs[uvIndex * 2 + 1];
+                    }
+                    it = uniqueVertices.emplace(key, static_cast<uint32_t>(mesh.vertices.size())).first;
+                    mesh.vertices.push_back(vertex);
+                }
+                face.push_back(it->second);
+            }
+
+            for (size_t i = 2; i < face.size(); i++) {
+                mesh.indices.insert(mesh.indices.end(), {face[0], face[i - 1], face[i]});
+            }
+        }
+    }
+
+    if (mesh.indices.empty()) {
+        LOG_MSG(ERRLevel::WARNING, "obj file has no faces: %s", fileName.c_str());
+        return ERR::INVALID;
+    }
+
+    if (!hasNormals) {
+        generateNormals(mesh);
+    }
+    return ERR::OK;
+}
+
+static void computeBounds(const MeshData& mesh, NanoMeshHeader& header) {
+    for (int i = 0; i < 3; i++) {
+        header.aabbMin[i] = mesh.vertices.empty() ? 0.0f : mesh.vertices[0].position[i];
+        header.aabbMax[i] = header.aabbMin[i];
+    }
+    for (const auto& vertex : mesh.vertices) {
+        for (int i = 0; i < 3; i++) {
+            header.aabbMin[i] = std::min(header.aabbMin[i], vertex.position[i]);
+            header.aabbMax[i] = std::max(header.aabbMax[i], vertex.position[i]);
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        header.quantizationOffset[i] = header.aabbMin[i];
+        float extent = header.aabbMax[i] - header.aabbMin[i];
+        header.quantizationScale[i] = extent > 0.0f ? extent : 1.0f;
+    }
+}
+
+ERR WriteNanoMesh(const std::string& fileName, const MeshData& mesh, const NanoMeshWriteOptions& options) {
+    NanoMeshHeader header{};
+    computeBounds(mesh, header);
+    header.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+    header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+
+    bool index32 = options.forceIndex32 || mesh.vertices.size() > UINT16_MAX;
+    if (index32) {
+        header.flags |= NANOMESH_FLAG_INDEX_32;
+    }
+    if (options.quantize) {
+        header.flags |= NANOMESH_FLAG_QUANTIZED;
+    }
+    header.vertexStride = options.quantize ? sizeof(NanoQuantizedVertex) : sizeof(NanoVertex);
+
+    // streams are packed exactly as the GPU reads them
+    std::vector<NanoMeshExtraStream> streams(2);
+    streams[0].type = NanoMeshStreamType::VERTEX;
+    if (options.quantize) {
+        streams[0].data.resize(mesh.vertices.size() * sizeof(NanoQuantizedVertex));
+        NanoQuantizedVertex* quantized = reinterpret_cast<NanoQuantizedVertex*>(streams[0].data.data());
+        for (size_t i = 0; i < mesh.vertices.size(); i++) {
+            quantized[i] = MeshQuantization::QuantizeVertex(mesh.vertices[i], header);
+        }
+    } else {
+        streams[0].data.resize(mesh.vertices.size() * sizeof(NanoVertex));
+        memcpy(streams[0].data.data(), mesh.vertices.data(), streams[0].data.size());
+    }
+
+    streams[1].type = NanoMeshStreamType::INDEX;
+    if (index32) {
+        streams[1].data.resize(mesh.indices.size() * sizeof(uint32_t));
+        memcpy(streams[1].data.data(), mesh.indices.data(), streams[1].data.size());
+    } else {
+        streams[1].data.resize(mesh.indices.size() * sizeof(uint16_t));
+        uint16_t* indices16 = reinterpret_cast<uint16_t*>(streams[1].data.data());
+        for (size_t i = 0; i < mesh.indices.size(); i++) {
+            indices16[i] = static_cast<uint16_t>(mesh.indices[i]);
+        }
+    }
+    streams.insert(streams.end(), options.extraStreams.begin(), options.extraStreams.end());
+    header.streamCount = static_cast<uint32_t>(streams.size());
+
+    std::vector<NanoMeshStream> streamTable(streams.size());
+    uint64_t offset = MeshQuantization::AlignUp(sizeof(NanoMeshHeader) + sizeof(NanoMeshStream) * streams.size(), NANOMESH_STREAM_ALIGNMENT);
+    for (size_t i = 0; i < streams.size(); i++) {
+        streamTable[i].type = streams[i].type;
+        streamTable[i].compression = NanoMeshCompression::NONE;
+        streamTable[i].offset = offset;
+        streamTable[i].size = streams[i].data.size();
+        streamTable[i].uncompressedSize = streams[i].data.size();
+        offset = MeshQuantization::AlignUp(offset + streams[i].data.size(), NANOMESH_STREAM_ALIGNMENT);
+    }
+
+    std::vector<uint8_t> fileData(offset, 0);
+    memcpy(fileData.data(), &header, sizeof(header));
+    memcpy(fileData.data() + sizeof(header), streamTable.data(), sizeof(NanoMeshStream) * streamTable.size());
+    for (size_t i = 0; i < streams.size(); i++) {
+        if (!streams[i].data.empty()) {
+            memcpy(fileData.data() + streamTable[i].offset, streams[i].data.data(), streams[i].data.size());
+        }
+    }
+
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        LOG_MSG(ERRLevel::WARNING, "could not open output file: %s", fileName.c_str());
+        return ERR::NOT_FOUND;
+    }
+    file.write(reinterpret_cast<const char*>(fileData.data()), static_cast<std::streamsize>(fileData.size()));
+    return file.good() ? ERR::OK : ERR::INVALID;
+}
+
+ERR ReadNanoMesh(const std::string& fileName, MeshData& mesh, std::vector<NanoMeshExtraStream>* extraStreams) {
+    NanoMappedFile file{};
+    ERR err = file.Open(fileName);
+    if (err != ERR::OK) {
+        return err;
+    }
+
+    NanoMeshView view{};
+    if (view.Open(file.GetData(), file.GetSize()) != ERR::OK) {
+        LOG_MSG(ERRLevel::WARNING, "not a valid nmesh file (or wrong version): %s", fileName.c_str());
+        return ERR::INVALID;
+    }
+
+    const NanoMeshStream* vertexStream = view.FindStream(NanoMeshStreamType::VERTEX);
+    const NanoMeshStream* indexStream = view.FindStream(NanoMeshStreamType::INDEX);
+    if (!vertexStream || !indexStream) {
+        return ERR::INVALID;
+    }
+
+    const NanoMeshHeader& header = *view.header;
+    mesh = {};
+    mesh.vertices.resize(header.vertexCount);
+    if (header.flags & NANOMESH_FLAG_QUANTIZED) {
+        const NanoQuantizedVertex* quantized = reinterpret_cast<const NanoQuantizedVertex*>(view.GetStreamData(*vertexStream));
+        for (uint32_t i = 0; i < header.vertexCount; i++) {
+            mesh.vertices[i] = MeshQuantization::DequantizeVertex(quantized[i], header);
+        }
+    } else {
+        memcpy(mesh.vertices.data(), view.GetStreamData(*vertexStream), header.vertexCount * sizeof(NanoVertex));
+    }
+
+    mesh.indices.resize(header.indexCount);
+    if (header.flags & NANOMESH_FLAG_INDEX_32) {
+        memcpy(mesh.indices.data(), view.GetStreamData(*indexStream), header.indexCount * sizeof(uint32_t));
+    } else {
+        const uint16_t* indices16 = reinterpret_cast<const uint16_t*>(view.GetStreamData(*indexStream));
+        for (uint32_t i = 0; i < header.indexCount; i++) {
+            mesh.indices[i] = indices16[i];
+        }
+    }
+
+    if (extraStreams) {
+        extraStreams->clear();
+        for (uint32_t i = 0; i < header.streamCount; i++) {
+            const NanoMeshStream& stream = view.streams[i];
+            if (stream.type == NanoMeshStreamType::VERTEX || stream.type == NanoMeshStreamType::INDEX) {
+                continue;
+            }
+            NanoMeshExtraStream extra{};
+            extra.type = stream.type;
+            extra.data.assign(view.GetStreamData(stream), view.GetStreamData(stream) + stream.size);
+            extraStreams->push_back(std::move(extra));
+        }
+    }
+    return ERR::OK;
+}
+
+ERR LoadMesh(const std::string& fileName, MeshData& mesh) {
+    if (fileName.size() > 4 && fileName.substr(fileName.size() - 4) == ".obj") {
+        return LoadObj(fileName, mesh);
+    }
+
+    std::vector<NanoMeshExtraStream> extraStreams{};
+    ERR err = ReadNanoMesh(fileName, mesh, &extraStreams);
+    if (err != ERR::OK) {
+        return err;
+    }
+
+    // only LOD 0 is kept, the tools regenerate the coarser levels from it anyway
+    for (const auto& stream : extraStreams) {
+        if (stream.type == NanoMeshStreamType::LODS && stream.data.size() >= sizeof(NanoMeshLod)) {
+            NanoMeshLod lod0{};
+            memcpy(&lod0, stream.data.data(), sizeof(NanoMeshLod));
+            mesh.indices.erase(mesh.indices.begin() + lod0.indexOffset + lod0.indexCount, mesh.indices.end());
+            mesh.indices.erase(mesh.indices.begin(), mesh.indices.begin() + lod0.indexOffset);
+        }
+    }
+    return err;
+}
+
+} // namespace MeshIO
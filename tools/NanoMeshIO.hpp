@@ -0,0 +1,38 @@
+#ifndef NANOMESHIO_H_
+#define NANOMESHIO_H_
+
+#include "NanoError.hpp"
+#include "NanoMeshFormat.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// CPU side mesh used by the offline tools. Always full precision and 32 bit indices, the writer picks the packing
+struct MeshData {
+    std::vector<NanoVertex> vertices{};
+    std::vector<uint32_t> indices{};
+};
+
+// any stream other than VERTEX / INDEX, written as is after them
+struct NanoMeshExtraStream {
+    NanoMeshStreamType type = NanoMeshStreamType::VERTEX;
+    std::vector<uint8_t> data{};
+};
+
+struct NanoMeshWriteOptions {
+    bool quantize = false;
+    bool forceIndex32 = false;
+    std::vector<NanoMeshExtraStream> extraStreams{};
+};
+
+namespace MeshIO {
+// Wavefront OBJ: v / vt / vn / f. Faces are fan triangulated, missing normals are generated from the faces
+ERR LoadObj(const std::string& fileName, MeshData& mesh);
+ERR WriteNanoMesh(const std::string& fileName, const MeshData& mesh, const NanoMeshWriteOptions& options);
+// quantized files are dequantized, so tools can chain on any .nmesh
+ERR ReadNanoMesh(const std::string& fileName, MeshData& mesh, std::vector<NanoMeshExtraStream>* extraStreams = nullptr);
+ERR LoadMesh(const std::string& fileName, MeshData& mesh); // picks the reader from the extension, LOD 0 only for .nmesh
+} // namespace MeshIO
+
+#endif // NANOMESHIO_H_
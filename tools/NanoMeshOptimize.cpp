@@ -0,0 +1,587 @@
+#include "NanoMeshOptimize.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace MeshOptimize {
+
+static void sub(const float a[3], const float b[3], float out[3]) {
+    out[0] = a[0] - b[0];
+    out[1] = a[1] - b[1];
+    out[2] = a[2] - b[2];
+}
+
+static void cross(const float a[3], const float b[3], float out[3]) {
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static float dot(const float a[3], const float b[3]) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// unnormalized, its length is twice the triangle area
+static void triangleNormal(const std::vector<NanoVertex>& vertices, const uint32_t* triangle, float out[3]) {
+    float e0[3], e1[3];
+    sub(vertices[triangle[1]].position, vertices[triangle[0]].position, e0);
+    sub(vertices[triangle[2]].position, vertices[triangle[0]].position, e1);
+    cross(e0, e1, out);
+}
+
+// returns the number of misses, the cache is a ring of vertex indices (FIFO, like the post transform cache of most GPUs)
+struct FifoCache {
+    std::vector<uint32_t> timestamps{}; // per vertex, time it entered the cache
+    uint32_t time = 0;
+    uint32_t size = 0;
+
+    FifoCache(uint32_t vertexCount, uint32_t cacheSize) : timestamps(vertexCount, 0), time(cacheSize + 1), size(cacheSize) {}
+
+    void Reset() { time += size + 1; }
+
+    uint32_t Update(const uint32_t* triangle) {
+        uint32_t misses = 0;
+        for (uint32_t k = 0; k < 3; k++) {
+            if (time - timestamps[triangle[k]] > size) {
+                timestamps[triangle[k]] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+};
+
+VertexCacheStatistics AnalyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize) {
+    VertexCacheStatistics stats{};
+    if (indices.empty()) {
+        return stats;
+    }
+
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> referenced(vertexCount, false);
+    uint32_t referencedCount = 0;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        stats.vertexTransforms += cache.Update(&indices[i]);
+        for (uint32_t k = 0; k < 3; k++) {
+            if (!referenced[indices[i + k]]) {
+                referenced[indices[i + k]] = true;
+                referencedCount++;
+            }
+        }
+    }
+
+    stats.acmr = static_cast<float>(stats.vertexTransforms) / static_cast<float>(indices.size() / 3);
+    stats.atvr = static_cast<float>(stats.vertexTransforms) / static_cast<float>(referencedCount);
+    return stats;
+}
+
+// Vertex cache
+////////////////////////////////////////////////////////////////////////////////
+
+static float vertexScore(int32_t cachePosition, uint32_t remainingTriangles) {
+    if (remainingTriangles == 0) {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            // the vertices of the last triangle get a fixed score, otherwise the next triangle would always reuse the same edge
+            score = 0.75f;
+        } else {
+            float scaler = 1.0f / static_cast<float>(OPTIMIZER_CACHE_SIZE - 3);
+            score = std::pow(1.0f - static_cast<float>(cachePosition - 3) * scaler, 1.5f);
+        }
+    }
+
+    // boost vertices with few triangles left, so lone triangles get cleared instead of left behind for a later cache miss
+    score += 2.0f / std::sqrt(static_cast<float>(remainingTriangles));
+    return score;
+}
+
+void OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount) {
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // vertex -> triangle adjacency, compacted as triangles get emitted
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++) {
+        remaining[indices[i]]++;
+    }
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remaining[v];
+    }
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    {
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++) {
+            for (uint32_t k = 0; k < 3; k++) {
+                adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+            }
+        }
+    }
+
+    std::vector<int32_t> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount, 0.0f);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        score[v] = vertexScore(-1, remaining[v]);
+    }
+
+    std::vector<float> triangleScore(triangleCount, 0.0f);
+    for (size_t t = 0; t < triangleCount; t++) {
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> result{};
+    result.reserve(triangleCount * 3);
+
+    std::vector<uint32_t> cache{};
+    std::vector<uint32_t> newCache{};
+    cache.reserve(OPTIMIZER_CACHE_SIZE + 3);
+    newCache.reserve(OPTIMIZER_CACHE_SIZE + 3);
+
+    size_t deadEndCursor = 0;
+    int64_t bestTriangle = -1;
+    for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+        if (bestTriangle < 0) {
+            // nothing in the cache has triangles left, restart from the first triangle that wasn't emitted yet
+            while (emitted[deadEndCursor]) {
+                deadEndCursor++;
+            }
+            bestTriangle = static_cast<int64_t>(deadEndCursor);
+        }
+
+        const uint32_t* triangle = &indices[bestTriangle * 3];
+        emitted[bestTriangle] = true;
+        result.insert(result.end(), triangle, triangle + 3);
+
+        // drop the triangle from the adjacency of its vertices
+        for (uint32_t k = 0; k < 3; k++) {
+            uint32_t v = triangle[k];
+            uint32_t* begin = &adjacency[adjacencyOffsets[v]];
+            uint32_t* end = begin + remaining[v];
+            uint32_t* it = std::find(begin, end, static_cast<uint32_t>(bestTriangle));
+            if (it != end) {
+                std::swap(*it, *(end - 1));
+                remaining[v]--;
+            }
+        }
+
+        // LRU: the triangle's vertices go to the front, the rest is shifted back
+        newCache.clear();
+        for (uint32_t k = 0; k < 3; k++) {
+            if (std::find(newCache.begin(), newCache.end(), triangle[k]) == newCache.end()) {
+                newCache.push_back(triangle[k]); // degenerate triangles repeat a vertex
+            }
+        }
+        for (uint32_t v : cache) {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                newCache.push_back(v);
+            }
+        }
+        for (size_t i = OPTIMIZER_CACHE_SIZE; i < newCache.size(); i++) {
+            cachePosition[newCache[i]] = -1;
+            score[newCache[i]] = vertexScore(-1, remaining[newCache[i]]);
+        }
+        if (newCache.size() > OPTIMIZER_CACHE_SIZE) {
+            newCache.resize(OPTIMIZER_CACHE_SIZE);
+        }
+        cache.swap(newCache);
+
+        for (size_t i = 0; i < cache.size(); i++) {
+            cachePosition[cache[i]] = static_cast<int32_t>(i);
+            score[cache[i]] = vertexScore(static_cast<int32_t>(i), remaining[cache[i]]);
+        }
+
+        // only triangles touching the cache can have changed, the best of them is the next one
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+        for (uint32_t v : cache) {
+            for (uint32_t i = 0; i < remaining[v]; i++) {
+                uint32_t t = adjacency[adjacencyOffsets[v] + i];
+                triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+    }
+
+    indices.swap(result);
+}
+
+// Overdraw
+////////////////////////////////////////////////////////////////////////////////
+
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<NanoVertex>& vertices, float threshold) {
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+    const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+
+    // hard boundaries: a triangle that misses on all three vertices starts a new strip anyway, splitting there is free
+    std::vector<size_t> hardBoundaries{};
+    {
+        FifoCache cache(vertexCount, VERTEX_CACHE_SIZE);
+        for (size_t t = 0; t < triangleCount; t++) {
+            if (cache.Update(&indices[t * 3]) == 3) {
+                hardBoundaries.push_back(t);
+            }
+        }
+        hardBoundaries.push_back(triangleCount);
+    }
+
+    // soft boundaries: split a hard cluster again once the local ACMR is within threshold of the cluster's own ACMR,
+    // which trades a few extra transforms for many more (smaller) clusters to sort
+    std::vector<size_t> clusters{};
+    {
+        FifoCache cache(vertexCount, VERTEX_CACHE_SIZE);
+        for (size_t c = 0; c + 1 < hardBoundaries.size(); c++) {
+            size_t start = hardBoundaries[c];
+            size_t end = hardBoundaries[c + 1];
+
+            cache.Reset();
+            uint32_t clusterMisses = 0;
+            for (size_t t = start; t < end; t++) {
+                clusterMisses += cache.Update(&indices[t * 3]);
+            }
+            float clusterThreshold = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+            clusters.push_back(start);
+            cache.Reset();
+            uint32_t runningMisses = 0;
+            uint32_t runningTriangles = 0;
+            for (size_t t = start; t < end; t++) {
+                runningMisses += cache.Update(&indices[t * 3]);
+                runningTriangles++;
+                if (t + 1 < end && static_cast<float>(runningMisses) / static_cast<float>(runningTriangles) <= clusterThreshold) {
+                    clusters.push_back(t + 1);
+                    cache.Reset();
+                    runningMisses = 0;
+                    runningTriangles = 0;
+                }
+            }
+        }
+        clusters.push_back(triangleCount);
+    }
+
+    const size_t clusterCount = clusters.size() - 1;
+    std::vector<float> clusterCentroids(clusterCount * 3, 0.0f);
+    std::vector<float> clusterNormals(clusterCount * 3, 0.0f);
+    float meshCentroid[3] = {0.0f, 0.0f, 0.0f};
+    float meshArea = 0.0f;
+
+    for (size_t c = 0; c < clusterCount; c++) {
+        float* centroid = &clusterCentroids[c * 3];
+        float* normal = &clusterNormals[c * 3];
+        float clusterArea = 0.0f;
+
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+            const uint32_t* triangle = &indices[t * 3];
+            float n[3];
+            triangleNormal(vertices, triangle, n);
+            float area = std::sqrt(dot(n, n));
+
+            for (uint32_t axis = 0; axis < 3; axis++) {
+                float center =
+                    (vertices[triangle[0]].position[axis] + vertices[triangle[1]].position[axis] + vertices[triangle[2]].position[axis]) / 3.0f;
+                centroid[axis] += center * area;
+                normal[axis] += n[axis];
+            }
+            clusterArea += area;
+        }
+
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            meshCentroid[axis] += centroid[axis];
+            centroid[axis] = clusterArea > 0.0f ? centroid[axis] / clusterArea : 0.0f;
+        }
+        meshArea += clusterArea;
+
+        float length = std::sqrt(dot(normal, normal));
+        if (length > 0.0f) {
+            normal[0] /= length;
+            normal[1] /= length;
+            normal[2] /= length;
+        }
+    }
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        meshCentroid[axis] = meshArea > 0.0f ? meshCentroid[axis] / meshArea : 0.0f;
+    }
+
+    // clusters far out and facing away from the center are the likely occluders, they go first
+    std::vector<float> sortKeys(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) {
+        float offset[3];
+        sub(&clusterCentroids[c * 3], meshCentroid, offset);
+        sortKeys[c] = dot(offset, &clusterNormals[c * 3]);
+    }
+
+    std::vector<size_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<uint32_t> result{};
+    result.reserve(indices.size());
+    for (size_t c : order) {
+        result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+    }
+    indices.swap(result);
+}
+
+// Vertex fetch
+////////////////////////////////////////////////////////////////////////////////
+
+void OptimizeVertexFetch(MeshData& mesh) {
+    constexpr uint32_t unused = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> remap(mesh.vertices.size(), unused);
+    std::vector<NanoVertex> vertices{};
+    vertices.reserve(mesh.vertices.size());
+
+    for (uint32_t& index : mesh.indices) {
+        if (remap[index] == unused) {
+            remap[index] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    mesh.vertices.swap(vertices);
+}
+
+// Meshlets
+////////////////////////////////////////////////////////////////////////////////
+
+static void computeMeshletBounds(const std::vector<NanoVertex>& vertices, MeshletData& data, NanoMeshlet& meshlet) {
+    float minPos[3] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+    float maxPos[3] = {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()};
+    for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+        const float* position = vertices[data.vertices[meshlet.vertexOffset + i]].position;
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            minPos[axis] = std::min(minPos[axis], position[axis]);
+            maxPos[axis] = std::max(maxPos[axis], position[axis]);
+        }
+    }
+
+    float radiusSq = 0.0f;
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        meshlet.center[axis] = (minPos[axis] + maxPos[axis]) * 0.5f;
+    }
+    for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+        float offset[3];
+        sub(vertices[data.vertices[meshlet.vertexOffset + i]].position, meshlet.center, offset);
+        radiusSq = std::max(radiusSq, dot(offset, offset));
+    }
+    meshlet.radius = std::sqrt(radiusSq);
+
+    // normal cone: average direction, opened up until every triangle normal is inside
+    std::vector<float> normals{};
+    normals.reserve(meshlet.triangleCount * 3);
+    float axis[3] = {0.0f, 0.0f, 0.0f};
+    for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+        const uint8_t* local = &data.triangles[meshlet.triangleOffset + t * 3];
+        uint32_t triangle[3] = {data.vertices[meshlet.vertexOffset + local[0]], data.vertices[meshlet.vertexOffset + local[1]],
+                                data.vertices[meshlet.vertexOffset + local[2]]};
+        float n[3];
+        triangleNormal(vertices, triangle, n);
+        float length = std::sqrt(dot(n, n));
+        if (length == 0.0f) {
+            continue; // degenerate, doesn't constrain the cone
+        }
+        for (uint32_t k = 0; k < 3; k++) {
+            n[k] /= length;
+            axis[k] += n[k];
+            normals.push_back(n[k]);
+        }
+    }
+
+    meshlet.coneAxis[0] = meshlet.coneAxis[1] = meshlet.coneAxis[2] = 0.0f;
+    meshlet.coneCutoff = 1.0f;
+
+    float axisLength = std::sqrt(dot(axis, axis));
+    if (axisLength == 0.0f) {
+        return;
+    }
+    for (uint32_t k = 0; k < 3; k++) {
+        meshlet.coneAxis[k] = axis[k] / axisLength;
+    }
+
+    float minDot = 1.0f;
+    for (size_t i = 0; i < normals.size(); i += 3) {
+        minDot = std::min(minDot, dot(&normals[i], meshlet.coneAxis));
+    }
+
+    // wider than ~84 degrees: the cone would almost never cull anything, don't bother
+    if (minDot > 0.1f) {
+        meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+}
+
+MeshletData BuildMeshlets(const std::vector<uint32_t>& indices, const std::vector<NanoVertex>& vertices, uint32_t maxVertices,
+                          uint32_t maxTriangles) {
+    MeshletData data{};
+    if (indices.empty()) {
+        return data;
+    }
+
+    constexpr uint8_t unused = 0xff;
+    std::vector<uint8_t> localIndex(vertices.size(), unused);
+    NanoMeshlet meshlet{};
+
+    auto finishMeshlet = [&]() {
+        if (meshlet.triangleCount == 0) {
+            return;
+        }
+        for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+            localIndex[data.vertices[meshlet.vertexOffset + i]] = unused;
+        }
+        // keeps every meshlet's triangle list 4 byte aligned, so shaders can read it as uints
+        while (data.triangles.size() % 4 != 0) {
+            data.triangles.push_back(0);
+        }
+        computeMeshletBounds(vertices, data, meshlet);
+        data.meshlets.push_back(meshlet);
+
+        meshlet = {};
+        meshlet.vertexOffset = static_cast<uint32_t>(data.vertices.size());
+        meshlet.triangleOffset = static_cast<uint32_t>(data.triangles.size());
+    };
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        const uint32_t* triangle = &indices[i];
+        uint32_t newVertices = (localIndex[triangle[0]] == unused) + (localIndex[triangle[1]] == unused) + (localIndex[triangle[2]] == unused);
+        if (meshlet.vertexCount + newVertices > maxVertices || meshlet.triangleCount + 1 > maxTriangles) {
+            finishMeshlet();
+        }
+
+        for (uint32_t k = 0; k < 3; k++) {
+            uint32_t v = triangle[k];
+            if (localIndex[v] == unused) {
+                localIndex[v] = static_cast<uint8_t>(meshlet.vertexCount++);
+                data.vertices.push_back(v);
+            }
+            data.triangles.push_back(localIndex[v]);
+        }
+        meshlet.triangleCount++;
+    }
+    finishMeshlet();
+
+    return data;
+}
+
+// Overdraw analysis
+////////////////////////////////////////////////////////////////////////////////
+
+constexpr int32_t OVERDRAW_GRID_SIZE = 256;
+
+struct OverdrawRasterizer {
+    std::vector<float> depth = std::vector<float>(OVERDRAW_GRID_SIZE * OVERDRAW_GRID_SIZE, std::numeric_limits<float>::max());
+    uint64_t shaded = 0;
+
+    // top left rule, so pixels on an edge shared by two triangles are only shaded once
+    static bool isTopLeft(float dx, float dy) { return dy > 0.0f || (dy == 0.0f && dx < 0.0f); }
+
+    void Rasterize(const float* v0, const float* v1, const float* v2) {
+        float area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v1[1] - v0[1]) * (v2[0] - v0[0]);
+        if (area <= 0.0f) {
+            return; // back facing or degenerate
+        }
+
+        int32_t minX = std::max(0, static_cast<int32_t>(std::floor(std::min({v0[0], v1[0], v2[0]}))));
+        int32_t minY = std::max(0, static_cast<int32_t>(std::floor(std::min({v0[1], v1[1], v2[1]}))));
+        int32_t maxX = std::min(OVERDRAW_GRID_SIZE - 1, static_cast<int32_t>(std::ceil(std::max({v0[0], v1[0], v2[0]}))));
+        int32_t maxY = std::min(OVERDRAW_GRID_SIZE - 1, static_cast<int32_t>(std::ceil(std::max({v0[1], v1[1], v2[1]}))));
+
+        const float* edges[3][2] = {{v1, v2}, {v2, v0}, {v0, v1}};
+        bool topLeft[3];
+        for (uint32_t e = 0; e < 3; e++) {
+            topLeft[e] = isTopLeft(edges[e][1][0] - edges[e][0][0], edges[e][1][1] - edges[e][0][1]);
+        }
+
+        for (int32_t y = minY; y <= maxY; y++) {
+            for (int32_t x = minX; x <= maxX; x++) {
+                float px = static_cast<float>(x) + 0.5f;
+                float py = static_cast<float>(y) + 0.5f;
+
+                float w[3];
+                bool inside = true;
+                for (uint32_t e = 0; e < 3 && inside; e++) {
+                    const float* a = edges[e][0];
+                    const float* b = edges[e][1];
+                    w[e] = (b[0] - a[0]) * (py - a[1]) - (b[1] - a[1]) * (px - a[0]);
+                    inside = w[e] > 0.0f || (w[e] == 0.0f && topLeft[e]);
+                }
+                if (!inside) {
+                    continue;
+                }
+
+                float z = (w[0] * v0[2] + w[1] * v1[2] + w[2] * v2[2]) / area;
+                float& stored = depth[y * OVERDRAW_GRID_SIZE + x];
+                if (z < stored) {
+                    stored = z;
+                    shaded++;
+                }
+            }
+        }
+    }
+
+    uint64_t Covered() const {
+        return static_cast<uint64_t>(std::count_if(depth.begin(), depth.end(), [](float d) { return d != std::numeric_limits<float>::max(); }));
+    }
+};
+
+OverdrawStatistics AnalyzeOverdraw(const std::vector<uint32_t>& indices, const std::vector<NanoVertex>& vertices) {
+    OverdrawStatistics stats{};
+    if (indices.empty()) {
+        return stats;
+    }
+
+    float minPos[3] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+    float maxPos[3] = {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()};
+    for (uint32_t index : indices) {
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            minPos[axis] = std::min(minPos[axis], vertices[index].position[axis]);
+            maxPos[axis] = std::max(maxPos[axis], vertices[index].position[axis]);
+        }
+    }
+    float extent = std::max({maxPos[0] - minPos[0], maxPos[1] - minPos[1], maxPos[2] - minPos[2]});
+    float scale = extent > 0.0f ? 1.0f / extent : 0.0f;
+
+    // orthographic views along +-X, +-Y, +-Z. Looking from the other side mirrors the image, which flips the winding
+    for (uint32_t view = 0; view < 6; view++) {
+        uint32_t axis = view / 2;
+        bool flip = view % 2 == 1;
+        uint32_t u = (axis + 1) % 3;
+        uint32_t v = (axis + 2) % 3;
+
+        OverdrawRasterizer rasterizer{};
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            float projected[3][3];
+            for (uint32_t k = 0; k < 3; k++) {
+                const float* position = vertices[indices[i + k]].position;
+                float x = (position[u] - minPos[u]) * scale * static_cast<float>(OVERDRAW_GRID_SIZE);
+                float y = (position[v] - minPos[v]) * scale * static_cast<float>(OVERDRAW_GRID_SIZE);
+                float z = (position[axis] - minPos[axis]) * scale;
+                projected[k][0] = flip ? static_cast<float>(OVERDRAW_GRID_SIZE) - x : x;
+                projected[k][1] = y;
+                projected[k][2] = flip ? z : 1.0f - z; // the camera sits on the far side of the axis unless mirrored
+            }
+            rasterizer.Rasterize(projected[0], projected[1], projected[2]);
+        }
+
+        stats.pixelsCovered += rasterizer.Covered();
+        stats.pixelsShaded += rasterizer.shaded;
+    }
+
+    stats.overdraw = stats.pixelsCovered ? static_cast<float>(stats.pixelsShaded) / static_cast<float>(stats.pixelsCovered) : 0.0f;
+    return stats;
+}
+
+} // namespace MeshOptimize
@@ -0,0 +1,51 @@
+#ifndef NANOMESHOPTIMIZE_H_
+#define NANOMESHOPTIMIZE_H_
+
+#include "NanoMeshFormat.hpp"
+#include "NanoMeshIO.hpp"
+
+#include <cstdint>
+#include <vector>
+
+struct VertexCacheStatistics {
+    uint32_t vertexTransforms = 0; // cache misses
+    float acmr = 0.0f;             // transforms per triangle, 0.5 is the limit for a regular grid, 3 is no reuse at all
+    float atvr = 0.0f;             // transforms per referenced vertex, 1 is perfect
+};
+
+struct OverdrawStatistics {
+    uint64_t pixelsCovered = 0;
+    uint64_t pixelsShaded = 0;
+    float overdraw = 0.0f; // shaded / covered, 1 is perfect
+};
+
+struct MeshletData {
+    std::vector<NanoMeshlet> meshlets{};
+    std::vector<uint32_t> vertices{};
+    std::vector<uint8_t> triangles{};
+};
+
+namespace MeshOptimize {
+constexpr uint32_t VERTEX_CACHE_SIZE = 16;         // FIFO size used for the statistics, close to what current hardware does
+constexpr uint32_t OPTIMIZER_CACHE_SIZE = 32;      // LRU size the reordering models
+constexpr float OVERDRAW_THRESHOLD = 1.05f;        // how much ACMR the overdraw pass may give up
+constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;    // 124 * 3 bytes + padding stays below 384
+
+// Forsyth's linear speed vertex cache optimisation, greedy triangle emission driven by cache position and valence
+void OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount);
+// Splits the cache optimized order into clusters (Sander et al. "Fast triangle reordering") and sorts them front to back
+// from the outside in, so occluders tend to be drawn first. Must run after OptimizeVertexCache
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<NanoVertex>& vertices, float threshold = OVERDRAW_THRESHOLD);
+// Renumbers vertices in order of first use, unreferenced vertices are dropped
+void OptimizeVertexFetch(MeshData& mesh);
+// Greedy build in index order, so it inherits the locality of the passes above
+MeshletData BuildMeshlets(const std::vector<uint32_t>& indices, const std::vector<NanoVertex>& vertices, uint32_t maxVertices = MESHLET_MAX_VERTICES,
+                          uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+VertexCacheStatistics AnalyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+// rasterizes the mesh from the six axis directions into a small depth buffer, in index order
+OverdrawStatistics AnalyzeOverdraw(const std::vector<uint32_t>& indices, const std::vector<NanoVertex>& vertices);
+} // namespace MeshOptimize
+
+#endif // NANOMESHOPTIMIZE_H_
@@ -0,0 +1,134 @@
+#include "NanoLogger.hpp"
+#include "NanoMeshIO.hpp"
+#include "NanoMeshOptimize.hpp"
+#include "NanoMeshSimplify.hpp"
+
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+static void printStatistics(const char* label, const MeshData& mesh) {
+    VertexCacheStatistics cache = MeshOptimize::AnalyzeVertexCache(mesh.indices, static_cast<uint32_t>(mesh.vertices.size()));
+    OverdrawStatistics overdraw = MeshOptimize::AnalyzeOverdraw(mesh.indices, mesh.vertices);
+    LOG_MSG(ERRLevel::INFO, "%s: ACMR %f, ATVR %f (FIFO %d), overdraw %f", label, cache.acmr, cache.atvr, MeshOptimize::VERTEX_CACHE_SIZE,
+            overdraw.overdraw);
+}
+
+static void appendStream(NanoMeshWriteOptions& options, NanoMeshStreamType type, const void* data, size_t size) {
+    NanoMeshExtraStream stream{};
+    stream.type = type;
+    stream.data.resize(size);
+    memcpy(stream.data.data(), data, size);
+    options.extraStreams.push_back(std::move(stream));
+}
+
+// NanoMeshOptimizer <input.obj|input.nmesh> <output.nmesh> [--quantize] [--index32] [--no-overdraw] [--no-meshlets]
+//                   [--lods <count>] [--lod-ratio <ratio>] [--lod-error <fraction of the mesh extent>]
+int main(int argc, char *argv[]) {
+    Logger::setSeverity(ERRLevel::INFO);
+
+    if (argc < 3) {
+        fprintf(stderr,
+                "usage: %s <input.obj|input.nmesh> <output.nmesh> [--quantize] [--index32] [--no-overdraw] [--no-meshlets] [--lods <count>] "
+                "[--lod-ratio <ratio>] [--lod-error <fraction>]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    NanoMeshWriteOptions options{};
+    bool optimizeOverdraw = true;
+    bool buildMeshlets = true;
+    uint32_t lodCount = 4;
+    float lodRatio = 0.5f;
+    float lodError = 0.05f;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--quantize") == 0) {
+            options.quantize = true;
+        } else if (strcmp(argv[i], "--index32") == 0) {
+            options.forceIndex32 = true;
+        } else if (strcmp(argv[i], "--no-overdraw") == 0) {
+            optimizeOverdraw = false;
+        } else if (strcmp(argv[i], "--no-meshlets") == 0) {
+            buildMeshlets = false;
+        } else if (strcmp(argv[i], "--lods") == 0 && i + 1 < argc) {
+            lodCount = static_cast<uint32_t>(std::max(1, atoi(argv[++i])));
+        } else if (strcmp(argv[i], "--lod-ratio") == 0 && i + 1 < argc) {
+            lodRatio = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--lod-error") == 0 && i + 1 < argc) {
+            lodError = static_cast<float>(atof(argv[++i]));
+        } else {
+            fprintf(stderr, "unknown option: %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    MeshData mesh{};
+    if (MeshIO::LoadMesh(argv[1], mesh) != ERR::OK) {
+        return EXIT_FAILURE;
+    }
+
+    printStatistics("before", mesh);
+
+    // order matters: overdraw works on the clusters the cache pass produced, fetch follows the final index order
+    MeshOptimize::OptimizeVertexCache(mesh.indices, static_cast<uint32_t>(mesh.vertices.size()));
+    printStatistics("vertex cache", mesh);
+
+    if (optimizeOverdraw) {
+        MeshOptimize::OptimizeOverdraw(mesh.indices, mesh.vertices);
+        printStatistics("overdraw", mesh);
+    }
+
+    // the levels share the vertex buffer and are simplified from the optimized LOD 0, so its order is kept intact
+    float extent = 0.0f;
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        auto [minIt, maxIt] = std::minmax_element(mesh.vertices.begin(), mesh.vertices.end(),
+                                                  [axis](const NanoVertex& a, const NanoVertex& b) { return a.position[axis] < b.position[axis]; });
+        extent = std::max(extent, maxIt->position[axis] - minIt->position[axis]);
+    }
+    std::vector<MeshLod> lods = MeshSimplify::GenerateLods(mesh, lodCount, lodRatio, lodError * extent);
+
+    std::vector<NanoMeshLod> lodTable{};
+    std::vector<uint32_t> allIndices{};
+    for (auto& lod : lods) {
+        if (lodTable.size() > 0) {
+            MeshOptimize::OptimizeVertexCache(lod.indices, static_cast<uint32_t>(mesh.vertices.size()));
+        }
+        lodTable.push_back({static_cast<uint32_t>(allIndices.size()), static_cast<uint32_t>(lod.indices.size()), lod.error, 0});
+        allIndices.insert(allIndices.end(), lod.indices.begin(), lod.indices.end());
+        LOG_MSG(ERRLevel::INFO, "LOD %d: %d triangles, error %f", static_cast<int>(lodTable.size() - 1), static_cast<int>(lod.indices.size() / 3),
+                lod.error);
+    }
+    mesh.indices.swap(allIndices);
+    if (lodTable.size() > 1) {
+        appendStream(options, NanoMeshStreamType::LODS, lodTable.data(), lodTable.size() * sizeof(NanoMeshLod));
+    }
+
+    // LOD 0 comes first in the index buffer, so it decides the vertex order
+    MeshOptimize::OptimizeVertexFetch(mesh);
+
+    if (buildMeshlets) {
+        std::vector<uint32_t> lod0Indices(mesh.indices.begin(), mesh.indices.begin() + lodTable[0].indexCount);
+        MeshletData meshlets = MeshOptimize::BuildMeshlets(lod0Indices, mesh.vertices);
+        appendStream(options, NanoMeshStreamType::MESHLETS, meshlets.meshlets.data(), meshlets.meshlets.size() * sizeof(NanoMeshlet));
+        appendStream(options, NanoMeshStreamType::MESHLET_VERTICES, meshlets.vertices.data(), meshlets.vertices.size() * sizeof(uint32_t));
+        appendStream(options, NanoMeshStreamType::MESHLET_TRIANGLES, meshlets.triangles.data(), meshlets.triangles.size());
+
+        uint32_t culledByCone = 0;
+        for (const auto& meshlet : meshlets.meshlets) {
+            culledByCone += meshlet.coneCutoff < 1.0f;
+        }
+        float meshletCount = static_cast<float>(meshlets.meshlets.size());
+        LOG_MSG(ERRLevel::INFO, "%d meshlets, %f vertices / %f triangles on average, %d with a usable normal cone",
+                static_cast<int>(meshlets.meshlets.size()), static_cast<float>(meshlets.vertices.size()) / meshletCount,
+                static_cast<float>(lod0Indices.size() / 3) / meshletCount, culledByCone);
+    }
+
+    if (MeshIO::WriteNanoMesh(argv[2], mesh, options) != ERR::OK) {
+        return EXIT_FAILURE;
+    }
+
+    LOG_MSG(ERRLevel::INFO, "wrote %s: %d vertices, %d indices", argv[2], static_cast<int>(mesh.vertices.size()),
+            static_cast<int>(mesh.indices.size()));
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,329 @@
+#include "NanoMeshSimplify.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+namespace MeshSimplify {
+
+// symmetric 4x4 plane quadric, weighted by triangle area. Error is normalized by the accumulated weight so it reads as a distance
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+    double b0 = 0, b1 = 0, b2 = 0;
+    double c = 0;
+    double weight = 0;
+
+    void AddPlane(const double n[3], double d, double w) {
+        a00 += w * n[0] * n[0];
+        a01 += w * n[0] * n[1];
+        a02 += w * n[0] * n[2];
+        a11 += w * n[1] * n[1];
+        a12 += w * n[1] * n[2];
+        a22 += w * n[2] * n[2];
+        b0 += w * n[0] * d;
+        b1 += w * n[1] * d;
+        b2 += w * n[2] * d;
+        c += w * d * d;
+        weight += w;
+    }
+
+    void Add(const Quadric& other) {
+        a00 += other.a00;
+        a01 += other.a01;
+        a02 += other.a02;
+        a11 += other.a11;
+        a12 += other.a12;
+        a22 += other.a22;
+        b0 += other.b0;
+        b1 += other.b1;
+        b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+    }
+
+    // squared distance
+    double Evaluate(const float p[3]) const {
+        double x = p[0], y = p[1], z = p[2];
+        double e = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) + 2.0 * (b0 * x + b1 * y + b2 * z);
+        e += c;
+        return weight > 0.0 ? std::max(e, 0.0) / weight : 0.0;
+    }
+};
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    float cost;     // geometric + attribute, used for ordering
+    float distance; // geometric only, squared
+};
+
+static void triangleNormal(const std::vector<NanoVertex>& vertices, uint32_t i0, uint32_t i1, uint32_t i2, double out[3]) {
+    const float* p0 = vertices[i0].position;
+    const float* p1 = vertices[i1].position;
+    const float* p2 = vertices[i2].position;
+    double e0[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    double e1[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+    out[0] = e0[1] * e1[2] - e0[2] * e1[1];
+    out[1] = e0[2] * e1[0] - e0[0] * e1[2];
+    out[2] = e0[0] * e1[1] - e0[1] * e1[0];
+}
+
+static float attributeDistance(const NanoVertex& a, const NanoVertex& b) {
+    float distance = 0.0f;
+    for (uint32_t k = 0; k < 3; k++) {
+        distance += (a.normal[k] - b.normal[k]) * (a.normal[k] - b.normal[k]);
+    }
+    for (uint32_t k = 0; k < 2; k++) {
+        distance += (a.uv[k] - b.uv[k]) * (a.uv[k] - b.uv[k]);
+    }
+    return distance;
+}
+
+// vertices that share a position with another vertex (uv / normal seams), or sit on an open or non manifold edge
+static std::vector<bool> findLockedVertices(const std::vector<uint32_t>& indices, const std::vector<NanoVertex>& vertices) {
+    std::vector<uint32_t> positionId(vertices.size());
+    std::vector<uint32_t> positionUses{};
+    {
+        std::map<std::tuple<float, float, float>, uint32_t> positions{};
+        for (size_t v = 0; v < vertices.size(); v++) {
+            auto key = std::make_tuple(vertices[v].position[0], vertices[v].position[1], vertices[v].position[2]);
+            auto [it, inserted] = positions.emplace(key, static_cast<uint32_t>(positionUses.size()));
+            if (inserted) {
+                positionUses.push_back(0);
+            }
+            positionId[v] = it->second;
+            positionUses[it->second]++;
+        }
+    }
+
+    std::vector<bool> locked(vertices.size(), false);
+    for (size_t v = 0; v < vertices.size(); v++) {
+        locked[v] = positionUses[positionId[v]] > 1;
+    }
+
+    // topology on welded positions, so a seam doesn't count as a border
+    std::unordered_map<uint64_t, uint32_t> edgeUses{};
+    edgeUses.reserve(indices.size());
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        for (uint32_t k = 0; k < 3; k++) {
+            uint64_t a = positionId[indices[i + k]];
+            uint64_t b = positionId[indices[i + (k + 1) % 3]];
+            edgeUses[std::min(a, b) << 32 | std::max(a, b)]++;
+        }
+    }
+
+    std::vector<bool> positionLocked(positionUses.size(), false);
+    for (const auto& [edge, uses] : edgeUses) {
+        if (uses != 2) {
+            positionLocked[edge >> 32] = true;
+            positionLocked[edge & 0xffffffff] = true;
+        }
+    }
+    for (size_t v = 0; v < vertices.size(); v++) {
+        locked[v] = locked[v] || positionLocked[positionId[v]];
+    }
+    return locked;
+}
+
+// collapsing from -> to must not turn any remaining triangle around from inside out or to a sliver
+static bool flipsTriangle(const std::vector<uint32_t>& indices, const std::vector<NanoVertex>& vertices, const std::vector<uint32_t>& remap,
+                          const std::vector<uint32_t>& triangles, uint32_t from, uint32_t to) {
+    for (uint32_t t : triangles) {
+        uint32_t corners[3] = {remap[indices[t * 3]], remap[indices[t * 3 + 1]], remap[indices[t * 3 + 2]]};
+        if (corners[0] == to || corners[1] == to || corners[2] == to) {
+            continue; // collapses to nothing
+        }
+        if (corners[0] != from && corners[1] != from && corners[2] != from) {
+            continue;
+        }
+
+        double before[3], after[3];
+        triangleNormal(vertices, corners[0], corners[1], corners[2], before);
+        for (uint32_t k = 0; k < 3; k++) {
+            corners[k] = corners[k] == from ? to : corners[k];
+        }
+        triangleNormal(vertices, corners[0], corners[1], corners[2], after);
+
+        double dotNormals = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+        double lengthBefore = std::sqrt(before[0] * before[0] + before[1] * before[1] + before[2] * before[2]);
+        double lengthAfter = std::sqrt(after[0] * after[0] + after[1] * after[1] + after[2] * after[2]);
+        // more than ~75 degrees of rotation is treated as a flip as well
+        if (dotNormals <= 0.25 * lengthBefore * lengthAfter) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<uint32_t> Simplify(const std::vector<uint32_t>& indices, const std::vector<NanoVertex>& vertices, size_t targetIndexCount,
+                               float targetError, float* error) {
+    std::vector<uint32_t> result = indices;
+    float resultError = 0.0f;
+    const size_t vertexCount = vertices.size();
+
+    if (result.size() <= targetIndexCount || vertexCount == 0) {
+        if (error) {
+            *error = 0.0f;
+        }
+        return result;
+    }
+
+    float minPos[3] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+    float maxPos[3] = {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()};
+    for (const auto& vertex : vertices) {
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            minPos[axis] = std::min(minPos[axis], vertex.position[axis]);
+            maxPos[axis] = std::max(maxPos[axis], vertex.position[axis]);
+        }
+    }
+    float extent = std::max({maxPos[0] - minPos[0], maxPos[1] - minPos[1], maxPos[2] - minPos[2]});
+    float attributeScale = ATTRIBUTE_WEIGHT * ATTRIBUTE_WEIGHT * extent * extent;
+
+    std::vector<bool> locked = findLockedVertices(indices, vertices);
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i + 2 < result.size(); i += 3) {
+        double n[3];
+        triangleNormal(vertices, result[i], result[i + 1], result[i + 2], n);
+        double area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (area == 0.0) {
+            continue;
+        }
+        n[0] /= area;
+        n[1] /= area;
+        n[2] /= area;
+        const float* p = vertices[result[i]].position;
+        double d = -(n[0] * p[0] + n[1] * p[1] + n[2] * p[2]);
+        for (uint32_t k = 0; k < 3; k++) {
+            quadrics[result[i + k]].AddPlane(n, d, area * 0.5);
+        }
+    }
+
+    const float maxDistanceSq = targetError * targetError;
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+    std::vector<uint32_t> adjacency{};
+    std::vector<Collapse> collapses{};
+
+    while (result.size() > targetIndexCount) {
+        const size_t triangleCount = result.size() / 3;
+
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (uint32_t index : result) {
+            adjacencyOffsets[index + 1]++;
+        }
+        for (size_t v = 0; v < vertexCount; v++) {
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        }
+        adjacency.resize(result.size());
+        {
+            std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t t = 0; t < triangleCount; t++) {
+                for (uint32_t k = 0; k < 3; k++) {
+                    adjacency[fill[result[t * 3 + k]]++] = static_cast<uint32_t>(t);
+                }
+            }
+        }
+
+        collapses.clear();
+        for (size_t t = 0; t < triangleCount; t++) {
+            for (uint32_t k = 0; k < 3; k++) {
+                uint32_t a = result[t * 3 + k];
+                uint32_t b = result[t * 3 + (k + 1) % 3];
+                for (auto [from, to] : {std::make_pair(a, b), std::make_pair(b, a)}) {
+                    if (locked[from]) {
+                        continue;
+                    }
+                    float distance = static_cast<float>(quadrics[from].Evaluate(vertices[to].position));
+                    float cost = distance + attributeScale * attributeDistance(vertices[from], vertices[to]);
+                    collapses.push_back({from, to, cost, distance});
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+        for (size_t v = 0; v < vertexCount; v++) {
+            remap[v] = static_cast<uint32_t>(v);
+        }
+        std::fill(touched.begin(), touched.end(), false);
+
+        size_t remainingTriangles = triangleCount;
+        size_t collapsed = 0;
+        for (const Collapse& collapse : collapses) {
+            if (remainingTriangles * 3 <= targetIndexCount || collapse.distance > maxDistanceSq) {
+                break;
+            }
+            if (touched[collapse.from] || touched[collapse.to]) {
+                continue;
+            }
+
+            std::vector<uint32_t> triangles(adjacency.begin() + adjacencyOffsets[collapse.from],
+                                            adjacency.begin() + adjacencyOffsets[collapse.from + 1]);
+            if (flipsTriangle(result, vertices, remap, triangles, collapse.from, collapse.to)) {
+                continue;
+            }
+
+            for (uint32_t t : triangles) {
+                uint32_t c0 = remap[result[t * 3]], c1 = remap[result[t * 3 + 1]], c2 = remap[result[t * 3 + 2]];
+                remainingTriangles -= (c0 == collapse.to || c1 == collapse.to || c2 == collapse.to);
+            }
+
+            remap[collapse.from] = collapse.to;
+            touched[collapse.from] = touched[collapse.to] = true;
+            quadrics[collapse.to].Add(quadrics[collapse.from]);
+            resultError = std::max(resultError, collapse.distance);
+            collapsed++;
+        }
+
+        if (collapsed == 0) {
+            break;
+        }
+
+        size_t writeIndex = 0;
+        for (size_t t = 0; t < triangleCount; t++) {
+            uint32_t c0 = remap[result[t * 3]], c1 = remap[result[t * 3 + 1]], c2 = remap[result[t * 3 + 2]];
+            if (c0 == c1 || c1 == c2 || c0 == c2) {
+                continue;
+            }
+            result[writeIndex++] = c0;
+            result[writeIndex++] = c1;
+            result[writeIndex++] = c2;
+        }
+        result.resize(writeIndex);
+    }
+
+    if (error) {
+        *error = std::sqrt(resultError);
+    }
+    return result;
+}
+
+std::vector<MeshLod> GenerateLods(const MeshData& mesh, uint32_t lodCount, float ratio, float maxError) {
+    std::vector<MeshLod> lods{};
+    lods.push_back({mesh.indices, 0.0f});
+
+    size_t targetIndexCount = mesh.indices.size();
+    for (uint32_t level = 1; level < lodCount; level++) {
+        targetIndexCount = static_cast<size_t>(static_cast<float>(targetIndexCount / 3) * ratio) * 3;
+        if (targetIndexCount < 3) {
+            break;
+        }
+
+        // always from LOD 0, so the error stays the distance to the real mesh and doesn't pile up level over level
+        MeshLod lod{};
+        lod.indices = Simplify(mesh.indices, mesh.vertices, targetIndexCount, maxError, &lod.error);
+        if (static_cast<float>(lod.indices.size()) > static_cast<float>(lods.back().indices.size()) * MIN_LOD_REDUCTION) {
+            break;
+        }
+        // a coarser level can't be more accurate than a finer one, keeps the runtime selection monotonic
+        lod.error = std::max(lod.error, lods.back().error);
+        lods.push_back(std::move(lod));
+    }
+    return lods;
+}
+
+} // namespace MeshSimplify
@@ -0,0 +1,30 @@
+#ifndef NANOMESHSIMPLIFY_H_
+#define NANOMESHSIMPLIFY_H_
+
+#include "NanoMeshFormat.hpp"
+#include "NanoMeshIO.hpp"
+
+#include <cstdint>
+#include <vector>
+
+struct MeshLod {
+    std::vector<uint32_t> indices{};
+    float error = 0.0f; // object space distance to LOD 0, see NanoMeshLod
+};
+
+namespace MeshSimplify {
+constexpr float ATTRIBUTE_WEIGHT = 0.05f; // normal / uv difference cost, relative to the mesh extent
+constexpr float MIN_LOD_REDUCTION = 0.9f; // a level that keeps more than this of the previous one ends the chain
+
+// Quadric error metric edge collapse (Garland & Heckbert), vertices only ever collapse onto one of their neighbours so no
+// new vertices (and no new attributes) are made. Open borders and attribute seams are locked in place.
+// Returns the new index list, error is the largest object space deviation caused by any collapse
+std::vector<uint32_t> Simplify(const std::vector<uint32_t>& indices, const std::vector<NanoVertex>& vertices, size_t targetIndexCount,
+                               float targetError, float* error = nullptr);
+
+// LOD 0 is the input, every next level targets ratio times the triangles of the one before. Stops early when a level
+// can't be reduced any further without breaking the locked borders / seams
+std::vector<MeshLod> GenerateLods(const MeshData& mesh, uint32_t lodCount, float ratio, float maxError);
+} // namespace MeshSimplify
+
+#endif // NANOMESHSIMPLIFY_H_